@@ -0,0 +1,102 @@
+#ifndef CHECKPOINT_LIBRARY_INCLUDE_GUARD_HPP
+#define CHECKPOINT_LIBRARY_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Library for checkpointing the slam node in the background and restoring it after a restart
+///
+/// A checkpoint is a map file (map_file_library.hpp) with the odometry section, so it is written and mapped
+/// the same way and load_map can read it as a map.
+
+#include <nuslam/map_file_library.hpp>
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace checkpoint
+{
+    /// \brief flag of a checkpoint of the localization filter, whose state is only the pose
+    constexpr uint32_t CHECKPOINT_LOCALIZATION = 1;
+
+    /// \brief everything needed to resume the slam node where it was
+    struct Checkpoint
+    {
+        uint64_t sequence = 0;
+        int64_t stamp = 0;                              // ns
+        uint32_t flags = 0;
+        int32_t landmarkGeneration = 0;
+        map_file::OdometryBaseline odometry = {};       // the odometry published as odom -> body
+        map_file::OdometryBaseline prediction = {};     // the odometry the filter predicts from
+        std::vector<double> state;                      // (theta, x, y, x1, y1, ...)
+        std::vector<double> cov;                        // column major
+        std::vector<map_file::LandmarkInfo> landmarks;  // one per landmark of the state, with the fitted radii
+    };
+
+    /// \brief writes a checkpoint to a file, replacing it only once the new file is on disk
+    /// \param path - the file to write
+    /// \param snapshot - the checkpoint, cov must hold state.size() squared values and landmarks one per landmark
+    /// \param error - the reason the checkpoint was not written
+    /// \return true if the checkpoint was written
+    bool writeCheckpoint(const std::string & path, const Checkpoint & snapshot, std::string & error);
+
+    /// \brief maps a checkpoint file, checks it and copies it out
+    /// \param path - the file to read
+    /// \param snapshot - the checkpoint, its vectors keep their capacity
+    /// \param error - the reason the file could not be used
+    /// \return true if the checkpoint was read
+    bool readCheckpoint(const std::string & path, Checkpoint & snapshot, std::string & error);
+
+    /// \brief writes checkpoints on a background thread
+    /// Two snapshots are kept: the one being written, and the latest one submitted, which replaces any
+    /// submitted before it that was not written yet. Submitting only copies the snapshot, it never waits
+    /// for the disk.
+    class CheckpointWriter
+    {
+        private:
+            std::string path;
+
+            std::mutex mutex;
+            std::condition_variable wake;
+            Checkpoint pending;                 // the latest snapshot submitted
+            bool havePending;
+            bool stopping;
+            uint64_t nextSequence;
+            uint64_t written;
+            uint64_t replaced;
+            std::string error;
+
+            Checkpoint writing;                 // only touched by the thread
+            std::thread thread;
+
+            /// \brief writes each snapshot as it is submitted, until stopped
+            void run();
+
+        public:
+            /// \brief starts the writing thread
+            /// \param checkpointPath - the file to write
+            explicit CheckpointWriter(const std::string & checkpointPath);
+
+            CheckpointWriter(const CheckpointWriter &) = delete;
+            CheckpointWriter & operator=(const CheckpointWriter &) = delete;
+
+            /// \brief writes the last snapshot submitted and stops the thread
+            ~CheckpointWriter();
+
+            /// \brief hands a snapshot to the thread, its sequence is set here
+            /// \param snapshot - the checkpoint to write
+            void submit(const Checkpoint & snapshot);
+
+            /// \brief returns the number of checkpoints written
+            uint64_t numWritten();
+
+            /// \brief returns the number of snapshots replaced before they were written
+            uint64_t numReplaced();
+
+            /// \brief returns the reason the last write failed, empty if it succeeded
+            std::string lastError();
+    };
+}
+
+#endif
@@ -18,7 +18,7 @@ namespace circle_fit
     /// \brief function that clusters points in groups corresponding to individual landmarks
     /// \param minRange - the minimum range that the scanner can detect
     /// \param maxRange - the maximum range that the scanner can detect
-    /// \param ranges - the vector of ranges that the lidar scanner detects
+    /// \param ranges - the vector of ranges that the lidar scanner detects, evenly spaced around the full circle
     /// \return a vector of "clusters" that contain points for each cluster
     std::vector<std::vector<geometry_msgs::Point>> ClusterPoints(std::vector<float> ranges, double minRange, double maxRange);
 
@@ -0,0 +1,94 @@
+#ifndef CONSISTENCY_LIBRARY_INCLUDE_GUARD_HPP
+#define CONSISTENCY_LIBRARY_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Library for checking that a Kalman filter is consistent, from its normalized errors
+///
+/// When the filter is consistent the normalized innovation squared (NIS) of a range-bearing update is
+/// chi-square with 2 degrees of freedom, and the normalized estimation error squared (NEES) of the pose
+/// against the ground truth is chi-square with 3. The sum of a window of them is then chi-square with
+/// the window times as many degrees of freedom. A window mean above the upper bound means the filter
+/// is overconfident (its covariance is too small for its errors), below the lower bound underconfident.
+
+#include <array>
+#include <cstdint>
+#include <deque>
+
+namespace consistency
+{
+    /// \brief the outcome of the test of a window, the values of the FilterConsistency message
+    enum class Verdict : uint8_t
+    {
+        FILLING = 0,            // fewer samples than the window, nothing to tell yet
+        CONSISTENT,
+        OVERCONFIDENT,
+        UNDERCONFIDENT
+    };
+
+    /// \brief a quantile of the chi-square distribution, with the Wilson-Hilferty approximation
+    /// \param p - the probability, in (0, 1)
+    /// \param dof - the degrees of freedom
+    /// \return x such that P(X <= x) = p
+    double chiSquareQuantile(double p, double dof);
+
+    /// \brief tests a window of normalized errors against the chi-square distribution
+    /// Adding a sample and testing the window are constant time.
+    class ConsistencyMonitor
+    {
+        private:
+            int window;
+            int dof;
+            double lower;           // bounds of the window mean
+            double upper;
+
+            std::deque<double> samples;
+            double sum;
+            uint64_t total;
+            double last;
+
+        public:
+            /// \brief create a monitor with default parameters, for the NIS of range-bearing updates
+            ConsistencyMonitor();
+
+            /// \brief create a monitor
+            /// \param windowSize - the number of recent samples tested
+            /// \param degreesOfFreedom - of each sample, the size of the error vector
+            /// \param confidence - the probability that a consistent filter raises no alarm, in (0, 1)
+            ConsistencyMonitor(int windowSize, int degreesOfFreedom, double confidence);
+
+            /// \brief adds a sample, dropping the oldest once the window is full
+            /// Samples that are not finite are ignored.
+            /// \param value - the NIS or NEES
+            void add(double value);
+
+            /// \brief empties the window
+            void clear();
+
+            /// \brief the test of the samples in the window
+            Verdict verdict() const;
+
+            /// \brief the mean of the samples in the window, 0 if there are none
+            double mean() const;
+
+            /// \brief the lowest window mean of a consistent filter
+            double lowerBound() const;
+
+            /// \brief the highest window mean of a consistent filter
+            double upperBound() const;
+
+            /// \brief the last sample added
+            double latest() const;
+
+            /// \brief the number of samples added so far
+            uint64_t count() const;
+    };
+
+    /// \brief the NEES of a pose estimate
+    /// \param estimate - (theta, x, y)
+    /// \param truth - (theta, x, y)
+    /// \param cov - the covariance of the estimate, column major
+    /// \return e^T cov^-1 e, with the heading error wrapped to (-pi, pi], or -1 if cov is singular
+    double poseNees(const std::array<double, 3> & estimate, const std::array<double, 3> & truth,
+                    const std::array<double, 9> & cov);
+}
+
+#endif
@@ -0,0 +1,132 @@
+#ifndef EXCHANGE_LIBRARY_INCLUDE_GUARD_HPP
+#define EXCHANGE_LIBRARY_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Library for exchanging landmark summaries between robots and fusing them with covariance intersection
+///
+/// Robots that meet send each other the mean and 2x2 marginal covariance of their landmarks instead of
+/// the whole filter. A summary may repeat information the receiver already has (it may even come from
+/// the receiver, through a third robot), and the correlation with the receiver's own estimate is
+/// unknown, so it is fused with covariance intersection, which stays consistent for any correlation.
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace exchange
+{
+    /// \brief one landmark of a summary
+    struct LandmarkSummary
+    {
+        int id;                     // the slot of the landmark in the filter of the sender, from 0
+        double x;
+        double y;
+        std::array<double, 3> cov;  // (xx, xy, yy)
+    };
+
+    /// \brief decides which landmarks to send to the robots in range
+    /// Each landmark has a revision that moves on when it changed enough since it was last sent:
+    /// a new landmark, a location that moved, or a variance that shrank. Every robot met remembers
+    /// the revision it was last sent up to, so a summary only lists what changed since the last
+    /// exchange with the robots now in range, and everything to a robot met for the first time.
+    class SummaryTracker
+    {
+        private:
+            /// \brief a robot heard from
+            struct Peer
+            {
+                double x = 0.0;
+                double y = 0.0;
+                double heard = -1.0;        // time of its last summary (s)
+                uint64_t sentUpTo = 0;      // the revisions sent to it
+            };
+
+            double range;
+            double timeout;
+            double moveDistance;
+            double shrinkFraction;
+
+            uint64_t clock;
+            int generation;
+            std::vector<uint64_t> revision;                 // of each landmark
+            std::vector<LandmarkSummary> reference;         // each landmark as last revised
+            std::unordered_map<std::string, Peer> peers;
+
+        public:
+            /// \brief create a tracker with default parameters
+            SummaryTracker();
+
+            /// \brief create a tracker
+            /// \param exchangeRange - the largest distance between robots that exchange summaries (m)
+            /// \param peerTimeout - a robot not heard from for this long is out of range (s)
+            /// \param changeDistance - a landmark that moved this far since it was last revised is sent again (m)
+            /// \param changeFraction - a landmark whose variance shrank by this fraction is sent again
+            SummaryTracker(double exchangeRange, double peerTimeout, double changeDistance, double changeFraction);
+
+            /// \brief compares the landmarks of the filter with their last revision
+            /// \param state - the state vector (theta, x, y, x1, y1, ...)
+            /// \param cov - the covariance of the state, column major
+            /// \param stateLength - the length of the state vector
+            /// \param visited - the number of landmarks seen, the first in the state
+            /// \param landmarkGeneration - changes whenever landmarks were merged or renumbered, which revises them all
+            void update(const double * state, const double * cov, int stateLength, int visited, int landmarkGeneration);
+
+            /// \brief records the summary of another robot
+            /// \param robot - the name of the robot
+            /// \param x - its position
+            /// \param y - its position
+            /// \param now - the time of the summary (s)
+            void heard(const std::string & robot, double x, double y, double now);
+
+            /// \brief returns true if a robot was heard recently and is within range
+            /// \param robot - the name of the robot
+            /// \param x - the position of this robot
+            /// \param y - the position of this robot
+            /// \param now - the current time (s)
+            bool inRange(const std::string & robot, double x, double y, double now) const;
+
+            /// \brief lists the landmarks the robots in range have not been sent, and counts them as sent
+            /// \param x - the position of this robot
+            /// \param y - the position of this robot
+            /// \param now - the current time (s)
+            /// \param summary - the landmarks to send, empty if there is nobody to send them to
+            /// \return the number of robots in range
+            int select(double x, double y, double now, std::vector<LandmarkSummary> & summary);
+
+            /// \brief returns the revision of every landmark so far
+            uint64_t revisions() const;
+    };
+
+    /// \brief the covariance intersection weight of two estimates of a landmark
+    /// The fused covariance is (w A^-1 + (1 - w) B^-1)^-1, and w is chosen to minimize its determinant.
+    /// \param A - the covariance of the own estimate, column major
+    /// \param B - the covariance of the received estimate, column major
+    /// \return w in [0, 1], 1 if the received estimate adds nothing
+    double intersectionWeight(const std::array<double, 4> & A, const std::array<double, 4> & B);
+
+    /// \brief fuses two estimates of a landmark with covariance intersection
+    /// \param a - the own estimate
+    /// \param A - its covariance, column major
+    /// \param b - the received estimate
+    /// \param B - its covariance, column major
+    /// \param fused - the fused estimate
+    /// \param F - its covariance, column major
+    /// \return the weight w of the own estimate
+    double intersect(const std::array<double, 2> & a, const std::array<double, 4> & A,
+                     const std::array<double, 2> & b, const std::array<double, 4> & B,
+                     std::array<double, 2> & fused, std::array<double, 4> & F);
+
+    /// \brief finds the landmark of the filter a received landmark is most likely to be
+    /// \param state - the state vector (theta, x, y, x1, y1, ...)
+    /// \param cov - the covariance of the state, column major
+    /// \param stateLength - the length of the state vector
+    /// \param visited - the number of landmarks seen
+    /// \param landmark - the received landmark
+    /// \param distance - the squared Mahalanobis distance to the closest landmark
+    /// \return the slot of the closest landmark from 0, -1 if there are none
+    int closestLandmark(const double * state, const double * cov, int stateLength, int visited,
+                        const LandmarkSummary & landmark, double & distance);
+}
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef EXPLORATION_LIBRARY_INCLUDE_GUARD_HPP
+#define EXPLORATION_LIBRARY_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Library for choosing exploration goals on the frontiers of a coarse free / unknown grid
+
+#include <cstdint>
+#include <vector>
+
+namespace exploration
+{
+    /// \brief what is known about a cell
+    enum class CellState : uint8_t
+    {
+        UNKNOWN = 0,
+        FREE,
+        OCCUPIED
+    };
+
+    /// \brief parameters of the grid and of the goal choice
+    struct ExploreParams
+    {
+        double resolution = 0.1;        // side of a cell (m), coarse as only the frontiers are needed
+        int size = 256;                 // cells on a side, the grid is centered on the origin of the map
+        int minClusterSize = 3;         // smaller frontier clusters are noise between beams
+        double gainRadius = 1.0;        // the unknown cells within this distance of a goal are its gain (m)
+        double minCost = 0.5;           // the travel cost of a goal is never counted as less than this (m)
+    };
+
+    /// \brief a group of 8 connected frontier cells
+    struct Cluster
+    {
+        int cells = 0;                  // frontier cells in the cluster
+        double goalX = 0.0;             // the frontier cell closest to the centroid of the cluster (m)
+        double goalY = 0.0;
+        int gain = 0;                   // unknown cells within the gain radius of the goal
+        double cost = 0.0;              // length of the shortest path to the goal through free cells (m), -1 if unreachable
+        double score = 0.0;             // gain per cost
+    };
+
+    /// \brief a grid of free, occupied and unknown cells with the frontier between free and unknown
+    /// Scans only ever turn unknown cells into free or occupied ones, and free ones into occupied ones,
+    /// so the frontier can only change next to the cells a scan touched. The frontier cells are kept in
+    /// a list with the position of each cell in it, and after each scan only the touched cells and their
+    /// neighbors are checked, so the cost of a scan does not grow with the explored area.
+    class FrontierGrid
+    {
+        private:
+            ExploreParams params;
+            int half;                           // cells from the origin to an edge
+
+            std::vector<CellState> state;       // row major
+            std::vector<int32_t> frontierSlot;  // position of a cell in the frontier list, -1 if not a frontier
+            std::vector<int32_t> frontier;      // indices of the frontier cells
+
+            std::vector<int32_t> touched;       // cells changed by the scan being inserted
+            std::vector<uint32_t> touchStamp;   // the scan that last touched a cell
+            uint32_t scanCount;
+
+            /// \brief sets the state of a cell, remembering it as touched if it changed
+            void setState(int index, CellState s);
+
+            /// \brief walks the cells from (x0, y0) up to (x1, y1), marking them free, and the last one occupied if hit
+            void traceRay(int x0, int y0, int x1, int y1, bool hitEnd);
+
+            /// \brief adds or removes a cell from the frontier list to match its state and neighbors
+            void updateFrontier(int index);
+
+        public:
+            /// \brief create an unknown grid
+            /// \param exploreParams - the parameters of the grid
+            explicit FrontierGrid(const ExploreParams & exploreParams);
+
+            /// \brief inserts a laser scan taken from a pose in the grid frame and updates the frontier
+            /// \param sx - x of the sensor
+            /// \param sy - y of the sensor
+            /// \param sth - heading of the sensor
+            /// \param angleMin - angle of the first beam
+            /// \param angleIncrement - angle between beams
+            /// \param ranges - range of each beam
+            /// \param rangeMin - shorter ranges are ignored
+            /// \param rangeMax - longer ranges clear the grid up to rangeMax without marking a hit
+            /// \return the number of cells whose state changed
+            int insertScan(double sx, double sy, double sth, double angleMin, double angleIncrement,
+                           const std::vector<float> & ranges, double rangeMin, double rangeMax);
+
+            /// \brief returns the cell index of a coordinate, cells on both sides of the origin
+            int toCell(double v) const;
+
+            /// \brief returns true if the cell is on the grid
+            bool contains(int cx, int cy) const;
+
+            /// \brief returns the state of a cell, unknown off the grid
+            CellState at(int cx, int cy) const;
+
+            /// \brief returns true if the cell is free with an unknown 4 connected neighbor
+            bool isFrontier(int cx, int cy) const;
+
+            /// \brief returns the number of frontier cells
+            int frontierSize() const;
+
+            /// \brief groups the frontier cells and scores each group large enough as a goal
+            /// The clusters are found with union-find over the frontier list only, and the travel cost is a
+            /// breadth first search through the free cells from the robot, which stops once every goal is reached.
+            /// \param rx - x of the robot
+            /// \param ry - y of the robot
+            /// \return the clusters, best score first, the unreachable ones left out
+            std::vector<Cluster> clusters(double rx, double ry) const;
+    };
+}
+
+#endif
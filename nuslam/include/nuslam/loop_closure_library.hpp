@@ -0,0 +1,129 @@
+#ifndef LOOP_CLOSURE_LIBRARY_INCLUDE_GUARD_HPP
+#define LOOP_CLOSURE_LIBRARY_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Library for detecting landmarks that were mapped twice after a loop
+
+#include "nuslam/relocalization_library.hpp"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace loop_closure
+{
+    /// \brief a detected loop closure
+    struct Closure
+    {
+        std::vector<std::pair<int, int>> pairs;     // (older landmark, newer duplicate), in the order the landmarks were added
+        double x = 0.0;                             // drift that moves the newer landmarks onto the older ones
+        double y = 0.0;
+        double th = 0.0;
+        double rms = 0.0;                           // root mean square distance of the matched landmarks after the drift (m)
+        int generation = 0;                         // the generation of the landmarks the closure was found in
+    };
+
+    /// \brief finds the newest landmarks that duplicate older ones
+    /// The newest landmarks are matched as one constellation against the older ones with the
+    /// triangle hash of the relocalization library: each triangle of the constellation looks up
+    /// the older triangles with the same shape, and each match is checked against the whole
+    /// constellation. A closure is reported only for a unique match of enough landmarks, with a drift
+    /// the odometry could plausibly have built up. The hash of the older landmarks is kept between
+    /// calls and only the landmarks that became old since are added to it.
+    class LoopClosureDetector
+    {
+        private:
+            int recent;
+            double maxSide;
+            double matchDistance;
+            int minMatches;
+            double maxDrift;
+            double maxDriftAngle;
+            int maxSamples;
+
+            relocalization::Relocalizer index;
+            std::vector<double> indexed;        // the locations of the landmarks in the index when they were added
+            int rebuildCount;
+
+        public:
+            /// \brief create a detector with default parameters
+            LoopClosureDetector();
+
+            /// \brief create a detector
+            /// \param recentCount - how many of the newest landmarks are checked for duplicates
+            /// \param maxTriangleSide - the longest triangle side in a constellation (m)
+            /// \param matchDist - the largest distance between a landmark and its duplicate after the drift (m)
+            /// \param minMatchCount - the fewest duplicates accepted as a closure, at least three
+            /// \param maxDriftDist - the largest translation of an accepted drift (m)
+            /// \param maxDriftRot - the largest rotation of an accepted drift (rad)
+            /// \param maxSampleCount - the most triangles of the constellation tried
+            LoopClosureDetector(int recentCount, double maxTriangleSide, double matchDist, int minMatchCount,
+                                double maxDriftDist, double maxDriftRot, int maxSampleCount);
+
+            /// \brief looks for duplicates of the newest landmarks among the older ones
+            /// The index is rebuilt if landmarks were removed or one of the indexed landmarks moved more
+            /// than half the match distance since it was added.
+            /// \param landmarks - the landmark locations in the order they were added (x1, y1, x2, y2, ...)
+            /// \param closure - the duplicates found
+            /// \return true if a closure was found
+            bool detect(const std::vector<double> & landmarks, Closure & closure);
+
+            /// \brief returns the number of landmarks in the index
+            int indexSize() const;
+
+            /// \brief returns how many times the index was built from scratch
+            int rebuilds() const;
+    };
+
+    /// \brief runs a loop closure detector on its own thread
+    /// The filter thread hands over a copy of the landmarks and picks up the result later, and
+    /// neither call waits for the detection.
+    class BackgroundDetector
+    {
+        private:
+            LoopClosureDetector detector;
+
+            std::mutex mtx;
+            std::condition_variable wake;
+            std::thread worker;
+
+            std::vector<double> job;
+            int jobGeneration;
+            bool hasJob;
+            bool busy;
+            bool stop;
+
+            Closure result;
+            bool hasResult;
+
+            /// \brief the loop of the detection thread
+            void run();
+
+        public:
+            /// \brief starts the detection thread
+            /// \param loopDetector - the detector to run
+            explicit BackgroundDetector(const LoopClosureDetector & loopDetector);
+
+            BackgroundDetector(const BackgroundDetector &) = delete;
+            BackgroundDetector & operator=(const BackgroundDetector &) = delete;
+
+            /// \brief stops and joins the detection thread
+            ~BackgroundDetector();
+
+            /// \brief hands the landmarks to the detection thread
+            /// \param landmarks - the landmark locations in the order they were added
+            /// \param generation - a number that changes whenever landmarks are merged or removed
+            /// \return false if the thread is still busy with the last landmarks
+            bool submit(const std::vector<double> & landmarks, int generation);
+
+            /// \brief takes the last closure found, if any
+            /// \param closure - the closure
+            /// \return true if a closure was waiting
+            bool poll(Closure & closure);
+
+            /// \brief returns true while landmarks are waiting or being checked
+            bool isBusy();
+    };
+}
+
+#endif
@@ -0,0 +1,153 @@
+#ifndef MAP_FILE_LIBRARY_INCLUDE_GUARD_HPP
+#define MAP_FILE_LIBRARY_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Library for saving a SLAM map to a binary file and memory mapping it back
+///
+/// The file is a fixed 64 byte header followed by three sections, each starting on a 64 byte boundary:
+///     the state vector        (stateLength doubles)
+///     the covariance          (stateLength x stateLength doubles, column major)
+///     the landmark metadata   (numLandmarks LandmarkInfo)
+///     the odometry            (one OdometryInfo, only in a checkpoint of a running slam node)
+/// The odometry section starts at the first boundary after the landmarks, and is there if the file is long
+/// enough to hold it. Numbers are stored in the byte order of the machine that wrote the file. Since the sections are
+/// aligned, a mapped file can be used in place without parsing or copying.
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace map_file
+{
+    /// \brief the version written by saveMap
+    constexpr uint32_t MAP_VERSION = 1;
+
+    /// \brief the alignment of every section in the file
+    constexpr uint64_t MAP_ALIGNMENT = 64;
+
+    /// \brief the header at the start of a map file
+    struct MapHeader
+    {
+        char magic[8];              // "NUSLAMAP"
+        uint32_t version;           // MAP_VERSION
+        uint32_t byteOrder;         // 0x01020304 in the byte order of the writer
+        uint64_t stateLength;       // 3 + 2 * numLandmarks
+        uint64_t numLandmarks;
+        uint64_t stateOffset;       // byte offsets of the sections from the start of the file
+        uint64_t covOffset;
+        uint64_t landmarkOffset;
+        uint64_t fileSize;
+    };
+
+    static_assert(sizeof(MapHeader) == 64, "the map file header must stay 64 bytes");
+
+    /// \brief what is known about one landmark of the map
+    struct LandmarkInfo
+    {
+        int32_t id;                 // index of the landmark in the state vector
+        uint32_t flags;             // LANDMARK_INITIALIZED once the landmark has been seen
+        double radius;              // radius of the landmark (m)
+    };
+
+    static_assert(sizeof(LandmarkInfo) == 16, "landmark metadata must stay 16 bytes");
+
+    /// \brief flag of a landmark that has been seen and has an estimated location
+    constexpr uint32_t LANDMARK_INITIALIZED = 1;
+
+    /// \brief the configuration of a DiffDrive and the wheel angles it last saw
+    struct OdometryBaseline
+    {
+        double x;
+        double y;
+        double th;
+        double thL;
+        double thR;
+    };
+
+    static_assert(sizeof(OdometryBaseline) == 40, "odometry baselines must stay 40 bytes");
+
+    /// \brief where a running slam node was when its map was written
+    struct OdometryInfo
+    {
+        uint64_t sequence;              // counts the checkpoints written by a checkpoint::CheckpointWriter
+        int64_t stamp;                  // time of the snapshot (ns)
+        uint32_t flags;                 // checkpoint::CHECKPOINT_LOCALIZATION
+        int32_t landmarkGeneration;     // changes whenever landmarks are merged or replaced
+        OdometryBaseline odometry;      // the odometry published as odom -> body
+        OdometryBaseline prediction;    // the odometry the filter predicts from
+    };
+
+    static_assert(sizeof(OdometryInfo) == 104, "the odometry section must stay 104 bytes");
+
+    /// \brief writes a map to a file, replacing it only once the new file is on disk
+    /// \param path - the file to write
+    /// \param state - the state vector (theta, x, y, x1, y1, ...)
+    /// \param stateLength - the length of the state vector
+    /// \param cov - the covariance of the state, column major
+    /// \param landmarks - the metadata of each landmark, one per landmark in the state
+    /// \param error - the reason the map was not written
+    /// \param odometry - the odometry section, nullptr to write a plain map
+    /// \return true if the map was written
+    bool saveMap(const std::string & path, const double * state, uint64_t stateLength, const double * cov,
+                 const std::vector<LandmarkInfo> & landmarks, std::string & error,
+                 const OdometryInfo * odometry = nullptr);
+
+    /// \brief a read only, memory mapped map file
+    /// The state, covariance and metadata point directly into the mapping and stay valid until the
+    /// MappedMap is closed or destroyed.
+    class MappedMap
+    {
+        private:
+            void * data;
+            size_t length;
+            const MapHeader * header;
+
+        public:
+            /// \brief create a closed map
+            MappedMap();
+
+            MappedMap(const MappedMap &) = delete;
+            MappedMap & operator=(const MappedMap &) = delete;
+
+            MappedMap(MappedMap && other);
+            MappedMap & operator=(MappedMap && other);
+
+            /// \brief unmaps the file
+            ~MappedMap();
+
+            /// \brief maps a map file and checks its header and sections
+            /// \param path - the file to map
+            /// \param error - the reason the file could not be used
+            /// \return true if the map can be used
+            bool open(const std::string & path, std::string & error);
+
+            /// \brief unmaps the file
+            void close();
+
+            /// \brief returns true if a map is mapped
+            bool isOpen() const;
+
+            /// \brief returns the version of the file
+            uint32_t version() const;
+
+            /// \brief returns the length of the state vector
+            uint64_t stateLength() const;
+
+            /// \brief returns the number of landmarks
+            uint64_t numLandmarks() const;
+
+            /// \brief returns the state vector (theta, x, y, x1, y1, ...)
+            const double * state() const;
+
+            /// \brief returns the covariance, column major
+            const double * cov() const;
+
+            /// \brief returns the metadata of each landmark
+            const LandmarkInfo * landmarks() const;
+
+            /// \brief returns the odometry section, nullptr if the file has none
+            const OdometryInfo * odometry() const;
+    };
+}
+
+#endif
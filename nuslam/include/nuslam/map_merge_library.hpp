@@ -0,0 +1,124 @@
+#ifndef MAP_MERGE_LIBRARY_INCLUDE_GUARD_HPP
+#define MAP_MERGE_LIBRARY_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Library for merging the landmark maps of two robots into one map that can seed any robot's filter
+
+#include <nuslam/map_file_library.hpp>
+
+#include <array>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace map_merge
+{
+    /// \brief the landmarks of one map and the covariance of each location
+    /// Only the 2x2 marginal of each landmark is kept, so a map of n landmarks is O(n) instead of O(n^2).
+    struct LandmarkMap
+    {
+        std::vector<double> mean;   // (x1, y1, x2, y2, ...)
+        std::vector<double> cov;    // the 2x2 covariance of each landmark, column major (4 per landmark)
+
+        /// \brief returns the number of landmarks
+        int size() const;
+    };
+
+    /// \brief the transform between the frames of two maps
+    struct Alignment
+    {
+        bool found = false;         // true if enough landmarks of the two maps match
+        bool ambiguous = false;     // true if another, different transform matches as many landmarks
+        double x = 0.0;             // pose of the frame of map b in the frame of map a
+        double y = 0.0;
+        double th = 0.0;
+        std::array<double, 9> cov = {};                 // covariance of (x, y, th), column major
+        int inliers = 0;                                // number of landmarks in both maps
+        double rms = 0.0;                               // root mean square distance of the matched landmarks (m)
+        std::vector<std::pair<int, int>> matches;       // (landmark of a, landmark of b) of every inlier
+    };
+
+    /// \brief two maps merged in the frame of the first
+    struct MergedMap
+    {
+        LandmarkMap landmarks;                          // the landmarks of a, fused where shared, then those only in b
+        std::vector<std::pair<int, int>> origin;        // (landmark of a, landmark of b) of each, -1 where a map lacks it
+        Alignment alignment;
+        int shared = 0;                                 // number of fused landmarks
+    };
+
+    /// \brief finds the transform between two landmark maps and fuses them
+    /// Each landmark forms triangles with its nearest neighbors, which are stored in a hash table keyed
+    /// by their quantized side lengths and handedness, as in the relocalization library. Keeping to
+    /// the neighbors makes the table O(n) instead of O(n^3). Triangles of the second map look up
+    /// the triangles of the first with the same shape and each match votes for a transform. The most
+    /// voted transforms are checked against the whole map, and the best one is refined by weighted
+    /// least squares over every shared landmark.
+    class MapMerger
+    {
+        private:
+            double maxSide;
+            double matchDist;
+            int neighbors;
+            int minMatches;
+            int maxSamples;
+            unsigned int seed;
+
+        public:
+            /// \brief create a merger with default parameters
+            MapMerger();
+
+            /// \brief create a merger
+            /// \param maxTriangleSide - the longest triangle side stored (m)
+            /// \param matchDistance - the largest distance between a landmark and its match after the transform (m)
+            /// \param neighborCount - the nearest landmarks each landmark makes triangles with
+            /// \param minMatchCount - the fewest shared landmarks accepted, at least three
+            /// \param maxSampleCount - the most triangles of the second map looked up
+            /// \param randomSeed - the seed used to pick the triangles when there are more
+            MapMerger(double maxTriangleSide, double matchDistance, int neighborCount, int minMatchCount,
+                      int maxSampleCount, unsigned int randomSeed = 0);
+
+            /// \brief finds the transform that moves map b onto map a
+            /// \param a - the map whose frame is kept
+            /// \param b - the map to move
+            /// \param alignment - the transform and the shared landmarks
+            /// \return true if a unique transform was found
+            bool align(const LandmarkMap & a, const LandmarkMap & b, Alignment & alignment) const;
+
+            /// \brief merges map b into the frame of map a
+            /// Given the transform, the shared landmarks are independent of each other, so the batch update
+            /// is one 2x2 information form fusion per landmark. The landmarks only in b also get the
+            /// uncertainty of the transform.
+            /// \param a - the map whose frame is kept
+            /// \param b - the map to merge in
+            /// \param merged - the merged map
+            /// \return true if the maps were aligned and merged
+            bool merge(const LandmarkMap & a, const LandmarkMap & b, MergedMap & merged) const;
+    };
+
+    /// \brief the landmarks of a map file that have been seen
+    /// \param mapped - an open map file
+    /// \return the locations and their marginal covariances
+    LandmarkMap seenLandmarks(const map_file::MappedMap & mapped);
+
+    /// \brief moves a robot pose from the frame of map b to the frame of map a
+    /// \param alignment - the transform between the maps
+    /// \param pose - (theta, x, y) in the frame of b, replaced by the pose in the frame of a
+    /// \param poseCov - the covariance of the pose, column major, replaced like the pose
+    void transformPose(const Alignment & alignment, std::array<double, 3> & pose, std::array<double, 9> & poseCov);
+
+    /// \brief builds an EKF state and covariance from a robot pose and a landmark map
+    /// The landmarks fill the first slots of the filter and the rest are left unseen, as in a new filter.
+    /// \param landmarks - the landmarks that have been seen
+    /// \param pose - (theta, x, y) of the robot
+    /// \param poseCov - the covariance of the pose, column major
+    /// \param numLandmarks - the number of landmarks the filter holds
+    /// \param state - the state vector (theta, x, y, x1, y1, ...)
+    /// \param cov - the covariance, column major
+    /// \param error - the reason no state was built
+    /// \return true if the landmarks fit in the filter
+    bool seedState(const LandmarkMap & landmarks, const std::array<double, 3> & pose,
+                   const std::array<double, 9> & poseCov, int numLandmarks,
+                   std::vector<double> & state, std::vector<double> & cov, std::string & error);
+}
+
+#endif
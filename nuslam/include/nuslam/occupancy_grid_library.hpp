@@ -0,0 +1,137 @@
+#ifndef OCCUPANCY_GRID_LIBRARY_INCLUDE_GUARD_HPP
+#define OCCUPANCY_GRID_LIBRARY_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Library for building a log-odds occupancy grid from laser scans
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace occupancy_grid
+{
+    /// \brief log2 of the number of cells along a side of a tile
+    constexpr int TILE_BITS = 6;
+
+    /// \brief the number of cells along a side of a tile
+    constexpr int TILE_SIZE = 1 << TILE_BITS;
+
+    /// \brief the log-odds of a cell that has never been observed
+    constexpr int16_t UNKNOWN = std::numeric_limits<int16_t>::min();
+
+    /// \brief parameters of the grid, log-odds are in natural log units
+    struct GridParams
+    {
+        double resolution = 0.05;       // side of a cell (m)
+        double hit = 0.85;              // log-odds added to a cell a beam ends in
+        double miss = -0.4;             // log-odds added to a cell a beam passes through
+        double minLogOdds = -2.0;       // clamp, so a cell can change its mind quickly
+        double maxLogOdds = 3.5;
+        bool clearNoReturn = false;     // if true, a beam at or past the maximum range clears the cells up to it
+    };
+
+    /// \brief a rectangle of cells
+    struct Region
+    {
+        int x = 0;          // lowest cell index in x
+        int y = 0;          // lowest cell index in y
+        int width = 0;
+        int height = 0;
+
+        /// \brief returns true if the region holds no cells
+        bool empty() const;
+
+        /// \brief returns true if the region holds every cell of another
+        /// \param other - the other region
+        bool contains(const Region & other) const;
+    };
+
+    /// \brief a log-odds occupancy grid allocated in square tiles as the robot explores
+    /// Cells are indexed by floor(x / resolution), so the grid can grow in every direction.
+    /// Log-odds are stored as 16 bit fixed point with two decimals. Every cell an update
+    /// touches is added to a dirty region, so only the changed part of the grid needs to be sent.
+    class TiledGrid
+    {
+        private:
+            struct Tile
+            {
+                int16_t cells[TILE_SIZE * TILE_SIZE];
+            };
+
+            GridParams params;
+            int16_t hit, miss, minValue, maxValue;
+
+            std::unordered_map<uint64_t, std::unique_ptr<Tile>> tiles;
+            int tileMinX, tileMinY, tileMaxX, tileMaxY;
+
+            // cell range touched since the last takeDirty
+            int dirtyMinX, dirtyMinY, dirtyMaxX, dirtyMaxY;
+
+            // beam directions, recomputed only when the scan geometry changes
+            std::vector<double> beamCos, beamSin;
+            double beamAngleMin, beamIncrement;
+
+            // the last tile touched, most consecutive cells of a ray share it
+            uint64_t cachedKey;
+            Tile * cachedTile;
+
+            /// \brief returns the tile holding a cell, allocating it if needed
+            Tile * tileAt(int cx, int cy);
+
+            /// \brief adds log-odds to a cell
+            void addToCell(int cx, int cy, int16_t delta);
+
+            /// \brief walks the cells from (x0, y0) up to (x1, y1), marking them free, and the last one occupied if hit
+            void traceRay(int x0, int y0, int x1, int y1, bool hitEnd);
+
+        public:
+            /// \brief create a grid with default parameters
+            TiledGrid();
+
+            /// \brief create a grid
+            /// \param gridParams - the parameters of the grid
+            explicit TiledGrid(const GridParams & gridParams);
+
+            /// \brief inserts a laser scan taken from a pose in the grid frame
+            /// \param sx - x of the sensor
+            /// \param sy - y of the sensor
+            /// \param sth - heading of the sensor
+            /// \param angleMin - angle of the first beam
+            /// \param angleIncrement - angle between beams
+            /// \param ranges - range of each beam, nan is ignored
+            /// \param rangeMin - shorter ranges are ignored
+            /// \param rangeMax - longer ranges are ignored, or clear the grid up to rangeMax without
+            /// marking a hit if clearNoReturn is set
+            void insertScan(double sx, double sy, double sth, double angleMin, double angleIncrement,
+                            const std::vector<float> & ranges, double rangeMin, double rangeMax);
+
+            /// \brief returns the cell index of a coordinate
+            int toCell(double v) const;
+
+            /// \brief returns the side of a cell
+            double resolution() const;
+
+            /// \brief returns the fixed point log-odds of a cell, UNKNOWN if never observed
+            int16_t logOdds(int cx, int cy) const;
+
+            /// \brief returns the occupancy of a cell as in nav_msgs/OccupancyGrid, 0 to 100 or -1 if unknown
+            int8_t occupancy(int cx, int cy) const;
+
+            /// \brief returns the number of tiles allocated
+            int numTiles() const;
+
+            /// \brief returns the cells covered by the allocated tiles
+            Region bounds() const;
+
+            /// \brief returns the cells changed since the last call and clears the dirty region
+            Region takeDirty();
+
+            /// \brief writes the occupancy of a region, row by row
+            /// \param region - the cells to write
+            /// \param data - the occupancy, resized to width * height
+            void fill(const Region & region, std::vector<int8_t> & data) const;
+    };
+}
+
+#endif
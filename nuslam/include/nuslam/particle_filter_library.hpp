@@ -0,0 +1,169 @@
+#ifndef PARTICLE_FILTER_LIBRARY_INCLUDE_GUARD_HPP
+#define PARTICLE_FILTER_LIBRARY_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Library for Monte Carlo localization against a fixed landmark map
+
+#include <rigid2d/rigid2d.hpp>
+
+#include <cstdint>
+#include <random>
+#include <unordered_set>
+#include <vector>
+
+namespace particle_filter
+{
+    using namespace rigid2d;
+
+    /// \brief a range-bearing measurement of a landmark, relative to the robot
+    struct Observation
+    {
+        double range = 0.0;
+        double bearing = 0.0;
+        int id = -1;            // index of the landmark in the map, -1 if unknown
+    };
+
+    /// \brief parameters of the particle filter
+    struct MclParams
+    {
+        int minParticles = 500;         // fewest particles kept by KLD sampling
+        int maxParticles = 5000;        // most particles, also the size of a global initialization
+
+        double kldEpsilon = 0.05;       // largest KL divergence between the sample and the posterior
+        double kldZ = 2.326;            // upper standard normal quantile of the KLD bound (0.99)
+        double binXY = 0.1;             // size of a KLD histogram bin in x and y (m)
+        double binTh = 0.175;           // size of a KLD histogram bin in heading (rad)
+
+        double alpha1 = 0.1;            // heading noise per unit of rotation
+        double alpha2 = 0.05;           // heading noise per unit of translation
+        double alpha3 = 0.1;            // translation noise per unit of translation
+        double alpha4 = 0.05;           // translation noise per unit of rotation
+
+        double rangeSigma = 0.05;       // standard deviation of a range measurement (m)
+        double bearingSigma = 0.05;     // standard deviation of a bearing measurement (rad)
+        double outlierGate = 16.0;      // largest squared Mahalanobis distance charged to one measurement
+
+        double alphaSlow = 0.001;       // rate of the long term average likelihood
+        double alphaFast = 0.1;         // rate of the short term average likelihood
+    };
+
+    /// \brief Monte Carlo localization with a particle filter
+    /// The particles are stored as separate arrays of x, y and heading, so the measurement likelihood
+    /// runs as a branch free loop over contiguous memory that GCC vectorizes at -O3. It needs sqrt
+    /// without errno, the library is built with -fno-math-errno.
+    /// The number of particles adapts with KLD sampling and random particles are injected when the
+    /// measurements fit the particles much worse than they used to (augmented MCL), which recovers
+    /// from a bad global initialization or a kidnapped robot.
+    class ParticleFilter
+    {
+        private:
+            MclParams params;
+
+            std::vector<double> lx, ly;                 // landmark locations
+
+            std::vector<double> px, py, pth;            // particle poses
+            std::vector<double> weight;                 // normalized particle weights
+
+            std::vector<double> nx, ny, nth;            // resampling buffers
+            std::vector<double> cosTh, sinTh, logw, best, cumulative;
+            std::vector<int> index;
+            std::unordered_set<uint64_t> bins;
+
+            double xMin, xMax, yMin, yMax;              // region for random particles
+
+            double wSlow, wFast;
+            int injected;
+
+            double meanX, meanY, meanTh;
+
+            std::mt19937 gen;
+
+            /// \brief computes the log likelihood of the observations for every particle
+            /// \param obs - the observations
+            void weigh(const std::vector<Observation> & obs);
+
+            /// \brief draws the new set of particles, with KLD sampling and low variance resampling
+            void resample();
+
+            /// \brief draws particles with low variance resampling, their indexes are left in index
+            /// \param count - the number of particles to draw
+            void draw(int count);
+
+            /// \brief finds the number of particles needed for the histogram bins the drawn particles fall in
+            /// \return the number of particles
+            int kldCount();
+
+            /// \brief replaces some particles with random ones when the likelihood drops
+            void inject();
+
+            /// \brief computes the mean pose of the particles
+            void computeMean();
+
+            /// \brief sets a particle to a random pose in the bounds
+            /// \param i - the index of the particle
+            void randomParticle(int i);
+
+        public:
+            /// \brief create an empty particle filter
+            ParticleFilter();
+
+            /// \brief create a particle filter for a map, initialized globally
+            /// The bounds for random particles are the landmarks plus a meter on each side
+            /// \param mapState - the landmark locations (x1, y1, x2, y2, ...)
+            /// \param mclParams - the parameters of the filter
+            /// \param seed - the seed of the random number generator
+            ParticleFilter(const std::vector<double> & mapState, const MclParams & mclParams, unsigned int seed = 0);
+
+            /// \brief sets the region random particles are drawn from
+            /// \param xLow - lowest x
+            /// \param xHigh - highest x
+            /// \param yLow - lowest y
+            /// \param yHigh - highest y
+            void setBounds(double xLow, double xHigh, double yLow, double yHigh);
+
+            /// \brief spreads the largest number of particles uniformly over the bounds
+            void initGlobal();
+
+            /// \brief places the particles around a pose
+            /// \param x - x of the pose
+            /// \param y - y of the pose
+            /// \param th - heading of the pose
+            /// \param sigmaXY - standard deviation of the position
+            /// \param sigmaTh - standard deviation of the heading
+            void initPose(double x, double y, double th, double sigmaXY, double sigmaTh);
+
+            /// \brief moves every particle by a noisy copy of the body twist
+            /// \param tw - the motion of the robot since the last prediction
+            void predict(const Twist2D & tw);
+
+            /// \brief weighs the particles with the observations and resamples
+            /// \param obs - the observations
+            /// \return false if there were no observations and nothing changed
+            bool update(const std::vector<Observation> & obs);
+
+            /// \brief returns the number of particles
+            int size() const;
+
+            /// \brief returns the x of every particle
+            const std::vector<double> & getParticleX() const;
+
+            /// \brief returns the y of every particle
+            const std::vector<double> & getParticleY() const;
+
+            /// \brief returns the heading of every particle
+            const std::vector<double> & getParticleTh() const;
+
+            /// \brief returns the mean x of the particles
+            double getX() const;
+
+            /// \brief returns the mean y of the particles
+            double getY() const;
+
+            /// \brief returns the mean heading of the particles
+            double getTh() const;
+
+            /// \brief returns the number of random particles injected by the last update
+            int getInjected() const;
+    };
+}
+
+#endif
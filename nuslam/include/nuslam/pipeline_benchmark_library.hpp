@@ -0,0 +1,101 @@
+#ifndef PIPELINE_BENCHMARK_LIBRARY_INCLUDE_GUARD_HPP
+#define PIPELINE_BENCHMARK_LIBRARY_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Library for benchmarking the whole stack in one process: the tube_world simulation, the circle
+/// fit landmark detector and EKF SLAM, without ROS in between
+///
+/// The tubes are scattered at the density of the default tube_world, one per 1.25 m^2, in a square of walls,
+/// and the robot drives a circle around the middle at 10 Hz, one scan per step. Every landmark has a slot in
+/// the filter from the start, as in the slam node, so the cost of the filter follows the size of the map
+/// and not only the part of it seen so far.
+
+#include <nuturtlesim/tube_world_library.hpp>
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+namespace pipeline_benchmark
+{
+    /// \brief one combination of the sweep and the settings shared by all of them
+    struct RunParams
+    {
+        int landmarks = 6;              // tubes in the world, also the landmark slots of the filter
+        int beams = 360;                // lidar beams per scan
+        double speed = 0.2;             // forward speed of the robot (m/s)
+        int scans = 100;                // scans to run
+        double budget = 60.0;           // the run stops early once the detector and filter took this long (s)
+        double noise = 0.005;           // standard deviation of the range noise (m)
+        unsigned seed = 1;              // seed of the tube placement and of the noise
+        double radiusSpread = 0.0;      // the tubes are between (1 - radiusSpread) tubeRadius and tubeRadius
+        bool useRadius = true;          // associate by the fitted radius before the location
+
+        double tubeRadius = 0.0762;
+        double robotRadius = 0.095;
+        double minRange = 0.12;
+        double maxRange = 3.5;
+        double period = 0.1;            // time between scans (s)
+    };
+
+    /// \brief the measurements of one run
+    struct RunResult
+    {
+        RunParams params;
+        int tubes = 0;                  // tubes placed, fewer than asked for if the square filled up
+        double side = 0.0;              // side of the square of walls (m)
+        uint64_t scans = 0;             // scans run, fewer than asked for if the budget ran out
+
+        // latency of a scan through the detector and the filter (s)
+        double latencyMean = 0.0;
+        double latencyP50 = 0.0;
+        double latencyP90 = 0.0;
+        double latencyP99 = 0.0;
+        double latencyMax = 0.0;
+
+        // mean time of each stage per scan (s)
+        double simulateMean = 0.0;
+        double detectMean = 0.0;
+        double slamMean = 0.0;
+
+        double scanRate = 0.0;          // scans per second through the detector and the filter
+        double detections = 0.0;        // landmarks detected per scan
+        double mahalanobisTests = 0.0;  // candidates per scan that reached the Mahalanobis test
+        double radiusRejected = 0.0;    // candidates per scan the radius ruled out before it
+        int mapped = 0;                 // landmarks in the filter at the end
+        double filterMb = 0.0;          // size of the state and covariance of the filter (MB)
+        double peakRssMb = 0.0;         // peak resident memory of the process so far (MB)
+    };
+
+    /// \brief scatters tubes uniformly in a square of walls, apart from each other and off the circle the robot drives
+    /// \param count - the number of tubes
+    /// \param radius - the radius of the tubes
+    /// \param side - the side of the square, centered at the origin
+    /// \param orbit - the radius of the circle the robot drives around the origin
+    /// \param clearance - the distance kept between the tubes and from the tubes to the circle
+    /// \param seed - the seed of the placement
+    /// \return the tubes, fewer than count if no more fit
+    std::vector<tube_world::Tube> scatterTubes(int count, double radius, double side, double orbit, double clearance,
+                                               unsigned seed);
+
+    /// \brief the value below which a fraction of the samples fall, by nearest rank
+    /// \param sorted - the samples in increasing order
+    /// \param fraction - the fraction, in [0, 1]
+    /// \return the percentile, 0 if there are no samples
+    double percentile(const std::vector<double> & sorted, double fraction);
+
+    /// \brief the peak resident memory of the process (MB)
+    double peakRssMb();
+
+    /// \brief runs the simulator, the detector and the filter for one combination
+    /// \param params - the combination
+    /// \return the measurements
+    RunResult runPipeline(const RunParams & params);
+
+    /// \brief writes the results as a JSON array
+    void writeJson(const std::vector<RunResult> & results, std::ostream & out);
+
+    /// \brief writes the results as CSV, one line each, with a header line first if header is true
+    void writeCsv(const std::vector<RunResult> & results, std::ostream & out, bool header);
+}
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef RELOCALIZATION_LIBRARY_INCLUDE_GUARD_HPP
+#define RELOCALIZATION_LIBRARY_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Library for finding the pose of the robot from a single scan of landmarks with geometric hashing
+
+#include <cstdint>
+#include <random>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace relocalization
+{
+    /// \brief a pose proposed by the relocalizer
+    struct PoseHypothesis
+    {
+        bool found = false;         // true if a pose explains at least three landmarks
+        bool ambiguous = false;     // true if another, different pose explains the scan as well
+        double x = 0.0;
+        double y = 0.0;
+        double th = 0.0;
+        int inliers = 0;            // number of observed landmarks matched to the map
+        double rms = 0.0;           // root mean square distance between the matched landmarks (m)
+        std::vector<std::pair<int, int>> matches;   // (observed landmark, map landmark) of every inlier
+    };
+
+    /// \brief finds the pose of the robot in a landmark map from the landmarks of one scan
+    /// Every triplet of map landmarks is stored in a hash table keyed by its quantized side lengths
+    /// and handedness, which do not change with the pose of the robot. A triplet of observed landmarks
+    /// then finds its candidate matches with one lookup, each match proposes a pose, and every
+    /// proposal is verified against the rest of the scan (RANSAC).
+    class Relocalizer
+    {
+        private:
+            /// \brief map landmarks, ordered so their opposite sides are increasing
+            struct Triplet
+            {
+                int a, b, c;
+            };
+
+            std::vector<double> lx, ly;                             // landmark locations
+            std::unordered_map<uint64_t, std::vector<Triplet>> table;
+            int entries;
+
+            double binSize;
+            double inlierDist;
+            double maxSideLength;
+            int maxTriplets;
+
+            std::mt19937 gen;
+
+            /// \brief the hash key of a triangle
+            /// \param q0 - the bin of the shortest side
+            /// \param q1 - the bin of the middle side
+            /// \param q2 - the bin of the longest side
+            /// \param ccw - true if the vertices are counter clockwise
+            /// \return the key
+            static uint64_t key(int64_t q0, int64_t q1, int64_t q2, bool ccw);
+
+            /// \brief finds the pose that moves robot frame points onto map points in the least squares sense
+            /// \param ox - x of the observed points
+            /// \param oy - y of the observed points
+            /// \param mx - x of the matching map points
+            /// \param my - y of the matching map points
+            /// \param hyp - the pose is written to x, y, th of the hypothesis
+            static void align(const std::vector<double> & ox, const std::vector<double> & oy,
+                              const std::vector<double> & mx, const std::vector<double> & my,
+                              PoseHypothesis & hyp);
+
+            /// \brief counts the observed points that land on a map landmark and refines the pose with them
+            /// \param px - x of the observed points
+            /// \param py - y of the observed points
+            /// \param hyp - the pose to verify, refined in place
+            void verify(const std::vector<double> & px, const std::vector<double> & py, PoseHypothesis & hyp) const;
+
+        public:
+            /// \brief create an empty relocalizer
+            Relocalizer();
+
+            /// \brief create a relocalizer for a map
+            /// \param mapState - the landmark locations (x1, y1, x2, y2, ...)
+            /// \param maxSide - the longest triangle side stored, about twice the sensor range (m)
+            /// \param inlierDistance - the largest error of an observed landmark location (m)
+            /// \param maxSamples - the most observed triplets tried per query
+            /// \param seed - the seed of the random number generator
+            Relocalizer(const std::vector<double> & mapState, double maxSide, double inlierDistance,
+                        int maxSamples, unsigned int seed = 0);
+
+            /// \brief adds a landmark to the map and stores every triangle it forms with the landmarks already in it
+            /// \param x - x of the landmark
+            /// \param y - y of the landmark
+            void addLandmark(double x, double y);
+
+            /// \brief returns the number of landmarks in the map
+            int size() const;
+
+            /// \brief returns the number of triangles in the hash table, counting each bin a triangle lands in
+            int tableSize() const;
+
+            /// \brief finds the pose of the robot from the observed landmarks
+            /// \param points - the observed landmark locations relative to the robot (x1, y1, x2, y2, ...)
+            /// \return the best pose, not found if fewer than three landmarks match
+            PoseHypothesis relocalize(const std::vector<double> & points);
+    };
+}
+
+#endif
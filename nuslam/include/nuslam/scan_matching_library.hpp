@@ -0,0 +1,196 @@
+#ifndef SCAN_MATCHING_LIBRARY_INCLUDE_GUARD_HPP
+#define SCAN_MATCHING_LIBRARY_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Library for aligning laser scans with point-to-line ICP and a correlative search
+
+#include <cstdint>
+#include <vector>
+
+namespace scan_matching
+{
+    /// \brief parameters of the point-to-line ICP
+    struct IcpParams
+    {
+        int maxIterations = 20;
+        double maxCorrespondence = 0.3;     // largest point to reference distance on the first iteration (m)
+        double minCorrespondence = 0.05;    // the gate shrinks with the residual, but not below this (m)
+        int searchWindow = 3;               // beams on each side of the projected beam searched for a match
+        double maxNeighborGap = 0.15;       // neighbors further apart do not define a line (m)
+        double translationEpsilon = 1e-4;   // converged when a step moves less than this (m)
+        double rotationEpsilon = 1e-4;      // and turns less than this (rad)
+        int minCorrespondences = 20;        // fewer matches are not trusted
+    };
+
+    /// \brief the result of aligning a scan with the reference scan
+    struct IcpResult
+    {
+        bool converged = false;
+        double x = 0.0;             // pose of the scan in the frame of the reference scan
+        double y = 0.0;
+        double th = 0.0;
+        double cov[9] = {0.0};      // 3x3 covariance of (th, x, y), row major, the state order of the filters
+        int iterations = 0;
+        int correspondences = 0;
+        double rms = 0.0;           // root mean square point to line distance (m)
+    };
+
+    /// \brief aligns laser scans with point-to-line ICP
+    /// Each point of the new scan is moved into the reference frame and projected onto the reference beam
+    /// with the same bearing, and only a few beams around it are searched for the closest point, so no
+    /// search tree is needed. The distance to the line through that point and its neighbors is minimized
+    /// with Gauss-Newton on the 3x3 normal equations. The covariance is the residual variance times the
+    /// inverse of the normal matrix, and a scan that does not constrain every direction (a corridor) is
+    /// reported as not converged.
+    class IcpMatcher
+    {
+        private:
+            IcpParams params;
+
+            // reference scan, indexed by beam
+            double refAngleMin, refIncrement;
+            bool refWraps;
+            std::vector<double> refX, refY, refNx, refNy;
+            std::vector<uint8_t> refValid;
+
+            // points of the scan being matched, only the valid beams
+            std::vector<double> curX, curY;
+
+        public:
+            /// \brief create a matcher with default parameters
+            IcpMatcher();
+
+            /// \brief create a matcher
+            /// \param icpParams - the parameters of the ICP
+            explicit IcpMatcher(const IcpParams & icpParams);
+
+            /// \brief makes a scan the reference the next scans are matched against
+            /// \param angleMin - angle of the first beam
+            /// \param angleIncrement - angle between beams
+            /// \param ranges - range of each beam
+            /// \param rangeMin - shorter ranges are ignored
+            /// \param rangeMax - longer ranges are ignored
+            void setReference(double angleMin, double angleIncrement, const std::vector<float> & ranges,
+                              double rangeMin, double rangeMax);
+
+            /// \brief returns true once a reference scan was set
+            bool hasReference() const;
+
+            /// \brief finds the pose of a scan in the frame of the reference scan
+            /// \param angleMin - angle of the first beam
+            /// \param angleIncrement - angle between beams
+            /// \param ranges - range of each beam
+            /// \param rangeMin - shorter ranges are ignored
+            /// \param rangeMax - longer ranges are ignored
+            /// \param x0 - initial guess of the pose, e.g. from the wheels
+            /// \param y0 - initial guess of the pose
+            /// \param th0 - initial guess of the pose
+            /// \return the pose, its covariance and whether it can be trusted
+            IcpResult match(double angleMin, double angleIncrement, const std::vector<float> & ranges,
+                            double rangeMin, double rangeMax, double x0, double y0, double th0);
+    };
+
+    /// \brief parameters of the correlative matcher
+    struct CorrelativeParams
+    {
+        double resolution = 0.05;       // cell side of the finest likelihood field (m)
+        int levels = 5;                 // fields 1, 2, 4, ... 2^(levels-1) cells wide are precomputed
+        double sigma = 0.05;            // standard deviation of a point around the reference surface (m)
+        double linearWindow = 0.5;      // translations searched on each side of the guess (m)
+        double angularWindow = 0.8;     // rotations searched on each side of the guess (rad)
+        double minScore = 0.4;          // poses with a lower mean likelihood are not reported
+        int threads = 1;                // threads the rotations are split over
+    };
+
+    /// \brief the result of a correlative search
+    struct CorrelativeResult
+    {
+        bool found = false;
+        double x = 0.0;             // pose of the scan in the reference frame
+        double y = 0.0;
+        double th = 0.0;
+        double score = 0.0;         // mean likelihood of the points, 1 if every point is on the reference
+    };
+
+    /// \brief finds the pose of a scan in a window around a guess with an exhaustive, branch and bound search
+    /// The reference scans are rasterized into a likelihood field by stamping a precomputed Gaussian
+    /// kernel at each point. For each level k a second field holds the maximum of the finest field over the
+    /// 2^k x 2^k cells starting at each cell, so the score of a translation on level k bounds the score of
+    /// every translation in that square. Each rotation in the window is searched from the coarsest level down,
+    /// skipping every square that cannot beat the best pose found so far. The rotations are split over threads.
+    /// Unlike ICP it does not need a guess close to the answer, only one inside the window.
+    class CorrelativeMatcher
+    {
+        private:
+            CorrelativeParams params;
+
+            std::vector<double> refX, refY;     // points of the reference scans, in the reference frame
+            bool fieldsStale;
+
+            int width, height;
+            double originX, originY;
+            std::vector<std::vector<float>> fields;     // fields[k], row major, width x height
+
+            int kernelRadius;
+            std::vector<float> kernel;          // likelihood at each cell offset from a point
+
+            std::vector<double> curX, curY;
+
+            /// \brief rasterizes the reference points into the fields
+            void buildFields();
+
+            /// \brief finds the best translation for one rotation
+            /// \param cx - cell x of each rotated point at the guess translation
+            /// \param cy - cell y of each rotated point at the guess translation
+            /// \param window - translations searched on each side, in cells
+            /// \param best - the best score so far, raised when a better translation is found
+            /// \param bestI - the best translation in x, in cells
+            /// \param bestJ - the best translation in y, in cells
+            /// \return true if a translation beat best
+            bool searchRotation(const std::vector<int> & cx, const std::vector<int> & cy, int window,
+                                float & best, int & bestI, int & bestJ) const;
+
+            /// \brief mean of a field over the points shifted by (i, j) cells
+            float score(int level, const std::vector<int> & cx, const std::vector<int> & cy, int i, int j) const;
+
+        public:
+            /// \brief create a matcher with default parameters
+            CorrelativeMatcher();
+
+            /// \brief create a matcher
+            /// \param correlativeParams - the parameters of the search
+            explicit CorrelativeMatcher(const CorrelativeParams & correlativeParams);
+
+            /// \brief removes every reference scan
+            void clearReference();
+
+            /// \brief adds a scan to the reference
+            /// \param angleMin - angle of the first beam
+            /// \param angleIncrement - angle between beams
+            /// \param ranges - range of each beam
+            /// \param rangeMin - shorter ranges are ignored
+            /// \param rangeMax - longer ranges are ignored
+            /// \param x - pose of the scan in the reference frame
+            /// \param y - pose of the scan in the reference frame
+            /// \param th - pose of the scan in the reference frame
+            void addReference(double angleMin, double angleIncrement, const std::vector<float> & ranges,
+                              double rangeMin, double rangeMax, double x, double y, double th);
+
+            /// \brief returns the number of points in the reference
+            int numReferencePoints() const;
+
+            /// \brief finds the pose of a scan in the reference frame
+            /// \param angleMin - angle of the first beam
+            /// \param angleIncrement - angle between beams
+            /// \param ranges - range of each beam
+            /// \param rangeMin - shorter ranges are ignored
+            /// \param rangeMax - longer ranges are ignored
+            /// \param x0 - centre of the search window
+            /// \param y0 - centre of the search window
+            /// \param th0 - centre of the search window
+            /// \return the best pose in the window, found if it scores at least minScore
+            CorrelativeResult match(double angleMin, double angleIncrement, const std::vector<float> & ranges,
+                                    double rangeMin, double rangeMax, double x0, double y0, double th0);
+    };
+}
+
+#endif
@@ -0,0 +1,318 @@
+#ifndef SENSOR_LOG_LIBRARY_INCLUDE_GUARD_HPP
+#define SENSOR_LOG_LIBRARY_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Library for recording scans, joint states and landmark observations to a compact binary log
+///
+/// The file is a fixed 64 byte header, the chunks one after the other, and an index of the chunks:
+///     header                  (LogHeader, indexOffset is 0 until the log is closed)
+///     chunk 0                 (ChunkHeader, then storedSize bytes of records, padded to 8 bytes)
+///     chunk 1 ...
+///     index                   (numChunks ChunkIndex)
+/// The file is only ever appended to while recording, the header is patched with the index on close. A
+/// log that was never closed is still read, its index is rebuilt by walking the chunks.
+///
+/// Each record of a chunk is a type byte, the zigzag varint difference in nanoseconds between its time and
+/// the time of the record before it (the first record of a chunk is at the chunk's firstTime), then a
+/// fixed layout body padded to its alignment from the start of the chunk:
+///     SCAN                    float angleMin, angleIncrement, rangeMin, rangeMax, uint32 count, float ranges[count]
+///     JOINTS                  uint32 count, uint32 unused, double positions[count], double velocities[count]
+///     REAL_LANDMARKS,
+///     FAKE_LANDMARKS          uint32 count, Observation observations[count]
+///     POSE                    uint32 source, uint32 unused, int64 wallTime, double th, x, y
+/// When built with LZ4 (NUSLAM_HAVE_LZ4) a chunk may be stored compressed. Numbers are stored in the byte
+/// order of the machine that wrote the file. Version 1 logs, written before POSE records, are still read.
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace sensor_log
+{
+    /// \brief the version written by LogWriter
+    constexpr uint32_t LOG_VERSION = 2;
+
+    /// \brief the header at the start of a log file
+    struct LogHeader
+    {
+        char magic[8];              // "NUSLMLOG"
+        uint32_t version;           // LOG_VERSION
+        uint32_t byteOrder;         // 0x01020304 in the byte order of the writer
+        uint64_t indexOffset;       // byte offset of the index from the start of the file, 0 if never closed
+        uint64_t numChunks;
+        uint64_t numRecords;
+        int64_t firstTime;          // time of the earliest record (ns)
+        int64_t lastTime;           // time of the latest record (ns)
+        uint64_t reserved;
+    };
+
+    static_assert(sizeof(LogHeader) == 64, "the log file header must stay 64 bytes");
+
+    /// \brief the header in front of the records of a chunk
+    struct ChunkHeader
+    {
+        uint32_t magic;             // CHUNK_MAGIC, to find the chunks of a log that was never closed
+        uint32_t flags;             // CHUNK_LZ4 if the records are compressed
+        uint32_t numRecords;
+        uint32_t storedSize;        // bytes following this header, without the padding
+        uint32_t rawSize;           // bytes of records once decompressed
+        uint32_t reserved;
+        int64_t firstTime;          // time of the first record (ns)
+    };
+
+    static_assert(sizeof(ChunkHeader) == 32, "the chunk header must stay 32 bytes");
+
+    /// \brief the entry of a chunk in the index
+    struct ChunkIndex
+    {
+        uint64_t offset;            // byte offset of the chunk header from the start of the file
+        int64_t firstTime;          // earliest record of the chunk (ns)
+        int64_t lastTime;           // latest record of the chunk (ns)
+        uint64_t numRecords;
+    };
+
+    static_assert(sizeof(ChunkIndex) == 32, "index entries must stay 32 bytes");
+
+    /// \brief the first word of every chunk, "CHNK" read as little endian
+    constexpr uint32_t CHUNK_MAGIC = 0x4b4e4843;
+
+    /// \brief the records of a chunk are compressed with LZ4
+    constexpr uint32_t CHUNK_LZ4 = 1;
+
+    /// \brief the kinds of record
+    enum class RecordType : uint8_t
+    {
+        SCAN = 1,                   // sensor_msgs/LaserScan
+        JOINTS = 2,                 // sensor_msgs/JointState, positions and velocities in the order published
+        REAL_LANDMARKS = 3,         // the landmarks found in the scan, /real_sensor
+        FAKE_LANDMARKS = 4,         // the landmarks of the simulator, /fake_sensor
+        POSE = 5                    // the latest pose of a trajectory
+    };
+
+    /// \brief the trajectory a pose record belongs to
+    enum class PoseSource : uint32_t
+    {
+        SLAM = 0,                   // the filter estimate, /slam_path
+        ODOMETRY = 1,               // the wheel odometry, /odom_path
+        TRUTH = 2                   // the simulated robot, /real_path
+    };
+
+    /// \brief a landmark observed in the robot frame
+    struct Observation
+    {
+        float x;
+        float y;
+        float radius;
+        int32_t id;                 // -1 if not associated
+    };
+
+    static_assert(sizeof(Observation) == 16, "observations must stay 16 bytes");
+
+    /// \brief the body of a scan record
+    struct ScanView
+    {
+        float angleMin = 0.0f;
+        float angleIncrement = 0.0f;
+        float rangeMin = 0.0f;
+        float rangeMax = 0.0f;
+        uint32_t count = 0;
+        const float * ranges = nullptr;
+    };
+
+    /// \brief the body of a joints record
+    struct JointView
+    {
+        uint32_t count = 0;
+        const double * positions = nullptr;
+        const double * velocities = nullptr;
+    };
+
+    /// \brief the body of a landmarks record
+    struct LandmarkView
+    {
+        uint32_t count = 0;
+        const Observation * observations = nullptr;
+    };
+
+    /// \brief the body of a pose record
+    struct PoseView
+    {
+        PoseSource source = PoseSource::SLAM;
+        int64_t wallTime = 0;       // when the pose was received (ns), to measure how fast a replay ran
+        double th = 0.0;
+        double x = 0.0;
+        double y = 0.0;
+    };
+
+    /// \brief one record read back, only the view of its type is set
+    /// The arrays point into the mapped file, or into the reader's buffer for a compressed chunk, and stay
+    /// valid until the reader moves to another chunk.
+    struct Record
+    {
+        RecordType type = RecordType::SCAN;
+        int64_t time = 0;           // ns
+        ScanView scan;
+        JointView joints;
+        LandmarkView landmarks;
+        PoseView pose;
+    };
+
+    /// \brief returns true if the library was built with LZ4
+    bool haveLZ4();
+
+    /// \brief appends records to a log file, a chunk at a time
+    class LogWriter
+    {
+        private:
+            std::ofstream file;
+            std::string path;
+            bool compress;
+            size_t chunkBytes;
+
+            std::vector<uint8_t> chunk;         // records of the chunk being filled
+            ChunkIndex current;                 // the chunk being filled, its offset is set when written
+            int64_t chunkStart;                 // time of its first record
+            int64_t previousTime;
+            std::vector<ChunkIndex> index;
+            LogHeader header;
+
+            std::vector<char> compressed;
+
+            /// \brief starts a record, writing the chunk out first if the record would not fit
+            /// \param type - the kind of record
+            /// \param time - time of the record (ns)
+            /// \param bodyBytes - size of the body, to decide whether it fits
+            void begin(RecordType type, int64_t time, size_t bodyBytes);
+
+            /// \brief pads the chunk with zeros to an alignment from its start
+            void pad(size_t alignment);
+
+            /// \brief appends bytes to the chunk
+            void append(const void * bytes, size_t length);
+
+            /// \brief writes the chunk being filled to the file
+            bool flushChunk();
+
+        public:
+            /// \brief create a closed writer
+            LogWriter();
+
+            LogWriter(const LogWriter &) = delete;
+            LogWriter & operator=(const LogWriter &) = delete;
+
+            /// \brief closes the log
+            ~LogWriter();
+
+            /// \brief creates a log file, replacing any file at the path
+            /// \param logPath - the file to write
+            /// \param lz4 - compress the chunks, ignored if the library was built without LZ4
+            /// \param chunkSize - bytes of records gathered before a chunk is written
+            /// \param error - the reason the file could not be created
+            /// \return true if the log is open
+            bool open(const std::string & logPath, bool lz4, size_t chunkSize, std::string & error);
+
+            /// \brief returns true if a log is open
+            bool isOpen() const;
+
+            /// \brief appends a scan
+            void writeScan(int64_t time, float angleMin, float angleIncrement, float rangeMin, float rangeMax,
+                           const std::vector<float> & ranges);
+
+            /// \brief appends joint states, velocities are zero where missing
+            void writeJoints(int64_t time, const std::vector<double> & positions, const std::vector<double> & velocities);
+
+            /// \brief appends landmark observations
+            /// \param type - REAL_LANDMARKS or FAKE_LANDMARKS
+            void writeLandmarks(int64_t time, RecordType type, const std::vector<Observation> & observations);
+
+            /// \brief appends a pose of a trajectory
+            /// \param time - the stamp of the pose (ns)
+            /// \param source - the trajectory
+            /// \param wallTime - the wall clock time it was received (ns)
+            void writePose(int64_t time, PoseSource source, int64_t wallTime, double th, double x, double y);
+
+            /// \brief writes the last chunk and the index and closes the file
+            /// \param error - the reason the log could not be completed
+            /// \return true if the log was completed
+            bool close(std::string & error);
+    };
+
+    /// \brief a read only, memory mapped log file
+    /// Records are read in the order they were written. The index is searched to seek to a time without
+    /// reading the chunks before it.
+    class LogReader
+    {
+        private:
+            void * data;
+            size_t length;
+            std::vector<ChunkIndex> index;
+            bool rebuilt;
+            uint64_t totalRecords;
+
+            size_t chunk;                       // the chunk being read, index.size() at the end
+            const uint8_t * records;            // its records, decompressed if needed
+            size_t recordsSize;
+            size_t position;                    // byte of the next record
+            int64_t previousTime;
+            std::vector<uint64_t> buffer;       // decompressed records, 8 byte aligned
+            size_t skipped;
+
+            /// \brief makes a chunk the one being read, skipping chunks that cannot be read
+            void enterChunk(size_t k);
+
+        public:
+            /// \brief create a closed reader
+            LogReader();
+
+            LogReader(const LogReader &) = delete;
+            LogReader & operator=(const LogReader &) = delete;
+
+            /// \brief unmaps the file
+            ~LogReader();
+
+            /// \brief maps a log file and checks its header, rebuilding the index of a log that was never closed
+            /// \param path - the file to map
+            /// \param error - the reason the file could not be used
+            /// \return true if the log can be read
+            bool open(const std::string & path, std::string & error);
+
+            /// \brief unmaps the file
+            void close();
+
+            /// \brief returns true if a log is mapped
+            bool isOpen() const;
+
+            /// \brief returns true if the index was rebuilt because the log was never closed
+            bool recovered() const;
+
+            /// \brief returns the number of chunks
+            size_t numChunks() const;
+
+            /// \brief returns the number of records
+            uint64_t numRecords() const;
+
+            /// \brief returns the time of the earliest record (ns)
+            int64_t firstTime() const;
+
+            /// \brief returns the time of the latest record (ns)
+            int64_t lastTime() const;
+
+            /// \brief returns the number of chunks skipped because they could not be read
+            size_t skippedChunks() const;
+
+            /// \brief goes back to the first record
+            void rewind();
+
+            /// \brief goes to the first record at or after a time, in the first chunk that reaches it
+            /// \param time - the time to seek to (ns)
+            void seek(int64_t time);
+
+            /// \brief reads the next record
+            /// \param record - the record, its arrays point into the log
+            /// \return false at the end of the log
+            bool next(Record & record);
+    };
+}
+
+#endif
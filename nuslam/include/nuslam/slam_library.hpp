@@ -6,6 +6,9 @@
 #include<armadillo>
 #include"rigid2d/rigid2d.hpp"
 #include"rigid2d/diff_drive.hpp"
+#include<cstdint>
+#include<utility>
+#include<vector>
 
 namespace slam_library
 {
@@ -18,6 +21,12 @@ namespace slam_library
     /// \param th the angle of the robot
     colvec RangeBearing(double xRel, double yRel);
 
+    /// \brief a function that finds where each landmark ends up after ExtendedKalman::mergeLandmarks
+    /// \param visited - the number of landmarks seen before the merge
+    /// \param pairs - the (kept, duplicate) landmark j given to mergeLandmarks
+    /// \return element j is the new j of landmark j, a duplicate gets the one of the landmark it was merged into
+    std::vector<int> mergedSlots(int visited, const std::vector<std::pair<int, int>> & pairs);
+
     /// \brief a class that contains functions when utilizing Extended Kalman Filter
     /// At each time step t, the EKF takes odometry (u) and sensor measurements (z)
     /// to generate estimate of full state vector (zeta)
@@ -33,6 +42,23 @@ namespace slam_library
             int n;                  // number of landmarks
             int N = 0;              // the number of landmarks visited
 
+            mat innovation;         // 2x2 innovation covariance S formed by the last KalmanGain
+
+            // the radius of each landmark, a feature estimated beside the state: no pose or location enters
+            // its measurement, so it would never correlate with them in the covariance
+            std::vector<double> radius;
+            std::vector<double> radiusVar;      // -1 until the landmark has a radius
+            double radiusNoise = 1e-4;          // variance of a fitted radius
+            double radiusGate = 6.63;           // chi-square bound, 1 degree of freedom
+            uint64_t radiusRejected = 0;        // candidates the radius ruled out before the Mahalanobis test
+            uint64_t mahalanobisTests = 0;
+
+            /// \brief whether a fitted radius can be of landmark j
+            /// \param j - the landmark j, numbered as in h
+            /// \param r - the fitted radius
+            /// \return true if the landmark has no radius yet or the difference is within the gate
+            bool radiusMatches(int j, double r) const;
+
             /// \brief initialize the initial covariance matrix
             /// \param num - the number of landmarks
             /// \return (3+2n)x(3_2n) covariance matrix
@@ -62,6 +88,77 @@ namespace slam_library
             /// \param covNew - the new covariance matrix
             ExtendedKalman & updateCov(mat covNew);
 
+            /// \brief moves the robot to a new pose, keeping the map
+            /// \param robotState - the new 3x1 pose (theta, x, y)
+            /// \param poseCov - the new 3x3 covariance of the pose
+            ExtendedKalman & resetPose(colvec robotState, mat poseCov);
+
+            /// \brief replaces the process noise used by the next predictions
+            /// \param Q - a 3x3 matrix representing process noise
+            ExtendedKalman & setProcessNoise(mat Q);
+
+            /// \brief returns the number of landmarks seen so far
+            int getNumVisited() const;
+
+            /// \brief replaces the noise and the gate of the radius feature
+            /// \param variance - the variance of a fitted radius
+            /// \param gate - the chi-square bound (1 degree of freedom) a fitted radius must be within
+            ExtendedKalman & setRadiusNoise(double variance, double gate);
+
+            /// \brief fuses a fitted radius into the radius of landmark j, or initializes it
+            /// \param j - the landmark j, numbered as in h
+            /// \param r - the fitted radius
+            ExtendedKalman & updateRadius(int j, double r);
+
+            /// \brief sets the radius of landmark j, as from a saved map
+            /// \param j - the landmark j, numbered as in h
+            /// \param r - the radius
+            /// \param variance - its variance, -1 to forget the radius
+            ExtendedKalman & setRadius(int j, double r, double variance);
+
+            /// \brief the radius of landmark j, numbered as in h
+            double getRadius(int j) const;
+
+            /// \brief the variance of the radius of landmark j, -1 if it has none
+            double getRadiusVar(int j) const;
+
+            /// \brief counts of the data association so far
+            /// \param tested - Mahalanobis distances formed
+            /// \param rejected - candidates the radius ruled out before it
+            void associationStats(uint64_t & tested, uint64_t & rejected) const;
+
+            /// \brief replaces the whole filter with a saved one, the radii are forgotten
+            /// \param savedState - the (3+2n)x1 state vector
+            /// \param savedCov - the (3+2n)x(3+2n) covariance
+            /// \param visited - the number of landmarks already seen
+            ExtendedKalman & warmStart(colvec savedState, mat savedCov, int visited);
+
+            /// \brief merges landmarks that were mapped twice
+            /// All pairs are fused in one joint update with the pseudo measurement (kept - duplicate) = 0,
+            /// then each duplicate is removed and the later landmarks move down one slot. The radius of a
+            /// duplicate is fused into the kept one.
+            /// \param pairs - (kept, duplicate) landmark j, numbered as in h
+            /// \param variance - the variance of each pseudo measurement
+            ExtendedKalman & mergeLandmarks(const std::vector<std::pair<int, int>> & pairs, double variance);
+
+            /// \brief fuses the estimates of several landmarks from another robot with covariance intersection
+            /// All landmarks are stacked into one direct measurement and fused with a single weight omega:
+            /// the seen part of the filter is scaled by 1/omega once, the estimates by 1/(1 - omega). Omega
+            /// minimizes the determinant of the whole fused covariance, the pose and the landmarks not in the
+            /// summary included, so the result stays consistent whatever the unknown correlation between the
+            /// two estimates and does not depend on the order of the landmarks.
+            /// \param js - the landmark j of each estimate, numbered as in h, each at most once
+            /// \param means - the (2m)x1 stacked locations from the other robot
+            /// \param landmarkCov - their (2m)x(2m) covariance
+            /// \return omega, the weight of the own estimate, 1 if the estimates were not fused
+            double intersectLandmarks(const std::vector<int> & js, colvec means, mat landmarkCov);
+
+            /// \brief adds a landmark only another robot has seen, in the next free slot
+            /// \param mean - the 2x1 location from the other robot
+            /// \param landmarkCov - its 2x2 covariance
+            /// \return the landmark j, numbered as in h, or -1 if every slot is taken
+            int adoptLandmark(colvec mean, mat landmarkCov);
+
             /// \brief g function that updates the estimate using the model
             /// \param prevState - a (3+2n)x1 column vector representing the state of the robot
             /// \param tw - the twist / controls
@@ -85,10 +182,17 @@ namespace slam_library
             colvec h(int j);
 
             /// \brief calculates the Kalman Gain from the linearized measurement model
+            /// The innovation covariance it forms is kept for NIS.
             /// \param j - the landmark j
             /// \return (3+2n)x2 matrix, Kalman gain 
             mat KalmanGain(int j);
 
+            /// \brief the normalized innovation squared of the update the last KalmanGain was for
+            /// \param z_diff - the innovation z - h(j), bearing normalized
+            /// \return z_diff^T S^-1 z_diff, chi-square with 2 degrees of freedom when the filter is consistent,
+            /// or -1 before the first KalmanGain
+            double NIS(const colvec & z_diff) const;
+
             /// \brief gets the matrix H_j
             /// \param j - the landmark j
             /// \return 2x(3+2n) matrix, the derivative of h_j wrt the state
@@ -99,9 +203,108 @@ namespace slam_library
             mat getH2(int j, vec temp);
 
             /// \brief function used for data association
+            /// A landmark whose radius differs from the fitted one beyond the radius gate is skipped before
+            /// its Mahalanobis distance is formed. Its distance is only formed if no other landmark matches, and
+            /// the measurement is dropped if it is within the gate, as two tubes cannot share a location.
             /// \param z_i : the range bearing measurement
-            /// \return an integer representing the marker id
-            int DataAssociation(vec z_i);
+            /// \param r : the fitted radius of the measured tube, or -1 to associate on the location alone
+            /// \return the landmark j (from 1) the measurement is of, initialized if it is new, or -1 if it is
+            /// ambiguous, at a landmark of another radius, or a new landmark has no free slot in the state
+            int DataAssociation(vec z_i, double r = -1.0);
+    };
+
+    /// \brief a class that localizes the robot against a fixed, surveyed landmark map with an Extended Kalman Filter
+    /// Only the 3x1 robot pose (theta, x, y) is estimated. The uncertainty of each landmark is folded into the
+    /// measurement noise (R + H_m * Sigma_m * H_m^T), so each prediction and update costs the same regardless of map size.
+    /// Landmarks are indexed from 0, in the order they appear in the map.
+    class LocalizationKalman
+    {
+        private:
+            colvec stateVec;        // 3x1 state vector (theta, x, y)
+            mat processNoise;       // 3x3 process noise Q matrix
+            mat sensorNoise;        // 2x2 sensor noise R matrix
+            mat cov;                // 3x3 covariance of the pose
+
+            mat landmarks;          // 2xn landmark locations, one column per landmark
+            cube landmarkCov;       // 2x2xn covariance of each landmark location
+
+            int n;                  // number of landmarks
+
+            double nis = -1.0;      // normalized innovation squared of the last update
+
+        public:
+            /// \brief create a class for localizing against a fixed map
+            /// \param robotState - a 3x1 column vector representing the initial pose of the robot
+            /// \param mapState - a 2nx1 column representing the map (x1, y1, x2, y2, ...), where n is the number of landmarks
+            /// \param Q - a 3x3 matrix representing process noise
+            /// \param R - a 2x2 matrix representing sensor noise
+            /// \param mapVar - the variance of each landmark coordinate
+            LocalizationKalman(colvec robotState, colvec mapState, mat Q, mat R, double mapVar);
+
+            /// \brief returns the pose estimate
+            /// \return 3x1 state vector (theta, x, y)
+            const colvec & getStateVec() const;
+
+            /// \brief returns the covariance of the pose
+            /// \return 3x3 covariance matrix
+            const mat & getCov() const;
+
+            /// \brief resets the pose estimate and its covariance
+            /// \param robotState - the new 3x1 pose (theta, x, y)
+            /// \param poseCov - the new 3x3 covariance
+            LocalizationKalman & resetPose(colvec robotState, mat poseCov);
+
+            /// \brief replaces the process noise used by the next predictions
+            /// \param Q - a 3x3 matrix representing process noise
+            LocalizationKalman & setProcessNoise(mat Q);
+
+            /// \brief returns the number of landmarks in the map
+            int numLandmarks() const;
+
+            /// \brief returns the location of landmark j
+            /// \param j - the landmark j (0 indexed)
+            /// \return 2x1 column vector (x, y)
+            colvec getLandmark(int j) const;
+
+            /// \brief sets the covariance of the location of landmark j
+            /// \param j - the landmark j (0 indexed)
+            /// \param landmarkCovj - 2x2 covariance
+            LocalizationKalman & setLandmarkCov(int j, mat landmarkCovj);
+
+            /// \brief propagates the pose and its covariance with the motion model
+            /// \param tw - the twist / controls
+            LocalizationKalman & predict(const Twist2D & tw);
+
+            /// \brief gets the expected range and bearing to landmark j from the current pose
+            /// \param j - the landmark j (0 indexed)
+            /// \return h_j
+            colvec h(int j) const;
+
+            /// \brief gets the derivative of h_j with respect to the pose
+            /// \param j - the landmark j (0 indexed)
+            /// \return 2x3 matrix
+            mat getH(int j) const;
+
+            /// \brief gets the innovation covariance of a measurement of landmark j,
+            /// including the uncertainty of the landmark location
+            /// \param j - the landmark j (0 indexed)
+            /// \return 2x2 matrix, H * cov * H^T + R + H_m * Sigma_m * H_m^T
+            mat innovationCov(int j) const;
+
+            /// \brief corrects the pose with a range-bearing measurement of landmark j
+            /// \param j - the landmark j (0 indexed)
+            /// \param z - the range bearing measurement
+            LocalizationKalman & update(int j, const colvec & z);
+
+            /// \brief the normalized innovation squared of the last update
+            /// \return z_diff^T S^-1 z_diff, or -1 before the first update
+            double NIS() const;
+
+            /// \brief finds the landmark a measurement most likely belongs to
+            /// \param z - the range bearing measurement
+            /// \param gate - the largest Mahalanobis distance (squared) accepted
+            /// \return the landmark j (0 indexed), or -1 if no landmark is within the gate
+            int DataAssociation(const colvec & z, double gate) const;
     };
 }
 
@@ -0,0 +1,201 @@
+#ifndef TRAJECTORY_EVAL_LIBRARY_INCLUDE_GUARD_HPP
+#define TRAJECTORY_EVAL_LIBRARY_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Library for measuring the accuracy of an estimated trajectory against the ground truth
+///
+/// Each estimated pose is paired with the ground truth interpolated at its stamp. The absolute pose
+/// error (ATE) is the error of each pose once the whole estimate is moved by the SE(2) transform that
+/// fits it best to the ground truth, the relative pose error (RPE) is the error of the motion over a
+/// fixed time, which needs no alignment. A sensor log is read twice, once to fit the alignment and
+/// the RPE and once for the ATE, so a log of any length takes linear time and constant memory.
+
+#include <nuslam/sensor_log_library.hpp>
+
+#include <cstdint>
+#include <deque>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace trajectory_eval
+{
+    /// \brief a pose at a time
+    struct StampedPose
+    {
+        double t;                   // (s)
+        double th;
+        double x;
+        double y;
+    };
+
+    /// \brief an estimated pose and the ground truth at its stamp
+    struct PosePair
+    {
+        StampedPose estimate;
+        StampedPose truth;
+    };
+
+    /// \brief pairs each estimated pose with the ground truth interpolated at its stamp
+    /// Both streams must be roughly in time order. Only the last two ground truth poses are kept, and
+    /// estimates newer than the latest one wait for the next, so memory does not grow with the log.
+    class TimeAssociator
+    {
+        private:
+            double maxGap;
+            std::deque<StampedPose> truth;      // at most the last two
+            std::deque<StampedPose> pending;    // estimates newer than the latest ground truth
+            uint64_t unmatched;
+
+            /// \brief pairs an estimate with the ground truth around it, if there is any
+            /// \return false if the estimate cannot be paired
+            bool pair(const StampedPose & estimate, std::vector<PosePair> & pairs) const;
+
+        public:
+            /// \brief create an associator
+            /// \param maxTruthGap - estimates between ground truth poses further apart than this are not paired (s)
+            explicit TimeAssociator(double maxTruthGap = 0.5);
+
+            /// \brief adds a ground truth pose
+            /// \param pose - the pose
+            /// \param pairs - the estimates waiting for it are appended
+            void addTruth(const StampedPose & pose, std::vector<PosePair> & pairs);
+
+            /// \brief adds an estimated pose
+            /// \param pose - the pose
+            /// \param pairs - the pair is appended if the ground truth reaches past it
+            void addEstimate(const StampedPose & pose, std::vector<PosePair> & pairs);
+
+            /// \brief the estimates that could not be paired, including those still waiting
+            uint64_t unpaired() const;
+    };
+
+    /// \brief the rigid transform moving the estimate onto the ground truth
+    struct Alignment
+    {
+        bool valid = false;
+        double th = 0.0;
+        double x = 0.0;
+        double y = 0.0;
+    };
+
+    /// \brief fits the SE(2) transform that minimizes the squared distance between the aligned
+    /// estimated positions and the ground truth, from running sums of the pairs
+    class Se2Aligner
+    {
+        private:
+            uint64_t count;
+            double sumP[2];             // estimated positions
+            double sumQ[2];             // ground truth positions
+            double sumDot;              // p . q
+            double sumCross;            // p x q
+
+        public:
+            /// \brief create an empty aligner
+            Se2Aligner();
+
+            /// \brief adds a pair
+            void add(const PosePair & pair);
+
+            /// \brief the best transform, invalid with fewer than 2 pairs
+            Alignment solve() const;
+    };
+
+    /// \brief streaming statistics of an error
+    struct ErrorStats
+    {
+        uint64_t count = 0;
+        double sum = 0.0;
+        double sumSq = 0.0;
+        double max = 0.0;
+
+        /// \brief adds an error
+        void add(double error);
+
+        /// \brief the mean error, 0 if there are none
+        double mean() const;
+
+        /// \brief the root mean square error, 0 if there are none
+        double rmse() const;
+    };
+
+    /// \brief the relative pose error over a fixed time
+    /// Only the pairs of the last delta seconds are kept.
+    class RelativeError
+    {
+        private:
+            double delta;
+            std::deque<PosePair> recent;
+
+        public:
+            ErrorStats translation;
+            ErrorStats rotation;
+
+            /// \brief create an empty measure
+            /// \param deltaTime - the time the motion is compared over (s)
+            explicit RelativeError(double deltaTime = 1.0);
+
+            /// \brief adds a pair, comparing its motion from the pair delta seconds before it
+            void add(const PosePair & pair);
+    };
+
+    /// \brief the absolute error of a pair once the estimate is aligned
+    /// \param alignment - the transform moving the estimate onto the ground truth
+    /// \param pair - the pair
+    /// \param translation - the distance between the positions
+    /// \param rotation - the absolute heading error
+    void absoluteError(const Alignment & alignment, const PosePair & pair, double & translation, double & rotation);
+
+    /// \brief what is evaluated
+    struct EvalParams
+    {
+        sensor_log::PoseSource estimate = sensor_log::PoseSource::SLAM;
+        double maxTruthGap = 0.5;       // (s)
+        double rpeDelta = 1.0;          // (s)
+    };
+
+    /// \brief the result of evaluating a log
+    struct Report
+    {
+        std::string estimate;           // the name of the evaluated trajectory
+        uint64_t estimates = 0;         // estimated poses in the log
+        uint64_t truths = 0;            // ground truth poses in the log
+        uint64_t pairs = 0;
+        uint64_t unpaired = 0;
+
+        Alignment alignment;
+        ErrorStats ateTranslation;
+        ErrorStats ateRotation;
+        double rpeDelta = 0.0;
+        ErrorStats rpeTranslation;
+        ErrorStats rpeRotation;
+
+        uint64_t scans = 0;
+        double logDuration = 0.0;       // between the first and last estimate, by their stamps (s)
+        double wallDuration = 0.0;      // between the first and last estimate, by the wall clock (s)
+        double realtimeFactor = 0.0;    // log time over wall time, 0 if unknown
+        double estimateRate = 0.0;      // estimates per wall clock second
+        double scanRate = 0.0;          // scans per wall clock second, while the estimate ran
+
+        uint64_t records = 0;           // records in the log
+        double evaluationTime = 0.0;    // wall clock time of the evaluation itself, both passes (s)
+    };
+
+    /// \brief the name of a trajectory, as in the report
+    std::string sourceName(sensor_log::PoseSource source);
+
+    /// \brief evaluates the trajectories recorded in a log
+    /// \param reader - an open log, it is rewound and read twice
+    /// \param params - the trajectory and the settings
+    /// \param report - the result
+    /// \param error - the reason the log could not be evaluated
+    /// \return false if the log pairs no estimated pose with the ground truth
+    bool evaluateLog(sensor_log::LogReader & reader, const EvalParams & params, Report & report, std::string & error);
+
+    /// \brief writes a report as a JSON object
+    void writeJson(const Report & report, std::ostream & out);
+
+    /// \brief writes a report as one CSV line, with a header line first if header is true
+    void writeCsv(const Report & report, std::ostream & out, bool header);
+}
+
+#endif
@@ -0,0 +1,142 @@
+/// \file checkpoint_library.cpp
+/// \brief a library that checkpoints the slam node in the background and restores it after a restart
+
+#include "nuslam/checkpoint_library.hpp"
+
+namespace checkpoint
+{
+    bool writeCheckpoint(const std::string & path, const Checkpoint & snapshot, std::string & error)
+    {
+        const uint64_t n = snapshot.state.size();
+        if (snapshot.cov.size() != n * n)
+        {
+            error = "the covariance does not match the state";
+            return false;
+        }
+
+        map_file::OdometryInfo info;
+        info.sequence = snapshot.sequence;
+        info.stamp = snapshot.stamp;
+        info.flags = snapshot.flags;
+        info.landmarkGeneration = snapshot.landmarkGeneration;
+        info.odometry = snapshot.odometry;
+        info.prediction = snapshot.prediction;
+
+        return map_file::saveMap(path, snapshot.state.data(), n, snapshot.cov.data(), snapshot.landmarks, error, &info);
+    }
+
+    bool readCheckpoint(const std::string & path, Checkpoint & snapshot, std::string & error)
+    {
+        map_file::MappedMap mapped;
+        if (!mapped.open(path, error))
+        {
+            return false;
+        }
+        const map_file::OdometryInfo * info = mapped.odometry();
+        if (!info)
+        {
+            error = path + " is a map without odometry, not a checkpoint";
+            return false;
+        }
+
+        const uint64_t n = mapped.stateLength();
+        snapshot.sequence = info->sequence;
+        snapshot.stamp = info->stamp;
+        snapshot.flags = info->flags;
+        snapshot.landmarkGeneration = info->landmarkGeneration;
+        snapshot.odometry = info->odometry;
+        snapshot.prediction = info->prediction;
+        snapshot.state.assign(mapped.state(), mapped.state() + n);
+        snapshot.cov.assign(mapped.cov(), mapped.cov() + n * n);
+        snapshot.landmarks.assign(mapped.landmarks(), mapped.landmarks() + mapped.numLandmarks());
+        return true;
+    }
+
+    CheckpointWriter::CheckpointWriter(const std::string & checkpointPath)
+        : path(checkpointPath), havePending(false), stopping(false), nextSequence(1), written(0), replaced(0)
+    {
+        thread = std::thread(&CheckpointWriter::run, this);
+    }
+
+    CheckpointWriter::~CheckpointWriter()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        thread.join();
+    }
+
+    void CheckpointWriter::submit(const Checkpoint & snapshot)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (havePending)
+            {
+                ++replaced;
+            }
+            // assigning keeps the capacity of the vectors, so this only allocates for the first snapshot
+            pending.stamp = snapshot.stamp;
+            pending.flags = snapshot.flags;
+            pending.landmarkGeneration = snapshot.landmarkGeneration;
+            pending.odometry = snapshot.odometry;
+            pending.prediction = snapshot.prediction;
+            pending.state.assign(snapshot.state.begin(), snapshot.state.end());
+            pending.cov.assign(snapshot.cov.begin(), snapshot.cov.end());
+            pending.landmarks.assign(snapshot.landmarks.begin(), snapshot.landmarks.end());
+            pending.sequence = nextSequence++;
+            havePending = true;
+        }
+        wake.notify_one();
+    }
+
+    void CheckpointWriter::run()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true)
+        {
+            wake.wait(lock, [this]() { return havePending || stopping; });
+            if (!havePending)
+            {
+                return;
+            }
+
+            // the lock is only held for the swap, never while writing
+            std::swap(pending, writing);
+            havePending = false;
+            lock.unlock();
+
+            std::string writeError;
+            const bool ok = writeCheckpoint(path, writing, writeError);
+
+            lock.lock();
+            if (ok)
+            {
+                ++written;
+                error.clear();
+            } else
+            {
+                error = writeError;
+            }
+        }
+    }
+
+    uint64_t CheckpointWriter::numWritten()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return written;
+    }
+
+    uint64_t CheckpointWriter::numReplaced()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return replaced;
+    }
+
+    std::string CheckpointWriter::lastError()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return error;
+    }
+}
@@ -130,9 +130,13 @@ namespace circle_fit
         int angle = 0;
         double threshold = 0.07;
 
+        // the beams are evenly spaced around the full circle
+        const int beams = ranges.size();
+        const double increment = 2 * PI / beams;
+
         std::vector<geometry_msgs::Point> currCluster;
 
-        while (angle < 360)
+        while (angle < beams)
         {
             // if the point is out of range, then ignore it
             if ((ranges[angle] > maxRange) | (ranges[angle] < minRange))
@@ -145,7 +149,7 @@ namespace circle_fit
             int currAngle = angle;
             int nextAngle = angle + 1;
 
-            if (nextAngle == 360)
+            if (nextAngle == beams)
             {
                 nextAngle = 0;
             }
@@ -154,8 +158,8 @@ namespace circle_fit
             double nextDist = ranges[nextAngle];
 
             geometry_msgs::Point point;
-            point.x = ranges[currAngle] * cos(deg2rad(currAngle));
-            point.y = ranges[currAngle] * sin(deg2rad(currAngle));
+            point.x = ranges[currAngle] * cos(currAngle * increment);
+            point.y = ranges[currAngle] * sin(currAngle * increment);
 
             // if the distance between the two points is less than the threshold
             if (fabs(currDist - nextDist) < threshold)
@@ -164,10 +168,14 @@ namespace circle_fit
                 // currCluster.push_back(point);
                 // angle += 1;
 
-                // if at current is 359 and next is 0
-                if (nextAngle < angle)
+                // if at current is the last beam and next is 0, the first cluster wraps around
+                if ((nextAngle < angle) && !clusters.empty())
                 {
                     clusters[0].push_back(point);
+                } else if (nextAngle < angle) // nothing broke the scan, it is one cluster
+                {
+                    currCluster.push_back(point);
+                    clusters.push_back(currCluster);
                 } else // all other scenarios
                 {
                     currCluster.push_back(point);
@@ -0,0 +1,162 @@
+/// \file consistency_library.cpp
+/// \brief a library that checks the consistency of a Kalman filter with windowed chi-square tests
+
+#include "nuslam/consistency_library.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace consistency
+{
+    /// \brief a quantile of the standard normal distribution
+    /// Bisection on erfc, only used when a monitor is created.
+    static double normalQuantile(double p)
+    {
+        double lo = -10.0, hi = 10.0;
+        for (int i = 0; i < 100; ++i)
+        {
+            const double mid = 0.5 * (lo + hi);
+            if (0.5 * std::erfc(-mid / std::sqrt(2.0)) < p)
+            {
+                lo = mid;
+            } else
+            {
+                hi = mid;
+            }
+        }
+        return 0.5 * (lo + hi);
+    }
+
+    double chiSquareQuantile(double p, double dof)
+    {
+        // (X / k)^(1/3) is close to normal with mean 1 - 2/(9k) and variance 2/(9k)
+        const double v = 2.0 / (9.0 * dof);
+        const double cube = 1.0 - v + normalQuantile(p) * std::sqrt(v);
+        return dof * std::max(0.0, cube * cube * cube);
+    }
+
+    ConsistencyMonitor::ConsistencyMonitor()
+        : ConsistencyMonitor(50, 2, 0.95)
+    {
+    }
+
+    ConsistencyMonitor::ConsistencyMonitor(int windowSize, int degreesOfFreedom, double confidence)
+        : window(std::max(1, windowSize)), dof(std::max(1, degreesOfFreedom)), sum(0.0), total(0), last(0.0)
+    {
+        // the window sum is chi-square with window * dof degrees of freedom
+        const double alpha = 1.0 - std::min(std::max(confidence, 1e-6), 1.0 - 1e-6);
+        lower = chiSquareQuantile(0.5 * alpha, window * dof) / window;
+        upper = chiSquareQuantile(1.0 - 0.5 * alpha, window * dof) / window;
+    }
+
+    void ConsistencyMonitor::add(double value)
+    {
+        if (!std::isfinite(value))
+        {
+            return;
+        }
+
+        samples.push_back(value);
+        sum += value;
+        if (int(samples.size()) > window)
+        {
+            sum -= samples.front();
+            samples.pop_front();
+        }
+        last = value;
+        ++total;
+
+        // sum again once per window so the rounding of the running sum does not build up
+        if (total % window == 0)
+        {
+            sum = 0.0;
+            for (double sample: samples)
+            {
+                sum += sample;
+            }
+        }
+    }
+
+    void ConsistencyMonitor::clear()
+    {
+        samples.clear();
+        sum = 0.0;
+    }
+
+    Verdict ConsistencyMonitor::verdict() const
+    {
+        if (int(samples.size()) < window)
+        {
+            return Verdict::FILLING;
+        }
+        const double m = mean();
+        if (m > upper)
+        {
+            return Verdict::OVERCONFIDENT;
+        }
+        if (m < lower)
+        {
+            return Verdict::UNDERCONFIDENT;
+        }
+        return Verdict::CONSISTENT;
+    }
+
+    double ConsistencyMonitor::mean() const
+    {
+        return samples.empty() ? 0.0 : sum / samples.size();
+    }
+
+    double ConsistencyMonitor::lowerBound() const
+    {
+        return lower;
+    }
+
+    double ConsistencyMonitor::upperBound() const
+    {
+        return upper;
+    }
+
+    double ConsistencyMonitor::latest() const
+    {
+        return last;
+    }
+
+    uint64_t ConsistencyMonitor::count() const
+    {
+        return total;
+    }
+
+    double poseNees(const std::array<double, 3> & estimate, const std::array<double, 3> & truth,
+                    const std::array<double, 9> & cov)
+    {
+        const double e[3] = {std::remainder(estimate[0] - truth[0], 2.0 * M_PI), estimate[1] - truth[1],
+                             estimate[2] - truth[2]};
+
+        // the inverse of the 3x3 covariance from its cofactors
+        auto c = [&](int row, int col) { return cov[3*col + row]; };
+        double adj[3][3];
+        for (int row = 0; row < 3; ++row)
+        {
+            for (int col = 0; col < 3; ++col)
+            {
+                const int r0 = (col + 1) % 3, r1 = (col + 2) % 3;
+                const int c0 = (row + 1) % 3, c1 = (row + 2) % 3;
+                adj[row][col] = c(r0, c0) * c(r1, c1) - c(r0, c1) * c(r1, c0);
+            }
+        }
+        const double det = c(0, 0) * adj[0][0] + c(0, 1) * adj[1][0] + c(0, 2) * adj[2][0];
+        if (!(std::abs(det) > 0.0))
+        {
+            return -1.0;
+        }
+
+        double nees = 0.0;
+        for (int row = 0; row < 3; ++row)
+        {
+            for (int col = 0; col < 3; ++col)
+            {
+                nees += e[row] * adj[row][col] * e[col];
+            }
+        }
+        return nees / det;
+    }
+}
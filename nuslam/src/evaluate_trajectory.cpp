@@ -0,0 +1,140 @@
+/// \file evaluate_trajectory.cpp
+/// \brief contains a command line tool called evaluate_trajectory that measures the absolute and relative
+/// pose error of a trajectory recorded by record_log against the ground truth of tube_world
+///
+/// USAGE: evaluate_trajectory LOG [--estimate slam|odom] [--rpe-delta SECONDS] [--max-gap SECONDS]
+///                                [--format json|csv] [--output FILE]
+///     --estimate : the trajectory evaluated, /slam_path or /odom_path (default slam)
+///     --rpe-delta : the time the relative error compares the motion over (default 1.0)
+///     --max-gap : estimates between ground truth poses further apart than this are not paired (default 0.5)
+///     --format : json for one object, csv for a header and one line (default json)
+///     --output : the file the report is written to (default the standard output)
+///
+/// The report also gives how fast the recorded run went through its data, from the wall clock time each
+/// estimate was recorded at. It needs no ROS master, and reads the log twice without loading it.
+
+#include <nuslam/sensor_log_library.hpp>
+#include <nuslam/trajectory_eval_library.hpp>
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+/**********
+ * Helper Functions
+ * *******/
+void usage();
+
+/*********
+ * Main Function
+ * ******/
+int main(int argc, char* argv[])
+{
+    using namespace trajectory_eval;
+
+    /*********
+     * Read the arguments
+     * ******/
+    std::string log_file, format = "json", output;
+    EvalParams params;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const bool hasValue = (i + 1 < argc);
+        if ((arg == "--estimate") && hasValue)
+        {
+            const std::string estimate = argv[++i];
+            if (estimate == "slam")
+            {
+                params.estimate = sensor_log::PoseSource::SLAM;
+            } else if (estimate == "odom")
+            {
+                params.estimate = sensor_log::PoseSource::ODOMETRY;
+            } else
+            {
+                usage();
+                return 2;
+            }
+        } else if ((arg == "--rpe-delta") && hasValue)
+        {
+            params.rpeDelta = std::atof(argv[++i]);
+        } else if ((arg == "--max-gap") && hasValue)
+        {
+            params.maxTruthGap = std::atof(argv[++i]);
+        } else if ((arg == "--format") && hasValue)
+        {
+            format = argv[++i];
+        } else if ((arg == "--output") && hasValue)
+        {
+            output = argv[++i];
+        } else if (log_file.empty() && (arg.compare(0, 2, "--") != 0))
+        {
+            log_file = arg;
+        } else
+        {
+            usage();
+            return 2;
+        }
+    }
+
+    if (log_file.empty() || ((format != "json") && (format != "csv")) || (params.rpeDelta <= 0.0))
+    {
+        usage();
+        return 2;
+    }
+
+    /*********
+     * Evaluate the log
+     * ******/
+    sensor_log::LogReader reader;
+    std::string error;
+    if (!reader.open(log_file, error))
+    {
+        std::cerr << "evaluate_trajectory: " << error << std::endl;
+        return 1;
+    }
+    if (reader.recovered())
+    {
+        std::cerr << "evaluate_trajectory: " << log_file << " was not closed, its index was rebuilt" << std::endl;
+    }
+
+    Report report;
+    if (!evaluateLog(reader, params, report, error))
+    {
+        std::cerr << "evaluate_trajectory: " << error << std::endl;
+        return 1;
+    }
+
+    /*********
+     * Write the report
+     * ******/
+    std::ofstream file;
+    if (!output.empty())
+    {
+        file.open(output);
+        if (!file)
+        {
+            std::cerr << "evaluate_trajectory: cannot write " << output << std::endl;
+            return 1;
+        }
+    }
+    std::ostream & out = output.empty() ? std::cout : file;
+
+    if (format == "csv")
+    {
+        writeCsv(report, out, true);
+    } else
+    {
+        writeJson(report, out);
+    }
+    return out ? 0 : 1;
+}
+
+/// \brief prints how to call the tool
+void usage()
+{
+    std::cerr << "usage: evaluate_trajectory LOG [--estimate slam|odom] [--rpe-delta SECONDS] [--max-gap SECONDS]"
+              << " [--format json|csv] [--output FILE]" << std::endl;
+}
@@ -0,0 +1,206 @@
+/// \file exchange_library.cpp
+/// \brief a library that exchanges landmark summaries between robots and fuses them with covariance intersection
+
+#include "nuslam/exchange_library.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace exchange
+{
+    /// \brief the inverse of a 2x2 matrix, column major
+    static std::array<double, 4> inverse(const std::array<double, 4> & m)
+    {
+        const double det = m[0] * m[3] - m[1] * m[2];
+        return {m[3] / det, -m[1] / det, -m[2] / det, m[0] / det};
+    }
+
+    /// \brief the 2x2 covariance of a summary, column major
+    static std::array<double, 4> matrix(const std::array<double, 3> & cov)
+    {
+        return {cov[0], cov[1], cov[1], cov[2]};
+    }
+
+    SummaryTracker::SummaryTracker()
+        : SummaryTracker(3.0, 2.0, 0.02, 0.2)
+    {
+    }
+
+    SummaryTracker::SummaryTracker(double exchangeRange, double peerTimeout, double changeDistance,
+                                   double changeFraction)
+        : range(exchangeRange), timeout(peerTimeout), moveDistance(changeDistance), shrinkFraction(changeFraction),
+          clock(0), generation(0)
+    {
+    }
+
+    void SummaryTracker::update(const double * state, const double * cov, int stateLength, int visited,
+                                int landmarkGeneration)
+    {
+        // after a merge the slots hold other landmarks, so every one is revised
+        if (landmarkGeneration != generation)
+        {
+            reference.clear();
+            revision.clear();
+            generation = landmarkGeneration;
+        }
+        visited = std::min(visited, (stateLength - 3) / 2);
+        reference.resize(std::min<int>(reference.size(), visited));
+        revision.resize(visited, 0);
+
+        for (int j = 0; j < visited; ++j)
+        {
+            const int k = 3 + 2 * j;
+            const LandmarkSummary current = {j, state[k], state[k+1],
+                                             {cov[k*stateLength + k], cov[k*stateLength + k+1],
+                                              cov[(k+1)*stateLength + k+1]}};
+
+            bool changed = (j >= int(reference.size()));
+            if (!changed)
+            {
+                const LandmarkSummary & last = reference[j];
+                changed = (std::hypot(current.x - last.x, current.y - last.y) > moveDistance) ||
+                          (current.cov[0] + current.cov[2] < (1.0 - shrinkFraction) * (last.cov[0] + last.cov[2]));
+            }
+            if (!changed)
+            {
+                continue;
+            }
+
+            revision[j] = ++clock;
+            if (j < int(reference.size()))
+            {
+                reference[j] = current;
+            } else
+            {
+                reference.push_back(current);
+            }
+        }
+    }
+
+    void SummaryTracker::heard(const std::string & robot, double x, double y, double now)
+    {
+        Peer & peer = peers[robot];
+        peer.x = x;
+        peer.y = y;
+        peer.heard = now;
+    }
+
+    bool SummaryTracker::inRange(const std::string & robot, double x, double y, double now) const
+    {
+        auto found = peers.find(robot);
+        if (found == peers.end())
+        {
+            return false;
+        }
+        const Peer & peer = found->second;
+        return (peer.heard >= 0.0) && (now - peer.heard <= timeout) && (std::hypot(peer.x - x, peer.y - y) <= range);
+    }
+
+    int SummaryTracker::select(double x, double y, double now, std::vector<LandmarkSummary> & summary)
+    {
+        summary.clear();
+
+        // everything newer than what the least informed robot in range was sent
+        int count = 0;
+        uint64_t sentUpTo = std::numeric_limits<uint64_t>::max();
+        for (const auto & peer: peers)
+        {
+            if (inRange(peer.first, x, y, now))
+            {
+                sentUpTo = std::min(sentUpTo, peer.second.sentUpTo);
+                ++count;
+            }
+        }
+        if (count == 0)
+        {
+            return 0;
+        }
+
+        for (int j = 0; j < int(reference.size()); ++j)
+        {
+            if (revision[j] > sentUpTo)
+            {
+                summary.push_back(reference[j]);
+            }
+        }
+
+        for (auto & peer: peers)
+        {
+            if (inRange(peer.first, x, y, now))
+            {
+                peer.second.sentUpTo = clock;
+            }
+        }
+        return count;
+    }
+
+    uint64_t SummaryTracker::revisions() const
+    {
+        return clock;
+    }
+
+    double intersectionWeight(const std::array<double, 4> & A, const std::array<double, 4> & B)
+    {
+        // det(w Ai + (1 - w) Bi) = det(Bi + w D) is a quadratic in w, the fused determinant is its inverse
+        const std::array<double, 4> Ai = inverse(A), Bi = inverse(B);
+        const std::array<double, 4> D = {Ai[0] - Bi[0], Ai[1] - Bi[1], Ai[2] - Bi[2], Ai[3] - Bi[3]};
+        const double c0 = Bi[0] * Bi[3] - Bi[1] * Bi[2];
+        const double c1 = Bi[0] * D[3] + Bi[3] * D[0] - Bi[1] * D[2] - Bi[2] * D[1];
+        const double c2 = D[0] * D[3] - D[1] * D[2];
+        auto det = [&](double w) { return c0 + c1 * w + c2 * w * w; };
+
+        double best = 1.0;
+        if (det(0.0) > det(best))
+        {
+            best = 0.0;
+        }
+        if (c2 < 0.0)
+        {
+            const double vertex = -c1 / (2.0 * c2);
+            if ((vertex > 0.0) && (vertex < 1.0) && (det(vertex) > det(best)))
+            {
+                best = vertex;
+            }
+        }
+        return best;
+    }
+
+    double intersect(const std::array<double, 2> & a, const std::array<double, 4> & A,
+                     const std::array<double, 2> & b, const std::array<double, 4> & B,
+                     std::array<double, 2> & fused, std::array<double, 4> & F)
+    {
+        const double w = intersectionWeight(A, B);
+        const std::array<double, 4> Ai = inverse(A), Bi = inverse(B);
+        F = inverse({w * Ai[0] + (1 - w) * Bi[0], w * Ai[1] + (1 - w) * Bi[1],
+                     w * Ai[2] + (1 - w) * Bi[2], w * Ai[3] + (1 - w) * Bi[3]});
+
+        const double ex = w * (Ai[0] * a[0] + Ai[2] * a[1]) + (1 - w) * (Bi[0] * b[0] + Bi[2] * b[1]);
+        const double ey = w * (Ai[1] * a[0] + Ai[3] * a[1]) + (1 - w) * (Bi[1] * b[0] + Bi[3] * b[1]);
+        fused = {F[0] * ex + F[2] * ey, F[1] * ex + F[3] * ey};
+        return w;
+    }
+
+    int closestLandmark(const double * state, const double * cov, int stateLength, int visited,
+                        const LandmarkSummary & landmark, double & distance)
+    {
+        int best = -1;
+        distance = std::numeric_limits<double>::infinity();
+        const std::array<double, 4> B = matrix(landmark.cov);
+
+        for (int j = 0; j < std::min(visited, (stateLength - 3) / 2); ++j)
+        {
+            const int k = 3 + 2 * j;
+            const std::array<double, 4> Si = inverse({cov[k*stateLength + k] + B[0], cov[k*stateLength + k+1] + B[1],
+                                                      cov[(k+1)*stateLength + k] + B[2],
+                                                      cov[(k+1)*stateLength + k+1] + B[3]});
+            const double dx = landmark.x - state[k], dy = landmark.y - state[k+1];
+            const double d = dx * (Si[0] * dx + Si[2] * dy) + dy * (Si[1] * dx + Si[3] * dy);
+            if (d < distance)
+            {
+                best = j;
+                distance = d;
+            }
+        }
+        return best;
+    }
+}
@@ -0,0 +1,348 @@
+/// \file exploration_library.cpp
+/// \brief a library that keeps the frontier of a coarse grid up to date and scores exploration goals on it
+
+#include "nuslam/exploration_library.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+namespace exploration
+{
+    /// \brief finds the root of a union-find tree, halving the path on the way
+    static int findRoot(std::vector<int> & parent, int i)
+    {
+        while (parent[i] != i)
+        {
+            parent[i] = parent[parent[i]];
+            i = parent[i];
+        }
+        return i;
+    }
+
+    FrontierGrid::FrontierGrid(const ExploreParams & exploreParams)
+        : params(exploreParams),
+          half(exploreParams.size / 2),
+          state(exploreParams.size * exploreParams.size, CellState::UNKNOWN),
+          frontierSlot(exploreParams.size * exploreParams.size, -1),
+          touchStamp(exploreParams.size * exploreParams.size, 0),
+          scanCount(0)
+    {
+    }
+
+    void FrontierGrid::setState(int index, CellState s)
+    {
+        if (state[index] == s)
+        {
+            return;
+        }
+        state[index] = s;
+        if (touchStamp[index] != scanCount)
+        {
+            touchStamp[index] = scanCount;
+            touched.push_back(index);
+        }
+    }
+
+    void FrontierGrid::traceRay(int x0, int y0, int x1, int y1, bool hitEnd)
+    {
+        // Bresenham, stopping where the ray leaves the grid
+        const int dx = std::abs(x1 - x0), sx = (x0 < x1) ? 1 : -1;
+        const int dy = -std::abs(y1 - y0), sy = (y0 < y1) ? 1 : -1;
+        int err = dx + dy;
+
+        while ((x0 != x1) || (y0 != y1))
+        {
+            if (!contains(x0, y0))
+            {
+                return;
+            }
+            const int i = (y0 + half) * params.size + x0 + half;
+            if (state[i] == CellState::UNKNOWN)
+            {
+                setState(i, CellState::FREE);
+            }
+
+            int e2 = 2 * err;
+            if (e2 >= dy)
+            {
+                err += dy;
+                x0 += sx;
+            }
+            if (e2 <= dx)
+            {
+                err += dx;
+                y0 += sy;
+            }
+        }
+
+        if (!contains(x1, y1))
+        {
+            return;
+        }
+        const int i = (y1 + half) * params.size + x1 + half;
+        if (hitEnd)
+        {
+            setState(i, CellState::OCCUPIED);
+        } else if (state[i] == CellState::UNKNOWN)
+        {
+            setState(i, CellState::FREE);
+        }
+    }
+
+    void FrontierGrid::updateFrontier(int index)
+    {
+        const int size = params.size;
+        const int cx = index % size, cy = index / size;
+
+        // the edge of the grid is not a frontier, there is nothing to explore past it
+        bool isFront = false;
+        if (state[index] == CellState::FREE)
+        {
+            isFront = ((cx > 0) && (state[index - 1] == CellState::UNKNOWN)) ||
+                      ((cx < size - 1) && (state[index + 1] == CellState::UNKNOWN)) ||
+                      ((cy > 0) && (state[index - size] == CellState::UNKNOWN)) ||
+                      ((cy < size - 1) && (state[index + size] == CellState::UNKNOWN));
+        }
+
+        int32_t & slot = frontierSlot[index];
+        if (isFront && (slot < 0))
+        {
+            slot = frontier.size();
+            frontier.push_back(index);
+        } else if (!isFront && (slot >= 0))
+        {
+            // swap the last frontier cell into the hole
+            const int32_t moved = frontier.back();
+            frontier[slot] = moved;
+            frontierSlot[moved] = slot;
+            frontier.pop_back();
+            slot = -1;
+        }
+    }
+
+    int FrontierGrid::insertScan(double sx, double sy, double sth, double angleMin, double angleIncrement,
+                                 const std::vector<float> & ranges, double rangeMin, double rangeMax)
+    {
+        ++scanCount;
+        touched.clear();
+
+        const double c = std::cos(sth), s = std::sin(sth);
+        const int ox = toCell(sx), oy = toCell(sy);
+        for (unsigned int i = 0; i < ranges.size(); ++i)
+        {
+            // nan and inf compare false, so they count as a beam that saw nothing
+            const double r = ranges[i];
+            const bool valid = (r >= rangeMin) && (r < rangeMax);
+            if (!valid && (r < rangeMin))
+            {
+                continue;
+            }
+            const double range = valid ? r : rangeMax;
+            const double a = angleMin + i * angleIncrement;
+            const double bx = std::cos(a), by = std::sin(a);
+            traceRay(ox, oy, toCell(sx + range * (c * bx - s * by)), toCell(sy + range * (s * bx + c * by)), valid);
+        }
+
+        // the frontier only changes at the touched cells and their neighbors
+        const int size = params.size;
+        for (const int i : touched)
+        {
+            const int cx = i % size, cy = i / size;
+            updateFrontier(i);
+            if (cx > 0)
+            {
+                updateFrontier(i - 1);
+            }
+            if (cx < size - 1)
+            {
+                updateFrontier(i + 1);
+            }
+            if (cy > 0)
+            {
+                updateFrontier(i - size);
+            }
+            if (cy < size - 1)
+            {
+                updateFrontier(i + size);
+            }
+        }
+        return touched.size();
+    }
+
+    int FrontierGrid::toCell(double v) const
+    {
+        return int(std::floor(v / params.resolution));
+    }
+
+    bool FrontierGrid::contains(int cx, int cy) const
+    {
+        return (cx >= -half) && (cy >= -half) && (cx < params.size - half) && (cy < params.size - half);
+    }
+
+    CellState FrontierGrid::at(int cx, int cy) const
+    {
+        if (!contains(cx, cy))
+        {
+            return CellState::UNKNOWN;
+        }
+        return state[(cy + half) * params.size + cx + half];
+    }
+
+    bool FrontierGrid::isFrontier(int cx, int cy) const
+    {
+        return contains(cx, cy) && (frontierSlot[(cy + half) * params.size + cx + half] >= 0);
+    }
+
+    int FrontierGrid::frontierSize() const
+    {
+        return frontier.size();
+    }
+
+    std::vector<Cluster> FrontierGrid::clusters(double rx, double ry) const
+    {
+        const int size = params.size;
+        const int n = frontier.size();
+
+        /****************
+         * Union-find over the frontier list, each cell joins the frontier cells ahead of it
+         * *************/
+        std::vector<int> parent(n);
+        for (int i = 0; i < n; ++i)
+        {
+            parent[i] = i;
+        }
+        for (int i = 0; i < n; ++i)
+        {
+            const int cx = frontier[i] % size, cy = frontier[i] / size;
+            const int ahead[4][2] = {{1, 0}, {1, 1}, {0, 1}, {-1, 1}};
+            for (const auto & d : ahead)
+            {
+                const int x = cx + d[0], y = cy + d[1];
+                if ((x < 0) || (x >= size) || (y >= size))
+                {
+                    continue;
+                }
+                const int j = frontierSlot[y * size + x];
+                if (j >= 0)
+                {
+                    parent[findRoot(parent, j)] = findRoot(parent, i);
+                }
+            }
+        }
+
+        // the centroid of each cluster, then the cell of the cluster closest to it
+        std::vector<int> count(n, 0);
+        std::vector<double> sumX(n, 0.0), sumY(n, 0.0);
+        for (int i = 0; i < n; ++i)
+        {
+            const int root = findRoot(parent, i);
+            ++count[root];
+            sumX[root] += frontier[i] % size;
+            sumY[root] += frontier[i] / size;
+        }
+        std::vector<int> nearest(n, -1);
+        std::vector<double> nearestD2(n, std::numeric_limits<double>::max());
+        for (int i = 0; i < n; ++i)
+        {
+            const int root = findRoot(parent, i);
+            const double ex = frontier[i] % size - sumX[root] / count[root];
+            const double ey = frontier[i] / size - sumY[root] / count[root];
+            if (ex * ex + ey * ey < nearestD2[root])
+            {
+                nearestD2[root] = ex * ex + ey * ey;
+                nearest[root] = frontier[i];
+            }
+        }
+
+        std::vector<Cluster> result;
+        std::vector<int> goalCells;
+        const int gainCells = int(std::ceil(params.gainRadius / params.resolution));
+        for (int root = 0; root < n; ++root)
+        {
+            if ((parent[root] != root) || (count[root] < params.minClusterSize))
+            {
+                continue;
+            }
+
+            Cluster cluster;
+            cluster.cells = count[root];
+            const int gx = nearest[root] % size, gy = nearest[root] / size;
+            cluster.goalX = (gx - half + 0.5) * params.resolution;
+            cluster.goalY = (gy - half + 0.5) * params.resolution;
+
+            for (int y = std::max(0, gy - gainCells); y <= std::min(size - 1, gy + gainCells); ++y)
+            {
+                for (int x = std::max(0, gx - gainCells); x <= std::min(size - 1, gx + gainCells); ++x)
+                {
+                    if (((x - gx) * (x - gx) + (y - gy) * (y - gy) <= gainCells * gainCells) &&
+                        (state[y * size + x] == CellState::UNKNOWN))
+                    {
+                        ++cluster.gain;
+                    }
+                }
+            }
+            cluster.cost = -1.0;
+            result.push_back(cluster);
+            goalCells.push_back(nearest[root]);
+        }
+        if (result.empty())
+        {
+            return result;
+        }
+
+        /****************
+         * Breadth first through the free cells from the robot, 8 connected, until every goal is reached
+         * *************/
+        std::vector<int32_t> steps(size * size, -1);
+        std::vector<int32_t> goalOf(size * size, -1);
+        for (unsigned int k = 0; k < goalCells.size(); ++k)
+        {
+            goalOf[goalCells[k]] = k;
+        }
+        std::vector<int32_t> queue;
+        int remaining = goalCells.size();
+
+        const int rcx = std::min(std::max(toCell(rx) + half, 0), size - 1);
+        const int rcy = std::min(std::max(toCell(ry) + half, 0), size - 1);
+        steps[rcy * size + rcx] = 0;
+        queue.push_back(rcy * size + rcx);
+        for (unsigned int head = 0; (head < queue.size()) && (remaining > 0); ++head)
+        {
+            const int i = queue[head];
+            if (goalOf[i] >= 0)
+            {
+                result[goalOf[i]].cost = steps[i] * params.resolution;
+                --remaining;
+            }
+
+            const int cx = i % size, cy = i / size;
+            for (int dy = -1; dy <= 1; ++dy)
+            {
+                for (int dx = -1; dx <= 1; ++dx)
+                {
+                    const int x = cx + dx, y = cy + dy;
+                    if ((x < 0) || (y < 0) || (x >= size) || (y >= size))
+                    {
+                        continue;
+                    }
+                    const int j = y * size + x;
+                    if ((steps[j] < 0) && (state[j] == CellState::FREE))
+                    {
+                        steps[j] = steps[i] + 1;
+                        queue.push_back(j);
+                    }
+                }
+            }
+        }
+
+        result.erase(std::remove_if(result.begin(), result.end(), [](const Cluster & c) { return c.cost < 0.0; }),
+                     result.end());
+        for (auto & cluster : result)
+        {
+            cluster.score = cluster.gain / std::max(cluster.cost, params.minCost);
+        }
+        std::sort(result.begin(), result.end(), [](const Cluster & a, const Cluster & b) { return a.score > b.score; });
+        return result;
+    }
+}
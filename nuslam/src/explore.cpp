@@ -0,0 +1,218 @@
+/// \file explore.cpp
+/// \brief contains a node called explore that sends the robot to the frontiers of the mapped area until none are left
+///
+/// PARAMETERS:
+///     map_frame_id (string) : The frame the grid and the goals are in
+///     body_frame_id (string) : The frame of the robot, the scan is taken from its origin
+///     explore_resolution (double) : side of a cell of the coarse grid (m) (default 0.1)
+///     explore_size (int) : cells on a side of the grid, centered on the map origin (default 256)
+///     explore_min_cluster_size (int) : frontier clusters with fewer cells are ignored (default 3)
+///     explore_gain_radius (double) : unknown cells this close to a goal count as its gain (m) (default 1.0)
+///     explore_goal_tolerance (double) : distance at which a goal is reached (m) (default 0.15)
+///     explore_goal_timeout (double) : seconds after which a goal not reached is given up on (default 60.0)
+///     explore_blacklist_radius (double) : frontiers this close to a goal given up on are not chosen again (m) (default 0.3)
+///     shm_transport (bool) : read the scans through shared memory when the publisher is local (default true)
+/// PUBLISHES:  /move_base_simple/goal (geometry_msgs::PoseStamped)
+/// SUBSCRIBES: /scan (sensor_msgs::LaserScan)
+///
+/// The pose of each scan is the map -> body transform at its stamp, so the grid follows the slam estimate.
+/// Each scan only updates the frontier next to the cells it changed. A new goal is only chosen when the
+/// current one is reached, given up on, or no longer on the frontier, so the node idles between scans.
+
+#include <ros/ros.h>
+
+#include <geometry_msgs/PoseStamped.h>
+#include <geometry_msgs/TransformStamped.h>
+
+#include <sensor_msgs/LaserScan.h>
+
+#include <tf2_ros/buffer.h>
+#include <tf2_ros/transform_listener.h>
+#include <tf2/utils.h>
+#include <tf2_geometry_msgs/tf2_geometry_msgs.h>
+
+#include <nuslam/exploration_library.hpp>
+#include <rigid2d/shm_transport.hpp>
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+/**********
+ * Declare global variables
+ * *******/
+static sensor_msgs::LaserScan::ConstPtr scan_msg;
+static bool scan_flag = false;
+
+/**********
+ * Helper Functions
+ * *******/
+void scanCallback(const sensor_msgs::LaserScan::ConstPtr & msg);
+
+/*********
+ * Main Function
+ * ******/
+int main(int argc, char* argv[])
+{
+    using namespace exploration;
+
+    /*********
+     * Initialize the node & node handle
+     * ******/
+    ros::init(argc, argv, "explore");
+    ros::NodeHandle n;
+
+    /*********
+     * Declare local variables
+     * ******/
+    std::string map_frame_id = "map", body_frame_id = "base_footprint";
+    double goalTol = 0.15, goalTimeout = 60.0, blacklistRadius = 0.3;
+
+    int frequency = 5;
+
+    ExploreParams params;
+
+    tf2_ros::Buffer tfBuffer;
+    tf2_ros::TransformListener tfListener(tfBuffer);
+
+    geometry_msgs::PoseStamped goal_msg;
+
+    bool shm_transport = true;
+
+    /*********
+     * Read parameters from parameter server
+     * ******/
+    n.getParam("map_frame_id", map_frame_id);
+    n.getParam("body_frame_id", body_frame_id);
+    n.getParam("explore_resolution", params.resolution);
+    n.getParam("explore_size", params.size);
+    n.getParam("explore_min_cluster_size", params.minClusterSize);
+    n.getParam("explore_gain_radius", params.gainRadius);
+    n.getParam("explore_goal_tolerance", goalTol);
+    n.getParam("explore_goal_timeout", goalTimeout);
+    n.getParam("explore_blacklist_radius", blacklistRadius);
+    n.getParam("shm_transport", shm_transport);
+
+    /*********
+     * Define publishers, subscribers and services
+     ********/
+    ros::Publisher goal_pub = n.advertise<geometry_msgs::PoseStamped>("/move_base_simple/goal", 1, true);
+
+    rigid2d::ShmSubscriber<sensor_msgs::LaserScan> scan_sub(n, "/scan", 1, scanCallback, shm_transport);
+
+    ros::Rate loop_rate(frequency);
+
+    FrontierGrid grid(params);
+
+    bool haveGoal = false, finished = false;
+    double goalX = 0.0, goalY = 0.0;
+    ros::Time goalTime;
+    std::vector<std::pair<double, double>> blacklist;
+
+    while (ros::ok())
+    {
+        ros::spinOnce();
+
+        if (!scan_flag)
+        {
+            loop_rate.sleep();
+            continue;
+        }
+        scan_flag = false;
+
+        ros::Time current_time = ros::Time::now();
+
+        /**********
+         * Insert the scan from the pose of the robot in the map when it was taken
+         * *******/
+        geometry_msgs::TransformStamped mapBody;
+        try
+        {
+            mapBody = tfBuffer.lookupTransform(map_frame_id, body_frame_id, scan_msg->header.stamp,
+                                               ros::Duration(0.05));
+        }
+        catch (tf2::TransformException & ex)
+        {
+            ROS_WARN_THROTTLE(1.0, "explore: %s", ex.what());
+            loop_rate.sleep();
+            continue;
+        }
+
+        const double rx = mapBody.transform.translation.x, ry = mapBody.transform.translation.y;
+        grid.insertScan(rx, ry, tf2::getYaw(mapBody.transform.rotation), scan_msg->angle_min,
+                        scan_msg->angle_increment, scan_msg->ranges, scan_msg->range_min, scan_msg->range_max);
+
+        /**********
+         * Keep the goal while it is still worth going to
+         * *******/
+        if (haveGoal)
+        {
+            if (std::hypot(goalX - rx, goalY - ry) < goalTol)
+            {
+                haveGoal = false;
+            } else if ((current_time - goalTime).toSec() > goalTimeout)
+            {
+                ROS_WARN("explore: giving up on the goal (%.2f, %.2f)", goalX, goalY);
+                blacklist.emplace_back(goalX, goalY);
+                haveGoal = false;
+            } else if (!grid.isFrontier(grid.toCell(goalX), grid.toCell(goalY)))
+            {
+                haveGoal = false;
+            }
+        }
+
+        if (!haveGoal)
+        {
+            std::vector<Cluster> clusters = grid.clusters(rx, ry);
+            for (const auto & c : clusters)
+            {
+                bool banned = false;
+                for (const auto & b : blacklist)
+                {
+                    banned |= std::hypot(c.goalX - b.first, c.goalY - b.second) < blacklistRadius;
+                }
+                if (banned)
+                {
+                    continue;
+                }
+
+                haveGoal = true;
+                finished = false;
+                goalX = c.goalX;
+                goalY = c.goalY;
+                goalTime = current_time;
+
+                // facing the frontier from where the robot is now
+                tf2::Quaternion q;
+                q.setRPY(0.0, 0.0, std::atan2(goalY - ry, goalX - rx));
+                goal_msg.header.stamp = current_time;
+                goal_msg.header.frame_id = map_frame_id;
+                goal_msg.pose.position.x = goalX;
+                goal_msg.pose.position.y = goalY;
+                goal_msg.pose.orientation = tf2::toMsg(q);
+                goal_pub.publish(goal_msg);
+
+                ROS_INFO("explore: goal (%.2f, %.2f), %d frontier cells, gain %d over %.2f m", goalX, goalY,
+                         c.cells, c.gain, c.cost);
+                break;
+            }
+
+            if (!haveGoal && !finished)
+            {
+                ROS_INFO("explore: no frontier left to reach, %d frontier cells", grid.frontierSize());
+                finished = true;
+            }
+        }
+
+        loop_rate.sleep();
+    }
+    return 0;
+}
+
+/// \brief callback function for subscriber to the lidar scan
+/// \param msg : the scan
+void scanCallback(const sensor_msgs::LaserScan::ConstPtr & msg)
+{
+    scan_msg = msg;
+    scan_flag = true;
+}
@@ -0,0 +1,199 @@
+/// \file grid_mapper.cpp
+/// \brief contains a node called grid_mapper that builds an occupancy grid from the lidar scans and the slam pose
+///
+/// PARAMETERS:
+///     map_frame_id (string) : The frame the grid is built in
+///     body_frame_id (string) : The frame of the robot, the scan is taken from its origin
+///     grid_resolution (double) : side of a grid cell (m) (default 0.05)
+///     grid_hit (double) : log-odds added to the cell a beam ends in (default 0.85)
+///     grid_miss (double) : log-odds added to the cells a beam passes through (default -0.4)
+///     grid_min_log_odds (double) : lower clamp of the log-odds of a cell (default -2.0)
+///     grid_max_log_odds (double) : upper clamp of the log-odds of a cell (default 3.5)
+///     grid_clear_no_return (bool) : if true, a beam at or past the maximum range clears the cells up to it,
+///                                   otherwise it is ignored like a nan (default false)
+///     grid_full_period (double) : seconds between full grids, the changes in between are sent as updates (default 5.0)
+///     shm_transport (bool) : read the scans through shared memory when the publisher is local (default true)
+/// PUBLISHES:  /map (nav_msgs::OccupancyGrid)
+///             /map_updates (map_msgs::OccupancyGridUpdate)
+/// SUBSCRIBES: /scan (sensor_msgs::LaserScan)
+///
+/// The pose of each scan is the map -> odom -> body transform at its stamp, so the grid follows the slam estimate.
+/// A full grid is only published when the grid grows past the last one or every grid_full_period seconds,
+/// otherwise only the rectangle of cells changed since the last message is sent.
+
+#include <ros/ros.h>
+
+#include <nav_msgs/OccupancyGrid.h>
+#include <map_msgs/OccupancyGridUpdate.h>
+
+#include <sensor_msgs/LaserScan.h>
+
+#include <geometry_msgs/TransformStamped.h>
+
+#include <tf2_ros/buffer.h>
+#include <tf2_ros/transform_listener.h>
+#include <tf2/utils.h>
+#include <tf2_geometry_msgs/tf2_geometry_msgs.h>
+
+#include <nuslam/occupancy_grid_library.hpp>
+#include <rigid2d/shm_transport.hpp>
+
+#include <string>
+#include <vector>
+
+/**********
+ * Declare global variables
+ * *******/
+static sensor_msgs::LaserScan::ConstPtr scan_msg;
+static bool scan_flag = false;
+
+/**********
+ * Helper Functions
+ * *******/
+void scanCallback(const sensor_msgs::LaserScan::ConstPtr & msg);
+
+/*********
+ * Main Function
+ * ******/
+int main(int argc, char* argv[])
+{
+    using namespace occupancy_grid;
+
+    /*********
+     * Initialize the node & node handle
+     * ******/
+    ros::init(argc, argv, "grid_mapper");
+    ros::NodeHandle n;
+
+    /*********
+     * Declare local variables
+     * ******/
+    std::string map_frame_id = "map", body_frame_id = "base_footprint";
+    double fullPeriod = 5.0;
+
+    int frequency = 10;
+
+    GridParams params;
+
+    tf2_ros::Buffer tfBuffer;
+    tf2_ros::TransformListener tfListener(tfBuffer);
+
+    nav_msgs::OccupancyGrid grid_msg;
+    map_msgs::OccupancyGridUpdate update_msg;
+
+    bool shm_transport = true;
+
+    /*********
+     * Read parameters from parameter server
+     * ******/
+    n.getParam("map_frame_id", map_frame_id);
+    n.getParam("body_frame_id", body_frame_id);
+    n.getParam("grid_resolution", params.resolution);
+    n.getParam("grid_hit", params.hit);
+    n.getParam("grid_miss", params.miss);
+    n.getParam("grid_min_log_odds", params.minLogOdds);
+    n.getParam("grid_max_log_odds", params.maxLogOdds);
+    n.getParam("grid_clear_no_return", params.clearNoReturn);
+    n.getParam("grid_full_period", fullPeriod);
+    n.getParam("shm_transport", shm_transport);
+
+    /*********
+     * Define publishers, subscribers and services
+     ********/
+    ros::Publisher grid_pub = n.advertise<nav_msgs::OccupancyGrid>("/map", 1, true);
+    ros::Publisher update_pub = n.advertise<map_msgs::OccupancyGridUpdate>("/map_updates", frequency);
+
+    rigid2d::ShmSubscriber<sensor_msgs::LaserScan> scan_sub(n, "/scan", frequency, scanCallback, shm_transport);
+
+    ros::Rate loop_rate(frequency);
+
+    TiledGrid grid(params);
+
+    // the cells covered by the last full grid, updates are relative to its origin
+    Region published;
+    ros::Time lastFull;
+
+    while (ros::ok())
+    {
+        ros::spinOnce();
+
+        ros::Time current_time = ros::Time::now();
+
+        /**********
+         * If a scan is received, insert it from the pose of the robot in the map when it was taken
+         * *******/
+        if (scan_flag)
+        {
+            scan_flag = false;
+
+            geometry_msgs::TransformStamped mapBody;
+            try
+            {
+                mapBody = tfBuffer.lookupTransform(map_frame_id, body_frame_id, scan_msg->header.stamp,
+                                                   ros::Duration(0.05));
+            }
+            catch (tf2::TransformException & ex)
+            {
+                ROS_WARN_THROTTLE(1.0, "grid_mapper: %s", ex.what());
+                loop_rate.sleep();
+                continue;
+            }
+
+            grid.insertScan(mapBody.transform.translation.x, mapBody.transform.translation.y,
+                            tf2::getYaw(mapBody.transform.rotation), scan_msg->angle_min,
+                            scan_msg->angle_increment, scan_msg->ranges, scan_msg->range_min, scan_msg->range_max);
+
+            Region dirty = grid.takeDirty();
+
+            /**********
+             * Publish the whole grid when it outgrew the last one or it is time for a refresh
+             * *******/
+            if (published.empty() || !published.contains(dirty) ||
+                (current_time - lastFull).toSec() >= fullPeriod)
+            {
+                published = grid.bounds();
+
+                grid_msg.header.stamp = current_time;
+                grid_msg.header.frame_id = map_frame_id;
+                grid_msg.info.map_load_time = current_time;
+                grid_msg.info.resolution = grid.resolution();
+                grid_msg.info.width = published.width;
+                grid_msg.info.height = published.height;
+                grid_msg.info.origin.position.x = published.x * grid.resolution();
+                grid_msg.info.origin.position.y = published.y * grid.resolution();
+                grid_msg.info.origin.orientation.w = 1.0;
+                grid.fill(published, grid_msg.data);
+
+                grid_pub.publish(grid_msg);
+                lastFull = current_time;
+            }
+
+            /**********
+             * Otherwise only the changed cells
+             * *******/
+            else if (!dirty.empty())
+            {
+                update_msg.header.stamp = current_time;
+                update_msg.header.frame_id = map_frame_id;
+                update_msg.x = dirty.x - published.x;
+                update_msg.y = dirty.y - published.y;
+                update_msg.width = dirty.width;
+                update_msg.height = dirty.height;
+                grid.fill(dirty, update_msg.data);
+
+                update_pub.publish(update_msg);
+            }
+        }
+
+        loop_rate.sleep();
+    }
+    return 0;
+}
+
+/// \brief callback function for subscriber to the lidar scan
+/// \param msg : the scan
+void scanCallback(const sensor_msgs::LaserScan::ConstPtr & msg)
+{
+    scan_msg = msg;
+    scan_flag = true;
+}
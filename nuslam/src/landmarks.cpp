@@ -4,6 +4,7 @@
 /// PARAMETERS:     minRange (the minimum range that the Lidar sensor can sense)
 ///                 maxRange (the maximum range that the Lidar sensor can sesne)
 ///                 tubeRad (the radius of the tubes)
+///                 shm_transport (read the scans through shared memory when the publisher is local, default true)
 /// PUBLISHES:      visualization_msgs::MarkerArray (array of markers that are the detected landmarks)
 /// SUBSCRIBES:     sensor_msgs::LaserScan (scan message from the Lidar Sensor)
 /// SERVICES:       none
@@ -11,6 +12,7 @@
 #include <ros/ros.h>
 
 #include <nuslam/circle_fit_library.hpp>
+#include <rigid2d/shm_transport.hpp>
 
 #include <sensor_msgs/LaserScan.h>
 
@@ -51,6 +53,7 @@ int main(int argc, char* argv[])
      * *****/
     int frequency = 100;
     double minRange, maxRange, tubeRad;
+    bool shm_transport = true;
 
     ros::Rate loop_rate(frequency);
 
@@ -60,11 +63,12 @@ int main(int argc, char* argv[])
     n.getParam("minimum_range", minRange);
     n.getParam("maximum_range", maxRange);
     n.getParam("tube_radius", tubeRad);
+    n.getParam("shm_transport", shm_transport);
 
     /********
      * Define publisher, subscriber
      * *****/
-    ros::Subscriber lidar_sub = n.subscribe("/scan", frequency, scanCallback);
+    rigid2d::ShmSubscriber<sensor_msgs::LaserScan> lidar_sub(n, "/scan", frequency, scanCallback, shm_transport);
     ros::Publisher landmark_pub = n.advertise<visualization_msgs::MarkerArray>("/real_sensor", frequency);
 
     ros::Time current_time = ros::Time::now();
@@ -0,0 +1,179 @@
+/// \file loop_closure_library.cpp
+/// \brief a library that detects landmarks that were mapped twice after a loop
+
+#include "nuslam/loop_closure_library.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace loop_closure
+{
+    LoopClosureDetector::LoopClosureDetector()
+        : LoopClosureDetector(6, 2.0, 0.15, 3, 1.0, 0.5, 200)
+    {
+    }
+
+    LoopClosureDetector::LoopClosureDetector(int recentCount, double maxTriangleSide, double matchDist, int minMatchCount,
+                                             double maxDriftDist, double maxDriftRot, int maxSampleCount)
+        : recent(std::max(recentCount, 3)), maxSide(maxTriangleSide), matchDistance(matchDist),
+          minMatches(std::max(minMatchCount, 3)), maxDrift(maxDriftDist), maxDriftAngle(maxDriftRot),
+          maxSamples(maxSampleCount), index(std::vector<double>(), maxTriangleSide, matchDist, maxSampleCount),
+          rebuildCount(0)
+    {
+    }
+
+    int LoopClosureDetector::indexSize() const
+    {
+        return index.size();
+    }
+
+    int LoopClosureDetector::rebuilds() const
+    {
+        return rebuildCount;
+    }
+
+    bool LoopClosureDetector::detect(const std::vector<double> & landmarks, Closure & closure)
+    {
+        const int n = landmarks.size() / 2;
+        const int newer = std::min(recent, n - 3);
+        if (newer < 3)
+        {
+            return false;
+        }
+
+        // the older landmarks are the map, the newest ones the constellation looked up in it
+        const int older = n - newer;
+        std::vector<double> constellation(landmarks.begin() + 2 * older, landmarks.begin() + 2 * n);
+
+        // a merge removes landmarks and moves the later ones down, and the filter can still move a
+        // landmark after it was hashed, both leave triangles in the table that are no longer there
+        bool rebuild = older < index.size();
+        for (int i = 0; !rebuild && (i < index.size()); ++i)
+        {
+            rebuild = std::hypot(landmarks[2*i] - indexed[2*i], landmarks[2*i + 1] - indexed[2*i + 1]) > 0.5 * matchDistance;
+        }
+        if (rebuild)
+        {
+            index = relocalization::Relocalizer(std::vector<double>(), maxSide, matchDistance, maxSamples);
+            indexed.clear();
+            ++rebuildCount;
+        }
+
+        // only the landmarks that became old since the last call are hashed
+        for (int i = index.size(); i < older; ++i)
+        {
+            index.addLandmark(landmarks[2*i], landmarks[2*i + 1]);
+            indexed.push_back(landmarks[2*i]);
+            indexed.push_back(landmarks[2*i + 1]);
+        }
+
+        relocalization::PoseHypothesis match = index.relocalize(constellation);
+
+        if (!match.found || match.ambiguous || (match.inliers < minMatches))
+        {
+            return false;
+        }
+
+        // three landmarks can line up with some far away triangle by chance, a real drift stays small
+        if ((std::hypot(match.x, match.y) > maxDrift) || (std::fabs(match.th) > maxDriftAngle))
+        {
+            return false;
+        }
+
+        closure.pairs.clear();
+        for (const auto & m: match.matches)
+        {
+            closure.pairs.emplace_back(m.second, older + m.first);
+        }
+        closure.x = match.x;
+        closure.y = match.y;
+        closure.th = match.th;
+        closure.rms = match.rms;
+        return true;
+    }
+
+    BackgroundDetector::BackgroundDetector(const LoopClosureDetector & loopDetector)
+        : detector(loopDetector), jobGeneration(0), hasJob(false), busy(false), stop(false), hasResult(false)
+    {
+        worker = std::thread(&BackgroundDetector::run, this);
+    }
+
+    BackgroundDetector::~BackgroundDetector()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stop = true;
+        }
+        wake.notify_one();
+        worker.join();
+    }
+
+    bool BackgroundDetector::submit(const std::vector<double> & landmarks, int generation)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (hasJob || busy)
+            {
+                return false;
+            }
+            job = landmarks;
+            jobGeneration = generation;
+            hasJob = true;
+        }
+        wake.notify_one();
+        return true;
+    }
+
+    bool BackgroundDetector::poll(Closure & closure)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!hasResult)
+        {
+            return false;
+        }
+        closure = result;
+        hasResult = false;
+        return true;
+    }
+
+    bool BackgroundDetector::isBusy()
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        return hasJob || busy;
+    }
+
+    void BackgroundDetector::run()
+    {
+        std::vector<double> landmarks;
+        while (true)
+        {
+            int generation;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                wake.wait(lock, [this] { return stop || hasJob; });
+                if (stop)
+                {
+                    return;
+                }
+                landmarks.swap(job);
+                generation = jobGeneration;
+                hasJob = false;
+                busy = true;
+            }
+
+            // the detection itself runs without the lock, so submit and poll never wait for it
+            Closure found;
+            bool detected = detector.detect(landmarks, found);
+            found.generation = generation;
+
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                if (detected)
+                {
+                    result = found;
+                    hasResult = true;
+                }
+                busy = false;
+            }
+        }
+    }
+}
@@ -0,0 +1,275 @@
+/// \file map_file_library.cpp
+/// \brief a library that saves a SLAM map to a binary file and memory maps it back
+
+#include "nuslam/map_file_library.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace map_file
+{
+    static const char MAGIC[8] = {'N', 'U', 'S', 'L', 'A', 'M', 'A', 'P'};
+    static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+    /// \brief rounds a byte offset up to the section alignment
+    static uint64_t align(uint64_t offset)
+    {
+        return (offset + MAP_ALIGNMENT - 1) / MAP_ALIGNMENT * MAP_ALIGNMENT;
+    }
+
+    /// \brief the byte offset of the odometry section of a map with the given header
+    static uint64_t odometryOffset(const MapHeader & header)
+    {
+        return align(header.landmarkOffset + header.numLandmarks * sizeof(LandmarkInfo));
+    }
+
+    /// \brief writes all of a buffer at an offset
+    static bool writeAt(int fd, const void * bytes, size_t length, uint64_t offset)
+    {
+        const char * p = static_cast<const char *>(bytes);
+        while (length > 0)
+        {
+            const ssize_t n = pwrite(fd, p, length, offset);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                return false;
+            }
+            p += n;
+            length -= n;
+            offset += n;
+        }
+        return true;
+    }
+
+    bool saveMap(const std::string & path, const double * state, uint64_t stateLength, const double * cov,
+                 const std::vector<LandmarkInfo> & landmarks, std::string & error, const OdometryInfo * odometry)
+    {
+        if ((stateLength < 3) || ((stateLength - 3) % 2 != 0) || ((stateLength - 3) / 2 != landmarks.size()))
+        {
+            error = "the state does not hold one (x, y) per landmark";
+            return false;
+        }
+
+        MapHeader header;
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = MAP_VERSION;
+        header.byteOrder = BYTE_ORDER_MARK;
+        header.stateLength = stateLength;
+        header.numLandmarks = landmarks.size();
+        header.stateOffset = align(sizeof(MapHeader));
+        header.covOffset = align(header.stateOffset + stateLength * sizeof(double));
+        header.landmarkOffset = align(header.covOffset + stateLength * stateLength * sizeof(double));
+        header.fileSize = header.landmarkOffset + landmarks.size() * sizeof(LandmarkInfo);
+        if (odometry)
+        {
+            header.fileSize = odometryOffset(header) + sizeof(OdometryInfo);
+        }
+
+        // write next to the old map and swap it in, so a crash never leaves half a map behind
+        // the gaps between the sections read back as zeros
+        const std::string tmpPath = path + ".tmp";
+        const int fd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+        {
+            error = "cannot open " + tmpPath + ": " + std::strerror(errno);
+            return false;
+        }
+        const bool ok = writeAt(fd, &header, sizeof(header), 0)
+                        && writeAt(fd, state, stateLength * sizeof(double), header.stateOffset)
+                        && writeAt(fd, cov, stateLength * stateLength * sizeof(double), header.covOffset)
+                        && writeAt(fd, landmarks.data(), landmarks.size() * sizeof(LandmarkInfo), header.landmarkOffset)
+                        && (!odometry || writeAt(fd, odometry, sizeof(OdometryInfo), odometryOffset(header)))
+                        && (ftruncate(fd, header.fileSize) == 0)
+                        && (fdatasync(fd) == 0);
+        if (!ok)
+        {
+            error = "cannot write " + tmpPath + ": " + std::strerror(errno);
+        }
+        if ((::close(fd) != 0) && ok)
+        {
+            error = "cannot write " + tmpPath + ": " + std::strerror(errno);
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+        if (!ok)
+        {
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+
+        if (std::rename(tmpPath.c_str(), path.c_str()) != 0)
+        {
+            error = "cannot replace " + path + ": " + std::strerror(errno);
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    MappedMap::MappedMap()
+        : data(nullptr), length(0), header(nullptr)
+    {
+    }
+
+    MappedMap::MappedMap(MappedMap && other)
+        : data(other.data), length(other.length), header(other.header)
+    {
+        other.data = nullptr;
+        other.length = 0;
+        other.header = nullptr;
+    }
+
+    MappedMap & MappedMap::operator=(MappedMap && other)
+    {
+        if (this != &other)
+        {
+            close();
+            data = other.data;
+            length = other.length;
+            header = other.header;
+
+            other.data = nullptr;
+            other.length = 0;
+            other.header = nullptr;
+        }
+        return *this;
+    }
+
+    MappedMap::~MappedMap()
+    {
+        close();
+    }
+
+    bool MappedMap::open(const std::string & path, std::string & error)
+    {
+        close();
+
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            error = "cannot open " + path + ": " + std::strerror(errno);
+            return false;
+        }
+
+        struct stat info;
+        if ((fstat(fd, &info) != 0) || (uint64_t(info.st_size) < sizeof(MapHeader)))
+        {
+            error = path + " is too short to be a map";
+            ::close(fd);
+            return false;
+        }
+
+        void * mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED)
+        {
+            error = "cannot map " + path + ": " + std::strerror(errno);
+            return false;
+        }
+
+        data = mapped;
+        length = info.st_size;
+        const MapHeader * h = static_cast<const MapHeader *>(data);
+
+        // check everything the accessors rely on, so a corrupt file is refused here and not read out of bounds later
+        const uint64_t n = h->stateLength;
+        if (std::memcmp(h->magic, MAGIC, sizeof(MAGIC)) != 0)
+        {
+            error = path + " is not a map file";
+        } else if (h->byteOrder != BYTE_ORDER_MARK)
+        {
+            error = path + " was written on a machine with a different byte order";
+        } else if (h->version != MAP_VERSION)
+        {
+            error = path + " has version " + std::to_string(h->version) + ", expected " + std::to_string(MAP_VERSION);
+        } else if (h->fileSize != length)
+        {
+            error = path + " is truncated";
+        } else if ((n < 3) || (n > (1u << 20)) || (h->numLandmarks != (n - 3) / 2) || ((n - 3) % 2 != 0))
+        {
+            error = path + " has an inconsistent state length";
+        } else if ((h->stateOffset % MAP_ALIGNMENT != 0) || (h->covOffset % MAP_ALIGNMENT != 0) ||
+                   (h->landmarkOffset % MAP_ALIGNMENT != 0) ||
+                   (h->stateOffset < sizeof(MapHeader)) ||
+                   (h->stateOffset + n * sizeof(double) > h->covOffset) ||
+                   (h->covOffset + n * n * sizeof(double) > h->landmarkOffset) ||
+                   (h->landmarkOffset + h->numLandmarks * sizeof(LandmarkInfo) > length) ||
+                   ((length > h->landmarkOffset + h->numLandmarks * sizeof(LandmarkInfo)) &&
+                    (length != odometryOffset(*h) + sizeof(OdometryInfo))))
+        {
+            error = path + " has sections out of place";
+        } else
+        {
+            header = h;
+            return true;
+        }
+
+        close();
+        return false;
+    }
+
+    void MappedMap::close()
+    {
+        if (data)
+        {
+            munmap(data, length);
+        }
+        data = nullptr;
+        length = 0;
+        header = nullptr;
+    }
+
+    bool MappedMap::isOpen() const
+    {
+        return header != nullptr;
+    }
+
+    uint32_t MappedMap::version() const
+    {
+        return header ? header->version : 0;
+    }
+
+    uint64_t MappedMap::stateLength() const
+    {
+        return header ? header->stateLength : 0;
+    }
+
+    uint64_t MappedMap::numLandmarks() const
+    {
+        return header ? header->numLandmarks : 0;
+    }
+
+    const double * MappedMap::state() const
+    {
+        return header ? reinterpret_cast<const double *>(static_cast<const char *>(data) + header->stateOffset) : nullptr;
+    }
+
+    const double * MappedMap::cov() const
+    {
+        return header ? reinterpret_cast<const double *>(static_cast<const char *>(data) + header->covOffset) : nullptr;
+    }
+
+    const LandmarkInfo * MappedMap::landmarks() const
+    {
+        return header ? reinterpret_cast<const LandmarkInfo *>(static_cast<const char *>(data) + header->landmarkOffset) : nullptr;
+    }
+
+    const OdometryInfo * MappedMap::odometry() const
+    {
+        if (!header || (header->fileSize < odometryOffset(*header) + sizeof(OdometryInfo)))
+        {
+            return nullptr;
+        }
+        return reinterpret_cast<const OdometryInfo *>(static_cast<const char *>(data) + odometryOffset(*header));
+    }
+}
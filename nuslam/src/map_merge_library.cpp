@@ -0,0 +1,682 @@
+/// \file map_merge_library.cpp
+/// \brief a library that merges the landmark maps of two robots through constellation matching
+
+#include "nuslam/map_merge_library.hpp"
+#include "rigid2d/rigid2d.hpp"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace map_merge
+{
+    /// \brief a triangle of landmarks, its vertices ordered so their opposite sides are increasing
+    struct Triangle
+    {
+        std::array<int, 3> v;
+        std::array<double, 3> s;
+        bool ccw;
+    };
+
+    /// \brief the landmarks of a map bucketed in square cells
+    struct Grid
+    {
+        double cell;
+        std::unordered_map<uint64_t, std::vector<int>> cells;
+
+        static uint64_t key(int64_t cx, int64_t cy)
+        {
+            return (uint64_t(cx) << 32) ^ (uint64_t(cy) & 0xFFFFFFFF);
+        }
+
+        Grid(const std::vector<double> & mean, double cellSize)
+            : cell(cellSize)
+        {
+            for (int i = 0; i + 1 < int(mean.size()); i += 2)
+            {
+                cells[key(std::floor(mean[i] / cell), std::floor(mean[i + 1] / cell))].push_back(i / 2);
+            }
+        }
+
+        /// \brief the landmarks in the cells within one cell of a point, a superset of those within cell of it
+        template <typename F>
+        void near(double x, double y, F f) const
+        {
+            const int64_t cx = std::floor(x / cell), cy = std::floor(y / cell);
+            for (int64_t i = cx - 1; i <= cx + 1; ++i)
+            {
+                for (int64_t j = cy - 1; j <= cy + 1; ++j)
+                {
+                    auto found = cells.find(key(i, j));
+                    if (found != cells.end())
+                    {
+                        for (int k: found->second)
+                        {
+                            f(k);
+                        }
+                    }
+                }
+            }
+        }
+    };
+
+    /// \brief the hash key of a triangle, as in the relocalization library
+    static uint64_t key(int64_t q0, int64_t q1, int64_t q2, bool ccw)
+    {
+        return ((uint64_t(q0) & 0xFFFFF) << 41) | ((uint64_t(q1) & 0xFFFFF) << 21) | ((uint64_t(q2) & 0xFFFFF) << 1) | uint64_t(ccw);
+    }
+
+    /// \brief true if the vertices of a triangle are counter clockwise
+    static bool counterClockwise(const std::vector<double> & m, const std::array<int, 3> & v)
+    {
+        return (m[2*v[1]] - m[2*v[0]]) * (m[2*v[2]+1] - m[2*v[0]+1]) -
+               (m[2*v[1]+1] - m[2*v[0]+1]) * (m[2*v[2]] - m[2*v[0]]) > 0.0;
+    }
+
+    /// \brief the triangles each landmark makes with its nearest neighbors, each triangle once
+    static std::vector<Triangle> triangles(const std::vector<double> & m, const Grid & grid, double maxSide,
+                                           int neighbors)
+    {
+        std::vector<Triangle> result;
+        std::unordered_set<uint64_t> seen;
+        std::vector<std::pair<double, int>> close;
+        const int n = m.size() / 2;
+
+        for (int i = 0; i < n; ++i)
+        {
+            close.clear();
+            grid.near(m[2*i], m[2*i+1], [&](int j)
+            {
+                const double d = std::hypot(m[2*j] - m[2*i], m[2*j+1] - m[2*i+1]);
+                if ((j != i) && (d <= maxSide))
+                {
+                    close.emplace_back(d, j);
+                }
+            });
+            const int k = std::min<int>(neighbors, close.size());
+            std::partial_sort(close.begin(), close.begin() + k, close.end());
+
+            for (int p = 0; p < k; ++p)
+            {
+                for (int q = p + 1; q < k; ++q)
+                {
+                    std::array<int, 3> v = {i, close[p].second, close[q].second};
+                    std::array<int, 3> ids = v;
+                    std::sort(ids.begin(), ids.end());
+                    if (!seen.insert((uint64_t(ids[0]) << 42) | (uint64_t(ids[1]) << 21) | uint64_t(ids[2])).second)
+                    {
+                        continue;
+                    }
+
+                    std::array<double, 3> s = {std::hypot(m[2*v[1]] - m[2*v[2]], m[2*v[1]+1] - m[2*v[2]+1]),
+                                               std::hypot(m[2*v[0]] - m[2*v[2]], m[2*v[0]+1] - m[2*v[2]+1]),
+                                               std::hypot(m[2*v[0]] - m[2*v[1]], m[2*v[0]+1] - m[2*v[1]+1])};
+                    if (*std::max_element(s.begin(), s.end()) > maxSide)
+                    {
+                        continue;
+                    }
+
+                    std::array<int, 3> o = {0, 1, 2};
+                    std::sort(o.begin(), o.end(), [&s](int a, int b) { return s[a] < s[b]; });
+                    Triangle t;
+                    t.v = {v[o[0]], v[o[1]], v[o[2]]};
+                    t.s = {s[o[0]], s[o[1]], s[o[2]]};
+                    t.ccw = counterClockwise(m, t.v);
+                    result.push_back(t);
+                }
+            }
+        }
+        return result;
+    }
+
+    /// \brief finds the transform that moves points of b onto points of a in the least squares sense
+    static void fit(const std::vector<double> & a, const std::vector<double> & b,
+                    const std::vector<std::pair<int, int>> & pairs, Alignment & alignment)
+    {
+        const int n = pairs.size();
+        double acx = 0.0, acy = 0.0, bcx = 0.0, bcy = 0.0;
+        for (const auto & p: pairs)
+        {
+            acx += a[2*p.first];
+            acy += a[2*p.first+1];
+            bcx += b[2*p.second];
+            bcy += b[2*p.second+1];
+        }
+        acx /= n;
+        acy /= n;
+        bcx /= n;
+        bcy /= n;
+
+        double sDot = 0.0, sCross = 0.0;
+        for (const auto & p: pairs)
+        {
+            const double bx = b[2*p.second] - bcx, by = b[2*p.second+1] - bcy;
+            const double ax = a[2*p.first] - acx, ay = a[2*p.first+1] - acy;
+            sDot += bx * ax + by * ay;
+            sCross += bx * ay - by * ax;
+        }
+
+        alignment.th = std::atan2(sCross, sDot);
+        alignment.x = acx - (std::cos(alignment.th) * bcx - std::sin(alignment.th) * bcy);
+        alignment.y = acy - (std::sin(alignment.th) * bcx + std::cos(alignment.th) * bcy);
+    }
+
+    /// \brief matches every landmark of b to the closest free landmark of a after the transform, then refits
+    static void verify(const std::vector<double> & a, const Grid & gridA, const std::vector<double> & b,
+                       double matchDist, Alignment & alignment)
+    {
+        std::vector<int> owner(a.size() / 2, -1);
+        std::vector<double> ownerDist(a.size() / 2, matchDist);
+
+        for (int round = 0; round < 2; ++round)
+        {
+            std::fill(owner.begin(), owner.end(), -1);
+            std::fill(ownerDist.begin(), ownerDist.end(), matchDist);
+            const double c = std::cos(alignment.th), s = std::sin(alignment.th);
+
+            // each landmark of a keeps the closest landmark of b that lands on it
+            for (int j = 0; j < int(b.size() / 2); ++j)
+            {
+                const double wx = alignment.x + c * b[2*j] - s * b[2*j+1];
+                const double wy = alignment.y + s * b[2*j] + c * b[2*j+1];
+                int best = -1;
+                double bestDist = matchDist;
+                gridA.near(wx, wy, [&](int i)
+                {
+                    const double d = std::hypot(a[2*i] - wx, a[2*i+1] - wy);
+                    if (d < bestDist)
+                    {
+                        best = i;
+                        bestDist = d;
+                    }
+                });
+                if ((best >= 0) && (bestDist < ownerDist[best]))
+                {
+                    owner[best] = j;
+                    ownerDist[best] = bestDist;
+                }
+            }
+
+            alignment.matches.clear();
+            for (int i = 0; i < int(owner.size()); ++i)
+            {
+                if (owner[i] >= 0)
+                {
+                    alignment.matches.emplace_back(i, owner[i]);
+                }
+            }
+            alignment.inliers = alignment.matches.size();
+            if (alignment.inliers < 3)
+            {
+                return;
+            }
+            fit(a, b, alignment.matches, alignment);
+        }
+
+        const double c = std::cos(alignment.th), s = std::sin(alignment.th);
+        double sum = 0.0;
+        for (const auto & p: alignment.matches)
+        {
+            const double bx = b[2*p.second], by = b[2*p.second+1];
+            sum += std::pow(alignment.x + c * bx - s * by - a[2*p.first], 2) +
+                   std::pow(alignment.y + s * bx + c * by - a[2*p.first+1], 2);
+        }
+        alignment.rms = std::sqrt(sum / alignment.inliers);
+    }
+
+    /// \brief inverts a symmetric 2x2 matrix, column major
+    static std::array<double, 4> inverse2(const std::array<double, 4> & m)
+    {
+        const double det = m[0] * m[3] - m[1] * m[2];
+        return {m[3] / det, -m[1] / det, -m[2] / det, m[0] / det};
+    }
+
+    /// \brief inverts a symmetric 3x3 matrix, column major
+    static std::array<double, 9> inverse3(const std::array<double, 9> & m)
+    {
+        std::array<double, 9> r;
+        r[0] = m[4] * m[8] - m[5] * m[7];
+        r[1] = m[2] * m[7] - m[1] * m[8];
+        r[2] = m[1] * m[5] - m[2] * m[4];
+        r[3] = m[5] * m[6] - m[3] * m[8];
+        r[4] = m[0] * m[8] - m[2] * m[6];
+        r[5] = m[2] * m[3] - m[0] * m[5];
+        r[6] = m[3] * m[7] - m[4] * m[6];
+        r[7] = m[1] * m[6] - m[0] * m[7];
+        r[8] = m[0] * m[4] - m[1] * m[3];
+        const double det = m[0] * r[0] + m[3] * r[1] + m[6] * r[2];
+        for (double & v: r)
+        {
+            v /= det;
+        }
+        return r;
+    }
+
+    /// \brief the 2x2 covariance of landmark i, with a floor that keeps it invertible
+    static std::array<double, 4> block(const LandmarkMap & m, int i)
+    {
+        return {m.cov[4*i] + 1e-12, m.cov[4*i+1], m.cov[4*i+2], m.cov[4*i+3] + 1e-12};
+    }
+
+    /// \brief R S R^T for a rotation by th
+    static std::array<double, 4> rotate(const std::array<double, 4> & S, double th)
+    {
+        const double c = std::cos(th), s = std::sin(th);
+        // R S, column major
+        const double a0 = c * S[0] - s * S[1], a1 = s * S[0] + c * S[1];
+        const double a2 = c * S[2] - s * S[3], a3 = s * S[2] + c * S[3];
+        // (R S) R^T
+        return {a0 * c - a2 * s, a1 * c - a3 * s, a0 * s + a2 * c, a1 * s + a3 * c};
+    }
+
+    /// \brief refines the transform with every match, weighting each by the covariance of both landmarks
+    static void refine(const LandmarkMap & a, const LandmarkMap & b, Alignment & alignment)
+    {
+        std::array<double, 9> H = {};
+        for (int iteration = 0; iteration < 5; ++iteration)
+        {
+            const double c = std::cos(alignment.th), s = std::sin(alignment.th);
+            H.fill(0.0);
+            std::array<double, 3> g = {0.0, 0.0, 0.0};
+
+            for (const auto & p: alignment.matches)
+            {
+                const double bx = b.mean[2*p.second], by = b.mean[2*p.second+1];
+                const std::array<double, 4> Sb = rotate(block(b, p.second), alignment.th);
+                const std::array<double, 4> Sa = block(a, p.first);
+                const std::array<double, 4> W = inverse2({Sa[0] + Sb[0], Sa[1] + Sb[1], Sa[2] + Sb[2], Sa[3] + Sb[3]});
+
+                const double rx = a.mean[2*p.first] - (alignment.x + c * bx - s * by);
+                const double ry = a.mean[2*p.first+1] - (alignment.y + s * bx + c * by);
+
+                // J = [1 0 jx; 0 1 jy], the derivative of the moved landmark with respect to (x, y, th)
+                const double jx = -s * bx - c * by, jy = c * bx - s * by;
+                const std::array<double, 6> J = {1.0, 0.0, 0.0, 1.0, jx, jy};
+
+                // W J, column major 2x3
+                std::array<double, 6> WJ;
+                for (int col = 0; col < 3; ++col)
+                {
+                    WJ[2*col] = W[0] * J[2*col] + W[2] * J[2*col+1];
+                    WJ[2*col+1] = W[1] * J[2*col] + W[3] * J[2*col+1];
+                }
+                for (int row = 0; row < 3; ++row)
+                {
+                    for (int col = 0; col < 3; ++col)
+                    {
+                        H[3*col + row] += J[2*row] * WJ[2*col] + J[2*row+1] * WJ[2*col+1];
+                    }
+                    g[row] += WJ[2*row] * rx + WJ[2*row+1] * ry;
+                }
+            }
+
+            const std::array<double, 9> Hinv = inverse3(H);
+            double step[3];
+            for (int row = 0; row < 3; ++row)
+            {
+                step[row] = Hinv[row] * g[0] + Hinv[3 + row] * g[1] + Hinv[6 + row] * g[2];
+            }
+            alignment.x += step[0];
+            alignment.y += step[1];
+            alignment.th = rigid2d::normalize_angle(alignment.th + step[2]);
+            alignment.cov = Hinv;
+
+            if ((std::fabs(step[0]) < 1e-9) && (std::fabs(step[1]) < 1e-9) && (std::fabs(step[2]) < 1e-9))
+            {
+                break;
+            }
+        }
+    }
+
+    /// \brief adds J P J^T to a 3x3 matrix, all column major
+    static void addSandwich(const std::array<double, 9> & J, const std::array<double, 9> & P, std::array<double, 9> & result)
+    {
+        for (int row = 0; row < 3; ++row)
+        {
+            for (int col = 0; col < 3; ++col)
+            {
+                double sum = 0.0;
+                for (int k = 0; k < 3; ++k)
+                {
+                    for (int l = 0; l < 3; ++l)
+                    {
+                        sum += J[3*k + row] * P[3*l + k] * J[3*l + col];
+                    }
+                }
+                result[3*col + row] += sum;
+            }
+        }
+    }
+
+    /// \brief the covariance of a landmark of the second map, moved into the frame of the first
+    /// \param t - the transform, with its covariance
+    /// \param S - the covariance of the landmark in its own map
+    /// \param bx - the x of the landmark in its own map
+    /// \param by - the y of the landmark in its own map
+    /// \return R S R^T + J T J^T, with J = [1 0 jx; 0 1 jy] the derivative of the moved landmark by (x, y, th)
+    static std::array<double, 4> movedCov(const Alignment & t, const std::array<double, 4> & S, double bx, double by)
+    {
+        const double c = std::cos(t.th), s = std::sin(t.th);
+        std::array<double, 4> moved = rotate(S, t.th);
+
+        const double jx = -s * bx - c * by, jy = c * bx - s * by;
+        const std::array<double, 9> & T = t.cov;
+        const double tx = T[0] + jx * T[2], ty = T[1] + jy * T[2];     // first column of J T
+        const double ux = T[3] + jx * T[5], uy = T[4] + jy * T[5];     // second column
+        const double vx = T[6] + jx * T[8], vy = T[7] + jy * T[8];     // third column
+        moved[0] += tx + vx * jx;
+        moved[1] += ty + vy * jx;
+        moved[2] += ux + vx * jy;
+        moved[3] += uy + vy * jy;
+        return moved;
+    }
+
+    int LandmarkMap::size() const
+    {
+        return mean.size() / 2;
+    }
+
+    MapMerger::MapMerger()
+        : MapMerger(2.0, 0.15, 6, 4, 500)
+    {
+    }
+
+    MapMerger::MapMerger(double maxTriangleSide, double matchDistance, int neighborCount, int minMatchCount,
+                         int maxSampleCount, unsigned int randomSeed)
+        : maxSide(maxTriangleSide), matchDist(matchDistance), neighbors(std::max(2, neighborCount)),
+          minMatches(std::max(3, minMatchCount)), maxSamples(maxSampleCount), seed(randomSeed)
+    {
+    }
+
+    bool MapMerger::align(const LandmarkMap & a, const LandmarkMap & b, Alignment & alignment) const
+    {
+        alignment = Alignment();
+        if ((a.size() < 3) || (b.size() < 3))
+        {
+            return false;
+        }
+
+        const Grid gridA(a.mean, maxSide);
+        const Grid gridB(b.mean, maxSide);
+        const double tol = matchDist;
+        const double binSize = matchDist;
+
+        // the triangles of a, in every bin a noisy copy of them could fall into
+        std::unordered_map<uint64_t, std::vector<int>> table;
+        const std::vector<Triangle> trianglesA = triangles(a.mean, gridA, maxSide, neighbors);
+        std::vector<std::array<int, 3>> ordered;
+        const std::array<std::array<int, 3>, 6> orders = {{{0, 1, 2}, {0, 2, 1}, {1, 0, 2}, {1, 2, 0}, {2, 0, 1}, {2, 1, 0}}};
+        for (const auto & t: trianglesA)
+        {
+            // every vertex order a noisy copy could sort into, so near isosceles triangles still match
+            for (const auto & o: orders)
+            {
+                if ((t.s[o[0]] > t.s[o[1]] + 2.0 * tol) || (t.s[o[1]] > t.s[o[2]] + 2.0 * tol))
+                {
+                    continue;
+                }
+                const std::array<int, 3> v = {t.v[o[0]], t.v[o[1]], t.v[o[2]]};
+                const bool ccw = counterClockwise(a.mean, v);
+                const int id = ordered.size();
+                ordered.push_back(v);
+
+                for (int64_t q0 = std::floor((t.s[o[0]] - tol) / binSize); q0 <= std::floor((t.s[o[0]] + tol) / binSize); ++q0)
+                {
+                    for (int64_t q1 = std::floor((t.s[o[1]] - tol) / binSize); q1 <= std::floor((t.s[o[1]] + tol) / binSize); ++q1)
+                    {
+                        for (int64_t q2 = std::floor((t.s[o[2]] - tol) / binSize); q2 <= std::floor((t.s[o[2]] + tol) / binSize); ++q2)
+                        {
+                            table[key(q0, q1, q2, ccw)].push_back(id);
+                        }
+                    }
+                }
+            }
+        }
+
+        // every triangle of b if there are few enough, random ones otherwise
+        std::vector<Triangle> trianglesB = triangles(b.mean, gridB, maxSide, neighbors);
+        if (int(trianglesB.size()) > maxSamples)
+        {
+            std::mt19937 gen(seed);
+            std::shuffle(trianglesB.begin(), trianglesB.end(), gen);
+            trianglesB.resize(maxSamples);
+        }
+
+        // each shape match votes for the transform it implies
+        const double angleBin = matchDist / maxSide;
+        std::vector<Alignment> proposals;
+        std::unordered_map<uint64_t, std::pair<int, int>> votes;      // (votes, first proposal)
+        for (const auto & t: trianglesB)
+        {
+            auto found = table.find(key(std::floor(t.s[0] / binSize), std::floor(t.s[1] / binSize),
+                                        std::floor(t.s[2] / binSize), t.ccw));
+            if (found == table.end())
+            {
+                continue;
+            }
+
+            for (int id: found->second)
+            {
+                const std::array<int, 3> & v = ordered[id];
+                Alignment proposal;
+                fit(a.mean, b.mean, {{v[0], t.v[0]}, {v[1], t.v[1]}, {v[2], t.v[2]}}, proposal);
+
+                const uint64_t bin = key(std::floor(proposal.x / matchDist), std::floor(proposal.y / matchDist),
+                                         std::floor((proposal.th + M_PI) / angleBin), false);
+                auto vote = votes.find(bin);
+                if (vote == votes.end())
+                {
+                    votes[bin] = {1, int(proposals.size())};
+                    proposals.push_back(proposal);
+                } else
+                {
+                    ++vote->second.first;
+                }
+            }
+        }
+        if (votes.empty())
+        {
+            return false;
+        }
+
+        // only the most voted transforms are checked against the whole map
+        std::vector<std::pair<int, int>> ranked;
+        for (const auto & vote: votes)
+        {
+            ranked.push_back(vote.second);
+        }
+        const int checked = std::min<int>(10, ranked.size());
+        std::partial_sort(ranked.begin(), ranked.begin() + checked, ranked.end(),
+                          [](const std::pair<int, int> & p, const std::pair<int, int> & q) { return p.first > q.first; });
+
+        std::vector<Alignment> verified;
+        for (int k = 0; k < checked; ++k)
+        {
+            Alignment hyp = proposals[ranked[k].second];
+            verify(a.mean, gridA, b.mean, matchDist, hyp);
+            if (hyp.inliers >= minMatches)
+            {
+                verified.push_back(hyp);
+            }
+        }
+        if (verified.empty())
+        {
+            return false;
+        }
+
+        // the most inliers wins, then the tightest fit
+        auto better = [](const Alignment & p, const Alignment & q)
+        {
+            return (p.inliers > q.inliers) || ((p.inliers == q.inliers) && (p.rms < q.rms));
+        };
+        alignment = *std::min_element(verified.begin(), verified.end(), better);
+        alignment.found = true;
+
+        // a different transform that explains as many landmarks makes the maps ambiguous
+        for (const auto & hyp: verified)
+        {
+            const bool same = (std::hypot(hyp.x - alignment.x, hyp.y - alignment.y) < matchDist) &&
+                              (std::fabs(rigid2d::normalize_angle(hyp.th - alignment.th)) < 0.1);
+            if ((hyp.inliers == alignment.inliers) && !same)
+            {
+                alignment.ambiguous = true;
+                return false;
+            }
+        }
+
+        refine(a, b, alignment);
+        return true;
+    }
+
+    bool MapMerger::merge(const LandmarkMap & a, const LandmarkMap & b, MergedMap & merged) const
+    {
+        merged = MergedMap();
+        if (!align(a, b, merged.alignment))
+        {
+            return false;
+        }
+        const Alignment & t = merged.alignment;
+        const double c = std::cos(t.th), s = std::sin(t.th);
+
+        std::vector<int> matchOfA(a.size(), -1), matchOfB(b.size(), -1);
+        for (const auto & p: t.matches)
+        {
+            matchOfA[p.first] = p.second;
+            matchOfB[p.second] = p.first;
+        }
+
+        LandmarkMap & out = merged.landmarks;
+        out.mean.reserve(2 * (a.size() + b.size() - t.inliers));
+        out.cov.reserve(4 * (a.size() + b.size() - t.inliers));
+
+        for (int i = 0; i < a.size(); ++i)
+        {
+            const int j = matchOfA[i];
+            if (j < 0)
+            {
+                out.mean.insert(out.mean.end(), {a.mean[2*i], a.mean[2*i+1]});
+                out.cov.insert(out.cov.end(), a.cov.begin() + 4*i, a.cov.begin() + 4*i + 4);
+                merged.origin.emplace_back(i, -1);
+                continue;
+            }
+
+            // information form: the fused location weighs each map by how sure it is, b with the uncertainty
+            // of the transform that moved it
+            const double bx = t.x + c * b.mean[2*j] - s * b.mean[2*j+1];
+            const double by = t.y + s * b.mean[2*j] + c * b.mean[2*j+1];
+            const std::array<double, 4> La = inverse2(block(a, i));
+            const std::array<double, 4> Lb = inverse2(movedCov(t, block(b, j), b.mean[2*j], b.mean[2*j+1]));
+            const std::array<double, 4> S = inverse2({La[0] + Lb[0], La[1] + Lb[1], La[2] + Lb[2], La[3] + Lb[3]});
+            const double ex = La[0] * a.mean[2*i] + La[2] * a.mean[2*i+1] + Lb[0] * bx + Lb[2] * by;
+            const double ey = La[1] * a.mean[2*i] + La[3] * a.mean[2*i+1] + Lb[1] * bx + Lb[3] * by;
+
+            out.mean.insert(out.mean.end(), {S[0] * ex + S[2] * ey, S[1] * ex + S[3] * ey});
+            out.cov.insert(out.cov.end(), S.begin(), S.end());
+            merged.origin.emplace_back(i, j);
+            ++merged.shared;
+        }
+
+        for (int j = 0; j < b.size(); ++j)
+        {
+            if (matchOfB[j] >= 0)
+            {
+                continue;
+            }
+            const double bx = b.mean[2*j], by = b.mean[2*j+1];
+            const std::array<double, 4> S = movedCov(t, {b.cov[4*j], b.cov[4*j+1], b.cov[4*j+2], b.cov[4*j+3]}, bx, by);
+
+            out.mean.insert(out.mean.end(), {t.x + c * bx - s * by, t.y + s * bx + c * by});
+            out.cov.insert(out.cov.end(), S.begin(), S.end());
+            merged.origin.emplace_back(-1, j);
+        }
+        return true;
+    }
+
+    LandmarkMap seenLandmarks(const map_file::MappedMap & mapped)
+    {
+        LandmarkMap map;
+        const uint64_t len = mapped.stateLength();
+        const double * state = mapped.state();
+        const double * cov = mapped.cov();
+
+        for (uint64_t j = 0; j < mapped.numLandmarks(); ++j)
+        {
+            const map_file::LandmarkInfo & info = mapped.landmarks()[j];
+            if (!(info.flags & map_file::LANDMARK_INITIALIZED))
+            {
+                continue;
+            }
+            const uint64_t k = 3 + 2 * uint64_t(info.id);
+            map.mean.insert(map.mean.end(), {state[k], state[k+1]});
+            map.cov.insert(map.cov.end(), {cov[k*len + k], cov[k*len + k+1], cov[(k+1)*len + k], cov[(k+1)*len + k+1]});
+        }
+        return map;
+    }
+
+    void transformPose(const Alignment & alignment, std::array<double, 3> & pose, std::array<double, 9> & poseCov)
+    {
+        const double c = std::cos(alignment.th), s = std::sin(alignment.th);
+        const double px = pose[1], py = pose[2];
+
+        // derivatives of (theta, x, y) after the transform, with respect to the pose and to (x, y, th) of the transform
+        const std::array<double, 9> Jp = {1.0, 0.0, 0.0, 0.0, c, s, 0.0, -s, c};
+        const std::array<double, 9> Jt = {0.0, 1.0, 0.0, 0.0, 0.0, 1.0, 1.0, -s * px - c * py, c * px - s * py};
+
+        std::array<double, 9> result = {};
+        addSandwich(Jp, poseCov, result);
+        addSandwich(Jt, alignment.cov, result);
+
+        pose = {rigid2d::normalize_angle(pose[0] + alignment.th),
+                alignment.x + c * px - s * py,
+                alignment.y + s * px + c * py};
+        poseCov = result;
+    }
+
+    bool seedState(const LandmarkMap & landmarks, const std::array<double, 3> & pose,
+                   const std::array<double, 9> & poseCov, int numLandmarks,
+                   std::vector<double> & state, std::vector<double> & cov, std::string & error)
+    {
+        if (landmarks.size() > numLandmarks)
+        {
+            error = "the map has " + std::to_string(landmarks.size()) + " landmarks, the filter holds " +
+                    std::to_string(numLandmarks);
+            return false;
+        }
+
+        const int len = 3 + 2 * numLandmarks;
+        state.assign(len, 0.0);
+        cov.assign(size_t(len) * len, 0.0);
+
+        for (int row = 0; row < 3; ++row)
+        {
+            state[row] = pose[row];
+            for (int col = 0; col < 3; ++col)
+            {
+                cov[size_t(col) * len + row] = poseCov[3*col + row];
+            }
+        }
+
+        for (int j = 0; j < numLandmarks; ++j)
+        {
+            const size_t k = 3 + 2 * j;
+            if (j < landmarks.size())
+            {
+                state[k] = landmarks.mean[2*j];
+                state[k+1] = landmarks.mean[2*j+1];
+                cov[k*len + k] = landmarks.cov[4*j];
+                cov[k*len + k+1] = landmarks.cov[4*j+1];
+                cov[(k+1)*len + k] = landmarks.cov[4*j+2];
+                cov[(k+1)*len + k+1] = landmarks.cov[4*j+3];
+            } else
+            {
+                // unseen, as in a new filter
+                cov[k*len + k] = INT_MAX;
+                cov[(k+1)*len + k+1] = INT_MAX;
+            }
+        }
+        return true;
+    }
+}
@@ -0,0 +1,343 @@
+/// \file mcl.cpp
+/// \brief contains a node called mcl that localizes the robot against the tube map with a particle filter
+///
+/// PARAMETERS:
+///     wheel_base (double) : The distance between wheels
+///     wheel_radius (double) : The radius of both wheels
+///     tube1_location ... tube6_location : the (x,y) locations of each tube / landmark
+///     mcl_min_particles (int) : fewest particles kept by KLD sampling (default 500)
+///     mcl_max_particles (int) : most particles, used for a global initialization (default 5000)
+///     mcl_kld_epsilon (double) : largest KL divergence between the particles and the posterior (default 0.05)
+///     mcl_range_sigma (double) : standard deviation of a range measurement (default 0.05)
+///     mcl_bearing_sigma (double) : standard deviation of a bearing measurement (default 0.05)
+///     mcl_motion_noise (double) : heading and translation noise per unit of motion (default 0.1)
+///     mcl_alpha_slow (double) : rate of the long term average likelihood (default 0.001)
+///     mcl_alpha_fast (double) : rate of the short term average likelihood (default 0.1)
+///     mcl_global_init (bool) : if true, spread the particles over the map at start, otherwise start at the origin (default true)
+/// PUBLISHES:  /mcl_path (nav_msgs::Path)
+///             /particles (geometry_msgs::PoseArray)
+/// SUBSCRIBES: /joint_states (sensor_msgs::JointState)
+///             /real_sensor (visualization_msgs::MarkerArray)
+///             /fake_sensor (visualization_msgs::MarkerArray)
+/// SERVICES: ~set_pose : Places the particles around the requested configuration, under the node name so it
+///                      does not take the set_pose of the slam node
+///
+/// Broadcasts the same world -> map -> odom -> body transforms as the slam node, so it can be used in its place.
+
+#include <ros/ros.h>
+
+#include <rigid2d/set_pose.h>
+
+#include <nav_msgs/Path.h>
+
+#include <geometry_msgs/TransformStamped.h>
+#include <geometry_msgs/PoseArray.h>
+#include <geometry_msgs/PoseStamped.h>
+
+#include <visualization_msgs/MarkerArray.h>
+
+#include <tf2_ros/transform_broadcaster.h>
+#include <tf2/LinearMath/Quaternion.h>
+#include <tf2_geometry_msgs/tf2_geometry_msgs.h>
+
+#include <sensor_msgs/JointState.h>
+
+#include <rigid2d/rigid2d.hpp>
+#include <rigid2d/diff_drive.hpp>
+
+#include <nuslam/particle_filter_library.hpp>
+
+#include <string>
+#include <vector>
+
+/**********
+ * Declare global variables
+ * *******/
+static rigid2d::DiffDrive odometry;
+static particle_filter::ParticleFilter mcl;
+
+static sensor_msgs::JointState::ConstPtr joint_state_msg;
+static std::vector<particle_filter::Observation> observations;
+
+static double wheelBase, wheelRad;
+static bool jointState_flag = false;
+static bool observation_flag = false;
+static bool odometry_init = false;
+
+/**********
+ * Helper Functions
+ * *******/
+void jointStateCallback(const sensor_msgs::JointState::ConstPtr & msg);
+void sensorCallback(const visualization_msgs::MarkerArray::ConstPtr & array);
+void fakeSensorCallback(const visualization_msgs::MarkerArray::ConstPtr & array);
+void addObservations(const visualization_msgs::MarkerArray & array, bool withIds);
+geometry_msgs::TransformStamped makeTransform(const std::string & parent, const std::string & child,
+                                              double x, double y, double th, const ros::Time & stamp);
+bool setPose(rigid2d::set_pose::Request & req, rigid2d::set_pose::Response & res);
+
+/*********
+ * Main Function
+ * ******/
+int main(int argc, char* argv[])
+{
+    using namespace rigid2d;
+    using namespace particle_filter;
+
+    /*********
+     * Initialize the node & node handle
+     * ******/
+    ros::init(argc, argv, "mcl");
+    ros::NodeHandle n;
+
+    /*********
+     * Declare local variables
+     * ******/
+    std::string world_frame_id, map_frame_id, odom_frame_id, body_frame_id;
+    std::vector<double> tube1_loc, tube2_loc, tube3_loc, tube4_loc, tube5_loc, tube6_loc;
+    double motionNoise = 0.1;
+    bool globalInit = true;
+
+    int frequency = 10;
+
+    MclParams params;
+
+    nav_msgs::Path mcl_path;
+    geometry_msgs::PoseArray particles_msg;
+    tf2_ros::TransformBroadcaster broadcaster;
+
+    /*********
+     * Read parameters from parameter server
+     * ******/
+    n.getParam("wheel_base", wheelBase);
+    n.getParam("wheel_radius", wheelRad);
+    n.getParam("world_frame_id", world_frame_id);
+    n.getParam("map_frame_id", map_frame_id);
+    n.getParam("odom_frame_id", odom_frame_id);
+    n.getParam("body_frame_id", body_frame_id);
+    n.getParam("tube1_location", tube1_loc);
+    n.getParam("tube2_location", tube2_loc);
+    n.getParam("tube3_location", tube3_loc);
+    n.getParam("tube4_location", tube4_loc);
+    n.getParam("tube5_location", tube5_loc);
+    n.getParam("tube6_location", tube6_loc);
+    n.getParam("mcl_min_particles", params.minParticles);
+    n.getParam("mcl_max_particles", params.maxParticles);
+    n.getParam("mcl_kld_epsilon", params.kldEpsilon);
+    n.getParam("mcl_range_sigma", params.rangeSigma);
+    n.getParam("mcl_bearing_sigma", params.bearingSigma);
+    n.getParam("mcl_motion_noise", motionNoise);
+    n.getParam("mcl_alpha_slow", params.alphaSlow);
+    n.getParam("mcl_alpha_fast", params.alphaFast);
+    n.getParam("mcl_global_init", globalInit);
+
+    params.alpha1 = motionNoise;
+    params.alpha2 = motionNoise / 2.0;
+    params.alpha3 = motionNoise;
+    params.alpha4 = motionNoise / 2.0;
+
+    /*********
+     * Define publishers, subscribers and services
+     ********/
+    ros::Publisher mclPath_pub = n.advertise<nav_msgs::Path>("/mcl_path", frequency);
+    ros::Publisher particles_pub = n.advertise<geometry_msgs::PoseArray>("/particles", frequency);
+
+    ros::Subscriber joint_sub = n.subscribe("/joint_states", frequency, jointStateCallback);
+    ros::Subscriber sensor_sub = n.subscribe("/real_sensor", frequency, sensorCallback);
+    ros::Subscriber fake_sensor_sub = n.subscribe("/fake_sensor", frequency, fakeSensorCallback);
+
+    ros::NodeHandle pn("~");
+    ros::ServiceServer setPose_service = pn.advertiseService("set_pose", setPose);
+
+    ros::Rate loop_rate(frequency);
+
+    /*********
+     * Create the particle filter against the tube map
+     * ******/
+    std::vector<double> mapState;
+    for (auto tube: {&tube1_loc, &tube2_loc, &tube3_loc, &tube4_loc, &tube5_loc, &tube6_loc})
+    {
+        if (tube->size() == 2)
+        {
+            mapState.push_back((*tube)[0]);
+            mapState.push_back((*tube)[1]);
+        }
+    }
+
+    odometry = DiffDrive(wheelBase, wheelRad, 0.0, 0.0, 0.0, 0.0, 0.0);
+    mcl = ParticleFilter(mapState, params, ros::Time::now().toNSec());
+    if (!globalInit)
+    {
+        mcl.initPose(0.0, 0.0, 0.0, 0.05, 0.05);
+    }
+
+    while (ros::ok())
+    {
+        ros::spinOnce();
+
+        ros::Time current_time = ros::Time::now();
+
+        /**********
+         * If a joint state message is received
+         * *******/
+        if (jointState_flag)
+        {
+            double left = joint_state_msg->position[0];
+            double right = joint_state_msg->position[1];
+
+            if (!odometry_init)
+            {
+                odometry = DiffDrive(wheelBase, wheelRad, 0.0, 0.0, 0.0, left, right);
+                odometry_init = true;
+            }
+
+            /***********
+             * Move the particles by the motion since the last joint state, then weigh them
+             * ********/
+            mcl.predict(odometry.getTwist(left, right));
+            odometry(left, right);
+
+            if (observation_flag)
+            {
+                mcl.update(observations);
+                observations.clear();
+                observation_flag = false;
+            }
+
+            if (mcl.getInjected() > 0)
+            {
+                ROS_DEBUG("mcl: injected %d random particles", mcl.getInjected());
+            }
+
+            /**********
+             * Publish world -> map, map -> odom and odom -> body
+             * T_map_odom = T_map_body * T_odom_body^-1
+             * *******/
+            Transform2D mapBody(Vector2D(mcl.getX(), mcl.getY()), mcl.getTh());
+            Transform2D odomBody(Vector2D(odometry.getX(), odometry.getY()), odometry.getTh());
+            Transform2D mapOdom = mapBody * odomBody.inv();
+
+            broadcaster.sendTransform(makeTransform(world_frame_id, map_frame_id, 0.0, 0.0, 0.0, current_time));
+            broadcaster.sendTransform(makeTransform(map_frame_id, odom_frame_id, mapOdom.getX(), mapOdom.getY(),
+                                                    atan2(mapOdom.getSinTh(), mapOdom.getCosTh()), current_time));
+            broadcaster.sendTransform(makeTransform(odom_frame_id, body_frame_id, odometry.getX(), odometry.getY(),
+                                                    odometry.getTh(), current_time));
+
+            /**********
+             * Publish the particles
+             * *******/
+            const std::vector<double> & px = mcl.getParticleX();
+            const std::vector<double> & py = mcl.getParticleY();
+            const std::vector<double> & pth = mcl.getParticleTh();
+
+            particles_msg.header.stamp = current_time;
+            particles_msg.header.frame_id = map_frame_id;
+            particles_msg.poses.resize(mcl.size());
+            for (int i = 0; i < mcl.size(); ++i)
+            {
+                tf2::Quaternion quater;
+                quater.setRPY(0.0, 0.0, pth[i]);
+                particles_msg.poses[i].position.x = px[i];
+                particles_msg.poses[i].position.y = py[i];
+                particles_msg.poses[i].orientation = tf2::toMsg(quater);
+            }
+            particles_pub.publish(particles_msg);
+
+            /*********
+             * Publish a nav_msgs/Path showing the trajectory of the robot according to the particle filter
+             * ******/
+            geometry_msgs::PoseStamped mcl_poseStamp;
+            mcl_path.header.stamp = current_time;
+            mcl_path.header.frame_id = world_frame_id;
+            mcl_poseStamp.pose.position.x = mcl.getX();
+            mcl_poseStamp.pose.position.y = mcl.getY();
+            mcl_poseStamp.pose.orientation.z = mcl.getTh();
+
+            mcl_path.poses.push_back(mcl_poseStamp);
+            mclPath_pub.publish(mcl_path);
+
+            jointState_flag = false;
+        }
+
+        loop_rate.sleep();
+    }
+    return 0;
+}
+
+/// \brief builds a planar transform message
+/// \param parent : the parent frame
+/// \param child : the child frame
+/// \param x : the x translation
+/// \param y : the y translation
+/// \param th : the rotation
+/// \param stamp : the time stamp
+/// \return the transform
+geometry_msgs::TransformStamped makeTransform(const std::string & parent, const std::string & child,
+                                              double x, double y, double th, const ros::Time & stamp)
+{
+    tf2::Quaternion quater;
+    quater.setRPY(0.0, 0.0, th);
+
+    geometry_msgs::TransformStamped trans;
+    trans.header.stamp = stamp;
+    trans.header.frame_id = parent;
+    trans.child_frame_id = child;
+    trans.transform.translation.x = x;
+    trans.transform.translation.y = y;
+    trans.transform.translation.z = 0.0;
+    trans.transform.rotation = tf2::toMsg(quater);
+    return trans;
+}
+
+/// \brief converts the markers to range-bearing observations and queues them for the next update
+/// \param array : the markers, relative to the robot
+/// \param withIds : whether the marker ids are the landmark indices
+void addObservations(const visualization_msgs::MarkerArray & array, bool withIds)
+{
+    for (const auto & marker: array.markers)
+    {
+        particle_filter::Observation z;
+        z.range = sqrt(pow(marker.pose.position.x, 2) + pow(marker.pose.position.y, 2));
+        z.bearing = atan2(marker.pose.position.y, marker.pose.position.x);
+        z.id = withIds ? marker.id : -1;
+        observations.push_back(z);
+    }
+    observation_flag = !observations.empty();
+}
+
+/// \brief callback function for subscriber to the real sensor, the landmark ids are unknown
+/// \param array : the detected landmarks
+void sensorCallback(const visualization_msgs::MarkerArray::ConstPtr & array)
+{
+    addObservations(*array, false);
+}
+
+/// \brief callback function for subscriber to the fake sensor, the marker ids are the landmark indices
+/// \param array : the measured landmarks
+void fakeSensorCallback(const visualization_msgs::MarkerArray::ConstPtr & array)
+{
+    addObservations(*array, true);
+}
+
+/// \brief callback function for subscriber to joint state message
+/// \param msg : the joint state message
+void jointStateCallback(const sensor_msgs::JointState::ConstPtr & msg)
+{
+    if (msg->position.size() < 2)
+    {
+        return;
+    }
+
+    joint_state_msg = msg;
+    jointState_flag = true;
+}
+
+/// \brief setPose function for set_pose service
+/// Places the particles tightly around the requested configuration
+/// \param req : The service request
+/// \param res : The service reponse
+/// \return true
+bool setPose(rigid2d::set_pose::Request &req, rigid2d::set_pose::Response &)
+{
+    mcl.initPose(req.x, req.y, req.th, 0.02, 0.02);
+    return true;
+}
@@ -0,0 +1,171 @@
+/// \file merge_maps.cpp
+/// \brief contains a node called merge_maps that merges the saved maps of two robots into one map file,
+/// which any robot's slam node can load with load_map
+///
+/// PARAMETERS:
+///     tube_radius : the radius of the tubes / landmarks, written to the merged map
+///     merge_map_a (string) : the map whose frame is kept (default nuslam_map.bin, relative to ROS_HOME)
+///     merge_map_b (string) : the map merged into it (default nuslam_map_b.bin)
+///     merged_map_file (string) : the file the merged map is written to (default nuslam_merged_map.bin)
+///     merge_pose (string) : "a" or "b", the robot whose pose, in the frame of a, the merged map starts from (default "a")
+///     merge_filter_landmarks (int) : landmarks the filter loading the merged map holds, 0 for exactly the merged ones (default 0)
+///     merge_max_side (double) : the longest landmark triangle stored (default 2.0)
+///     merge_match_distance (double) : the largest distance between a landmark and its match in the other map (default 0.15)
+///     merge_neighbors (int) : the nearest landmarks each landmark makes triangles with (default 6)
+///     merge_min_matches (int) : the fewest shared landmarks accepted, at least 3 (default 4)
+///     merge_max_samples (int) : the most triangles of map b looked up (default 500)
+/// SERVICES: merge_maps (std_srvs::Trigger) : merges merge_map_b into merge_map_a and writes merged_map_file
+
+#include <ros/ros.h>
+
+#include <std_srvs/Trigger.h>
+
+#include <nuslam/map_file_library.hpp>
+#include <nuslam/map_merge_library.hpp>
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**********
+ * Declare global variables
+ * *******/
+static map_merge::MapMerger merger;
+
+/**********
+ * Helper Functions
+ * *******/
+bool mergeMaps(std_srvs::Trigger::Request & req, std_srvs::Trigger::Response & res);
+void robotPose(const map_file::MappedMap & mapped, std::array<double, 3> & pose, std::array<double, 9> & poseCov);
+
+/*********
+ * Main Function
+ * ******/
+int main(int argc, char* argv[])
+{
+    /*********
+     * Initialize the node & node handle
+     * ******/
+    ros::init(argc, argv, "merge_maps");
+    ros::NodeHandle n;
+
+    /*********
+     * Read parameters from parameter server
+     * ******/
+    double maxSide = 2.0, matchDistance = 0.15;
+    int neighbors = 6, minMatches = 4, maxSamples = 500;
+
+    n.getParam("merge_max_side", maxSide);
+    n.getParam("merge_match_distance", matchDistance);
+    n.getParam("merge_neighbors", neighbors);
+    n.getParam("merge_min_matches", minMatches);
+    n.getParam("merge_max_samples", maxSamples);
+
+    merger = map_merge::MapMerger(maxSide, matchDistance, neighbors, minMatches, maxSamples);
+
+    /*********
+     * Define services
+     ********/
+    ros::ServiceServer merge_service = n.advertiseService("merge_maps", mergeMaps);
+
+    ros::spin();
+    return 0;
+}
+
+/// \brief mergeMaps function for merge_maps service
+/// Aligns the two map files, fuses their landmarks and writes the merged map
+/// \param res : The service response, success is false if the maps could not be merged
+/// \return true
+bool mergeMaps(std_srvs::Trigger::Request &, std_srvs::Trigger::Response & res)
+{
+    using namespace map_file;
+    using namespace map_merge;
+
+    std::string pathA = "nuslam_map.bin", pathB = "nuslam_map_b.bin", pathMerged = "nuslam_merged_map.bin";
+    std::string poseFrom = "a";
+    int filterLandmarks = 0;
+    double tubeRad = 0.0;
+    ros::param::get("merge_map_a", pathA);
+    ros::param::get("merge_map_b", pathB);
+    ros::param::get("merged_map_file", pathMerged);
+    ros::param::get("merge_pose", poseFrom);
+    ros::param::get("merge_filter_landmarks", filterLandmarks);
+    ros::param::get("tube_radius", tubeRad);
+
+    MappedMap mappedA, mappedB;
+    if (!mappedA.open(pathA, res.message) || !mappedB.open(pathB, res.message))
+    {
+        res.success = false;
+        return true;
+    }
+
+    const ros::WallTime start = ros::WallTime::now();
+    MergedMap merged;
+    if (!merger.merge(seenLandmarks(mappedA), seenLandmarks(mappedB), merged))
+    {
+        res.success = false;
+        res.message = merged.alignment.ambiguous ? "the maps fit together in more than one way"
+                                                 : "the maps do not share enough landmarks";
+        return true;
+    }
+    const double elapsed = (ros::WallTime::now() - start).toSec();
+
+    std::array<double, 3> pose;
+    std::array<double, 9> poseCov;
+    if (poseFrom == "b")
+    {
+        robotPose(mappedB, pose, poseCov);
+        transformPose(merged.alignment, pose, poseCov);
+    } else
+    {
+        robotPose(mappedA, pose, poseCov);
+    }
+
+    const int numLandmarks = (filterLandmarks > 0) ? filterLandmarks : merged.landmarks.size();
+    std::vector<double> state, cov;
+    if (!seedState(merged.landmarks, pose, poseCov, numLandmarks, state, cov, res.message))
+    {
+        res.success = false;
+        return true;
+    }
+
+    std::vector<LandmarkInfo> landmarks;
+    for (int j = 0; j < numLandmarks; ++j)
+    {
+        uint32_t flags = (j < merged.landmarks.size()) ? LANDMARK_INITIALIZED : 0;
+        landmarks.push_back({j, flags, tubeRad});
+    }
+
+    std::string error;
+    res.success = saveMap(pathMerged, state.data(), state.size(), cov.data(), landmarks, error);
+    if (!res.success)
+    {
+        res.message = error;
+        return true;
+    }
+
+    const Alignment & t = merged.alignment;
+    ROS_INFO("merge_maps: b is at x %f y %f th %f in a, %d shared landmarks (rms %f), merged in %f s",
+             t.x, t.y, t.th, merged.shared, t.rms, elapsed);
+
+    res.message = "merged " + std::to_string(merged.landmarks.size()) + " landmarks into " + pathMerged;
+    return true;
+}
+
+/// \brief the pose of the robot saved in a map file
+/// \param mapped : the map file
+/// \param pose : (theta, x, y)
+/// \param poseCov : the covariance of the pose, column major
+void robotPose(const map_file::MappedMap & mapped, std::array<double, 3> & pose, std::array<double, 9> & poseCov)
+{
+    const uint64_t len = mapped.stateLength();
+    for (int row = 0; row < 3; ++row)
+    {
+        pose[row] = mapped.state()[row];
+        for (int col = 0; col < 3; ++col)
+        {
+            poseCov[3*col + row] = mapped.cov()[col * len + row];
+        }
+    }
+}
@@ -0,0 +1,251 @@
+/// \file occupancy_grid_library.cpp
+/// \brief a library that builds a log-odds occupancy grid from laser scans
+
+#include "nuslam/occupancy_grid_library.hpp"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+
+namespace occupancy_grid
+{
+    /// \brief the key of the tile holding a cell
+    static uint64_t tileKey(int cx, int cy)
+    {
+        return (uint64_t(uint32_t(cx >> TILE_BITS)) << 32) | uint64_t(uint32_t(cy >> TILE_BITS));
+    }
+
+    /// \brief converts log-odds to the fixed point stored in the grid
+    static int16_t toFixed(double logOdds)
+    {
+        return int16_t(std::lround(std::max(-300.0, std::min(300.0, logOdds)) * 100.0));
+    }
+
+    bool Region::empty() const
+    {
+        return (width <= 0) || (height <= 0);
+    }
+
+    bool Region::contains(const Region & other) const
+    {
+        return (other.x >= x) && (other.y >= y) &&
+               (other.x + other.width <= x + width) && (other.y + other.height <= y + height);
+    }
+
+    TiledGrid::TiledGrid()
+        : TiledGrid(GridParams())
+    {
+    }
+
+    TiledGrid::TiledGrid(const GridParams & gridParams)
+        : params(gridParams)
+    {
+        hit = toFixed(params.hit);
+        miss = toFixed(params.miss);
+        minValue = toFixed(params.minLogOdds);
+        maxValue = toFixed(params.maxLogOdds);
+
+        tileMinX = INT_MAX;
+        tileMinY = INT_MAX;
+        tileMaxX = INT_MIN;
+        tileMaxY = INT_MIN;
+
+        dirtyMinX = INT_MAX;
+        dirtyMinY = INT_MAX;
+        dirtyMaxX = INT_MIN;
+        dirtyMaxY = INT_MIN;
+
+        beamAngleMin = 0.0;
+        beamIncrement = 0.0;
+
+        cachedKey = 0;
+        cachedTile = nullptr;
+    }
+
+    TiledGrid::Tile * TiledGrid::tileAt(int cx, int cy)
+    {
+        uint64_t key = tileKey(cx, cy);
+        if (cachedTile && (key == cachedKey))
+        {
+            return cachedTile;
+        }
+
+        auto & tile = tiles[key];
+        if (!tile)
+        {
+            tile.reset(new Tile);
+            std::fill(tile->cells, tile->cells + TILE_SIZE * TILE_SIZE, UNKNOWN);
+
+            tileMinX = std::min(tileMinX, cx >> TILE_BITS);
+            tileMinY = std::min(tileMinY, cy >> TILE_BITS);
+            tileMaxX = std::max(tileMaxX, cx >> TILE_BITS);
+            tileMaxY = std::max(tileMaxY, cy >> TILE_BITS);
+        }
+
+        cachedKey = key;
+        cachedTile = tile.get();
+        return cachedTile;
+    }
+
+    void TiledGrid::addToCell(int cx, int cy, int16_t delta)
+    {
+        Tile * tile = tileAt(cx, cy);
+        int16_t & cell = tile->cells[((cy & (TILE_SIZE - 1)) << TILE_BITS) | (cx & (TILE_SIZE - 1))];
+
+        int value = (cell == UNKNOWN) ? delta : cell + delta;
+        cell = int16_t(std::max(int(minValue), std::min(int(maxValue), value)));
+
+        dirtyMinX = std::min(dirtyMinX, cx);
+        dirtyMinY = std::min(dirtyMinY, cy);
+        dirtyMaxX = std::max(dirtyMaxX, cx);
+        dirtyMaxY = std::max(dirtyMaxY, cy);
+    }
+
+    void TiledGrid::traceRay(int x0, int y0, int x1, int y1, bool hitEnd)
+    {
+        // Bresenham, all integer
+        const int dx = std::abs(x1 - x0), sx = (x0 < x1) ? 1 : -1;
+        const int dy = -std::abs(y1 - y0), sy = (y0 < y1) ? 1 : -1;
+        int err = dx + dy;
+
+        while ((x0 != x1) || (y0 != y1))
+        {
+            addToCell(x0, y0, miss);
+
+            int e2 = 2 * err;
+            if (e2 >= dy)
+            {
+                err += dy;
+                x0 += sx;
+            }
+            if (e2 <= dx)
+            {
+                err += dx;
+                y0 += sy;
+            }
+        }
+        addToCell(x1, y1, hitEnd ? hit : miss);
+    }
+
+    void TiledGrid::insertScan(double sx, double sy, double sth, double angleMin, double angleIncrement,
+                               const std::vector<float> & ranges, double rangeMin, double rangeMax)
+    {
+        const int n = ranges.size();
+
+        if ((int(beamCos.size()) != n) || (angleMin != beamAngleMin) || (angleIncrement != beamIncrement))
+        {
+            beamCos.resize(n);
+            beamSin.resize(n);
+            for (int i = 0; i < n; ++i)
+            {
+                beamCos[i] = std::cos(angleMin + i * angleIncrement);
+                beamSin[i] = std::sin(angleMin + i * angleIncrement);
+            }
+            beamAngleMin = angleMin;
+            beamIncrement = angleIncrement;
+        }
+
+        const double c = std::cos(sth), s = std::sin(sth);
+        const int ox = toCell(sx), oy = toCell(sy);
+        for (int i = 0; i < n; ++i)
+        {
+            // nan, and shorter than rangeMin, is not a reading to trust either way
+            const double r = ranges[i];
+            if (std::isnan(r) || (r < rangeMin))
+            {
+                continue;
+            }
+
+            // a beam that saw nothing says nothing unless the sensor is trusted to see up to rangeMax
+            const bool hitEnd = r < rangeMax;
+            if (!hitEnd && !params.clearNoReturn)
+            {
+                continue;
+            }
+            const double range = hitEnd ? r : rangeMax;
+
+            const double wx = sx + range * (c * beamCos[i] - s * beamSin[i]);
+            const double wy = sy + range * (s * beamCos[i] + c * beamSin[i]);
+            traceRay(ox, oy, toCell(wx), toCell(wy), hitEnd);
+        }
+    }
+
+    int TiledGrid::toCell(double v) const
+    {
+        return int(std::floor(v / params.resolution));
+    }
+
+    double TiledGrid::resolution() const
+    {
+        return params.resolution;
+    }
+
+    int16_t TiledGrid::logOdds(int cx, int cy) const
+    {
+        auto found = tiles.find(tileKey(cx, cy));
+        if (found == tiles.end())
+        {
+            return UNKNOWN;
+        }
+        return found->second->cells[((cy & (TILE_SIZE - 1)) << TILE_BITS) | (cx & (TILE_SIZE - 1))];
+    }
+
+    int8_t TiledGrid::occupancy(int cx, int cy) const
+    {
+        int16_t value = logOdds(cx, cy);
+        if (value == UNKNOWN)
+        {
+            return -1;
+        }
+        return int8_t(std::lround(100.0 / (1.0 + std::exp(-value / 100.0))));
+    }
+
+    int TiledGrid::numTiles() const
+    {
+        return tiles.size();
+    }
+
+    Region TiledGrid::bounds() const
+    {
+        Region region;
+        if (tiles.empty())
+        {
+            return region;
+        }
+        region.x = tileMinX * TILE_SIZE;
+        region.y = tileMinY * TILE_SIZE;
+        region.width = (tileMaxX - tileMinX + 1) * TILE_SIZE;
+        region.height = (tileMaxY - tileMinY + 1) * TILE_SIZE;
+        return region;
+    }
+
+    Region TiledGrid::takeDirty()
+    {
+        Region region;
+        if (dirtyMaxX >= dirtyMinX)
+        {
+            region.x = dirtyMinX;
+            region.y = dirtyMinY;
+            region.width = dirtyMaxX - dirtyMinX + 1;
+            region.height = dirtyMaxY - dirtyMinY + 1;
+        }
+
+        dirtyMinX = INT_MAX;
+        dirtyMinY = INT_MAX;
+        dirtyMaxX = INT_MIN;
+        dirtyMaxY = INT_MIN;
+        return region;
+    }
+
+    void TiledGrid::fill(const Region & region, std::vector<int8_t> & data) const
+    {
+        data.resize(std::max(0, region.width) * std::max(0, region.height));
+        for (int row = 0; row < region.height; ++row)
+        {
+            for (int col = 0; col < region.width; ++col)
+            {
+                data[row * region.width + col] = occupancy(region.x + col, region.y + row);
+            }
+        }
+    }
+}
@@ -0,0 +1,434 @@
+/// \file particle_filter_library.cpp
+/// \brief a library that contains functions for Monte Carlo localization against a fixed landmark map
+
+#include "nuslam/particle_filter_library.hpp"
+#include "rigid2d/rigid2d.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace particle_filter
+{
+    ParticleFilter::ParticleFilter()
+        : ParticleFilter(std::vector<double>(), MclParams())
+    {
+    }
+
+    ParticleFilter::ParticleFilter(const std::vector<double> & mapState, const MclParams & mclParams, unsigned int seed)
+        : params(mclParams), gen(seed)
+    {
+        params.minParticles = std::max(params.minParticles, 1);
+        params.maxParticles = std::max(params.maxParticles, params.minParticles);
+
+        for (int i = 0; i + 1 < int(mapState.size()); i += 2)
+        {
+            lx.push_back(mapState[i]);
+            ly.push_back(mapState[i + 1]);
+        }
+
+        xMin = -1.0;
+        xMax = 1.0;
+        yMin = -1.0;
+        yMax = 1.0;
+        if (!lx.empty())
+        {
+            xMin = *std::min_element(lx.begin(), lx.end()) - 1.0;
+            xMax = *std::max_element(lx.begin(), lx.end()) + 1.0;
+            yMin = *std::min_element(ly.begin(), ly.end()) - 1.0;
+            yMax = *std::max_element(ly.begin(), ly.end()) + 1.0;
+        }
+
+        // every buffer is sized for the largest particle set up front, so updates never allocate
+        const int maxN = params.maxParticles;
+        for (auto v: {&px, &py, &pth, &weight, &nx, &ny, &nth, &cosTh, &sinTh, &logw, &best, &cumulative})
+        {
+            v->reserve(maxN);
+        }
+        index.reserve(maxN);
+        bins.reserve(2 * maxN);
+
+        initGlobal();
+    }
+
+    void ParticleFilter::setBounds(double xLow, double xHigh, double yLow, double yHigh)
+    {
+        xMin = xLow;
+        xMax = xHigh;
+        yMin = yLow;
+        yMax = yHigh;
+    }
+
+    void ParticleFilter::randomParticle(int i)
+    {
+        std::uniform_real_distribution<> ux(xMin, xMax);
+        std::uniform_real_distribution<> uy(yMin, yMax);
+        std::uniform_real_distribution<> uth(-PI, PI);
+
+        px[i] = ux(gen);
+        py[i] = uy(gen);
+        pth[i] = uth(gen);
+    }
+
+    void ParticleFilter::initGlobal()
+    {
+        const int n = params.maxParticles;
+        px.resize(n);
+        py.resize(n);
+        pth.resize(n);
+        weight.assign(n, 1.0 / n);
+
+        for (int i = 0; i < n; ++i)
+        {
+            randomParticle(i);
+        }
+
+        wSlow = 0.0;
+        wFast = 0.0;
+        injected = 0;
+        computeMean();
+    }
+
+    void ParticleFilter::initPose(double x, double y, double th, double sigmaXY, double sigmaTh)
+    {
+        std::normal_distribution<> nxy(0.0, std::max(sigmaXY, 1e-9));
+        std::normal_distribution<> nt(0.0, std::max(sigmaTh, 1e-9));
+
+        const int n = params.maxParticles;
+        px.resize(n);
+        py.resize(n);
+        pth.resize(n);
+        weight.assign(n, 1.0 / n);
+
+        for (int i = 0; i < n; ++i)
+        {
+            px[i] = x + nxy(gen);
+            py[i] = y + nxy(gen);
+            pth[i] = normalize_angle(th + nt(gen));
+        }
+
+        wSlow = 0.0;
+        wFast = 0.0;
+        injected = 0;
+        computeMean();
+    }
+
+    void ParticleFilter::predict(const Twist2D & tw)
+    {
+        if ((tw.dth == 0.0) && (tw.dx == 0.0))
+        {
+            return;
+        }
+
+        std::normal_distribution<> nrot(0.0, params.alpha1 * std::fabs(tw.dth) + params.alpha2 * std::fabs(tw.dx));
+        std::normal_distribution<> ntrans(0.0, params.alpha3 * std::fabs(tw.dx) + params.alpha4 * std::fabs(tw.dth));
+
+        const int n = size();
+        for (int i = 0; i < n; ++i)
+        {
+            double dth = tw.dth + nrot(gen);
+            double dx = tw.dx + ntrans(gen);
+            double th = pth[i];
+
+            // same arc as the diff drive odometry
+            if (std::fabs(dth) < 1e-9)
+            {
+                px[i] += dx * std::cos(th);
+                py[i] += dx * std::sin(th);
+            } else
+            {
+                double r = dx / dth;
+                px[i] += -r * std::sin(th) + r * std::sin(th + dth);
+                py[i] += r * std::cos(th) - r * std::cos(th + dth);
+            }
+            pth[i] = normalize_angle(th + dth);
+        }
+        computeMean();
+    }
+
+    void ParticleFilter::weigh(const std::vector<Observation> & obs)
+    {
+        const int n = size();
+        const int m = lx.size();
+        const double invVarR = 1.0 / (params.rangeSigma * params.rangeSigma);
+        const double invVarB = 1.0 / (params.bearingSigma * params.bearingSigma);
+        const double gate = params.outlierGate;
+
+        cosTh.resize(n);
+        sinTh.resize(n);
+        logw.assign(n, 0.0);
+        best.resize(n);
+
+        for (int i = 0; i < n; ++i)
+        {
+            cosTh[i] = std::cos(pth[i]);
+            sinTh[i] = std::sin(pth[i]);
+        }
+
+        const double * x = px.data();
+        const double * y = py.data();
+        const double * c = cosTh.data();
+        const double * s = sinTh.data();
+        double * q = best.data();
+        double * lw = logw.data();
+
+        for (const auto & z: obs)
+        {
+            const double cb = std::cos(z.bearing);
+            const double sb = std::sin(z.bearing);
+            const double zr = z.range;
+
+            int first = 0, last = m;
+            if ((z.id >= 0) && (z.id < m))
+            {
+                first = z.id;
+                last = z.id + 1;
+            }
+
+            std::fill(best.begin(), best.end(), gate);
+
+            // a measurement with an unknown id is charged to the landmark that explains it best
+            for (int j = first; j < last; ++j)
+            {
+                const double mx = lx[j];
+                const double my = ly[j];
+
+                for (int i = 0; i < n; ++i)
+                {
+                    // landmark in the frame of the particle
+                    double dx = mx - x[i];
+                    double dy = my - y[i];
+                    double bx = c[i] * dx + s[i] * dy;
+                    double by = -s[i] * dx + c[i] * dy;
+                    double d = std::sqrt(bx * bx + by * by) + 1e-12;
+
+                    // 2(1 - cos(e)) is e^2 for small bearing errors, without an atan2
+                    double er = d - zr;
+                    double eb2 = 2.0 * (1.0 - (cb * bx + sb * by) / d);
+
+                    double dist = er * er * invVarR + eb2 * invVarB;
+                    q[i] = std::min(q[i], dist);
+                }
+            }
+
+            for (int i = 0; i < n; ++i)
+            {
+                lw[i] -= 0.5 * q[i];
+            }
+        }
+    }
+
+    bool ParticleFilter::update(const std::vector<Observation> & obs)
+    {
+        if (obs.empty() || lx.empty())
+        {
+            return false;
+        }
+
+        weigh(obs);
+
+        const int n = size();
+        const double maxLog = *std::max_element(logw.begin(), logw.end());
+        const double perObs = 1.0 / obs.size();
+
+        double sum = 0.0;
+        double avg = 0.0;
+        for (int i = 0; i < n; ++i)
+        {
+            weight[i] = std::exp(logw[i] - maxLog);
+            sum += weight[i];
+
+            // likelihood per observation, so the average does not depend on how many landmarks are seen
+            avg += std::exp(logw[i] * perObs);
+        }
+        avg /= n;
+
+        for (int i = 0; i < n; ++i)
+        {
+            weight[i] /= sum;
+        }
+
+        if (wSlow == 0.0)
+        {
+            wSlow = avg;
+            wFast = avg;
+        } else
+        {
+            wSlow += params.alphaSlow * (avg - wSlow);
+            wFast += params.alphaFast * (avg - wFast);
+        }
+
+        resample();
+        inject();
+        computeMean();
+        return true;
+    }
+
+    int ParticleFilter::kldCount()
+    {
+        // count the histogram bins the drawn particles fall in
+        bins.clear();
+        for (int i: index)
+        {
+            uint64_t bx = uint64_t(int64_t(std::floor(px[i] / params.binXY))) & 0x1FFFFF;
+            uint64_t by = uint64_t(int64_t(std::floor(py[i] / params.binXY))) & 0x1FFFFF;
+            uint64_t bt = uint64_t(int64_t(std::floor(pth[i] / params.binTh))) & 0x1FFFFF;
+            bins.insert((bx << 42) | (by << 21) | bt);
+        }
+
+        int k = bins.size();
+        if (k <= 1)
+        {
+            return params.minParticles;
+        }
+
+        // Fox, KLD-sampling: the sample size keeping the KL divergence under epsilon with probability 1 - delta
+        double a = 2.0 / (9.0 * (k - 1));
+        double b = 1.0 - a + std::sqrt(a) * params.kldZ;
+        double count = (k - 1) / (2.0 * params.kldEpsilon) * b * b * b;
+
+        return std::min(params.maxParticles, std::max(params.minParticles, int(std::ceil(count))));
+    }
+
+    void ParticleFilter::draw(int count)
+    {
+        const int n = size();
+
+        // low variance resampling: one random offset, then evenly spaced pointers into the cumulative weights
+        std::uniform_real_distribution<> uoff(0.0, 1.0 / count);
+        const double offset = uoff(gen);
+        const double step = 1.0 / count;
+
+        index.resize(count);
+        int j = 0;
+        for (int i = 0; i < count; ++i)
+        {
+            double u = offset + i * step;
+            while ((j < n - 1) && (cumulative[j] < u))
+            {
+                ++j;
+            }
+            index[i] = j;
+        }
+    }
+
+    void ParticleFilter::resample()
+    {
+        const int n = size();
+
+        cumulative.resize(n);
+        double total = 0.0;
+        for (int i = 0; i < n; ++i)
+        {
+            total += weight[i];
+            cumulative[i] = total;
+        }
+        cumulative[n - 1] = 1.0;
+
+        // KLD sampling counts the bins of the particles as they are drawn, and low variance resampling
+        // needs the count up front. The bins are counted on a draw of the current size instead, and the
+        // set is drawn again only if the bound asks for another size. The bins of the two draws differ
+        // only by the particles the size change adds or leaves out.
+        draw(n);
+        const int count = kldCount();
+        if (count != n)
+        {
+            draw(count);
+        }
+
+        nx.resize(count);
+        ny.resize(count);
+        nth.resize(count);
+        for (int i = 0; i < count; ++i)
+        {
+            nx[i] = px[index[i]];
+            ny[i] = py[index[i]];
+            nth[i] = pth[index[i]];
+        }
+
+        px.swap(nx);
+        py.swap(ny);
+        pth.swap(nth);
+        weight.assign(count, 1.0 / count);
+    }
+
+    void ParticleFilter::inject()
+    {
+        injected = 0;
+        if (wSlow <= 0.0)
+        {
+            return;
+        }
+
+        double pRandom = std::max(0.0, 1.0 - wFast / wSlow);
+        if (pRandom <= 0.0)
+        {
+            return;
+        }
+
+        const int n = size();
+        std::binomial_distribution<> nRandom(n, pRandom);
+        std::uniform_int_distribution<> pick(0, n - 1);
+
+        injected = nRandom(gen);
+        for (int r = 0; r < injected; ++r)
+        {
+            randomParticle(pick(gen));
+        }
+    }
+
+    void ParticleFilter::computeMean()
+    {
+        const int n = size();
+        double sx = 0.0, sy = 0.0, sc = 0.0, ss = 0.0;
+        for (int i = 0; i < n; ++i)
+        {
+            sx += weight[i] * px[i];
+            sy += weight[i] * py[i];
+            sc += weight[i] * std::cos(pth[i]);
+            ss += weight[i] * std::sin(pth[i]);
+        }
+
+        meanX = sx;
+        meanY = sy;
+        meanTh = std::atan2(ss, sc);
+    }
+
+    int ParticleFilter::size() const
+    {
+        return px.size();
+    }
+
+    const std::vector<double> & ParticleFilter::getParticleX() const
+    {
+        return px;
+    }
+
+    const std::vector<double> & ParticleFilter::getParticleY() const
+    {
+        return py;
+    }
+
+    const std::vector<double> & ParticleFilter::getParticleTh() const
+    {
+        return pth;
+    }
+
+    double ParticleFilter::getX() const
+    {
+        return meanX;
+    }
+
+    double ParticleFilter::getY() const
+    {
+        return meanY;
+    }
+
+    double ParticleFilter::getTh() const
+    {
+        return meanTh;
+    }
+
+    int ParticleFilter::getInjected() const
+    {
+        return injected;
+    }
+}
@@ -0,0 +1,194 @@
+/// \file pipeline_benchmark.cpp
+/// \brief contains a command line tool called pipeline_benchmark that runs the tube_world simulation, the circle
+/// fit landmark detector and EKF SLAM in one process and measures how the stack scales with the size of the map
+///
+/// USAGE: pipeline_benchmark [--landmarks LIST] [--beams LIST] [--speeds LIST] [--scans N] [--budget SECONDS]
+///                           [--noise METERS] [--seed N] [--radius-spread FRACTION] [--position-only]
+///                           [--format csv|json] [--output FILE]
+///     --landmarks : comma separated numbers of tubes in the world (default 6,25,100,500,2000)
+///     --beams : comma separated numbers of lidar beams per scan (default 360)
+///     --speeds : comma separated forward speeds of the robot in m/s (default 0.2)
+///     --scans : the scans run for each combination (default 100)
+///     --budget : a combination stops early once its detector and filter took this many seconds (default 60)
+///     --noise : standard deviation of the range noise in m (default 0.005)
+///     --seed : seed of the tube placement and the noise (default 1)
+///     --radius-spread : the tubes are shrunk by up to this fraction of the default radius, to mix sizes (default 0)
+///     --position-only : associate on the location alone, without the radius gate
+///     --format : csv for a header and a line per combination, json for an array (default csv)
+///     --output : the file the results are written to (default the standard output)
+///
+/// Every combination of the lists is run, in increasing number of landmarks, since the peak memory reported is
+/// that of the whole process so far. Progress goes to the standard error. It needs no ROS master.
+
+#include <nuslam/pipeline_benchmark_library.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**********
+ * Helper Functions
+ * *******/
+void usage();
+
+/// \brief parses a comma separated list of numbers
+/// \param text - the list
+/// \param values - the numbers
+/// \return false if the list is empty or an entry is not a positive number
+template <typename T>
+bool parseList(const std::string & text, std::vector<T> & values);
+
+/*********
+ * Main Function
+ * ******/
+int main(int argc, char* argv[])
+{
+    using namespace pipeline_benchmark;
+
+    /*********
+     * Read the arguments
+     * ******/
+    std::vector<int> landmarks = {6, 25, 100, 500, 2000};
+    std::vector<int> beams = {360};
+    std::vector<double> speeds = {0.2};
+    std::string format = "csv", output;
+    RunParams params;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const bool hasValue = (i + 1 < argc);
+        bool valid = hasValue;
+        if ((arg == "--landmarks") && hasValue)
+        {
+            valid = parseList(argv[++i], landmarks);
+        } else if ((arg == "--beams") && hasValue)
+        {
+            valid = parseList(argv[++i], beams);
+        } else if ((arg == "--speeds") && hasValue)
+        {
+            valid = parseList(argv[++i], speeds);
+        } else if ((arg == "--scans") && hasValue)
+        {
+            params.scans = std::atoi(argv[++i]);
+        } else if ((arg == "--budget") && hasValue)
+        {
+            params.budget = std::atof(argv[++i]);
+        } else if ((arg == "--noise") && hasValue)
+        {
+            params.noise = std::atof(argv[++i]);
+        } else if ((arg == "--seed") && hasValue)
+        {
+            params.seed = std::strtoul(argv[++i], nullptr, 10);
+        } else if ((arg == "--radius-spread") && hasValue)
+        {
+            params.radiusSpread = std::atof(argv[++i]);
+        } else if (arg == "--position-only")
+        {
+            params.useRadius = false;
+            valid = true;
+        } else if ((arg == "--format") && hasValue)
+        {
+            format = argv[++i];
+        } else if ((arg == "--output") && hasValue)
+        {
+            output = argv[++i];
+        } else
+        {
+            valid = false;
+        }
+
+        if (!valid)
+        {
+            usage();
+            return 2;
+        }
+    }
+
+    if (((format != "json") && (format != "csv")) || (params.scans <= 0) || (params.budget <= 0.0) ||
+        (params.radiusSpread < 0.0) || (params.radiusSpread >= 1.0))
+    {
+        usage();
+        return 2;
+    }
+
+    std::ofstream file;
+    if (!output.empty())
+    {
+        file.open(output);
+        if (!file)
+        {
+            std::cerr << "pipeline_benchmark: cannot write " << output << std::endl;
+            return 1;
+        }
+    }
+    std::ostream & out = output.empty() ? std::cout : file;
+
+    /*********
+     * Run the sweep
+     * ******/
+    std::sort(landmarks.begin(), landmarks.end());
+
+    std::vector<RunResult> results;
+    for (int count: landmarks)
+    {
+        for (int beam: beams)
+        {
+            for (double speed: speeds)
+            {
+                params.landmarks = count;
+                params.beams = beam;
+                params.speed = speed;
+
+                std::cerr << "pipeline_benchmark: " << count << " landmarks, " << beam << " beams, " << speed
+                          << " m/s" << std::flush;
+                results.push_back(runPipeline(params));
+                std::cerr << ", " << results.back().scans << " scans at " << results.back().scanRate << " Hz"
+                          << std::endl;
+            }
+        }
+    }
+
+    /*********
+     * Write the results
+     * ******/
+    if (format == "csv")
+    {
+        writeCsv(results, out, true);
+    } else
+    {
+        writeJson(results, out);
+    }
+    return out ? 0 : 1;
+}
+
+/// \brief prints how to call the tool
+void usage()
+{
+    std::cerr << "usage: pipeline_benchmark [--landmarks LIST] [--beams LIST] [--speeds LIST] [--scans N]"
+              << " [--budget SECONDS] [--noise METERS] [--seed N] [--radius-spread FRACTION] [--position-only]"
+              << " [--format csv|json] [--output FILE]" << std::endl;
+}
+
+template <typename T>
+bool parseList(const std::string & text, std::vector<T> & values)
+{
+    values.clear();
+    std::istringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        std::istringstream number(item);
+        T value;
+        if (!(number >> value) || !number.eof() || (value <= 0))
+        {
+            return false;
+        }
+        values.push_back(value);
+    }
+    return !values.empty();
+}
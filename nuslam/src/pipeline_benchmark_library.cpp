@@ -0,0 +1,323 @@
+/// \file pipeline_benchmark_library.cpp
+/// \brief a library that runs the simulator, the landmark detector and EKF SLAM together and times them
+
+#include "nuslam/pipeline_benchmark_library.hpp"
+#include "nuslam/circle_fit_library.hpp"
+#include "nuslam/slam_library.hpp"
+#include "rigid2d/rigid2d.hpp"
+#include "rigid2d/diff_drive.hpp"
+#include <armadillo>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <sys/resource.h>
+
+namespace pipeline_benchmark
+{
+    using namespace arma;
+    using namespace rigid2d;
+
+    /// \brief the area of the default tube_world, 2.5 m by 3 m, per tube
+    static constexpr double AREA_PER_TUBE = 1.25;
+
+    /// \brief the wheels of the turtlebot
+    static constexpr double WHEEL_BASE = 0.16;
+    static constexpr double WHEEL_RADIUS = 0.033;
+
+    /// \brief seconds between two points of the steady clock
+    static double seconds(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+    {
+        return std::chrono::duration<double>(end - start).count();
+    }
+
+    std::vector<tube_world::Tube> scatterTubes(int count, double radius, double side, double orbit, double clearance,
+                                               unsigned seed)
+    {
+        std::mt19937 rng(seed);
+        const double half = side / 2 - radius - clearance;
+        std::uniform_real_distribution<double> coordinate(-half, half);
+
+        std::vector<tube_world::Tube> tubes;
+        const double apart = 2 * radius + clearance;
+        for (long attempt = 0; (int(tubes.size()) < count) && (attempt < 100L * count); ++attempt)
+        {
+            const double x = coordinate(rng);
+            const double y = coordinate(rng);
+            if (std::abs(std::sqrt(x * x + y * y) - orbit) < radius + clearance)
+            {
+                continue;
+            }
+
+            bool free = true;
+            for (const auto & tube: tubes)
+            {
+                if (std::pow(tube.x - x, 2) + std::pow(tube.y - y, 2) < apart * apart)
+                {
+                    free = false;
+                    break;
+                }
+            }
+            if (free)
+            {
+                tubes.push_back({x, y, radius});
+            }
+        }
+        return tubes;
+    }
+
+    double percentile(const std::vector<double> & sorted, double fraction)
+    {
+        if (sorted.empty())
+        {
+            return 0.0;
+        }
+        const long rank = std::ceil(fraction * sorted.size());
+        return sorted[std::min<long>(std::max<long>(rank, 1), sorted.size()) - 1];
+    }
+
+    double peakRssMb()
+    {
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0)
+        {
+            return 0.0;
+        }
+        // kilobytes on Linux
+        return usage.ru_maxrss / 1024.0;
+    }
+
+    RunResult runPipeline(const RunParams & params)
+    {
+        using clock = std::chrono::steady_clock;
+
+        RunResult result;
+        result.params = params;
+
+        /*********
+         * Build the world, the robot drives a circle halfway between the middle and the walls
+         * ******/
+        result.side = std::max(2.5, std::sqrt(params.landmarks * AREA_PER_TUBE));
+        const double orbit = result.side / 4;
+        const double clearance = params.robotRadius + 0.1;
+        std::vector<tube_world::Tube> tubes = scatterTubes(params.landmarks, params.tubeRadius, result.side, orbit,
+                                                           clearance, params.seed);
+        std::mt19937 rng(params.seed + 1);
+        std::uniform_real_distribution<double> shrink(1.0 - std::min(std::max(params.radiusSpread, 0.0), 1.0), 1.0);
+        for (auto & tube: tubes)
+        {
+            tube.radius *= shrink(rng);
+        }
+        const tube_world::Walls walls = {result.side, result.side};
+        result.tubes = tubes.size();
+
+        DiffDrive robot(WHEEL_BASE, WHEEL_RADIUS, orbit, 0.0, PI / 2, 0.0, 0.0);
+        const Twist2D command = {params.speed / orbit, params.speed, 0.0};
+        const wheelVel wheels = robot.convertTwist(command);
+        const Twist2D motion = {command.dth * params.period, command.dx * params.period, 0.0};
+        double left = 0.0, right = 0.0;
+
+        std::normal_distribution<double> rangeNoise(0.0, std::max(params.noise, 0.0));
+
+        /*********
+         * Create the filter as the slam node does, a slot for every landmark
+         * ******/
+        colvec robotState = {robot.getTh(), robot.getX(), robot.getY()};
+        colvec mapState(2 * params.landmarks, fill::zeros);
+        mat Q(3, 3, fill::eye);
+        Q *= 0.1;
+        mat R(2, 2, fill::eye);
+        R *= 0.01;
+        slam_library::ExtendedKalman ekf(robotState, mapState, Q, R);
+        const int len = 3 + 2 * params.landmarks;
+
+        std::vector<float> ranges(params.beams);
+        std::vector<double> latencies;
+        latencies.reserve(params.scans);
+        double simulateTotal = 0.0, detectTotal = 0.0, slamTotal = 0.0;
+        uint64_t detections = 0;
+
+        for (int k = 0; (k < params.scans) && (detectTotal + slamTotal < params.budget); ++k)
+        {
+            /*********
+             * Simulate: drive for one period, bump into the tubes and scan
+             * ******/
+            const auto start = clock::now();
+
+            left += wheels.uL * params.period;
+            right += wheels.uR * params.period;
+            robot(left, right);
+            tube_world::resolveCollisions(robot, params.robotRadius, tubes);
+            tube_world::simulateScan(robot.getTh(), robot.getX(), robot.getY(), tubes, walls, params.maxRange, ranges);
+            if (params.noise > 0.0)
+            {
+                for (auto & range: ranges)
+                {
+                    if (range <= params.maxRange)
+                    {
+                        range += rangeNoise(rng);
+                    }
+                }
+            }
+
+            const auto simulated = clock::now();
+
+            /*********
+             * Detect the landmarks as the landmarks node does
+             * ******/
+            std::vector<colvec> measurements;
+            std::vector<double> radii;
+            for (const auto & cluster: circle_fit::ClusterPoints(ranges, params.minRange, params.maxRange))
+            {
+                if (!circle_fit::ClassifyCluster(cluster))
+                {
+                    continue;
+                }
+                visualization_msgs::Marker marker = circle_fit::CircleFit(cluster);
+                if ((marker.id < 0) || (marker.scale.x > 2 * params.tubeRadius))
+                {
+                    continue;
+                }
+                measurements.push_back(slam_library::RangeBearing(marker.pose.position.x, marker.pose.position.y));
+                radii.push_back(marker.scale.x);
+            }
+
+            const auto detected = clock::now();
+
+            /*********
+             * Predict and correct as the slam node does with the real sensor
+             * ******/
+            colvec prevState = ekf.getStateVec();
+            colvec newState = ekf.g(prevState, motion);
+            mat A = ekf.getA(prevState, motion);
+            mat covNew = A * ekf.getCov() * A.t() + ekf.Q_bar();
+            ekf.updateStateVec(newState);
+            ekf.updateCov(covNew);
+
+            for (size_t m = 0; m < measurements.size(); ++m)
+            {
+                const colvec & rangeBearing = measurements[m];
+                const double radius = params.useRadius ? radii[m] : -1.0;
+                const int j = ekf.DataAssociation(rangeBearing, radius);
+                if (j < 1)
+                {
+                    continue;
+                }
+                ekf.updateRadius(j, radius);
+
+                colvec z_hat = ekf.h(j);
+                mat K_j = ekf.KalmanGain(j);
+
+                colvec z_diff = rangeBearing - z_hat;
+                z_diff(1) = normalize_angle(z_diff(1));
+                colvec stateUpdate = ekf.getStateVec() + K_j * z_diff;
+
+                mat Identity(len, len, fill::eye);
+                mat newCov = (Identity - K_j * ekf.getH(j)) * ekf.getCov();
+
+                ekf.updateStateVec(stateUpdate);
+                ekf.updateCov(newCov);
+            }
+
+            const auto corrected = clock::now();
+
+            simulateTotal += seconds(start, simulated);
+            detectTotal += seconds(simulated, detected);
+            slamTotal += seconds(detected, corrected);
+            latencies.push_back(seconds(simulated, corrected));
+            detections += measurements.size();
+        }
+
+        /*********
+         * Summarize
+         * ******/
+        result.scans = latencies.size();
+        if (result.scans > 0)
+        {
+            double total = 0.0;
+            for (double latency: latencies)
+            {
+                total += latency;
+            }
+            std::sort(latencies.begin(), latencies.end());
+
+            result.latencyMean = total / result.scans;
+            result.latencyP50 = percentile(latencies, 0.50);
+            result.latencyP90 = percentile(latencies, 0.90);
+            result.latencyP99 = percentile(latencies, 0.99);
+            result.latencyMax = latencies.back();
+            result.simulateMean = simulateTotal / result.scans;
+            result.detectMean = detectTotal / result.scans;
+            result.slamMean = slamTotal / result.scans;
+            result.scanRate = (total > 0.0) ? result.scans / total : 0.0;
+            result.detections = double(detections) / result.scans;
+
+            uint64_t tested, rejected;
+            ekf.associationStats(tested, rejected);
+            result.mahalanobisTests = double(tested) / result.scans;
+            result.radiusRejected = double(rejected) / result.scans;
+        }
+        result.mapped = ekf.getNumVisited();
+        result.filterMb = (ekf.getStateVec().n_elem + ekf.getCov().n_elem) * sizeof(double) / (1024.0 * 1024.0);
+        result.peakRssMb = peakRssMb();
+        return result;
+    }
+
+    void writeJson(const std::vector<RunResult> & results, std::ostream & out)
+    {
+        const std::ios::fmtflags flags = out.flags();
+        const std::streamsize precision = out.precision(6);
+
+        out << "[\n";
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            const RunResult & r = results[i];
+            out << "  {\"landmarks\": " << r.params.landmarks << ", \"beams\": " << r.params.beams << ", \"speed\": "
+                << r.params.speed << ", \"tubes\": " << r.tubes << ", \"side\": " << r.side << ", \"scans\": "
+                << r.scans << ",\n";
+            out << "   \"latency_ms\": {\"mean\": " << 1e3 * r.latencyMean << ", \"p50\": " << 1e3 * r.latencyP50
+                << ", \"p90\": " << 1e3 * r.latencyP90 << ", \"p99\": " << 1e3 * r.latencyP99 << ", \"max\": "
+                << 1e3 * r.latencyMax << "},\n";
+            out << "   \"stage_ms\": {\"simulate\": " << 1e3 * r.simulateMean << ", \"detect\": " << 1e3 * r.detectMean
+                << ", \"slam\": " << 1e3 * r.slamMean << "},\n";
+            out << "   \"association\": {\"radius\": " << (r.params.useRadius ? "true" : "false")
+                << ", \"radius_spread\": " << r.params.radiusSpread << ", \"mahalanobis_tests\": "
+                << r.mahalanobisTests << ", \"radius_rejected\": " << r.radiusRejected << "},\n";
+            out << "   \"scan_rate\": " << r.scanRate << ", \"detections\": " << r.detections << ", \"mapped\": "
+                << r.mapped << ", \"filter_mb\": " << r.filterMb << ", \"peak_rss_mb\": " << r.peakRssMb << "}"
+                << ((i + 1 < results.size()) ? ",\n" : "\n");
+        }
+        out << "]\n";
+
+        out.precision(precision);
+        out.flags(flags);
+    }
+
+    void writeCsv(const std::vector<RunResult> & results, std::ostream & out, bool header)
+    {
+        if (header)
+        {
+            out << "landmarks,beams,speed,tubes,side,scans,"
+                << "latency_mean_ms,latency_p50_ms,latency_p90_ms,latency_p99_ms,latency_max_ms,"
+                << "simulate_ms,detect_ms,slam_ms,radius,radius_spread,mahalanobis_tests,radius_rejected,"
+                << "scan_rate,detections,mapped,filter_mb,peak_rss_mb\n";
+        }
+
+        const std::ios::fmtflags flags = out.flags();
+        const std::streamsize precision = out.precision(6);
+
+        for (const auto & r: results)
+        {
+            out << r.params.landmarks << "," << r.params.beams << "," << r.params.speed << "," << r.tubes << ","
+                << r.side << "," << r.scans << "," << 1e3 * r.latencyMean << "," << 1e3 * r.latencyP50 << ","
+                << 1e3 * r.latencyP90 << "," << 1e3 * r.latencyP99 << "," << 1e3 * r.latencyMax << ","
+                << 1e3 * r.simulateMean << "," << 1e3 * r.detectMean << "," << 1e3 * r.slamMean << ","
+                << r.params.useRadius << "," << r.params.radiusSpread << "," << r.mahalanobisTests << ","
+                << r.radiusRejected << "," << r.scanRate << "," << r.detections << "," << r.mapped << "," << r.filterMb << ","
+                << r.peakRssMb << "\n";
+        }
+
+        out.precision(precision);
+        out.flags(flags);
+    }
+}
@@ -0,0 +1,220 @@
+/// \file record_log.cpp
+/// \brief contains a node called record_log that records the sensor topics to a compact binary log
+///
+/// PARAMETERS:
+///     log_file (string) : the log to write, replaced if it exists (default sensor.log)
+///     log_lz4 (bool) : compress the chunks with LZ4 when it makes them smaller, if built with LZ4 (default true)
+///     log_chunk_size (int) : bytes of records gathered before a chunk is written (default 262144)
+///     shm_transport (bool) : read the scans through shared memory when the publisher is local (default true)
+///     log_paths (bool) : also record the latest pose of each trajectory, for evaluate_trajectory (default true)
+/// SUBSCRIBES: /scan (sensor_msgs::LaserScan)
+///             /joint_states (sensor_msgs::JointState)
+///             /real_sensor (visualization_msgs::MarkerArray)
+///             /fake_sensor (visualization_msgs::MarkerArray)
+///             /slam_path, /odom_path, /real_path (nav_msgs::Path), when log_paths is true
+///
+/// Each message is appended as a record stamped with its header, the format is described in
+/// sensor_log_library.hpp. The index is written when the node shuts down, a log cut short is still read.
+/// A path is recorded as its newest pose along with the wall clock time it arrived.
+
+#include <ros/ros.h>
+
+#include <nav_msgs/Path.h>
+#include <sensor_msgs/JointState.h>
+#include <sensor_msgs/LaserScan.h>
+#include <visualization_msgs/MarkerArray.h>
+
+#include <tf2/utils.h>
+#include <tf2_geometry_msgs/tf2_geometry_msgs.h>
+
+#include <nuslam/sensor_log_library.hpp>
+#include <rigid2d/shm_transport.hpp>
+
+#include <string>
+#include <vector>
+
+/**********
+ * Declare global variables
+ * *******/
+static sensor_log::LogWriter writer;
+
+/**********
+ * Helper Functions
+ * *******/
+void scanCallback(const sensor_msgs::LaserScan::ConstPtr & msg);
+void jointStateCallback(const sensor_msgs::JointState::ConstPtr & msg);
+void realSensorCallback(const visualization_msgs::MarkerArray::ConstPtr & msg);
+void fakeSensorCallback(const visualization_msgs::MarkerArray::ConstPtr & msg);
+void slamPathCallback(const nav_msgs::Path::ConstPtr & msg);
+void odomPathCallback(const nav_msgs::Path::ConstPtr & msg);
+void realPathCallback(const nav_msgs::Path::ConstPtr & msg);
+void writeLandmarks(const visualization_msgs::MarkerArray & array, sensor_log::RecordType type);
+void writePose(const nav_msgs::Path & path, sensor_log::PoseSource source);
+
+/*********
+ * Main Function
+ * ******/
+int main(int argc, char* argv[])
+{
+    /*********
+     * Initialize the node & node handle
+     * ******/
+    ros::init(argc, argv, "record_log");
+    ros::NodeHandle n;
+
+    /*********
+     * Declare local variables
+     * ******/
+    std::string log_file = "sensor.log";
+    bool lz4 = true;
+    int chunkSize = 262144;
+    bool shm_transport = true;
+    bool log_paths = true;
+
+    int frequency = 100;
+
+    /*********
+     * Read parameters from parameter server
+     * ******/
+    n.getParam("log_file", log_file);
+    n.getParam("log_lz4", lz4);
+    n.getParam("log_chunk_size", chunkSize);
+    n.getParam("shm_transport", shm_transport);
+    n.getParam("log_paths", log_paths);
+
+    std::string error;
+    if (!writer.open(log_file, lz4, chunkSize, error))
+    {
+        ROS_FATAL("record_log: %s", error.c_str());
+        return 1;
+    }
+    if (lz4 && !sensor_log::haveLZ4())
+    {
+        ROS_WARN("record_log: built without LZ4, the chunks are stored uncompressed");
+    }
+    ROS_INFO("record_log: recording to %s", log_file.c_str());
+
+    /*********
+     * Define publishers, subscribers and services
+     ********/
+    rigid2d::ShmSubscriber<sensor_msgs::LaserScan> scan_sub(n, "/scan", frequency, scanCallback, shm_transport);
+    ros::Subscriber joint_sub = n.subscribe("/joint_states", frequency, jointStateCallback);
+    ros::Subscriber sensor_sub = n.subscribe("/real_sensor", frequency, realSensorCallback);
+    ros::Subscriber fake_sensor_sub = n.subscribe("/fake_sensor", frequency, fakeSensorCallback);
+
+    ros::Subscriber slam_path_sub, odom_path_sub, real_path_sub;
+    if (log_paths)
+    {
+        slam_path_sub = n.subscribe("/slam_path", frequency, slamPathCallback);
+        odom_path_sub = n.subscribe("/odom_path", frequency, odomPathCallback);
+        real_path_sub = n.subscribe("/real_path", frequency, realPathCallback);
+    }
+
+    ros::spin();
+
+    if (!writer.close(error))
+    {
+        ROS_ERROR("record_log: %s", error.c_str());
+        return 1;
+    }
+    return 0;
+}
+
+/// \brief callback function for subscriber to the lidar scan
+/// \param msg : the scan
+void scanCallback(const sensor_msgs::LaserScan::ConstPtr & msg)
+{
+    writer.writeScan(msg->header.stamp.toNSec(), msg->angle_min, msg->angle_increment, msg->range_min,
+                     msg->range_max, msg->ranges);
+}
+
+/// \brief callback function for subscriber to the joint states
+/// \param msg : the wheel angles and velocities
+void jointStateCallback(const sensor_msgs::JointState::ConstPtr & msg)
+{
+    writer.writeJoints(msg->header.stamp.toNSec(), msg->position, msg->velocity);
+}
+
+/// \brief callback function for subscriber to the landmarks found in the scan
+/// \param msg : a marker per landmark
+void realSensorCallback(const visualization_msgs::MarkerArray::ConstPtr & msg)
+{
+    writeLandmarks(*msg, sensor_log::RecordType::REAL_LANDMARKS);
+}
+
+/// \brief callback function for subscriber to the landmarks of the simulator
+/// \param msg : a marker per landmark
+void fakeSensorCallback(const visualization_msgs::MarkerArray::ConstPtr & msg)
+{
+    writeLandmarks(*msg, sensor_log::RecordType::FAKE_LANDMARKS);
+}
+
+/// \brief appends the markers that add a landmark, stamped with the first marker or the time received
+/// \param array : the markers
+/// \param type : REAL_LANDMARKS or FAKE_LANDMARKS
+void writeLandmarks(const visualization_msgs::MarkerArray & array, sensor_log::RecordType type)
+{
+    static std::vector<sensor_log::Observation> observations;
+    observations.clear();
+
+    ros::Time stamp = ros::Time::now();
+    if (!array.markers.empty() && !array.markers.front().header.stamp.isZero())
+    {
+        stamp = array.markers.front().header.stamp;
+    }
+
+    for (const auto & marker : array.markers)
+    {
+        if (marker.action != visualization_msgs::Marker::ADD)
+        {
+            continue;
+        }
+        sensor_log::Observation o;
+        o.x = marker.pose.position.x;
+        o.y = marker.pose.position.y;
+        o.radius = 0.5 * marker.scale.x;
+        o.id = marker.id;
+        observations.push_back(o);
+    }
+    writer.writeLandmarks(stamp.toNSec(), type, observations);
+}
+
+/// \brief callback function for subscriber to the trajectory of the slam filter
+/// \param msg : the path so far
+void slamPathCallback(const nav_msgs::Path::ConstPtr & msg)
+{
+    writePose(*msg, sensor_log::PoseSource::SLAM);
+}
+
+/// \brief callback function for subscriber to the trajectory of the wheel odometry
+/// \param msg : the path so far
+void odomPathCallback(const nav_msgs::Path::ConstPtr & msg)
+{
+    writePose(*msg, sensor_log::PoseSource::ODOMETRY);
+}
+
+/// \brief callback function for subscriber to the trajectory of the simulated robot
+/// \param msg : the path so far
+void realPathCallback(const nav_msgs::Path::ConstPtr & msg)
+{
+    writePose(*msg, sensor_log::PoseSource::TRUTH);
+}
+
+/// \brief appends the newest pose of a path, stamped with the path or the time received
+/// The nodes of this workspace publish the heading itself in orientation.z and leave w at 0,
+/// a proper quaternion is converted.
+/// \param path : the path so far
+/// \param source : the trajectory
+void writePose(const nav_msgs::Path & path, sensor_log::PoseSource source)
+{
+    if (path.poses.empty())
+    {
+        return;
+    }
+
+    ros::Time stamp = path.header.stamp.isZero() ? ros::Time::now() : path.header.stamp;
+    const geometry_msgs::Pose & pose = path.poses.back().pose;
+    const double th = (pose.orientation.w == 0.0) ? pose.orientation.z : tf2::getYaw(pose.orientation);
+
+    writer.writePose(stamp.toNSec(), source, ros::WallTime::now().toNSec(), th, pose.position.x, pose.position.y);
+}
@@ -0,0 +1,303 @@
+/// \file relocalization_library.cpp
+/// \brief a library that finds the pose of the robot from a single scan of landmarks with geometric hashing
+
+#include "nuslam/relocalization_library.hpp"
+#include "rigid2d/rigid2d.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace relocalization
+{
+    /// \brief the side lengths of a triangle, side i opposite vertex i
+    static std::array<double, 3> sides(const std::array<double, 3> & x, const std::array<double, 3> & y)
+    {
+        return {std::hypot(x[1] - x[2], y[1] - y[2]),
+                std::hypot(x[0] - x[2], y[0] - y[2]),
+                std::hypot(x[0] - x[1], y[0] - y[1])};
+    }
+
+    /// \brief true if the vertices of a triangle are counter clockwise
+    static bool counterClockwise(const std::array<double, 3> & x, const std::array<double, 3> & y)
+    {
+        return (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]) > 0.0;
+    }
+
+    Relocalizer::Relocalizer()
+        : Relocalizer(std::vector<double>(), 2.0, 0.05, 100)
+    {
+    }
+
+    Relocalizer::Relocalizer(const std::vector<double> & mapState, double maxSide, double inlierDistance,
+                             int maxSamples, unsigned int seed)
+        : entries(0), binSize(inlierDistance), inlierDist(inlierDistance), maxSideLength(maxSide), maxTriplets(maxSamples), gen(seed)
+    {
+        for (int i = 0; i + 1 < int(mapState.size()); i += 2)
+        {
+            addLandmark(mapState[i], mapState[i + 1]);
+        }
+    }
+
+    void Relocalizer::addLandmark(double x, double y)
+    {
+        const int k = lx.size();
+        lx.push_back(x);
+        ly.push_back(y);
+
+        const double tol = inlierDist;
+        const std::array<std::array<int, 3>, 6> orders = {{{0, 1, 2}, {0, 2, 1}, {1, 0, 2}, {1, 2, 0}, {2, 0, 1}, {2, 1, 0}}};
+
+        // the triangles without the new landmark are already in the table
+        for (int i = 0; i < k; ++i)
+        {
+            for (int j = i + 1; j < k; ++j)
+            {
+                const std::array<int, 3> ids = {i, j, k};
+                const std::array<double, 3> tx = {lx[i], lx[j], lx[k]};
+                const std::array<double, 3> ty = {ly[i], ly[j], ly[k]};
+                const std::array<double, 3> s = sides(tx, ty);
+
+                if (*std::max_element(s.begin(), s.end()) > maxSideLength)
+                {
+                    continue;
+                }
+
+                // every vertex order a noisy observation could sort into, so near isosceles triangles still match
+                for (const auto & o: orders)
+                {
+                    if ((s[o[0]] > s[o[1]] + 2.0 * tol) || (s[o[1]] > s[o[2]] + 2.0 * tol))
+                    {
+                        continue;
+                    }
+
+                    const std::array<double, 3> ox = {tx[o[0]], tx[o[1]], tx[o[2]]};
+                    const std::array<double, 3> oy = {ty[o[0]], ty[o[1]], ty[o[2]]};
+                    const bool ccw = counterClockwise(ox, oy);
+                    const Triplet t = {ids[o[0]], ids[o[1]], ids[o[2]]};
+
+                    // store the triangle in every bin a measurement within tol could fall into
+                    for (int64_t q0 = std::floor((s[o[0]] - tol) / binSize); q0 <= std::floor((s[o[0]] + tol) / binSize); ++q0)
+                    {
+                        for (int64_t q1 = std::floor((s[o[1]] - tol) / binSize); q1 <= std::floor((s[o[1]] + tol) / binSize); ++q1)
+                        {
+                            for (int64_t q2 = std::floor((s[o[2]] - tol) / binSize); q2 <= std::floor((s[o[2]] + tol) / binSize); ++q2)
+                            {
+                                table[key(q0, q1, q2, ccw)].push_back(t);
+                                ++entries;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    uint64_t Relocalizer::key(int64_t q0, int64_t q1, int64_t q2, bool ccw)
+    {
+        return ((uint64_t(q0) & 0xFFFFF) << 41) | ((uint64_t(q1) & 0xFFFFF) << 21) | ((uint64_t(q2) & 0xFFFFF) << 1) | uint64_t(ccw);
+    }
+
+    int Relocalizer::size() const
+    {
+        return lx.size();
+    }
+
+    int Relocalizer::tableSize() const
+    {
+        return entries;
+    }
+
+    void Relocalizer::align(const std::vector<double> & ox, const std::vector<double> & oy,
+                            const std::vector<double> & mx, const std::vector<double> & my,
+                            PoseHypothesis & hyp)
+    {
+        const int n = ox.size();
+        double ocx = 0.0, ocy = 0.0, mcx = 0.0, mcy = 0.0;
+        for (int i = 0; i < n; ++i)
+        {
+            ocx += ox[i];
+            ocy += oy[i];
+            mcx += mx[i];
+            mcy += my[i];
+        }
+        ocx /= n;
+        ocy /= n;
+        mcx /= n;
+        mcy /= n;
+
+        double sDot = 0.0, sCross = 0.0;
+        for (int i = 0; i < n; ++i)
+        {
+            double ax = ox[i] - ocx, ay = oy[i] - ocy;
+            double bx = mx[i] - mcx, by = my[i] - mcy;
+            sDot += ax * bx + ay * by;
+            sCross += ax * by - ay * bx;
+        }
+
+        hyp.th = std::atan2(sCross, sDot);
+        hyp.x = mcx - (std::cos(hyp.th) * ocx - std::sin(hyp.th) * ocy);
+        hyp.y = mcy - (std::sin(hyp.th) * ocx + std::cos(hyp.th) * ocy);
+    }
+
+    void Relocalizer::verify(const std::vector<double> & px, const std::vector<double> & py, PoseHypothesis & hyp) const
+    {
+        std::vector<double> ox, oy, mx, my;
+        std::vector<bool> used(lx.size(), false);
+        hyp.matches.clear();
+        const double c = std::cos(hyp.th), s = std::sin(hyp.th);
+
+        for (int i = 0; i < int(px.size()); ++i)
+        {
+            double wx = hyp.x + c * px[i] - s * py[i];
+            double wy = hyp.y + s * px[i] + c * py[i];
+
+            int best = -1;
+            double bestDist = inlierDist;
+            for (int j = 0; j < int(lx.size()); ++j)
+            {
+                double d = std::hypot(lx[j] - wx, ly[j] - wy);
+                if (!used[j] && (d < bestDist))
+                {
+                    best = j;
+                    bestDist = d;
+                }
+            }
+
+            if (best >= 0)
+            {
+                used[best] = true;
+                hyp.matches.emplace_back(i, best);
+                ox.push_back(px[i]);
+                oy.push_back(py[i]);
+                mx.push_back(lx[best]);
+                my.push_back(ly[best]);
+            }
+        }
+
+        hyp.inliers = ox.size();
+        if (hyp.inliers < 3)
+        {
+            return;
+        }
+
+        // refine with every match and measure how well they agree
+        align(ox, oy, mx, my, hyp);
+
+        const double rc = std::cos(hyp.th), rs = std::sin(hyp.th);
+        double sum = 0.0;
+        for (int i = 0; i < hyp.inliers; ++i)
+        {
+            double wx = hyp.x + rc * ox[i] - rs * oy[i];
+            double wy = hyp.y + rs * ox[i] + rc * oy[i];
+            sum += std::pow(wx - mx[i], 2) + std::pow(wy - my[i], 2);
+        }
+        hyp.rms = std::sqrt(sum / hyp.inliers);
+    }
+
+    PoseHypothesis Relocalizer::relocalize(const std::vector<double> & points)
+    {
+        PoseHypothesis result;
+
+        std::vector<double> px, py;
+        for (int i = 0; i + 1 < int(points.size()); i += 2)
+        {
+            px.push_back(points[i]);
+            py.push_back(points[i + 1]);
+        }
+
+        const int k = px.size();
+        if (k < 3)
+        {
+            return result;
+        }
+
+        // every observed triplet if there are few enough, random ones otherwise
+        std::vector<std::array<int, 3>> samples;
+        const long total = long(k) * (k - 1) * (k - 2) / 6;
+        if (total <= maxTriplets)
+        {
+            for (int i = 0; i < k; ++i)
+            {
+                for (int j = i + 1; j < k; ++j)
+                {
+                    for (int l = j + 1; l < k; ++l)
+                    {
+                        samples.push_back({i, j, l});
+                    }
+                }
+            }
+        } else
+        {
+            std::uniform_int_distribution<> pick(0, k - 1);
+            while (int(samples.size()) < maxTriplets)
+            {
+                int i = pick(gen), j = pick(gen), l = pick(gen);
+                if ((i != j) && (j != l) && (i != l))
+                {
+                    samples.push_back({i, j, l});
+                }
+            }
+        }
+
+        std::vector<PoseHypothesis> verified;
+        for (const auto & sample: samples)
+        {
+            std::array<double, 3> x = {px[sample[0]], px[sample[1]], px[sample[2]]};
+            std::array<double, 3> y = {py[sample[0]], py[sample[1]], py[sample[2]]};
+            std::array<double, 3> s = sides(x, y);
+
+            // order the vertices by their opposite side, as in the table
+            std::array<int, 3> o = {0, 1, 2};
+            std::sort(o.begin(), o.end(), [&s](int a, int b) { return s[a] < s[b]; });
+
+            const std::array<double, 3> ox = {x[o[0]], x[o[1]], x[o[2]]};
+            const std::array<double, 3> oy = {y[o[0]], y[o[1]], y[o[2]]};
+
+            auto found = table.find(key(std::floor(s[o[0]] / binSize), std::floor(s[o[1]] / binSize),
+                                        std::floor(s[o[2]] / binSize), counterClockwise(ox, oy)));
+            if (found == table.end())
+            {
+                continue;
+            }
+
+            for (const auto & t: found->second)
+            {
+                PoseHypothesis hyp;
+                align({ox[0], ox[1], ox[2]}, {oy[0], oy[1], oy[2]},
+                      {lx[t.a], lx[t.b], lx[t.c]}, {ly[t.a], ly[t.b], ly[t.c]}, hyp);
+
+                verify(px, py, hyp);
+                if (hyp.inliers >= 3)
+                {
+                    verified.push_back(hyp);
+                }
+            }
+        }
+
+        if (verified.empty())
+        {
+            return result;
+        }
+
+        // the most inliers wins, then the tightest fit
+        auto better = [](const PoseHypothesis & a, const PoseHypothesis & b)
+        {
+            return (a.inliers > b.inliers) || ((a.inliers == b.inliers) && (a.rms < b.rms));
+        };
+        result = *std::min_element(verified.begin(), verified.end(), better);
+        result.found = true;
+
+        // a different pose that explains as many landmarks makes the scan ambiguous
+        for (const auto & hyp: verified)
+        {
+            bool samePose = (std::hypot(hyp.x - result.x, hyp.y - result.y) < inlierDist) &&
+                            (std::fabs(rigid2d::normalize_angle(hyp.th - result.th)) < 0.1);
+            if ((hyp.inliers == result.inliers) && !samePose)
+            {
+                result.ambiguous = true;
+                break;
+            }
+        }
+        return result;
+    }
+}
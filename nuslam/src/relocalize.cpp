@@ -0,0 +1,151 @@
+/// \file relocalize.cpp
+/// \brief contains a node called relocalize that finds the pose of the robot in the tube map from the
+/// latest scan of fitted circles and seeds the slam node with it through set_pose
+///
+/// PARAMETERS:
+///     tube1_location ... tube6_location : the (x,y) locations of each tube / landmark
+///     relocalize_max_side (double) : the longest landmark triangle stored, about twice the sensor range (default 2.0)
+///     relocalize_inlier_distance (double) : the largest error of a fitted circle center (default 0.1)
+///     relocalize_max_samples (int) : the most triplets of circles tried per request (default 200)
+/// SUBSCRIBES: /real_sensor (visualization_msgs::MarkerArray)
+/// SERVICES: relocalize (std_srvs::Trigger) : finds the pose and, if it is unique, calls set_pose
+/// CLIENTS: set_pose (rigid2d::set_pose)
+
+#include <ros/ros.h>
+
+#include <rigid2d/set_pose.h>
+#include <std_srvs/Trigger.h>
+
+#include <visualization_msgs/MarkerArray.h>
+
+#include <nuslam/relocalization_library.hpp>
+
+#include <string>
+#include <vector>
+
+/**********
+ * Declare global variables
+ * *******/
+static relocalization::Relocalizer relocalizer;
+static ros::ServiceClient setPose_client;
+static visualization_msgs::MarkerArray::ConstPtr marker_array;
+
+/**********
+ * Helper Functions
+ * *******/
+void sensorCallback(const visualization_msgs::MarkerArray::ConstPtr & array);
+bool relocalize(std_srvs::Trigger::Request & req, std_srvs::Trigger::Response & res);
+
+/*********
+ * Main Function
+ * ******/
+int main(int argc, char* argv[])
+{
+    /*********
+     * Initialize the node & node handle
+     * ******/
+    ros::init(argc, argv, "relocalize");
+    ros::NodeHandle n;
+
+    /*********
+     * Read parameters from parameter server
+     * ******/
+    std::vector<double> tube1_loc, tube2_loc, tube3_loc, tube4_loc, tube5_loc, tube6_loc;
+    double maxSide = 2.0, inlierDistance = 0.1;
+    int maxSamples = 200;
+    int frequency = 10;
+
+    n.getParam("tube1_location", tube1_loc);
+    n.getParam("tube2_location", tube2_loc);
+    n.getParam("tube3_location", tube3_loc);
+    n.getParam("tube4_location", tube4_loc);
+    n.getParam("tube5_location", tube5_loc);
+    n.getParam("tube6_location", tube6_loc);
+    n.getParam("relocalize_max_side", maxSide);
+    n.getParam("relocalize_inlier_distance", inlierDistance);
+    n.getParam("relocalize_max_samples", maxSamples);
+
+    std::vector<double> mapState;
+    for (auto tube: {&tube1_loc, &tube2_loc, &tube3_loc, &tube4_loc, &tube5_loc, &tube6_loc})
+    {
+        if (tube->size() == 2)
+        {
+            mapState.push_back((*tube)[0]);
+            mapState.push_back((*tube)[1]);
+        }
+    }
+
+    relocalizer = relocalization::Relocalizer(mapState, maxSide, inlierDistance, maxSamples);
+
+    /*********
+     * Define subscribers, services and clients
+     ********/
+    ros::Subscriber sensor_sub = n.subscribe("/real_sensor", frequency, sensorCallback);
+    ros::ServiceServer relocalize_service = n.advertiseService("relocalize", relocalize);
+    setPose_client = n.serviceClient<rigid2d::set_pose>("set_pose");
+
+    ros::spin();
+    return 0;
+}
+
+/// \brief callback function for subscriber to the sensor message
+/// \param array : the fitted circles, relative to the robot
+void sensorCallback(const visualization_msgs::MarkerArray::ConstPtr & array)
+{
+    marker_array = array;
+}
+
+/// \brief relocalize function for relocalize service
+/// Matches the latest scan against the map and sends the pose to set_pose
+/// \param res : The service response, success is false if no unique pose was found
+/// \return true
+bool relocalize(std_srvs::Trigger::Request &, std_srvs::Trigger::Response & res)
+{
+    if (!marker_array)
+    {
+        res.success = false;
+        res.message = "no scan received";
+        return true;
+    }
+
+    std::vector<double> points;
+    for (const auto & marker: marker_array->markers)
+    {
+        points.push_back(marker.pose.position.x);
+        points.push_back(marker.pose.position.y);
+    }
+
+    relocalization::PoseHypothesis pose = relocalizer.relocalize(points);
+
+    if (!pose.found)
+    {
+        res.success = false;
+        res.message = "no pose explains three landmarks of the scan";
+        return true;
+    }
+
+    if (pose.ambiguous)
+    {
+        res.success = false;
+        res.message = "the scan matches more than one pose, move the robot and try again";
+        return true;
+    }
+
+    rigid2d::set_pose srv;
+    srv.request.x = pose.x;
+    srv.request.y = pose.y;
+    srv.request.th = pose.th;
+
+    if (!setPose_client.call(srv))
+    {
+        res.success = false;
+        res.message = "set_pose failed";
+        return true;
+    }
+
+    ROS_INFO("relocalize: x %f y %f th %f from %d landmarks (rms %f)", pose.x, pose.y, pose.th, pose.inliers, pose.rms);
+
+    res.success = true;
+    res.message = "relocalized";
+    return true;
+}
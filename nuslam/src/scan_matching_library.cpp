@@ -0,0 +1,603 @@
+/// \file scan_matching_library.cpp
+/// \brief a library that aligns laser scans with point-to-line ICP and a correlative search
+
+#include "nuslam/scan_matching_library.hpp"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace scan_matching
+{
+    /// \brief solves the symmetric 3x3 system A x = b with a Cholesky factorization
+    /// \return false if A is not positive definite enough to trust, relative to its diagonal
+    static bool solve3(const double A[9], const double b[3], double x[3])
+    {
+        const double scale = std::max({A[0], A[4], A[8], 1e-12});
+
+        double l00 = A[0];
+        if (l00 <= 1e-9 * scale)
+        {
+            return false;
+        }
+        l00 = std::sqrt(l00);
+        double l10 = A[3] / l00;
+        double l20 = A[6] / l00;
+
+        double l11 = A[4] - l10 * l10;
+        if (l11 <= 1e-9 * scale)
+        {
+            return false;
+        }
+        l11 = std::sqrt(l11);
+        double l21 = (A[7] - l20 * l10) / l11;
+
+        double l22 = A[8] - l20 * l20 - l21 * l21;
+        if (l22 <= 1e-9 * scale)
+        {
+            return false;
+        }
+        l22 = std::sqrt(l22);
+
+        // L y = b, then L^T x = y
+        double y0 = b[0] / l00;
+        double y1 = (b[1] - l10 * y0) / l11;
+        double y2 = (b[2] - l20 * y0 - l21 * y1) / l22;
+
+        x[2] = y2 / l22;
+        x[1] = (y1 - l21 * x[2]) / l11;
+        x[0] = (y0 - l10 * x[1] - l20 * x[2]) / l00;
+        return true;
+    }
+
+    /// \brief converts the valid ranges of a scan to points
+    /// \param valid - if given, the points are indexed by beam and valid marks the beams with a point
+    static void toPoints(double angleMin, double angleIncrement, const std::vector<float> & ranges,
+                         double rangeMin, double rangeMax, std::vector<double> & xs, std::vector<double> & ys,
+                         std::vector<uint8_t> * valid)
+    {
+        const int n = ranges.size();
+        xs.clear();
+        ys.clear();
+        if (valid)
+        {
+            valid->assign(n, 0);
+            xs.resize(n, 0.0);
+            ys.resize(n, 0.0);
+        }
+
+        for (int i = 0; i < n; ++i)
+        {
+            // nan compares false, so it is dropped along with the out of range beams
+            if (!((ranges[i] >= rangeMin) && (ranges[i] < rangeMax)))
+            {
+                continue;
+            }
+
+            double a = angleMin + i * angleIncrement;
+            double px = ranges[i] * std::cos(a), py = ranges[i] * std::sin(a);
+            if (valid)
+            {
+                xs[i] = px;
+                ys[i] = py;
+                (*valid)[i] = 1;
+            } else
+            {
+                xs.push_back(px);
+                ys.push_back(py);
+            }
+        }
+    }
+
+    IcpMatcher::IcpMatcher()
+        : IcpMatcher(IcpParams())
+    {
+    }
+
+    IcpMatcher::IcpMatcher(const IcpParams & icpParams)
+        : params(icpParams), refAngleMin(0.0), refIncrement(0.0), refWraps(false)
+    {
+    }
+
+    void IcpMatcher::setReference(double angleMin, double angleIncrement, const std::vector<float> & ranges,
+                                  double rangeMin, double rangeMax)
+    {
+        const int n = ranges.size();
+        refAngleMin = angleMin;
+        refIncrement = angleIncrement;
+        refWraps = std::fabs(n * angleIncrement) >= 2.0 * M_PI - 1e-6;
+
+        std::vector<uint8_t> hasPoint;
+        toPoints(angleMin, angleIncrement, ranges, rangeMin, rangeMax, refX, refY, &hasPoint);
+
+        // the line at each point is along its two neighbors, when they are close enough to be the same surface,
+        // and only points with a line are matched against
+        refNx.assign(n, 0.0);
+        refNy.assign(n, 0.0);
+        refValid.assign(n, 0);
+        const double maxGap2 = params.maxNeighborGap * params.maxNeighborGap;
+        for (int i = 0; i < n; ++i)
+        {
+            int prev = i - 1, next = i + 1;
+            if (refWraps)
+            {
+                prev = (prev + n) % n;
+                next = next % n;
+            }
+            if (!hasPoint[i] || (prev < 0) || (next >= n) || !hasPoint[prev] || !hasPoint[next])
+            {
+                continue;
+            }
+
+            double gap1 = std::pow(refX[i] - refX[prev], 2) + std::pow(refY[i] - refY[prev], 2);
+            double gap2 = std::pow(refX[next] - refX[i], 2) + std::pow(refY[next] - refY[i], 2);
+            double tx = refX[next] - refX[prev], ty = refY[next] - refY[prev];
+            double len = std::sqrt(tx * tx + ty * ty);
+            if ((gap1 > maxGap2) || (gap2 > maxGap2) || (len < 1e-9))
+            {
+                continue;
+            }
+            refNx[i] = -ty / len;
+            refNy[i] = tx / len;
+            refValid[i] = 1;
+        }
+    }
+
+    bool IcpMatcher::hasReference() const
+    {
+        return !refValid.empty();
+    }
+
+    IcpResult IcpMatcher::match(double angleMin, double angleIncrement, const std::vector<float> & ranges,
+                                double rangeMin, double rangeMax, double x0, double y0, double th0)
+    {
+        IcpResult result;
+        result.x = x0;
+        result.y = y0;
+        result.th = th0;
+        if (!hasReference())
+        {
+            return result;
+        }
+
+        toPoints(angleMin, angleIncrement, ranges, rangeMin, rangeMax, curX, curY, nullptr);
+
+        const int n = refValid.size();
+        const int m = curX.size();
+        const double invIncrement = 1.0 / refIncrement;
+        double gate = params.maxCorrespondence;
+
+        double A[9], b[3];
+        double sumSq = 0.0;
+        int count = 0;
+
+        for (int iter = 0; iter < params.maxIterations; ++iter)
+        {
+            const double c = std::cos(result.th), s = std::sin(result.th);
+            const double gate2 = gate * gate;
+
+            std::fill(A, A + 9, 0.0);
+            std::fill(b, b + 3, 0.0);
+            sumSq = 0.0;
+            count = 0;
+
+            for (int i = 0; i < m; ++i)
+            {
+                // the point in the reference frame
+                const double px = c * curX[i] - s * curY[i] + result.x;
+                const double py = s * curX[i] + c * curY[i] + result.y;
+
+                // projective search: the reference beam with the same bearing and its neighbors
+                int center = int(std::lround((std::atan2(py, px) - refAngleMin) * invIncrement));
+                int best = -1;
+                double bestD2 = gate2;
+                for (int k = -params.searchWindow; k <= params.searchWindow; ++k)
+                {
+                    int j = center + k;
+                    if (refWraps)
+                    {
+                        j = ((j % n) + n) % n;
+                    } else if ((j < 0) || (j >= n))
+                    {
+                        continue;
+                    }
+                    if (!refValid[j])
+                    {
+                        continue;
+                    }
+
+                    double d2 = (px - refX[j]) * (px - refX[j]) + (py - refY[j]) * (py - refY[j]);
+                    if (d2 < bestD2)
+                    {
+                        bestD2 = d2;
+                        best = j;
+                    }
+                }
+                if (best < 0)
+                {
+                    continue;
+                }
+
+                // residual along the normal, and its derivative wrt (x, y, th)
+                const double nx = refNx[best], ny = refNy[best];
+                const double r = nx * (px - refX[best]) + ny * (py - refY[best]);
+                const double jth = nx * (-(py - result.y)) + ny * (px - result.x);
+
+                A[0] += nx * nx;
+                A[1] += nx * ny;
+                A[2] += nx * jth;
+                A[4] += ny * ny;
+                A[5] += ny * jth;
+                A[8] += jth * jth;
+                b[0] -= nx * r;
+                b[1] -= ny * r;
+                b[2] -= jth * r;
+
+                sumSq += r * r;
+                ++count;
+            }
+            A[3] = A[1];
+            A[6] = A[2];
+            A[7] = A[5];
+
+            result.iterations = iter + 1;
+            result.correspondences = count;
+            if (count < params.minCorrespondences)
+            {
+                return result;
+            }
+
+            double delta[3];
+            if (!solve3(A, b, delta))
+            {
+                return result;
+            }
+
+            result.x += delta[0];
+            result.y += delta[1];
+            result.th += delta[2];
+
+            // the matches get stricter as the scans line up
+            result.rms = std::sqrt(sumSq / count);
+            gate = std::max(params.minCorrespondence, std::min(gate, 3.0 * result.rms));
+
+            if ((std::hypot(delta[0], delta[1]) < params.translationEpsilon) &&
+                (std::fabs(delta[2]) < params.rotationEpsilon))
+            {
+                result.converged = true;
+                break;
+            }
+        }
+
+        if (!result.converged)
+        {
+            return result;
+        }
+
+        // covariance = sigma^2 (J^T J)^-1, with J^T J from the last iteration, columns solved one at a time
+        const double sigma2 = sumSq / std::max(1, count - 3);
+        double inv[9];
+        for (int col = 0; col < 3; ++col)
+        {
+            double e[3] = {0.0, 0.0, 0.0}, x[3];
+            e[col] = 1.0;
+            solve3(A, e, x);
+            inv[col] = x[0];
+            inv[3 + col] = x[1];
+            inv[6 + col] = x[2];
+        }
+
+        // reorder (x, y, th) to (th, x, y)
+        const int order[3] = {2, 0, 1};
+        for (int r = 0; r < 3; ++r)
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                result.cov[3 * r + c] = sigma2 * inv[3 * order[r] + order[c]];
+            }
+        }
+        return result;
+    }
+
+    CorrelativeMatcher::CorrelativeMatcher()
+        : CorrelativeMatcher(CorrelativeParams())
+    {
+    }
+
+    CorrelativeMatcher::CorrelativeMatcher(const CorrelativeParams & correlativeParams)
+        : params(correlativeParams), fieldsStale(true), width(0), height(0), originX(0.0), originY(0.0)
+    {
+        params.levels = std::max(1, params.levels);
+
+        // the Gaussian around a point, out to three standard deviations
+        kernelRadius = int(std::ceil(3.0 * params.sigma / params.resolution));
+        const int side = 2 * kernelRadius + 1;
+        kernel.resize(side * side);
+        for (int dy = -kernelRadius; dy <= kernelRadius; ++dy)
+        {
+            for (int dx = -kernelRadius; dx <= kernelRadius; ++dx)
+            {
+                double d2 = (dx * dx + dy * dy) * params.resolution * params.resolution;
+                kernel[(dy + kernelRadius) * side + dx + kernelRadius] =
+                    float(std::exp(-d2 / (2.0 * params.sigma * params.sigma)));
+            }
+        }
+    }
+
+    void CorrelativeMatcher::clearReference()
+    {
+        refX.clear();
+        refY.clear();
+        fieldsStale = true;
+    }
+
+    void CorrelativeMatcher::addReference(double angleMin, double angleIncrement, const std::vector<float> & ranges,
+                                          double rangeMin, double rangeMax, double x, double y, double th)
+    {
+        std::vector<double> xs, ys;
+        toPoints(angleMin, angleIncrement, ranges, rangeMin, rangeMax, xs, ys, nullptr);
+
+        const double c = std::cos(th), s = std::sin(th);
+        for (unsigned int i = 0; i < xs.size(); ++i)
+        {
+            refX.push_back(c * xs[i] - s * ys[i] + x);
+            refY.push_back(s * xs[i] + c * ys[i] + y);
+        }
+        fieldsStale = true;
+    }
+
+    int CorrelativeMatcher::numReferencePoints() const
+    {
+        return refX.size();
+    }
+
+    void CorrelativeMatcher::buildFields()
+    {
+        fieldsStale = false;
+        fields.assign(params.levels, std::vector<float>());
+        if (refX.empty())
+        {
+            width = 0;
+            height = 0;
+            return;
+        }
+
+        // the bounding box of the points, with room for the kernel
+        const double margin = (kernelRadius + 1) * params.resolution;
+        originX = *std::min_element(refX.begin(), refX.end()) - margin;
+        originY = *std::min_element(refY.begin(), refY.end()) - margin;
+        width = int(std::ceil((*std::max_element(refX.begin(), refX.end()) + margin - originX) / params.resolution)) + 1;
+        height = int(std::ceil((*std::max_element(refY.begin(), refY.end()) + margin - originY) / params.resolution)) + 1;
+
+        // the finest field, the largest kernel value over all points
+        std::vector<float> & finest = fields[0];
+        finest.assign(width * height, 0.0f);
+        const int side = 2 * kernelRadius + 1;
+        for (unsigned int p = 0; p < refX.size(); ++p)
+        {
+            int px = int(std::floor((refX[p] - originX) / params.resolution));
+            int py = int(std::floor((refY[p] - originY) / params.resolution));
+            for (int dy = -kernelRadius; dy <= kernelRadius; ++dy)
+            {
+                float * row = &finest[(py + dy) * width + px];
+                const float * k = &kernel[(dy + kernelRadius) * side + kernelRadius];
+                for (int dx = -kernelRadius; dx <= kernelRadius; ++dx)
+                {
+                    row[dx] = std::max(row[dx], k[dx]);
+                }
+            }
+        }
+
+        // level k is the maximum over the 2^k square starting at each cell, built from two squares of level k - 1
+        for (int level = 1; level < params.levels; ++level)
+        {
+            const std::vector<float> & prev = fields[level - 1];
+            std::vector<float> & field = fields[level];
+            field.assign(width * height, 0.0f);
+
+            const int half = 1 << (level - 1);
+            for (int y = 0; y < height; ++y)
+            {
+                for (int x = 0; x < width; ++x)
+                {
+                    float v = prev[y * width + x];
+                    if (x + half < width)
+                    {
+                        v = std::max(v, prev[y * width + x + half]);
+                    }
+                    if (y + half < height)
+                    {
+                        v = std::max(v, prev[(y + half) * width + x]);
+                        if (x + half < width)
+                        {
+                            v = std::max(v, prev[(y + half) * width + x + half]);
+                        }
+                    }
+                    field[y * width + x] = v;
+                }
+            }
+        }
+    }
+
+    float CorrelativeMatcher::score(int level, const std::vector<int> & cx, const std::vector<int> & cy,
+                                    int i, int j) const
+    {
+        const std::vector<float> & field = fields[level];
+        const int n = cx.size();
+        float sum = 0.0f;
+        for (int p = 0; p < n; ++p)
+        {
+            // a square that starts left of or below the field still reaches into it
+            const int size = 1 << level;
+            int x = cx[p] + i, y = cy[p] + j;
+            if ((x + size <= 0) || (y + size <= 0) || (x >= width) || (y >= height))
+            {
+                continue;
+            }
+            sum += field[std::max(y, 0) * width + std::max(x, 0)];
+        }
+        return sum / n;
+    }
+
+    bool CorrelativeMatcher::searchRotation(const std::vector<int> & cx, const std::vector<int> & cy, int window,
+                                            float & best, int & bestI, int & bestJ) const
+    {
+        struct Candidate
+        {
+            int level, i, j;
+            float score;
+        };
+
+        // the coarsest squares that cover the window
+        const int top = params.levels - 1;
+        std::vector<Candidate> stack;
+        for (int i = -window; i <= window; i += (1 << top))
+        {
+            for (int j = -window; j <= window; j += (1 << top))
+            {
+                stack.push_back({top, i, j, score(top, cx, cy, i, j)});
+            }
+        }
+        std::sort(stack.begin(), stack.end(), [](const Candidate & a, const Candidate & b) { return a.score < b.score; });
+
+        // depth first, best candidate on top of the stack
+        bool improved = false;
+        std::vector<Candidate> children;
+        while (!stack.empty())
+        {
+            Candidate candidate = stack.back();
+            stack.pop_back();
+            if (candidate.score <= best)
+            {
+                continue;
+            }
+
+            if (candidate.level == 0)
+            {
+                best = candidate.score;
+                bestI = candidate.i;
+                bestJ = candidate.j;
+                improved = true;
+                continue;
+            }
+
+            // the four squares of the next level down, inside the window
+            const int level = candidate.level - 1, half = 1 << level;
+            children.clear();
+            for (int di: {0, half})
+            {
+                for (int dj: {0, half})
+                {
+                    int i = candidate.i + di, j = candidate.j + dj;
+                    if ((i > window) || (j > window))
+                    {
+                        continue;
+                    }
+                    float bound = score(level, cx, cy, i, j);
+                    if (bound > best)
+                    {
+                        children.push_back({level, i, j, bound});
+                    }
+                }
+            }
+            std::sort(children.begin(), children.end(),
+                      [](const Candidate & a, const Candidate & b) { return a.score < b.score; });
+            stack.insert(stack.end(), children.begin(), children.end());
+        }
+        return improved;
+    }
+
+    CorrelativeResult CorrelativeMatcher::match(double angleMin, double angleIncrement,
+                                                const std::vector<float> & ranges, double rangeMin, double rangeMax,
+                                                double x0, double y0, double th0)
+    {
+        CorrelativeResult result;
+        result.x = x0;
+        result.y = y0;
+        result.th = th0;
+
+        if (fieldsStale)
+        {
+            buildFields();
+        }
+        toPoints(angleMin, angleIncrement, ranges, rangeMin, rangeMax, curX, curY, nullptr);
+        if ((width == 0) || curX.empty())
+        {
+            return result;
+        }
+
+        // a rotation step that moves the furthest point by about one cell
+        double reach = 0.0;
+        for (unsigned int p = 0; p < curX.size(); ++p)
+        {
+            reach = std::max(reach, std::hypot(curX[p], curY[p]));
+        }
+        double step = std::acos(std::max(-1.0, 1.0 - std::pow(params.resolution / std::max(reach, params.resolution), 2) / 2.0));
+        step = std::max(1e-3, std::min(step, std::max(params.angularWindow, 1e-3)));
+        const int slices = int(std::ceil(params.angularWindow / step));
+        const int rotations = 2 * slices + 1;
+        const int window = int(std::ceil(params.linearWindow / params.resolution));
+
+        // each thread searches every threads-th rotation, with its own best score to prune against
+        const int threads = std::max(1, std::min(params.threads, rotations));
+        std::vector<float> bestScore(threads, float(params.minScore));
+        std::vector<int> bestRotation(threads, -1), bestI(threads, 0), bestJ(threads, 0);
+
+        auto search = [&](int t)
+        {
+            const int n = curX.size();
+            std::vector<int> cx(n), cy(n);
+            for (int r = t; r < rotations; r += threads)
+            {
+                const double th = th0 + (r - slices) * step;
+                const double c = std::cos(th), s = std::sin(th);
+                for (int p = 0; p < n; ++p)
+                {
+                    cx[p] = int(std::floor((c * curX[p] - s * curY[p] + x0 - originX) / params.resolution));
+                    cy[p] = int(std::floor((s * curX[p] + c * curY[p] + y0 - originY) / params.resolution));
+                }
+                if (searchRotation(cx, cy, window, bestScore[t], bestI[t], bestJ[t]))
+                {
+                    bestRotation[t] = r;
+                }
+            }
+        };
+
+        if (threads == 1)
+        {
+            search(0);
+        } else
+        {
+            std::vector<std::thread> workers;
+            for (int t = 1; t < threads; ++t)
+            {
+                workers.emplace_back(search, t);
+            }
+            search(0);
+
+            for (auto & worker: workers)
+            {
+                worker.join();
+            }
+        }
+
+        int winner = -1;
+        for (int t = 0; t < threads; ++t)
+        {
+            if ((bestRotation[t] >= 0) && ((winner < 0) || (bestScore[t] > bestScore[winner])))
+            {
+                winner = t;
+            }
+        }
+        if (winner < 0)
+        {
+            return result;
+        }
+
+        result.found = true;
+        result.x = x0 + bestI[winner] * params.resolution;
+        result.y = y0 + bestJ[winner] * params.resolution;
+        result.th = th0 + (bestRotation[winner] - slices) * step;
+        result.score = bestScore[winner];
+        return result;
+    }
+}
@@ -0,0 +1,670 @@
+/// \file sensor_log_library.cpp
+/// \brief a library that records sensor messages to a chunked binary log and memory maps it back
+
+#include "nuslam/sensor_log_library.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef NUSLAM_HAVE_LZ4
+#include <lz4.h>
+#endif
+
+namespace sensor_log
+{
+    static const char MAGIC[8] = {'N', 'U', 'S', 'L', 'M', 'L', 'O', 'G'};
+    static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+    /// \brief rounds a byte offset up to an alignment
+    static uint64_t align(uint64_t offset, uint64_t alignment)
+    {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+
+    /// \brief reads a record of a chunk
+    /// \param base - the records of the chunk, 8 byte aligned
+    /// \param size - bytes of records
+    /// \param pos - the byte the record starts at, moved past it
+    /// \param previous - the time of the record before it, replaced by its own
+    /// \param record - the record read
+    /// \return false if the record does not fit in the chunk or has an unknown type
+    static bool parseRecord(const uint8_t * base, size_t size, size_t & pos, int64_t & previous, Record & record)
+    {
+        if (pos >= size)
+        {
+            return false;
+        }
+        record.type = RecordType(base[pos++]);
+
+        // zigzag varint time difference
+        uint64_t zigzag = 0;
+        for (int shift = 0; ; shift += 7)
+        {
+            if ((pos >= size) || (shift > 63))
+            {
+                return false;
+            }
+            const uint8_t byte = base[pos++];
+            zigzag |= uint64_t(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+            {
+                break;
+            }
+        }
+        const int64_t delta = int64_t(zigzag >> 1) ^ -int64_t(zigzag & 1);
+        record.time = int64_t(uint64_t(previous) + uint64_t(delta));
+        previous = record.time;
+
+        uint32_t count = 0;
+        switch (record.type)
+        {
+            case RecordType::SCAN:
+            {
+                pos = align(pos, 4);
+                if (pos + 20 > size)
+                {
+                    return false;
+                }
+                std::memcpy(&record.scan.angleMin, base + pos, 4);
+                std::memcpy(&record.scan.angleIncrement, base + pos + 4, 4);
+                std::memcpy(&record.scan.rangeMin, base + pos + 8, 4);
+                std::memcpy(&record.scan.rangeMax, base + pos + 12, 4);
+                std::memcpy(&count, base + pos + 16, 4);
+                pos += 20;
+                if (count > (size - pos) / sizeof(float))
+                {
+                    return false;
+                }
+                record.scan.count = count;
+                record.scan.ranges = reinterpret_cast<const float *>(base + pos);
+                pos += count * sizeof(float);
+                return true;
+            }
+            case RecordType::JOINTS:
+            {
+                pos = align(pos, 8);
+                if (pos + 8 > size)
+                {
+                    return false;
+                }
+                std::memcpy(&count, base + pos, 4);
+                pos += 8;
+                if (count > (size - pos) / (2 * sizeof(double)))
+                {
+                    return false;
+                }
+                record.joints.count = count;
+                record.joints.positions = reinterpret_cast<const double *>(base + pos);
+                record.joints.velocities = record.joints.positions + count;
+                pos += 2 * count * sizeof(double);
+                return true;
+            }
+            case RecordType::REAL_LANDMARKS:
+            case RecordType::FAKE_LANDMARKS:
+            {
+                pos = align(pos, 4);
+                if (pos + 4 > size)
+                {
+                    return false;
+                }
+                std::memcpy(&count, base + pos, 4);
+                pos += 4;
+                if (count > (size - pos) / sizeof(Observation))
+                {
+                    return false;
+                }
+                record.landmarks.count = count;
+                record.landmarks.observations = reinterpret_cast<const Observation *>(base + pos);
+                pos += count * sizeof(Observation);
+                return true;
+            }
+            case RecordType::POSE:
+            {
+                pos = align(pos, 8);
+                if (pos + 40 > size)
+                {
+                    return false;
+                }
+                std::memcpy(&record.pose.source, base + pos, 4);
+                std::memcpy(&record.pose.wallTime, base + pos + 8, 8);
+                std::memcpy(&record.pose.th, base + pos + 16, 8);
+                std::memcpy(&record.pose.x, base + pos + 24, 8);
+                std::memcpy(&record.pose.y, base + pos + 32, 8);
+                pos += 40;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// \brief returns the records of a chunk, decompressing them into a buffer if needed
+    /// \return nullptr if the chunk cannot be read
+    static const uint8_t * chunkRecords(const uint8_t * file, uint64_t offset, std::vector<uint64_t> & buffer)
+    {
+        ChunkHeader h;
+        std::memcpy(&h, file + offset, sizeof(h));
+        const uint8_t * stored = file + offset + sizeof(ChunkHeader);
+        if (!(h.flags & CHUNK_LZ4))
+        {
+            return (h.storedSize == h.rawSize) ? stored : nullptr;
+        }
+#ifdef NUSLAM_HAVE_LZ4
+        buffer.resize(h.rawSize / 8 + 1);
+        const int n = LZ4_decompress_safe(reinterpret_cast<const char *>(stored), reinterpret_cast<char *>(buffer.data()),
+                                          h.storedSize, h.rawSize);
+        if ((n < 0) || (uint32_t(n) != h.rawSize))
+        {
+            return nullptr;
+        }
+        return reinterpret_cast<const uint8_t *>(buffer.data());
+#else
+        (void)buffer;
+        return nullptr;
+#endif
+    }
+
+    bool haveLZ4()
+    {
+#ifdef NUSLAM_HAVE_LZ4
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    LogWriter::LogWriter()
+        : compress(false), chunkBytes(0), current{0, 0, 0, 0}, chunkStart(0), previousTime(0), header{}
+    {
+    }
+
+    LogWriter::~LogWriter()
+    {
+        std::string error;
+        close(error);
+    }
+
+    bool LogWriter::open(const std::string & logPath, bool lz4, size_t chunkSize, std::string & error)
+    {
+        close(error);
+
+        file.open(logPath, std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            error = "cannot open " + logPath + ": " + std::strerror(errno);
+            return false;
+        }
+        path = logPath;
+        compress = lz4 && haveLZ4();
+        chunkBytes = std::max<size_t>(chunkSize, 1024);
+        chunk.clear();
+        chunk.reserve(chunkBytes);
+        index.clear();
+
+        header = LogHeader{};
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = LOG_VERSION;
+        header.byteOrder = BYTE_ORDER_MARK;
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        return bool(file);
+    }
+
+    bool LogWriter::isOpen() const
+    {
+        return file.is_open();
+    }
+
+    void LogWriter::begin(RecordType type, int64_t time, size_t bodyBytes)
+    {
+        // type, the longest varint and the padding
+        if (!chunk.empty() && (chunk.size() + 1 + 10 + 8 + bodyBytes > chunkBytes))
+        {
+            flushChunk();
+        }
+        if (chunk.empty())
+        {
+            current = ChunkIndex{0, time, time, 0};
+            chunkStart = time;
+            previousTime = time;
+        }
+        current.firstTime = std::min(current.firstTime, time);
+        current.lastTime = std::max(current.lastTime, time);
+        ++current.numRecords;
+
+        chunk.push_back(uint8_t(type));
+        const int64_t delta = int64_t(uint64_t(time) - uint64_t(previousTime));
+        uint64_t zigzag = (uint64_t(delta) << 1) ^ uint64_t(delta >> 63);
+        while (zigzag >= 0x80)
+        {
+            chunk.push_back(uint8_t(zigzag) | 0x80);
+            zigzag >>= 7;
+        }
+        chunk.push_back(uint8_t(zigzag));
+        previousTime = time;
+    }
+
+    void LogWriter::pad(size_t alignment)
+    {
+        chunk.resize(align(chunk.size(), alignment), 0);
+    }
+
+    void LogWriter::append(const void * bytes, size_t length)
+    {
+        const uint8_t * b = static_cast<const uint8_t *>(bytes);
+        chunk.insert(chunk.end(), b, b + length);
+    }
+
+    void LogWriter::writeScan(int64_t time, float angleMin, float angleIncrement, float rangeMin, float rangeMax,
+                              const std::vector<float> & ranges)
+    {
+        if (!isOpen())
+        {
+            return;
+        }
+        const uint32_t count = ranges.size();
+        begin(RecordType::SCAN, time, 20 + count * sizeof(float));
+        pad(4);
+        const float fields[4] = {angleMin, angleIncrement, rangeMin, rangeMax};
+        append(fields, sizeof(fields));
+        append(&count, sizeof(count));
+        append(ranges.data(), count * sizeof(float));
+    }
+
+    void LogWriter::writeJoints(int64_t time, const std::vector<double> & positions,
+                                const std::vector<double> & velocities)
+    {
+        if (!isOpen())
+        {
+            return;
+        }
+        const uint32_t count[2] = {uint32_t(positions.size()), 0};
+        begin(RecordType::JOINTS, time, 8 + 2 * count[0] * sizeof(double));
+        pad(8);
+        append(count, sizeof(count));
+        append(positions.data(), count[0] * sizeof(double));
+        const size_t given = std::min<size_t>(velocities.size(), count[0]);
+        append(velocities.data(), given * sizeof(double));
+        chunk.resize(chunk.size() + (count[0] - given) * sizeof(double), 0);
+    }
+
+    void LogWriter::writeLandmarks(int64_t time, RecordType type, const std::vector<Observation> & observations)
+    {
+        if (!isOpen())
+        {
+            return;
+        }
+        const uint32_t count = observations.size();
+        begin(type, time, 4 + count * sizeof(Observation));
+        pad(4);
+        append(&count, sizeof(count));
+        append(observations.data(), count * sizeof(Observation));
+    }
+
+    void LogWriter::writePose(int64_t time, PoseSource source, int64_t wallTime, double th, double x, double y)
+    {
+        if (!isOpen())
+        {
+            return;
+        }
+        begin(RecordType::POSE, time, 40);
+        pad(8);
+        const uint32_t fields[2] = {uint32_t(source), 0};
+        append(fields, sizeof(fields));
+        append(&wallTime, sizeof(wallTime));
+        const double pose[3] = {th, x, y};
+        append(pose, sizeof(pose));
+    }
+
+    bool LogWriter::flushChunk()
+    {
+        if (chunk.empty())
+        {
+            return bool(file);
+        }
+
+        ChunkHeader h;
+        h.magic = CHUNK_MAGIC;
+        h.flags = 0;
+        h.numRecords = current.numRecords;
+        h.storedSize = chunk.size();
+        h.rawSize = chunk.size();
+        h.reserved = 0;
+        h.firstTime = chunkStart;
+
+        const char * stored = reinterpret_cast<const char *>(chunk.data());
+#ifdef NUSLAM_HAVE_LZ4
+        if (compress)
+        {
+            // kept only if it is smaller
+            compressed.resize(LZ4_compressBound(chunk.size()));
+            const int n = LZ4_compress_default(stored, compressed.data(), chunk.size(), compressed.size());
+            if ((n > 0) && (uint32_t(n) < h.rawSize))
+            {
+                h.flags = CHUNK_LZ4;
+                h.storedSize = n;
+                stored = compressed.data();
+            }
+        }
+#endif
+
+        current.offset = file.tellp();
+        file.write(reinterpret_cast<const char *>(&h), sizeof(h));
+        file.write(stored, h.storedSize);
+        const char zeros[8] = {};
+        file.write(zeros, align(h.storedSize, 8) - h.storedSize);
+
+        index.push_back(current);
+        header.firstTime = (header.numChunks == 0) ? current.firstTime : std::min(header.firstTime, current.firstTime);
+        header.lastTime = (header.numChunks == 0) ? current.lastTime : std::max(header.lastTime, current.lastTime);
+        ++header.numChunks;
+        header.numRecords += current.numRecords;
+        chunk.clear();
+        return bool(file);
+    }
+
+    bool LogWriter::close(std::string & error)
+    {
+        if (!isOpen())
+        {
+            return true;
+        }
+
+        bool ok = flushChunk();
+        header.indexOffset = file.tellp();
+        file.write(reinterpret_cast<const char *>(index.data()), index.size() * sizeof(ChunkIndex));
+
+        // the header goes in last, a log without it is read by walking the chunks
+        file.seekp(0);
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.flush();
+        ok = ok && bool(file);
+        file.close();
+        if (!ok)
+        {
+            error = "cannot write " + path;
+        }
+        return ok;
+    }
+
+    LogReader::LogReader()
+        : data(nullptr), length(0), rebuilt(false), totalRecords(0), chunk(0), records(nullptr), recordsSize(0),
+          position(0), previousTime(0), skipped(0)
+    {
+    }
+
+    LogReader::~LogReader()
+    {
+        close();
+    }
+
+    bool LogReader::open(const std::string & path, std::string & error)
+    {
+        close();
+
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            error = "cannot open " + path + ": " + std::strerror(errno);
+            return false;
+        }
+
+        struct stat info;
+        if ((fstat(fd, &info) != 0) || (uint64_t(info.st_size) < sizeof(LogHeader)))
+        {
+            error = path + " is too short to be a log";
+            ::close(fd);
+            return false;
+        }
+
+        void * mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED)
+        {
+            error = "cannot map " + path + ": " + std::strerror(errno);
+            return false;
+        }
+        data = mapped;
+        length = info.st_size;
+
+        const uint8_t * bytes = static_cast<const uint8_t *>(data);
+        LogHeader h;
+        std::memcpy(&h, bytes, sizeof(h));
+        if (std::memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0)
+        {
+            error = path + " is not a log file";
+            close();
+            return false;
+        } else if (h.byteOrder != BYTE_ORDER_MARK)
+        {
+            error = path + " was written on a machine with a different byte order";
+            close();
+            return false;
+        } else if ((h.version < 1) || (h.version > LOG_VERSION))
+        {
+            error = path + " has version " + std::to_string(h.version) + ", expected at most " +
+                    std::to_string(LOG_VERSION);
+            close();
+            return false;
+        }
+
+        // a chunk can be used if its header and records lie inside the file
+        auto validChunk = [&](uint64_t offset)
+        {
+            if ((offset % 8 != 0) || (offset < sizeof(LogHeader)) || (offset + sizeof(ChunkHeader) > length))
+            {
+                return false;
+            }
+            ChunkHeader c;
+            std::memcpy(&c, bytes + offset, sizeof(c));
+            return (c.magic == CHUNK_MAGIC) && (offset + sizeof(ChunkHeader) + c.storedSize <= length);
+        };
+
+        bool indexed = (h.indexOffset >= sizeof(LogHeader)) && (h.indexOffset % 8 == 0) && (h.indexOffset <= length) &&
+                       (h.numChunks <= (length - h.indexOffset) / sizeof(ChunkIndex));
+        if (indexed)
+        {
+            index.resize(h.numChunks);
+            std::memcpy(index.data(), bytes + h.indexOffset, h.numChunks * sizeof(ChunkIndex));
+            for (const auto & entry : index)
+            {
+                indexed = indexed && validChunk(entry.offset);
+            }
+        }
+
+        if (!indexed)
+        {
+            /****************
+             * Never closed, walk the chunks up to the first one that was not written out completely
+             * *************/
+            index.clear();
+            rebuilt = true;
+            for (uint64_t offset = align(sizeof(LogHeader), 8); validChunk(offset); )
+            {
+                ChunkHeader c;
+                std::memcpy(&c, bytes + offset, sizeof(c));
+                const uint8_t * base = chunkRecords(bytes, offset, buffer);
+                if (!base)
+                {
+                    break;
+                }
+
+                ChunkIndex entry{offset, c.firstTime, c.firstTime, 0};
+                size_t pos = 0;
+                int64_t previous = c.firstTime;
+                Record r;
+                while ((pos < c.rawSize) && parseRecord(base, c.rawSize, pos, previous, r))
+                {
+                    entry.firstTime = std::min(entry.firstTime, r.time);
+                    entry.lastTime = std::max(entry.lastTime, r.time);
+                    ++entry.numRecords;
+                }
+                index.push_back(entry);
+                offset += sizeof(ChunkHeader) + align(c.storedSize, 8);
+            }
+        }
+
+        for (const auto & entry : index)
+        {
+            ChunkHeader c;
+            std::memcpy(&c, bytes + entry.offset, sizeof(c));
+            if ((c.flags & CHUNK_LZ4) && !haveLZ4())
+            {
+                error = path + " has LZ4 chunks and this build has no LZ4";
+                close();
+                return false;
+            }
+            totalRecords += entry.numRecords;
+        }
+
+        rewind();
+        return true;
+    }
+
+    void LogReader::close()
+    {
+        if (data)
+        {
+            munmap(data, length);
+        }
+        data = nullptr;
+        length = 0;
+        index.clear();
+        rebuilt = false;
+        totalRecords = 0;
+        chunk = 0;
+        records = nullptr;
+        recordsSize = 0;
+        position = 0;
+        skipped = 0;
+    }
+
+    bool LogReader::isOpen() const
+    {
+        return data != nullptr;
+    }
+
+    bool LogReader::recovered() const
+    {
+        return rebuilt;
+    }
+
+    size_t LogReader::numChunks() const
+    {
+        return index.size();
+    }
+
+    uint64_t LogReader::numRecords() const
+    {
+        return totalRecords;
+    }
+
+    int64_t LogReader::firstTime() const
+    {
+        int64_t t = index.empty() ? 0 : index.front().firstTime;
+        for (const auto & entry : index)
+        {
+            t = std::min(t, entry.firstTime);
+        }
+        return t;
+    }
+
+    int64_t LogReader::lastTime() const
+    {
+        int64_t t = index.empty() ? 0 : index.front().lastTime;
+        for (const auto & entry : index)
+        {
+            t = std::max(t, entry.lastTime);
+        }
+        return t;
+    }
+
+    size_t LogReader::skippedChunks() const
+    {
+        return skipped;
+    }
+
+    void LogReader::enterChunk(size_t k)
+    {
+        const uint8_t * bytes = static_cast<const uint8_t *>(data);
+        for (chunk = k; chunk < index.size(); ++chunk)
+        {
+            ChunkHeader c;
+            std::memcpy(&c, bytes + index[chunk].offset, sizeof(c));
+            records = chunkRecords(bytes, index[chunk].offset, buffer);
+            if (records)
+            {
+                recordsSize = c.rawSize;
+                position = 0;
+                previousTime = c.firstTime;
+                return;
+            }
+            ++skipped;
+        }
+        records = nullptr;
+        recordsSize = 0;
+        position = 0;
+    }
+
+    void LogReader::rewind()
+    {
+        enterChunk(0);
+    }
+
+    void LogReader::seek(int64_t time)
+    {
+        // the chunks are written in order, records only a little out of order between topics
+        auto after = std::upper_bound(index.begin(), index.end(), time,
+                                      [](int64_t t, const ChunkIndex & entry) { return t < entry.firstTime; });
+        size_t k = (after == index.begin()) ? 0 : size_t(after - index.begin()) - 1;
+        while ((k > 0) && (index[k - 1].lastTime >= time))
+        {
+            --k;
+        }
+        enterChunk(k);
+
+        Record r;
+        while (chunk < index.size())
+        {
+            const size_t savedChunk = chunk, savedPosition = position;
+            const int64_t savedTime = previousTime;
+            if (!next(r))
+            {
+                return;
+            }
+            if (r.time >= time)
+            {
+                if (chunk != savedChunk)
+                {
+                    enterChunk(savedChunk);
+                }
+                position = savedPosition;
+                previousTime = savedTime;
+                return;
+            }
+        }
+    }
+
+    bool LogReader::next(Record & record)
+    {
+        while (chunk < index.size())
+        {
+            if (position >= recordsSize)
+            {
+                enterChunk(chunk + 1);
+                continue;
+            }
+            if (parseRecord(records, recordsSize, position, previousTime, record))
+            {
+                return true;
+            }
+            ++skipped;
+            enterChunk(chunk + 1);
+        }
+        return false;
+    }
+}
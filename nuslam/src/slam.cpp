@@ -7,15 +7,71 @@
 ///     R : 2x2 sensor noise matrix
 ///     Q : 3x3 process noise matrix
 ///     tube_locations : the (x,y) locations of each tube / landmark
+///     use_fused_odom : if true, predict with the gyro / wheel fused odometry instead of the wheels alone (default false)
+///     use_scan_matching : if true, predict with the motion found by aligning consecutive lidar scans (default false)
+///     icp_max_iterations : most Gauss-Newton steps of a scan alignment (default 20)
+///     icp_max_correspondence : largest point to reference distance matched on the first step (default 0.3)
+///     icp_min_correspondence : the match distance shrinks with the residual, but not below this (default 0.05)
+///     icp_search_window : reference beams on each side of the projected beam searched for a match (default 3)
+///     correlative_scans : recent scans searched when an alignment fails (default 3)
+///     correlative_linear_window : translations searched on each side of the wheel motion (default 0.5)
+///     correlative_angular_window : rotations searched on each side of the wheel motion (default 0.8)
+///     correlative_threads : threads the correlative search is split over (default 2)
+///     shm_transport : read the scans through shared memory when the publisher is local (default true)
+///     mode : "slam" to map the landmarks while localizing, "localization" to localize against the fixed tube_locations (default "slam")
+///     map_variance : variance of each fixed landmark location in localization mode (default 0.0001)
+///     association_gate : Mahalanobis distance gate for matching real sensor measurements in localization mode (default 9.21)
+///     radius_variance : variance of the tube radius fitted by the landmarks node (default 0.0004)
+///     radius_gate : chi-square bound (1 degree of freedom) on the difference between a fitted radius and that of
+///                   a landmark, a real sensor measurement outside it is not associated with the landmark (default 6.63)
+///     set_pose_variance : variance of each pose coordinate after a set_pose request (default 0.001)
+///     map_file : the file save_map writes and load_map reads (default nuslam_map.bin, relative to ROS_HOME)
+///     load_map_on_start : if true, warm start the filter from map_file when the node starts (default false)
+///     checkpoint_file : the file the filter and odometry are checkpointed to (default nuslam_checkpoint.bin, relative to ROS_HOME)
+///     checkpoint_period : seconds between checkpoints, 0 to turn them off (default 0.0)
+///     checkpoint_resume : if true, resume from checkpoint_file on start (default false)
+///     checkpoint_max_age : a checkpoint at most this many seconds old is resumed from on start (default 30.0)
+///     loop_closure : if true, look for landmarks mapped twice on a background thread and merge them (default true)
+///     loop_closure_period : seconds between loop closure checks (default 1.0)
+///     loop_closure_recent : how many of the newest landmarks are checked for duplicates (default 6)
+///     loop_closure_max_side : longest side of a landmark triangle in a constellation, about twice the sensor range (default 2.0)
+///     loop_closure_match_distance : largest distance between a landmark and its duplicate after the drift (default 0.15)
+///     loop_closure_min_matches : fewest duplicates accepted as a loop closure, at least 3 (default 3)
+///     loop_closure_max_drift : largest drift translation accepted (default 1.0)
+///     loop_closure_max_drift_angle : largest drift rotation accepted (default 0.5)
+///     loop_closure_max_samples : most landmark triangles of a constellation looked up per check (default 200)
+///     loop_closure_variance : variance of the pseudo measurement that merges two landmarks (default 1e-6)
+///     exchange : if true, exchange landmark summaries with the other robots in range (default false)
+///     robot_name : the name this robot sends its summaries under (default the name of the node)
+///     exchange_period : seconds between summaries (default 1.0)
+///     exchange_range : the largest distance between robots that exchange summaries (default 3.0)
+///     exchange_timeout : a robot not heard from for this many seconds is out of range (default 2.0)
+///     exchange_change_distance : a landmark is sent again once it moved this far (default 0.02)
+///     exchange_change_fraction : a landmark is sent again once its variance shrank by this fraction (default 0.2)
+///     exchange_gate : squared Mahalanobis distance below which a received landmark is fused with one of the filter (default 9.21)
+///     exchange_new_gate : squared Mahalanobis distance above which a received landmark is added as a new one (default 50)
+///     consistency_rate : rate the filter consistency is published at (Hz), 0 to turn it off (default 1.0)
+///     consistency_window : the number of recent NIS / NEES samples tested (default 50)
+///     consistency_confidence : the probability that a consistent filter raises no alarm (default 0.95)
+///     consistency_ground_truth : if true, also find the NEES of the pose against the simulated robot (default false)
+///     turtle_frame_id : the frame of the simulated robot, the ground truth of the NEES
 /// PUBLISHES:  /slam_path (nav_msgs::Path)
 ///             /odom_path (nav_msgs::Path)
+///             /landmark_summaries (nuslam::LandmarkSummary), when exchange is true
+///             /filter_consistency (nuslam::FilterConsistency), when consistency_rate is above 0
 /// SUBSCRIBES: /joint_states (sensor_msgs::JointState)
+///             /fused_odom (nav_msgs::Odometry), when use_fused_odom is true
+///             /scan (sensor_msgs::LaserScan), when use_scan_matching is true
 ///             /fake_sensor (visualization_msgs::MarkerArray)
-/// SERVICES: set_pose : Sets the pose of the turtlebot's configuration
+///             /landmark_summaries (nuslam::LandmarkSummary), when exchange is true
+/// SERVICES: set_pose : Sets the pose of the turtlebot's configuration in the odometry and the filter
+///           save_map (std_srvs::Trigger) : Saves the state, covariance and landmarks of the EKF to map_file
+///           load_map (std_srvs::Trigger) : Replaces the EKF with the one saved in map_file
 
 #include <ros/ros.h>
 
 #include <rigid2d/set_pose.h>
+#include <std_srvs/Trigger.h>
 
 #include <nav_msgs/Odometry.h>
 #include <nav_msgs/Path.h>
@@ -28,17 +84,34 @@
 #include <visualization_msgs/Marker.h>
 
 #include <tf2_ros/transform_broadcaster.h>
+#include <tf2_ros/transform_listener.h>
 #include <tf2/LinearMath/Quaternion.h>
 #include <tf2_geometry_msgs/tf2_geometry_msgs.h>
+#include <tf2/utils.h>
 
 #include <sensor_msgs/JointState.h>
+#include <sensor_msgs/LaserScan.h>
 
 #include <rigid2d/rigid2d.hpp>
 #include <rigid2d/diff_drive.hpp>
+#include <rigid2d/shm_transport.hpp>
 
 #include <nuslam/slam_library.hpp>
+#include <nuslam/map_file_library.hpp>
+#include <nuslam/checkpoint_library.hpp>
+#include <nuslam/loop_closure_library.hpp>
+#include <nuslam/exchange_library.hpp>
+#include <nuslam/LandmarkSummary.h>
+#include <nuslam/consistency_library.hpp>
+#include <nuslam/FilterConsistency.h>
+#include <nuslam/scan_matching_library.hpp>
 
 #include <armadillo>
+#include <algorithm>
+#include <array>
+#include <deque>
+#include <map>
+#include <memory>
 #include <string>
 #include <iostream>
 
@@ -56,13 +129,53 @@ static bool jointState_flag = false;
 static bool markerArray_flag = false;
 static bool markerArrayFake_flag = false;
 
+static bool use_fused_odom = false;
+static bool fusedOdom_flag = false;
+static rigid2d::Transform2D fused_pose, fused_pose_predicted;
+
+static bool use_scan_matching = false;
+static bool scan_flag = false;
+static bool scanOdom_flag = false;
+static sensor_msgs::LaserScan::ConstPtr scan_msg;
+static scan_matching::IcpMatcher icp;
+static rigid2d::DiffDrive scanWheels;       // wheel odometry at the last scan, the initial guess of the alignment
+static rigid2d::Transform2D scan_pose, scan_pose_predicted;
+static arma::mat scan_cov = arma::zeros<arma::mat>(3, 3);      // covariance of the scan motion since the last prediction
+static arma::mat twist_cov = arma::zeros<arma::mat>(3, 3);     // covariance of the last prediction twist, in the body frame
+
+static scan_matching::CorrelativeMatcher correlative;
+static std::deque<std::pair<sensor_msgs::LaserScan::ConstPtr, rigid2d::Transform2D>> recent_scans;
+
+static bool localize = false;
+
+static bool setPose_flag = false;
+static double setPose_x, setPose_y, setPose_th;
+
+static slam_library::ExtendedKalman * ekf = nullptr;
+static int landmark_generation = 0;
+static std::map<int, int> fake_slots;       // landmark j of each tube id of the fake sensor
+
+static std::deque<nuslam::LandmarkSummary::ConstPtr> summaries;     // received since the last loop
+
 /**********
  * Helper Functions
  * *******/
 void jointStateCallback(const sensor_msgs::JointState msg);
 void sensorCallback(const visualization_msgs::MarkerArray array);
 void fakeSensorCallback(const visualization_msgs::MarkerArray array);
+void fusedOdomCallback(const nav_msgs::Odometry::ConstPtr & msg);
+void scanCallback(const sensor_msgs::LaserScan::ConstPtr & msg);
+void summaryCallback(const nuslam::LandmarkSummary::ConstPtr & msg);
+rigid2d::Twist2D arcTwist(const rigid2d::Transform2D & delta);
+rigid2d::Twist2D predictionTwist();
+arma::mat predictionNoise(const arma::mat & Q, double th);
 bool setPose(rigid2d::set_pose::Request & req, rigid2d::set_pose::Response & res);
+bool saveMap(std_srvs::Trigger::Request & req, std_srvs::Trigger::Response & res);
+bool loadMap(std_srvs::Trigger::Request & req, std_srvs::Trigger::Response & res);
+bool loadMapFile(std::string & message);
+map_file::OdometryBaseline odometryBaseline(const rigid2d::DiffDrive & odometry);
+void fillCheckpoint(checkpoint::Checkpoint & snapshot, const arma::colvec & state, const arma::mat & cov, int visited,
+                    const ros::Time & stamp);
 
 /*********
  * Main Function
@@ -86,7 +199,38 @@ int main(int argc, char* argv[])
     std::string map_frame_id, odom_frame_id, body_frame_id;
     std::vector<double> tube1_loc, tube2_loc, tube3_loc, tube4_loc, tube5_loc, tube6_loc;
     std::vector<double> rVec, qVec;
+    std::string mode = "slam";
     double tubeRad;
+    double mapVariance = 0.0001;
+    double associationGate = 9.21;
+    double radiusVariance = 0.0004, radiusGate = 6.63;
+    double setPoseVariance = 0.001;
+
+    bool shm_transport = true;
+
+    std::string checkpointFile = "nuslam_checkpoint.bin";
+    double checkpointPeriod = 0.0, checkpointMaxAge = 30.0;
+    bool checkpointResume = false;
+
+    bool loopClosure = true;
+    double loopClosurePeriod = 1.0, loopClosureVariance = 1e-6;
+    double loopMaxSide = 2.0, loopMatchDistance = 0.15, loopMaxDrift = 1.0, loopMaxDriftAngle = 0.5;
+    int loopRecent = 6, loopMinMatches = 3, loopMaxSamples = 200;
+
+    bool exchangeLandmarks = false;
+    std::string robotName = ros::this_node::getName();
+    double exchangePeriod = 1.0, exchangeRange = 3.0, exchangeTimeout = 2.0;
+    double exchangeChangeDistance = 0.02, exchangeChangeFraction = 0.2;
+    double exchangeGate = 9.21, exchangeNewGate = 50.0;
+
+    double consistencyRate = 1.0, consistencyConfidence = 0.95;
+    int consistencyWindow = 50;
+    bool groundTruth = false;
+
+    scan_matching::IcpParams icpParams;
+    scan_matching::CorrelativeParams correlativeParams;
+    int correlativeScans = 3;
+    correlativeParams.threads = 2;
 
     int frequency=10;
     int num = 6;
@@ -106,6 +250,7 @@ int main(int argc, char* argv[])
     n.getParam("left_wheel_joint", left_wheel_joint);
     n.getParam("right_wheel_joint", right_wheel_joint);
     n.getParam("world_frame_id", world_frame_id);
+    n.getParam("turtle_frame_id", turtle_frame_id);
     n.getParam("tube1_location", tube1_loc);
     n.getParam("tube2_location", tube2_loc);
     n.getParam("tube3_location", tube3_loc);
@@ -115,6 +260,58 @@ int main(int argc, char* argv[])
     n.getParam("tube_radius", tubeRad);
     n.getParam("R", rVec);
     n.getParam("Q", qVec);
+    n.getParam("use_fused_odom", use_fused_odom);
+    n.getParam("use_scan_matching", use_scan_matching);
+    n.getParam("shm_transport", shm_transport);
+    n.getParam("icp_max_iterations", icpParams.maxIterations);
+    n.getParam("icp_max_correspondence", icpParams.maxCorrespondence);
+    n.getParam("icp_min_correspondence", icpParams.minCorrespondence);
+    n.getParam("icp_search_window", icpParams.searchWindow);
+    n.getParam("correlative_scans", correlativeScans);
+    n.getParam("correlative_linear_window", correlativeParams.linearWindow);
+    n.getParam("correlative_angular_window", correlativeParams.angularWindow);
+    n.getParam("correlative_threads", correlativeParams.threads);
+    n.getParam("mode", mode);
+    n.getParam("map_variance", mapVariance);
+    n.getParam("association_gate", associationGate);
+    n.getParam("radius_variance", radiusVariance);
+    n.getParam("radius_gate", radiusGate);
+    n.getParam("set_pose_variance", setPoseVariance);
+    n.getParam("loop_closure", loopClosure);
+    n.getParam("loop_closure_period", loopClosurePeriod);
+    n.getParam("loop_closure_recent", loopRecent);
+    n.getParam("loop_closure_max_side", loopMaxSide);
+    n.getParam("loop_closure_match_distance", loopMatchDistance);
+    n.getParam("loop_closure_min_matches", loopMinMatches);
+    n.getParam("loop_closure_max_drift", loopMaxDrift);
+    n.getParam("loop_closure_max_drift_angle", loopMaxDriftAngle);
+    n.getParam("loop_closure_max_samples", loopMaxSamples);
+    n.getParam("loop_closure_variance", loopClosureVariance);
+    n.getParam("checkpoint_file", checkpointFile);
+    n.getParam("checkpoint_period", checkpointPeriod);
+    n.getParam("checkpoint_resume", checkpointResume);
+    n.getParam("checkpoint_max_age", checkpointMaxAge);
+    n.getParam("exchange", exchangeLandmarks);
+    n.getParam("robot_name", robotName);
+    n.getParam("exchange_period", exchangePeriod);
+    n.getParam("exchange_range", exchangeRange);
+    n.getParam("exchange_timeout", exchangeTimeout);
+    n.getParam("exchange_change_distance", exchangeChangeDistance);
+    n.getParam("exchange_change_fraction", exchangeChangeFraction);
+    n.getParam("exchange_gate", exchangeGate);
+    n.getParam("exchange_new_gate", exchangeNewGate);
+    n.getParam("consistency_rate", consistencyRate);
+    n.getParam("consistency_window", consistencyWindow);
+    n.getParam("consistency_confidence", consistencyConfidence);
+    n.getParam("consistency_ground_truth", groundTruth);
+
+    if (mode == "localization")
+    {
+        localize = true;
+    } else if (mode != "slam")
+    {
+        ROS_WARN("slam: unknown mode %s, running slam", mode.c_str());
+    }
 
     /*********
      * Define publishers, subscribers, services and clients
@@ -126,7 +323,21 @@ int main(int argc, char* argv[])
     ros::Subscriber sensor_sub = n.subscribe("/real_sensor", frequency, sensorCallback);
     ros::Subscriber fake_sensor_sub = n.subscribe("/fake_sensor", frequency, fakeSensorCallback);
 
+    ros::Subscriber fused_sub;
+    if (use_fused_odom)
+    {
+        fused_sub = n.subscribe("/fused_odom", frequency, fusedOdomCallback);
+    }
+
+    rigid2d::ShmSubscriber<sensor_msgs::LaserScan> scan_sub;
+    if (use_scan_matching)
+    {
+        scan_sub = rigid2d::ShmSubscriber<sensor_msgs::LaserScan>(n, "/scan", frequency, scanCallback, shm_transport);
+    }
+
     ros::ServiceServer setPose_service = n.advertiseService("set_pose", setPose);
+    ros::ServiceServer saveMap_service = n.advertiseService("save_map", saveMap);
+    ros::ServiceServer loadMap_service = n.advertiseService("load_map", loadMap);
     ros::ServiceClient setPose_client = n.serviceClient<rigid2d::set_pose>("set_pose");
 
     ros::Rate loop_rate(frequency);
@@ -135,6 +346,8 @@ int main(int argc, char* argv[])
      * ******/
     ninjaTurtle = DiffDrive(wheelBase, wheelRad, 0.0, 0.0, 0.0, 0.0, 0.0);
     teenageMutant = DiffDrive(wheelBase, wheelRad, 0.0, 0.0, 0.0, 0.0, 0.0);
+    icp = scan_matching::IcpMatcher(icpParams);
+    correlative = scan_matching::CorrelativeMatcher(correlativeParams);
 
     /*********
      * Create EKF SLAM object
@@ -171,6 +384,144 @@ int main(int argc, char* argv[])
     }
 
     ExtendedKalman raphael = ExtendedKalman(robotState, mapState, Q, R);
+    raphael.setRadiusNoise(radiusVariance, radiusGate);
+    ekf = &raphael;
+
+    /*********
+     * Start the loop closure detection thread
+     * ******/
+    std::unique_ptr<loop_closure::BackgroundDetector> loopDetector;
+    if (loopClosure && !localize)
+    {
+        loopDetector.reset(new loop_closure::BackgroundDetector(loop_closure::LoopClosureDetector(
+            loopRecent, loopMaxSide, loopMatchDistance, loopMinMatches, loopMaxDrift, loopMaxDriftAngle, loopMaxSamples)));
+    }
+    ros::Time lastLoopCheck = ros::Time::now();
+
+    /*********
+     * Exchange landmark summaries with the other robots, which share the map frame
+     * ******/
+    std::unique_ptr<exchange::SummaryTracker> summaryTracker;
+    ros::Publisher summary_pub;
+    ros::Subscriber summary_sub;
+    if (exchangeLandmarks && !localize)
+    {
+        summaryTracker.reset(new exchange::SummaryTracker(exchangeRange, exchangeTimeout, exchangeChangeDistance,
+                                                          exchangeChangeFraction));
+        summary_pub = n.advertise<nuslam::LandmarkSummary>("/landmark_summaries", frequency);
+        summary_sub = n.subscribe("/landmark_summaries", 100, summaryCallback);
+    }
+    ros::Time lastExchange = ros::Time::now();
+    nuslam::LandmarkSummary summary_msg;
+    std::vector<exchange::LandmarkSummary> outgoing;
+
+    /*********
+     * Test the normalized innovations of every update, and in simulation the normalized pose error
+     * against the true pose, for the filter growing over or under confident
+     * ******/
+    consistency::ConsistencyMonitor nisMonitor(consistencyWindow, 2, consistencyConfidence);
+    consistency::ConsistencyMonitor neesMonitor(consistencyWindow, 3, consistencyConfidence);
+    consistency::Verdict lastVerdict = consistency::Verdict::FILLING;
+    ros::Publisher consistency_pub;
+    if (consistencyRate > 0.0)
+    {
+        consistency_pub = n.advertise<nuslam::FilterConsistency>("/filter_consistency", frequency);
+    }
+    tf2_ros::Buffer tfBuffer;
+    std::unique_ptr<tf2_ros::TransformListener> tfListener;
+    if (groundTruth)
+    {
+        tfListener.reset(new tf2_ros::TransformListener(tfBuffer));
+    }
+    ros::Time lastConsistency = ros::Time::now();
+    nuslam::FilterConsistency consistency_msg;
+
+    bool loadMapOnStart = false;
+    n.getParam("load_map_on_start", loadMapOnStart);
+    if (loadMapOnStart)
+    {
+        std::string message;
+        if (loadMapFile(message))
+        {
+            ROS_INFO("slam: %s", message.c_str());
+        } else
+        {
+            ROS_WARN("slam: starting without a map, %s", message.c_str());
+        }
+    }
+
+    /*********
+     * Create localization object against the fixed tube locations
+     * ******/
+    LocalizationKalman donatello = LocalizationKalman(robotState, mapState, Q, R, mapVariance);
+
+    /*********
+     * Resume from the last checkpoint if asked to, and start checkpointing
+     * A checkpoint older than checkpoint_max_age is from an earlier run and is ignored
+     * ******/
+    std::unique_ptr<checkpoint::CheckpointWriter> checkpointWriter;
+    checkpoint::Checkpoint snapshot;
+    ros::Time lastCheckpoint = ros::Time::now();
+    if (checkpointResume)
+    {
+        std::string error;
+        if (!checkpoint::readCheckpoint(checkpointFile, snapshot, error))
+        {
+            ROS_WARN("slam: %s, starting fresh", error.c_str());
+        } else
+        {
+            const double age = (ros::Time::now() - ros::Time().fromNSec(snapshot.stamp)).toSec();
+            const bool sameMode = bool(snapshot.flags & checkpoint::CHECKPOINT_LOCALIZATION) == localize;
+            const uword len = localize ? donatello.getStateVec().n_elem : raphael.getStateVec().n_elem;
+
+            if (!sameMode || (snapshot.state.size() != len))
+            {
+                ROS_WARN("slam: %s does not match the filter, starting fresh", checkpointFile.c_str());
+            } else if ((age < 0.0) || (age > checkpointMaxAge))
+            {
+                ROS_INFO("slam: %s is %.0f s old, starting fresh", checkpointFile.c_str(), age);
+            } else
+            {
+                colvec savedState(snapshot.state.data(), len);
+                mat savedCov(snapshot.cov.data(), len, len);
+                if (localize)
+                {
+                    donatello.resetPose(savedState, savedCov);
+                } else
+                {
+                    int visited = 0;
+                    for (const map_file::LandmarkInfo & landmark : snapshot.landmarks)
+                    {
+                        visited += bool(landmark.flags & map_file::LANDMARK_INITIALIZED);
+                    }
+                    raphael.warmStart(savedState, savedCov, visited);
+
+                    // the checkpoint keeps no variance of the radii, they count as one fitted radius each
+                    for (unsigned int j = 0; j < snapshot.landmarks.size(); ++j)
+                    {
+                        const map_file::LandmarkInfo & landmark = snapshot.landmarks.at(j);
+                        if ((landmark.flags & map_file::LANDMARK_INITIALIZED) && (landmark.radius > 0.0))
+                        {
+                            raphael.setRadius(j+1, landmark.radius, radiusVariance);
+                        }
+                    }
+                }
+                landmark_generation = snapshot.landmarkGeneration + 1;
+                fake_slots.clear();
+
+                const map_file::OdometryBaseline & odom = snapshot.odometry;
+                const map_file::OdometryBaseline & pred = snapshot.prediction;
+                ninjaTurtle = DiffDrive(wheelBase, wheelRad, odom.x, odom.y, odom.th, odom.thL, odom.thR);
+                teenageMutant = DiffDrive(wheelBase, wheelRad, pred.x, pred.y, pred.th, pred.thL, pred.thR);
+
+                ROS_INFO("slam: resumed from %s, %.1f s old", checkpointFile.c_str(), age);
+            }
+        }
+    }
+    if (checkpointPeriod > 0.0)
+    {
+        checkpointWriter.reset(new checkpoint::CheckpointWriter(checkpointFile));
+    }
 
     while (ros::ok())
     {
@@ -178,6 +529,96 @@ int main(int argc, char* argv[])
 
         ros::Time current_time = ros::Time::now();
 
+        /**********
+         * If a set_pose request was received, move the filters to the requested pose
+         * The landmarks of the map are kept
+         * *******/
+        if (setPose_flag)
+        {
+            colvec requestedPose(3);
+            requestedPose(0) = setPose_th;
+            requestedPose(1) = setPose_x;
+            requestedPose(2) = setPose_y;
+
+            mat poseCov = setPoseVariance * mat(3, 3, fill::eye);
+
+            raphael.resetPose(requestedPose, poseCov);
+            donatello.resetPose(requestedPose, poseCov);
+
+            setPose_flag = false;
+        }
+
+        /**********
+         * If a scan is received, find the motion since the last scan by aligning the two
+         * The wheels give the initial guess. When ICP cannot get there from the guess, a correlative search
+         * against the last few scans finds a start close enough, and the wheels are used if that fails too
+         * *******/
+        if (scan_flag && (joint_state_msg.position.size() >= 2))
+        {
+            double left = joint_state_msg.position[0];
+            double right = joint_state_msg.position[1];
+
+            if (!icp.hasReference())
+            {
+                scanWheels = DiffDrive(wheelBase, wheelRad, 0.0, 0.0, 0.0, left, right);
+            } else
+            {
+                Twist2D guess = scanWheels.getTwist(left, right);
+                scanWheels(left, right);
+                Transform2D delta = integrateTwist(guess);
+
+                scan_matching::IcpResult aligned = icp.match(scan_msg->angle_min, scan_msg->angle_increment,
+                                                             scan_msg->ranges, scan_msg->range_min,
+                                                             scan_msg->range_max, delta.getX(), delta.getY(),
+                                                             atan2(delta.getSinTh(), delta.getCosTh()));
+
+                if (!aligned.converged && !recent_scans.empty())
+                {
+                    // the recent scans in the frame of the previous one
+                    correlative.clearReference();
+                    for (const auto & recent: recent_scans)
+                    {
+                        Transform2D relative = scan_pose.inv() * recent.second;
+                        correlative.addReference(recent.first->angle_min, recent.first->angle_increment,
+                                                 recent.first->ranges, recent.first->range_min,
+                                                 recent.first->range_max, relative.getX(), relative.getY(),
+                                                 atan2(relative.getSinTh(), relative.getCosTh()));
+                    }
+
+                    scan_matching::CorrelativeResult coarse = correlative.match(
+                        scan_msg->angle_min, scan_msg->angle_increment, scan_msg->ranges, scan_msg->range_min,
+                        scan_msg->range_max, delta.getX(), delta.getY(), atan2(delta.getSinTh(), delta.getCosTh()));
+                    if (coarse.found)
+                    {
+                        aligned = icp.match(scan_msg->angle_min, scan_msg->angle_increment, scan_msg->ranges,
+                                            scan_msg->range_min, scan_msg->range_max, coarse.x, coarse.y, coarse.th);
+                    }
+                }
+
+                if (aligned.converged)
+                {
+                    delta = Transform2D(Vector2D(aligned.x, aligned.y), aligned.th);
+                    scan_cov += mat(aligned.cov, 3, 3);
+                } else
+                {
+                    ROS_DEBUG("slam: scan alignment failed after %d steps with %d matches, using the wheels",
+                              aligned.iterations, aligned.correspondences);
+                }
+                scan_pose = scan_pose * delta;
+            }
+
+            recent_scans.emplace_back(scan_msg, scan_pose);
+            while (int(recent_scans.size()) > std::max(1, correlativeScans))
+            {
+                recent_scans.pop_front();
+            }
+
+            icp.setReference(scan_msg->angle_min, scan_msg->angle_increment, scan_msg->ranges,
+                             scan_msg->range_min, scan_msg->range_max);
+            scanOdom_flag = true;
+            scan_flag = false;
+        }
+
         /**********
          * If a joint state message is received
          * *******/
@@ -188,16 +629,65 @@ int main(int argc, char* argv[])
              * ********/
             ninjaTurtle(joint_state_msg.position[0], joint_state_msg.position[1]);
 
+            // whether a measurement update ran, for the NEES
+            bool corrected = false;
+
+            /**********
+             * If a marker array is received in localization mode
+             * Only the robot pose is estimated, the landmarks stay where the map puts them
+             * *******/
+            if (localize && (markerArray_flag || markerArrayFake_flag))
+            {
+                // predict with the motion since the last prediction
+                Twist2D loc_twist = predictionTwist();
+                donatello.setProcessNoise(predictionNoise(Q, donatello.getStateVec()(0)));
+                donatello.predict(loc_twist);
+
+                // real sensor: match each measurement to the closest landmark inside the gate
+                if (markerArray_flag)
+                {
+                    for (auto marker: marker_array.markers)
+                    {
+                        colvec rangeBearing = RangeBearing(marker.pose.position.x, marker.pose.position.y);
+
+                        int j = donatello.DataAssociation(rangeBearing, associationGate);
+                        if (j >= 0)
+                        {
+                            donatello.update(j, rangeBearing);
+                            nisMonitor.add(donatello.NIS());
+                        }
+                    }
+                }
+
+                // fake sensor: the marker id is the landmark index
+                if (markerArrayFake_flag)
+                {
+                    for (auto marker: marker_array_fake.markers)
+                    {
+                        if ((marker.id < 0) || (marker.id >= donatello.numLandmarks()))
+                        {
+                            continue;
+                        }
+
+                        colvec rangeBearing = RangeBearing(marker.pose.position.x, marker.pose.position.y);
+                        donatello.update(marker.id, rangeBearing);
+                        nisMonitor.add(donatello.NIS());
+                    }
+                }
+
+                corrected = true;
+                markerArray_flag = false;
+                markerArrayFake_flag = false;
+            }
+
             /**********
              * If a marker array from real sensor is received
              * *******/
             if (markerArray_flag)
             {
-                // // get velocities from new wheel angle
-                // made a separate diffdrive object since marker array messages may be sent at a different freuqancy
-                Twist2D slam_twist = teenageMutant.getTwist(joint_state_msg.position[0], joint_state_msg.position[1]);
-
-                teenageMutant(joint_state_msg.position[0], joint_state_msg.position[1]);
+                // get the motion since the last prediction, from the wheels, the fused odometry or the scans
+                Twist2D slam_twist = predictionTwist();
+                raphael.setProcessNoise(predictionNoise(Q, raphael.getStateVec()(0)));
 
                 /***********
                  *  predict: update the estimate using the model
@@ -235,8 +725,15 @@ int main(int argc, char* argv[])
                     colvec rangeBearing(2);
                     rangeBearing = RangeBearing(marker.pose.position.x, marker.pose.position.y);
 
-                    // data association
-                    int j = raphael.DataAssociation(rangeBearing);
+                    // data association, by the radius of the tube first, circle_fit keeps it in scale.x
+                    const double radius = marker.scale.x;
+                    const int visited = raphael.getNumVisited();
+                    int j = raphael.DataAssociation(rangeBearing, radius);
+                    if (j < 1)
+                    {
+                        continue;
+                    }
+                    raphael.updateRadius(j, radius);
 
                     // compute theoretical measurements, given the current state estimate
                     colvec z_hat(2);
@@ -256,6 +753,12 @@ int main(int argc, char* argv[])
                     z_diff(1) = normalize_angle(z_diff(1));
                     stateUpdate = currentEstimate + K_j * z_diff;
 
+                    // a landmark seen for the first time is initialized at the measurement, no test of the filter
+                    if ((j >= 1) && (raphael.getNumVisited() == visited))
+                    {
+                        nisMonitor.add(raphael.NIS(z_diff));
+                    }
+
                     // compute the posterior covariance
                     mat currentCov(3+2*num, 3+2*num);
                     currentCov = raphael.getCov();
@@ -273,6 +776,7 @@ int main(int argc, char* argv[])
                     raphael.updateCov(newCov);
                 }
                 
+                corrected = true;
                 markerArray_flag = false;
             }
 
@@ -281,11 +785,9 @@ int main(int argc, char* argv[])
              * *******/
             if (markerArrayFake_flag)
             {
-                // // get velocities from new wheel angle
-                // made a separate diffdrive object since marker array messages may be sent at a different freuqancy
-                Twist2D slam_twist = teenageMutant.getTwist(joint_state_msg.position[0], joint_state_msg.position[1]);
-
-                teenageMutant(joint_state_msg.position[0], joint_state_msg.position[1]);
+                // get the motion since the last prediction, from the wheels, the fused odometry or the scans
+                Twist2D slam_twist = predictionTwist();
+                raphael.setProcessNoise(predictionNoise(Q, raphael.getStateVec()(0)));
 
                 /***********
                  *  predict: update the estimate using the model
@@ -315,14 +817,36 @@ int main(int argc, char* argv[])
                 raphael.updateCov(covNew);
                 
                 // for loop that goes through each marker that was measured
-                for (auto marker: marker_array.markers)
+                for (auto marker: marker_array_fake.markers)
                 {
-                    int j = marker.id + 1;
-
                     // put the marker (x,y) location in range-bearing form
                     colvec rangeBearing(2);
                     rangeBearing = RangeBearing(marker.pose.position.x, marker.pose.position.y);
 
+                    // the fake sensor knows which tube it saw, a tube seen for the first time takes the landmark
+                    // data association gives it, so loop closure, the other robots and a loaded map can move
+                    // and add landmarks without the tube ids pointing at the wrong ones
+                    const int visited = raphael.getNumVisited();
+                    int j;
+                    auto slot = fake_slots.find(marker.id);
+                    if (slot != fake_slots.end())
+                    {
+                        j = slot->second;
+                    } else
+                    {
+                        j = raphael.DataAssociation(rangeBearing);
+                        bool taken = false;
+                        for (const auto & tube: fake_slots)
+                        {
+                            taken = taken || (tube.second == j);
+                        }
+                        if ((j < 1) || taken)
+                        {
+                            continue;
+                        }
+                        fake_slots[marker.id] = j;
+                    }
+
                     // compute theoretical measurements, given the current state estimate
                     colvec z_hat(2);
                     z_hat = raphael.h(j);
@@ -341,6 +865,12 @@ int main(int argc, char* argv[])
                     z_diff(1) = normalize_angle(z_diff(1));
                     stateUpdate = currentEstimate + K_j * z_diff;
 
+                    // a landmark seen for the first time is initialized at the measurement, no test of the filter
+                    if (raphael.getNumVisited() == visited)
+                    {
+                        nisMonitor.add(raphael.NIS(z_diff));
+                    }
+
                     // compute the posterior covariance
                     mat currentCov(3+2*num, 3+2*num);
                     currentCov = raphael.getCov();
@@ -358,9 +888,230 @@ int main(int argc, char* argv[])
                     raphael.updateCov(newCov);
                 }
                 
+                corrected = true;
                 markerArrayFake_flag = false;
             }
 
+            /**********
+             * Loop closure: merge the duplicates found by the detection thread,
+             * then hand it the current landmarks every loop_closure_period
+             * *******/
+            if (loopDetector)
+            {
+                loop_closure::Closure closure;
+                if (loopDetector->poll(closure) && (closure.generation == landmark_generation))
+                {
+                    // the detector numbers landmarks from 0 in the order they were added, h from 1
+                    std::vector<std::pair<int, int>> pairs;
+                    for (const auto & match: closure.pairs)
+                    {
+                        pairs.emplace_back(match.first + 1, match.second + 1);
+                    }
+                    const std::vector<int> slots = mergedSlots(raphael.getNumVisited(), pairs);
+                    raphael.mergeLandmarks(pairs, loopClosureVariance);
+                    ++landmark_generation;
+
+                    for (auto & tube: fake_slots)
+                    {
+                        tube.second = slots[tube.second];
+                    }
+
+                    ROS_INFO("slam: loop closure merged %d landmarks, drift %f %f %f",
+                             int(pairs.size()), closure.x, closure.y, closure.th);
+                }
+
+                if ((current_time - lastLoopCheck).toSec() >= loopClosurePeriod)
+                {
+                    const colvec & state = raphael.getStateVec();
+                    int seen = std::min(raphael.getNumVisited(), num);
+                    std::vector<double> landmarks(state.begin() + 3, state.begin() + 3 + 2 * seen);
+
+                    if (loopDetector->submit(landmarks, landmark_generation))
+                    {
+                        lastLoopCheck = current_time;
+                    }
+                }
+            }
+
+            /**********
+             * Fuse the landmarks each robot in range sent in one covariance intersection, since how much
+             * of their information came from this robot is unknown, and add the ones this robot has not seen.
+             * Every exchange_period send them the landmarks that changed since the last exchange
+             * *******/
+            if (summaryTracker)
+            {
+                int fused = 0, adopted = 0;
+                for (const auto & msg: summaries)
+                {
+                    const size_t count = msg->ids.size();
+                    if ((msg->robot == robotName) || (msg->means.size() != 2 * count) || (msg->covs.size() != 3 * count))
+                    {
+                        continue;
+                    }
+                    summaryTracker->heard(msg->robot, msg->x, msg->y, current_time.toSec());
+
+                    const colvec & pose = raphael.getStateVec();
+                    if (!summaryTracker->inRange(msg->robot, pose(1), pose(2), current_time.toSec()))
+                    {
+                        continue;
+                    }
+
+                    // match every landmark of the summary first, a landmark of the filter takes the closest one
+                    std::map<int, std::pair<size_t, double>> matched;
+                    std::vector<size_t> unseen;
+                    for (size_t k = 0; k < count; ++k)
+                    {
+                        const exchange::LandmarkSummary landmark = {msg->ids[k], msg->means[2*k], msg->means[2*k+1],
+                                                                    {msg->covs[3*k], msg->covs[3*k+1], msg->covs[3*k+2]}};
+                        double distance;
+                        const int j = exchange::closestLandmark(raphael.getStateVec().memptr(), raphael.getCov().memptr(),
+                                                                3+2*num, raphael.getNumVisited(), landmark, distance);
+                        if ((j >= 0) && (distance < exchangeGate))
+                        {
+                            auto match = matched.find(j+1);
+                            if ((match == matched.end()) || (distance < match->second.second))
+                            {
+                                matched[j+1] = std::make_pair(k, distance);
+                            }
+                        } else if ((j < 0) || (distance > exchangeNewGate))
+                        {
+                            unseen.push_back(k);
+                        }
+                    }
+
+                    // the sender keeps no correlation between its landmarks, the stacked covariance is block diagonal
+                    std::vector<int> js;
+                    colvec means(2 * matched.size());
+                    mat B(2 * matched.size(), 2 * matched.size(), fill::zeros);
+                    for (const auto & match: matched)
+                    {
+                        const size_t k = match.second.first;
+                        const int i = js.size();
+                        js.push_back(match.first);
+                        means(2*i) = msg->means[2*k];
+                        means(2*i+1) = msg->means[2*k+1];
+                        B(2*i, 2*i) = msg->covs[3*k];
+                        B(2*i, 2*i+1) = msg->covs[3*k+1];
+                        B(2*i+1, 2*i) = msg->covs[3*k+1];
+                        B(2*i+1, 2*i+1) = msg->covs[3*k+2];
+                    }
+                    if (raphael.intersectLandmarks(js, means, B) < 1.0)
+                    {
+                        fused += js.size();
+                    }
+
+                    for (size_t k: unseen)
+                    {
+                        const colvec mean = {msg->means[2*k], msg->means[2*k+1]};
+                        const mat cov = {{msg->covs[3*k], msg->covs[3*k+1]}, {msg->covs[3*k+1], msg->covs[3*k+2]}};
+                        if (raphael.adoptLandmark(mean, cov) > 0)
+                        {
+                            ++adopted;
+                        }
+                    }
+                }
+                summaries.clear();
+
+                if (fused + adopted > 0)
+                {
+                    ROS_DEBUG("slam: fused %d and added %d landmarks from other robots", fused, adopted);
+                }
+
+                // sent even when nobody is in range, so the other robots know where this one is
+                if ((current_time - lastExchange).toSec() >= exchangePeriod)
+                {
+                    const colvec & state = raphael.getStateVec();
+                    summaryTracker->update(state.memptr(), raphael.getCov().memptr(), state.n_elem,
+                                           raphael.getNumVisited(), landmark_generation);
+                    summaryTracker->select(state(1), state(2), current_time.toSec(), outgoing);
+
+                    summary_msg.header.stamp = current_time;
+                    summary_msg.header.frame_id = map_frame_id;
+                    summary_msg.robot = robotName;
+                    summary_msg.x = state(1);
+                    summary_msg.y = state(2);
+                    summary_msg.generation = landmark_generation;
+                    summary_msg.ids.clear();
+                    summary_msg.means.clear();
+                    summary_msg.covs.clear();
+                    for (const auto & landmark: outgoing)
+                    {
+                        summary_msg.ids.push_back(landmark.id);
+                        summary_msg.means.insert(summary_msg.means.end(), {landmark.x, landmark.y});
+                        summary_msg.covs.insert(summary_msg.covs.end(), landmark.cov.begin(), landmark.cov.end());
+                    }
+                    summary_pub.publish(summary_msg);
+                    lastExchange = current_time;
+                }
+            }
+
+            /**********
+             * In simulation, after each correction test the pose against the true pose of the robot
+             * The map frame is the world frame, so the two compare directly
+             * *******/
+            if (tfListener && corrected)
+            {
+                try
+                {
+                    geometry_msgs::TransformStamped truth = tfBuffer.lookupTransform(world_frame_id, turtle_frame_id,
+                                                                                     ros::Time(0));
+                    const colvec & state = localize ? donatello.getStateVec() : raphael.getStateVec();
+                    const mat poseCov = localize ? donatello.getCov() : mat(raphael.getCov()(span(0, 2), span(0, 2)));
+
+                    std::array<double, 9> cov;
+                    std::copy(poseCov.begin(), poseCov.end(), cov.begin());
+                    const double nees = consistency::poseNees({state(0), state(1), state(2)},
+                                                              {tf2::getYaw(truth.transform.rotation),
+                                                               truth.transform.translation.x,
+                                                               truth.transform.translation.y}, cov);
+                    if (nees >= 0.0)
+                    {
+                        neesMonitor.add(nees);
+                    }
+                } catch (tf2::TransformException & ex)
+                {
+                    ROS_WARN_THROTTLE(10.0, "slam: no ground truth for the NEES, %s", ex.what());
+                }
+            }
+
+            /**********
+             * Publish the consistency of the filter every 1 / consistency_rate seconds,
+             * and warn when the innovations stop matching their covariance
+             * *******/
+            const consistency::Verdict verdict = nisMonitor.verdict();
+            if ((verdict != lastVerdict) && (verdict == consistency::Verdict::OVERCONFIDENT))
+            {
+                ROS_WARN("slam: the filter is overconfident, mean NIS %f above %f", nisMonitor.mean(),
+                         nisMonitor.upperBound());
+            } else if ((verdict != lastVerdict) && (verdict == consistency::Verdict::UNDERCONFIDENT))
+            {
+                ROS_WARN("slam: the filter is underconfident, mean NIS %f below %f", nisMonitor.mean(),
+                         nisMonitor.lowerBound());
+            }
+            lastVerdict = verdict;
+
+            if ((consistencyRate > 0.0) && ((current_time - lastConsistency).toSec() >= 1.0 / consistencyRate))
+            {
+                consistency_msg.header.stamp = current_time;
+                consistency_msg.header.frame_id = map_frame_id;
+                consistency_msg.updates = nisMonitor.count();
+                consistency_msg.nis = nisMonitor.latest();
+                consistency_msg.nis_mean = nisMonitor.mean();
+                consistency_msg.nis_lower = nisMonitor.lowerBound();
+                consistency_msg.nis_upper = nisMonitor.upperBound();
+                consistency_msg.nis_verdict = uint8_t(verdict);
+
+                consistency_msg.nees_valid = (neesMonitor.count() > 0);
+                consistency_msg.nees = neesMonitor.latest();
+                consistency_msg.nees_mean = neesMonitor.mean();
+                consistency_msg.nees_lower = neesMonitor.lowerBound();
+                consistency_msg.nees_upper = neesMonitor.upperBound();
+                consistency_msg.nees_verdict = uint8_t(neesMonitor.verdict());
+
+                consistency_pub.publish(consistency_msg);
+                lastConsistency = current_time;
+            }
+
             /**********
              * Publish a transform from world to map
              * *******/
@@ -382,12 +1133,16 @@ int main(int argc, char* argv[])
 
             /**********
              * Pubish a transfrom from map to odom
+             * T_map_odom = T_map_body * T_odom_body^-1, from whichever filter is running
              * *******/
-            tf2::Quaternion mapOdomQuater;
-            
-            colvec currentStateVec = raphael.getStateVec();
+            colvec currentStateVec = localize ? donatello.getStateVec() : raphael.getStateVec();
+
+            Transform2D mapBody(Vector2D(currentStateVec(1), currentStateVec(2)), currentStateVec(0));
+            Transform2D odomBody(Vector2D(ninjaTurtle.getX(), ninjaTurtle.getY()), ninjaTurtle.getTh());
+            Transform2D mapOdom = mapBody * odomBody.inv();
 
-            mapOdomQuater.setRPY(0.0, 0.0, currentStateVec(0) - ninjaTurtle.getTh());
+            tf2::Quaternion mapOdomQuater;
+            mapOdomQuater.setRPY(0.0, 0.0, atan2(mapOdom.getSinTh(), mapOdom.getCosTh()));
             geometry_msgs::Quaternion mapOdomQuat = tf2::toMsg(mapOdomQuater);
 
             geometry_msgs::TransformStamped mapOdomTrans;
@@ -395,8 +1150,8 @@ int main(int argc, char* argv[])
             mapOdomTrans.header.frame_id = map_frame_id;
             mapOdomTrans.child_frame_id = odom_frame_id;
 
-            mapOdomTrans.transform.translation.x = currentStateVec(1) - ninjaTurtle.getX();
-            mapOdomTrans.transform.translation.y = currentStateVec(2) - ninjaTurtle.getY();
+            mapOdomTrans.transform.translation.x = mapOdom.getX();
+            mapOdomTrans.transform.translation.y = mapOdom.getY();
             mapOdomTrans.transform.translation.z = 0.0;
             mapOdomTrans.transform.rotation = mapOdomQuat;
 
@@ -447,6 +1202,31 @@ int main(int argc, char* argv[])
             slam_path.poses.push_back(slam_poseStamp);
             slamPath_pub.publish(slam_path);
 
+            /**********
+             * Hand a snapshot to the checkpoint thread every checkpoint_period
+             * Copying it is all the loop does, the file is written in the background
+             * *******/
+            if (checkpointWriter && ((current_time - lastCheckpoint).toSec() >= checkpointPeriod))
+            {
+                if (localize)
+                {
+                    fillCheckpoint(snapshot, donatello.getStateVec(), donatello.getCov(), 0, current_time);
+                    snapshot.flags = checkpoint::CHECKPOINT_LOCALIZATION;
+                } else
+                {
+                    fillCheckpoint(snapshot, raphael.getStateVec(), raphael.getCov(), raphael.getNumVisited(),
+                                   current_time);
+                }
+                checkpointWriter->submit(snapshot);
+                lastCheckpoint = current_time;
+
+                const std::string error = checkpointWriter->lastError();
+                if (!error.empty())
+                {
+                    ROS_WARN_THROTTLE(10.0, "slam: checkpoint failed, %s", error.c_str());
+                }
+            }
+
             jointState_flag = false;
         }
 
@@ -469,6 +1249,106 @@ void fakeSensorCallback(const visualization_msgs::MarkerArray array)
     markerArrayFake_flag = true;
 }
 
+/// \brief callback function for subscriber to the landmark summaries of the other robots
+/// \param msg : a summary, fused in the main loop
+void summaryCallback(const nuslam::LandmarkSummary::ConstPtr & msg)
+{
+    summaries.push_back(msg);
+    if (summaries.size() > 100)
+    {
+        summaries.pop_front();
+    }
+}
+
+/// \brief callback function for subscriber to the fused odometry
+/// \param msg : the fused gyro / wheel odometry
+void fusedOdomCallback(const nav_msgs::Odometry::ConstPtr & msg)
+{
+    rigid2d::Vector2D trans(msg->pose.pose.position.x, msg->pose.pose.position.y);
+    fused_pose = rigid2d::Transform2D(trans, tf2::getYaw(msg->pose.pose.orientation));
+
+    if (!fusedOdom_flag)
+    {
+        fused_pose_predicted = fused_pose;
+        fusedOdom_flag = true;
+    }
+}
+
+/// \brief callback function for subscriber to the lidar scan
+/// \param msg : the scan
+void scanCallback(const sensor_msgs::LaserScan::ConstPtr & msg)
+{
+    scan_msg = msg;
+    scan_flag = true;
+}
+
+/// \brief converts a relative motion to the twist of an arc from the start to the end pose
+/// \param delta : the end pose in the frame of the start pose
+/// \return the body twist
+rigid2d::Twist2D arcTwist(const rigid2d::Transform2D & delta)
+{
+    rigid2d::Twist2D twist;
+    double chord = sqrt(pow(delta.getX(), 2) + pow(delta.getY(), 2));
+    twist.dth = atan2(delta.getSinTh(), delta.getCosTh());
+
+    // the arc through both poses turns by dth, so it is longer than its chord by (dth/2) / sin(dth/2)
+    double arc = chord;
+    const double half = 0.5 * twist.dth;
+    if (!rigid2d::almost_equal(half, 0.0))
+    {
+        arc = chord * half / sin(half);
+    }
+
+    twist.dx = (delta.getX() < 0.0) ? -arc : arc;
+    twist.dy = 0.0;
+    return twist;
+}
+
+/// \brief finds the motion of the robot since the last prediction step
+/// Uses the scan matching or the fused odometry if enabled and received, the wheels otherwise.
+/// The wheel diff drive used for prediction is advanced either way.
+/// \return the body twist that moves the robot from the last predicted pose to the current one
+rigid2d::Twist2D predictionTwist()
+{
+    using namespace rigid2d;
+
+    // made a separate diffdrive object since marker array messages may be sent at a different freuqancy
+    Twist2D twist = teenageMutant.getTwist(joint_state_msg.position[0], joint_state_msg.position[1]);
+    teenageMutant(joint_state_msg.position[0], joint_state_msg.position[1]);
+    twist_cov.zeros();
+
+    if (use_scan_matching && scanOdom_flag)
+    {
+        // the motion of the scans since the last prediction, with the covariance of the alignments
+        twist = arcTwist(scan_pose_predicted.inv() * scan_pose);
+        twist_cov = scan_cov;
+
+        scan_pose_predicted = scan_pose;
+        scan_cov.zeros();
+    } else if (use_fused_odom && fusedOdom_flag)
+    {
+        // the relative motion in the frame of the last predicted pose, treated as an arc
+        twist = arcTwist(fused_pose_predicted.inv() * fused_pose);
+        fused_pose_predicted = fused_pose;
+    }
+    return twist;
+}
+
+/// \brief the process noise of the next prediction
+/// Adds the covariance of the prediction twist, rotated from the body to the map frame, to Q
+/// \param Q : the 3x3 process noise from the parameters
+/// \param th : the heading of the robot before the prediction
+/// \return 3x3 process noise of (theta, x, y)
+arma::mat predictionNoise(const arma::mat & Q, double th)
+{
+    arma::mat rot(3, 3, arma::fill::eye);
+    rot(1, 1) = cos(th);
+    rot(1, 2) = -sin(th);
+    rot(2, 1) = sin(th);
+    rot(2, 2) = cos(th);
+    return Q + rot * twist_cov * rot.t();
+}
+
 /// \brief callback function for subscriber to joint state message
 /// Sends an odometry message and broadcasts a tf transform to update the configuration of the robot
 /// \param msg : the joint state message
@@ -497,9 +1377,153 @@ bool setPose(rigid2d::set_pose::Request &req, rigid2d::set_pose::Response &res)
 
     /****************************
     * Location of odometry reset so robot is at requested location
-    * Replaces ninjaTurtle with a new configuration
+    * Replaces ninjaTurtle with a new configuration, keeping the current wheel angles
+    ****************************/
+    double thL = 0.0, thR = 0.0;
+    if (joint_state_msg.position.size() >= 2)
+    {
+        thL = joint_state_msg.position[0];
+        thR = joint_state_msg.position[1];
+    }
+    ninjaTurtle = DiffDrive(wheelBase, wheelRad, xNew, yNew, thNew, thL, thR);
+    teenageMutant = DiffDrive(wheelBase, wheelRad, xNew, yNew, thNew, thL, thR);
+
+    /****************************
+    * The filters are reset in the main loop
     ****************************/
-    ninjaTurtle = DiffDrive(wheelBase, wheelRad, xNew, yNew, thNew, 0.0, 0.0);
+    setPose_x = xNew;
+    setPose_y = yNew;
+    setPose_th = thNew;
+    setPose_flag = true;
+
+    return true;
+}
+
+/// \brief saveMap function for save_map service
+/// Writes the state vector, covariance and landmark metadata of the EKF to map_file
+/// \param res : The service response
+/// \return true
+bool saveMap(std_srvs::Trigger::Request &, std_srvs::Trigger::Response & res)
+{
+    using namespace map_file;
+
+    std::string path = "nuslam_map.bin";
+    double tubeRad = 0.0;
+    ros::param::get("map_file", path);
+    ros::param::get("tube_radius", tubeRad);
+
+    const arma::colvec & state = ekf->getStateVec();
+    const arma::mat & cov = ekf->getCov();
+
+    std::vector<LandmarkInfo> landmarks;
+    for (int j = 0; j < int(state.n_elem - 3) / 2; ++j)
+    {
+        uint32_t flags = (j < ekf->getNumVisited()) ? LANDMARK_INITIALIZED : 0;
+        const bool fitted = ekf->getRadiusVar(j+1) >= 0.0;
+        landmarks.push_back({j, flags, fitted ? ekf->getRadius(j+1) : tubeRad});
+    }
+
+    std::string error;
+    res.success = map_file::saveMap(path, state.memptr(), state.n_elem, cov.memptr(), landmarks, error);
+    res.message = res.success ? "saved " + path : error;
+    return true;
+}
+
+/// \brief loadMap function for load_map service
+/// Replaces the EKF with the one saved in map_file
+/// \param res : The service response
+/// \return true
+bool loadMap(std_srvs::Trigger::Request &, std_srvs::Trigger::Response & res)
+{
+    res.success = loadMapFile(res.message);
+    return true;
+}
+
+/// \brief maps map_file and warm starts the EKF with it
+/// \param message : what was loaded, or why nothing was
+/// \return true if the EKF was replaced
+bool loadMapFile(std::string & message)
+{
+    using namespace map_file;
+
+    std::string path = "nuslam_map.bin";
+    ros::param::get("map_file", path);
+
+    MappedMap mapped;
+    if (!mapped.open(path, message))
+    {
+        return false;
+    }
+
+    const arma::uword len = mapped.stateLength();
+    if (len != ekf->getStateVec().n_elem)
+    {
+        message = path + " has " + std::to_string(mapped.numLandmarks()) + " landmarks, the filter has " +
+                  std::to_string((ekf->getStateVec().n_elem - 3) / 2);
+        return false;
+    }
+
+    int visited = 0;
+    for (uint64_t j = 0; j < mapped.numLandmarks(); ++j)
+    {
+        if (mapped.landmarks()[j].flags & LANDMARK_INITIALIZED)
+        {
+            ++visited;
+        }
+    }
+
+    // the filter keeps its own copy, the mapping can go once it is made
+    ekf->warmStart(arma::colvec(mapped.state(), len), arma::mat(mapped.cov(), len, len), visited);
+
+    // the map keeps no variance of the radii, they count as one fitted radius each
+    double radiusVariance = 0.0004;
+    ros::param::get("radius_variance", radiusVariance);
+    for (uint64_t j = 0; j < mapped.numLandmarks(); ++j)
+    {
+        if ((mapped.landmarks()[j].flags & LANDMARK_INITIALIZED) && (mapped.landmarks()[j].radius > 0.0))
+        {
+            ekf->setRadius(j+1, mapped.landmarks()[j].radius, radiusVariance);
+        }
+    }
+    ++landmark_generation;
+    fake_slots.clear();
 
+    message = "loaded " + path + " with " + std::to_string(visited) + " landmarks seen";
     return true;
-}
\ No newline at end of file
+}
+
+/// \brief the configuration and wheel angles of a diff drive
+/// \param odometry : the diff drive
+/// \return what is needed to rebuild it
+map_file::OdometryBaseline odometryBaseline(const rigid2d::DiffDrive & odometry)
+{
+    return {odometry.getX(), odometry.getY(), odometry.getTh(), odometry.getThL(), odometry.getThR()};
+}
+
+/// \brief fills a checkpoint with a filter, the radii of its landmarks and both odometries, reusing the storage of
+/// its vectors
+/// \param snapshot : the checkpoint to fill
+/// \param state : the state vector of the filter
+/// \param cov : the covariance of the filter
+/// \param visited : the number of landmarks seen
+/// \param stamp : the time of the snapshot
+void fillCheckpoint(checkpoint::Checkpoint & snapshot, const arma::colvec & state, const arma::mat & cov, int visited,
+                    const ros::Time & stamp)
+{
+    snapshot.stamp = stamp.toNSec();
+    snapshot.flags = 0;
+    snapshot.landmarkGeneration = landmark_generation;
+    snapshot.odometry = odometryBaseline(ninjaTurtle);
+    snapshot.prediction = odometryBaseline(teenageMutant);
+    snapshot.state.assign(state.begin(), state.end());
+    snapshot.cov.assign(cov.begin(), cov.end());
+
+    // a landmark without a fitted radius is written with none, so it is not given one on resume
+    snapshot.landmarks.clear();
+    for (int j = 0; j < int(state.n_elem - 3) / 2; ++j)
+    {
+        const uint32_t flags = (j < visited) ? map_file::LANDMARK_INITIALIZED : 0;
+        const bool fitted = (j < visited) && (ekf->getRadiusVar(j+1) >= 0.0);
+        snapshot.landmarks.push_back({j, flags, fitted ? ekf->getRadius(j+1) : 0.0});
+    }
+}
@@ -5,7 +5,10 @@
 #include "rigid2d/rigid2d.hpp"
 #include "rigid2d/diff_drive.hpp"
 #include <armadillo>
+#include <algorithm>
+#include <climits>
 #include <cmath>
+#include <functional>
 #include <random>
 
 namespace slam_library
@@ -21,6 +24,39 @@ namespace slam_library
         return rangeBearing;
     }
 
+    std::vector<int> mergedSlots(int visited, const std::vector<std::pair<int, int>> & pairs)
+    {
+        std::vector<int> kept(visited+1);
+        for (int j = 0; j <= visited; ++j)
+        {
+            kept[j] = j;
+        }
+        for (const auto & match: pairs)
+        {
+            kept[std::max(match.first, match.second)] = std::min(match.first, match.second);
+        }
+
+        std::vector<int> slots(visited+1, 0);
+        for (int j = 1; j <= visited; ++j)
+        {
+            // the kept landmark can be the duplicate of an older one in turn
+            int k = j;
+            while (kept[k] != k)
+            {
+                k = kept[k];
+            }
+
+            // every removed duplicate below it moves it down one slot
+            int removed = 0;
+            for (int i = 1; i < k; ++i)
+            {
+                removed += (kept[i] != i);
+            }
+            slots[j] = k - removed;
+        }
+        return slots;
+    }
+
     ExtendedKalman::ExtendedKalman(colvec robotState, colvec mapState, mat Q, mat R)
     {
         // size = arma::size(robotState) + arma::size(mapState);
@@ -42,6 +78,9 @@ namespace slam_library
         }
 
         initCov();
+
+        radius.assign(n, 0.0);
+        radiusVar.assign(n, -1.0);
     }
 
     const colvec & ExtendedKalman::getStateVec() const
@@ -66,6 +105,277 @@ namespace slam_library
         return *this;
     }
 
+    ExtendedKalman & ExtendedKalman::resetPose(colvec robotState, mat poseCov)
+    {
+        stateVec.subvec(0, 2) = robotState;
+
+        // the new pose says nothing about the old one, so drop its correlation with the map
+        cov.rows(0, 2).zeros();
+        cov.cols(0, 2).zeros();
+        cov.submat(0, 0, 2, 2) = poseCov;
+        return *this;
+    }
+
+    ExtendedKalman & ExtendedKalman::setProcessNoise(mat Q)
+    {
+        processNoise = Q;
+        return *this;
+    }
+
+    int ExtendedKalman::getNumVisited() const
+    {
+        return N;
+    }
+
+    ExtendedKalman & ExtendedKalman::setRadiusNoise(double variance, double gate)
+    {
+        radiusNoise = variance;
+        radiusGate = gate;
+        return *this;
+    }
+
+    ExtendedKalman & ExtendedKalman::updateRadius(int j, double r)
+    {
+        if ((j < 1) || (j > n) || !(r > 0.0))
+        {
+            return *this;
+        }
+
+        double & mean = radius[j-1];
+        double & var = radiusVar[j-1];
+        if (var < 0.0)
+        {
+            mean = r;
+            var = radiusNoise;
+            return *this;
+        }
+
+        // a scalar Kalman update, the radius does not change between measurements
+        const double K = var / (var + radiusNoise);
+        mean += K * (r - mean);
+        var *= (1.0 - K);
+        return *this;
+    }
+
+    ExtendedKalman & ExtendedKalman::setRadius(int j, double r, double variance)
+    {
+        if ((j >= 1) && (j <= n))
+        {
+            radius[j-1] = r;
+            radiusVar[j-1] = variance;
+        }
+        return *this;
+    }
+
+    double ExtendedKalman::getRadius(int j) const
+    {
+        return ((j >= 1) && (j <= n)) ? radius[j-1] : 0.0;
+    }
+
+    double ExtendedKalman::getRadiusVar(int j) const
+    {
+        return ((j >= 1) && (j <= n)) ? radiusVar[j-1] : -1.0;
+    }
+
+    void ExtendedKalman::associationStats(uint64_t & tested, uint64_t & rejected) const
+    {
+        tested = mahalanobisTests;
+        rejected = radiusRejected;
+    }
+
+    bool ExtendedKalman::radiusMatches(int j, double r) const
+    {
+        const double var = radiusVar[j-1];
+        if (var < 0.0)
+        {
+            return true;
+        }
+        const double diff = r - radius[j-1];
+        return diff * diff <= radiusGate * (var + radiusNoise);
+    }
+
+    ExtendedKalman & ExtendedKalman::warmStart(colvec savedState, mat savedCov, int visited)
+    {
+        stateVec = savedState;
+        cov = savedCov;
+        N = visited;
+
+        radius.assign(n, 0.0);
+        radiusVar.assign(n, -1.0);
+        return *this;
+    }
+
+    ExtendedKalman & ExtendedKalman::mergeLandmarks(const std::vector<std::pair<int, int>> & pairs, double variance)
+    {
+        const int m = pairs.size();
+        if (m == 0)
+        {
+            return *this;
+        }
+
+        // joint update: each pair measures the difference of the two locations as zero
+        mat H(2*m, len, fill::zeros);
+        for (int k = 0; k < m; ++k)
+        {
+            int a = pairs[k].first;
+            int b = pairs[k].second;
+
+            H(2*k, 1+2*a) = 1;
+            H(2*k, 1+2*b) = -1;
+            H(2*k+1, 2+2*a) = 1;
+            H(2*k+1, 2+2*b) = -1;
+        }
+
+        colvec z_diff = -H * stateVec;
+        mat S = H * cov * H.t() + variance * mat(2*m, 2*m, fill::eye);
+        mat K = cov * H.t() * inv(S);
+
+        stateVec += K * z_diff;
+        stateVec(0) = normalize_angle(stateVec(0));
+
+        mat Identity(len, len, fill::eye);
+        cov = (Identity - K * H) * cov;
+
+        // the kept landmark takes the radius of its duplicate too, weighted by the variances
+        for (const auto & match: pairs)
+        {
+            const int kept = std::min(match.first, match.second) - 1;
+            const int duplicate = std::max(match.first, match.second) - 1;
+            const double keptVar = radiusVar[kept], duplicateVar = radiusVar[duplicate];
+            if (duplicateVar < 0.0)
+            {
+                continue;
+            }
+            if (keptVar < 0.0)
+            {
+                radius[kept] = radius[duplicate];
+                radiusVar[kept] = duplicateVar;
+            } else
+            {
+                radius[kept] = (radius[kept] * duplicateVar + radius[duplicate] * keptVar) / (keptVar + duplicateVar);
+                radiusVar[kept] = keptVar * duplicateVar / (keptVar + duplicateVar);
+            }
+        }
+
+        // remove the duplicates, last first so the slots still to be removed do not move
+        std::vector<int> duplicates;
+        for (const auto & match: pairs)
+        {
+            duplicates.push_back(std::max(match.first, match.second));
+        }
+        std::sort(duplicates.begin(), duplicates.end(), std::greater<int>());
+        duplicates.erase(std::unique(duplicates.begin(), duplicates.end()), duplicates.end());
+
+        for (int j: duplicates)
+        {
+            stateVec.shed_rows(1+2*j, 2+2*j);
+            cov.shed_rows(1+2*j, 2+2*j);
+            cov.shed_cols(1+2*j, 2+2*j);
+
+            // the freed slot goes to the end, unseen as in initCov
+            stateVec.insert_rows(len-2, 2);
+            cov.insert_rows(len-2, 2);
+            cov.insert_cols(len-2, 2);
+            cov(len-2, len-2) = INT_MAX;
+            cov(len-1, len-1) = INT_MAX;
+
+            radius.erase(radius.begin() + (j-1));
+            radiusVar.erase(radiusVar.begin() + (j-1));
+            radius.push_back(0.0);
+            radiusVar.push_back(-1.0);
+
+            --N;
+        }
+        return *this;
+    }
+
+    double ExtendedKalman::intersectLandmarks(const std::vector<int> & js, colvec means, mat landmarkCov)
+    {
+        const int m = js.size();
+        if (m == 0)
+        {
+            return 1.0;
+        }
+
+        mat H(2*m, len, fill::zeros);
+        for (int k = 0; k < m; ++k)
+        {
+            H(2*k, 1+2*js[k]) = 1;
+            H(2*k+1, 2+2*js[k]) = 1;
+        }
+
+        // the unseen slots are uncorrelated with the rest, scaling them would change nothing
+        const int seen = 3 + 2*N;
+        const mat A = H * cov * H.t();
+
+        // log det of the fused covariance of the seen state, up to a constant. It is
+        // convex in omega, the golden section search finds its minimum
+        auto fusedLogDet = [&](double w)
+        {
+            double value, sign;
+            log_det(value, sign, (1.0 - w) * A + w * landmarkCov);
+            return -(seen - 2*m) * std::log(w) - value;
+        };
+
+        const double ratio = (std::sqrt(5.0) - 1.0) / 2.0;
+        double lo = 0.0, hi = 1.0;
+        double w1 = hi - ratio * (hi - lo), w2 = lo + ratio * (hi - lo);
+        double f1 = fusedLogDet(w1), f2 = fusedLogDet(w2);
+        for (int i = 0; i < 60; ++i)
+        {
+            if (f1 < f2)
+            {
+                hi = w2;
+                w2 = w1;
+                f2 = f1;
+                w1 = hi - ratio * (hi - lo);
+                f1 = fusedLogDet(w1);
+            } else
+            {
+                lo = w1;
+                w1 = w2;
+                f1 = f2;
+                w2 = lo + ratio * (hi - lo);
+                f2 = fusedLogDet(w2);
+            }
+        }
+
+        // at omega = 1 the estimates are ignored, it wins unless fusing shrinks the whole covariance
+        const double omega = (lo + hi) / 2.0;
+        if ((omega > 1.0 - 1e-6) || (fusedLogDet(omega) >= fusedLogDet(1.0)))
+        {
+            return 1.0;
+        }
+
+        // covariance intersection as a Kalman update of the scaled filter
+        cov(span(0, seen-1), span(0, seen-1)) /= omega;
+        mat S = H * cov * H.t() + landmarkCov / (1.0 - omega);
+        mat K = cov * H.t() * inv(S);
+
+        stateVec += K * (means - H * stateVec);
+        stateVec(0) = normalize_angle(stateVec(0));
+
+        mat Identity(len, len, fill::eye);
+        cov = (Identity - K * H) * cov;
+        return omega;
+    }
+
+    int ExtendedKalman::adoptLandmark(colvec mean, mat landmarkCov)
+    {
+        if (N >= n)
+        {
+            return -1;
+        }
+
+        // nothing of the filter is correlated with it yet
+        const int k = 3 + 2*N;
+        stateVec(span(k, k+1)) = mean;
+        cov.rows(k, k+1).zeros();
+        cov.cols(k, k+1).zeros();
+        cov(span(k, k+1), span(k, k+1)) = landmarkCov;
+        return ++N;
+    }
+
     void ExtendedKalman::initCov()
     {
         cov = mat(len, len, fill::zeros);
@@ -162,11 +472,23 @@ namespace slam_library
 
     mat ExtendedKalman::KalmanGain(int j)
     {
+        mat H = getH(j);
+        innovation = H * cov * H.t() + sensorNoise;
+
         mat K_i(len,2);
-        K_i = cov * getH(j).t() * (getH(j) * cov * getH(j).t() + sensorNoise).i();
+        K_i = cov * H.t() * innovation.i();
         return K_i;
     }
 
+    double ExtendedKalman::NIS(const colvec & z_diff) const
+    {
+        if (innovation.n_elem != 4)
+        {
+            return -1.0;
+        }
+        return as_scalar(z_diff.t() * solve(innovation, z_diff));
+    }
+
     mat ExtendedKalman::getH(int j)
     {
         mat H(2, len, fill::zeros);
@@ -221,7 +543,7 @@ namespace slam_library
         return tempH;
     }
 
-    int ExtendedKalman::DataAssociation(vec z_i)
+    int ExtendedKalman::DataAssociation(vec z_i, double r)
     {
         vec temp(3+2*(N+1));
         double max_threshold = 50;
@@ -233,19 +555,21 @@ namespace slam_library
             stateVec(3) = stateVec(1) + z_i(0) * cos(z_i(1) + stateVec(0));
             stateVec(4) = stateVec(2) + z_i(0) * sin(z_i(1) + stateVec(0));
 
-           return N++;
+           return ++N;
         }
 
         temp(span(0, 2+2*N)) = stateVec(span(0, 2+2*N));
         temp(3+2*N) = temp(1) + z_i(0) * cos(z_i(1) + temp(0));
         temp(4+2*N) = temp(2) + z_i(0) * sin(z_i(1) + temp(0));
 
-        for (int i = 1; i <= N; i++)
+        // the mahalanobis distance of the measurement to landmark i
+        auto mahalanobisTo = [&](int i)
         {
-            stateVec.print();
+            ++mahalanobisTests;
+
             // compute the linearized measurement model
             mat H_k = getH(i);
-            
+
             // compute the covariance
             mat psi_k = H_k * cov * H_k.t() + sensorNoise;
             // compute the expected measurement
@@ -253,7 +577,21 @@ namespace slam_library
 
             // compute the mahalanobis distance
             mat d_k = (z_i - z_hat).t() * psi_k.i() * (z_i - z_hat);
-            double mahalanobis = d_k(0);
+            return d_k(0);
+        };
+
+        std::vector<int> otherSize;
+        for (int i = 1; i <= N; i++)
+        {
+            // a tube of another size is not this landmark, whatever its location
+            if ((r > 0.0) && !radiusMatches(i, r))
+            {
+                ++radiusRejected;
+                otherSize.push_back(i);
+                continue;
+            }
+
+            double mahalanobis = mahalanobisTo(i);
   
             if (mahalanobis < min_threshold) // if less than min threshold
             {
@@ -264,8 +602,200 @@ namespace slam_library
             }
 
         }
+
+        // two tubes cannot stand in the same place, so a fit that only the radius kept from a landmark is a bad
+        // fit of that landmark rather than a new one
+        for (int i : otherSize)
+        {
+            if (mahalanobisTo(i) < max_threshold)
+            {
+                return -1;
+            }
+        }
+
+        // a new landmark, unless every slot of the state is taken
+        if (N >= n)
+        {
+            return -1;
+        }
         stateVec(3+2*N) = stateVec(1) + z_i(0) * cos(z_i(1) + stateVec(0));
         stateVec(4+2*N) = stateVec(2) + z_i(0) * sin(z_i(1) + stateVec(0));
-        return N++;
+        return ++N;
+    }
+
+    LocalizationKalman::LocalizationKalman(colvec robotState, colvec mapState, mat Q, mat R, double mapVar)
+    {
+        n = mapState.n_elem / 2;
+
+        stateVec = robotState;
+        processNoise = Q;
+        sensorNoise = R;
+        cov = mat(3, 3, fill::zeros);
+
+        landmarks = mat(2, n);
+        landmarkCov = cube(2, 2, n, fill::zeros);
+
+        for (int j = 0; j < n; ++j)
+        {
+            landmarks(0, j) = mapState(2*j);
+            landmarks(1, j) = mapState(2*j + 1);
+            landmarkCov(0, 0, j) = mapVar;
+            landmarkCov(1, 1, j) = mapVar;
+        }
+    }
+
+    const colvec & LocalizationKalman::getStateVec() const
+    {
+        return stateVec;
+    }
+
+    const mat & LocalizationKalman::getCov() const
+    {
+        return cov;
+    }
+
+    LocalizationKalman & LocalizationKalman::resetPose(colvec robotState, mat poseCov)
+    {
+        stateVec = robotState;
+        cov = poseCov;
+        return *this;
+    }
+
+    LocalizationKalman & LocalizationKalman::setProcessNoise(mat Q)
+    {
+        processNoise = Q;
+        return *this;
+    }
+
+    int LocalizationKalman::numLandmarks() const
+    {
+        return n;
+    }
+
+    colvec LocalizationKalman::getLandmark(int j) const
+    {
+        return landmarks.col(j);
+    }
+
+    LocalizationKalman & LocalizationKalman::setLandmarkCov(int j, mat landmarkCovj)
+    {
+        landmarkCov.slice(j) = landmarkCovj;
+        return *this;
+    }
+
+    LocalizationKalman & LocalizationKalman::predict(const Twist2D & tw)
+    {
+        double theta = stateVec(0);
+
+        mat A(3, 3, fill::eye);
+
+        if (tw.dth == 0.0)
+        {
+            stateVec(1) += tw.dx * cos(theta);
+            stateVec(2) += tw.dx * sin(theta);
+
+            A(1, 0) = -tw.dx * sin(theta);
+            A(2, 0) = tw.dx * cos(theta);
+        } else
+        {
+            double r = tw.dx / tw.dth;
+
+            stateVec(0) += tw.dth;
+            stateVec(1) += -r * sin(theta) + r * sin(theta + tw.dth);
+            stateVec(2) += r * cos(theta) - r * cos(theta + tw.dth);
+
+            A(1, 0) = -r * cos(theta) + r * cos(theta + tw.dth);
+            A(2, 0) = -r * sin(theta) + r * sin(theta + tw.dth);
+        }
+        stateVec(0) = normalize_angle(stateVec(0));
+
+        cov = A * cov * A.t() + processNoise;
+        return *this;
+    }
+
+    colvec LocalizationKalman::h(int j) const
+    {
+        double dx = landmarks(0, j) - stateVec(1);
+        double dy = landmarks(1, j) - stateVec(2);
+
+        colvec h_j(2);
+        h_j(0) = sqrt(pow(dx, 2) + pow(dy, 2));
+        h_j(1) = normalize_angle(atan2(dy, dx) - stateVec(0));
+        return h_j;
+    }
+
+    mat LocalizationKalman::getH(int j) const
+    {
+        double dx = landmarks(0, j) - stateVec(1);
+        double dy = landmarks(1, j) - stateVec(2);
+        double d = pow(dx, 2) + pow(dy, 2);
+
+        mat H(2, 3, fill::zeros);
+        H(1, 0) = -1;
+        H(0, 1) = -dx / sqrt(d);
+        H(1, 1) = dy / d;
+        H(0, 2) = -dy / sqrt(d);
+        H(1, 2) = -dx / d;
+        return H;
+    }
+
+    mat LocalizationKalman::innovationCov(int j) const
+    {
+        double dx = landmarks(0, j) - stateVec(1);
+        double dy = landmarks(1, j) - stateVec(2);
+        double d = pow(dx, 2) + pow(dy, 2);
+
+        // derivative of h_j with respect to the landmark location
+        mat H_m(2, 2);
+        H_m(0, 0) = dx / sqrt(d);
+        H_m(0, 1) = dy / sqrt(d);
+        H_m(1, 0) = -dy / d;
+        H_m(1, 1) = dx / d;
+
+        mat H = getH(j);
+        return H * cov * H.t() + sensorNoise + H_m * landmarkCov.slice(j) * H_m.t();
+    }
+
+    LocalizationKalman & LocalizationKalman::update(int j, const colvec & z)
+    {
+        mat H = getH(j);
+        mat S = innovationCov(j);
+        mat K = cov * H.t() * inv(S);
+
+        colvec z_diff = z - h(j);
+        z_diff(1) = normalize_angle(z_diff(1));
+        nis = as_scalar(z_diff.t() * solve(S, z_diff));
+
+        stateVec += K * z_diff;
+        stateVec(0) = normalize_angle(stateVec(0));
+
+        mat I(3, 3, fill::eye);
+        cov = (I - K * H) * cov;
+        return *this;
+    }
+
+    double LocalizationKalman::NIS() const
+    {
+        return nis;
+    }
+
+    int LocalizationKalman::DataAssociation(const colvec & z, double gate) const
+    {
+        int best = -1;
+        double bestDist = gate;
+
+        for (int j = 0; j < n; ++j)
+        {
+            colvec z_diff = z - h(j);
+            z_diff(1) = normalize_angle(z_diff(1));
+
+            double mahalanobis = as_scalar(z_diff.t() * inv(innovationCov(j)) * z_diff);
+            if (mahalanobis < bestDist)
+            {
+                bestDist = mahalanobis;
+                best = j;
+            }
+        }
+        return best;
     }
 }
\ No newline at end of file
@@ -0,0 +1,411 @@
+/// \file trajectory_eval_library.cpp
+/// \brief a library that measures the absolute and relative pose error of a recorded trajectory
+
+#include "nuslam/trajectory_eval_library.hpp"
+#include "rigid2d/rigid2d.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+
+namespace trajectory_eval
+{
+    using rigid2d::Transform2D;
+    using rigid2d::Vector2D;
+
+    /// \brief the most estimates kept waiting for the ground truth
+    static const size_t MAX_PENDING = 100000;
+
+    /// \brief the transform of a pose
+    static Transform2D transform(const StampedPose & pose)
+    {
+        return Transform2D(Vector2D(pose.x, pose.y), pose.th);
+    }
+
+    /// \brief the angle of a transform
+    static double angle(const Transform2D & T)
+    {
+        return std::atan2(T.getSinTh(), T.getCosTh());
+    }
+
+    /// \brief writes the statistics of an error as a JSON object
+    static void jsonStats(const ErrorStats & stats, std::ostream & out)
+    {
+        out << "{\"rmse\": " << stats.rmse() << ", \"mean\": " << stats.mean() << ", \"max\": " << stats.max << "}";
+    }
+
+    TimeAssociator::TimeAssociator(double maxTruthGap)
+        : maxGap(maxTruthGap), unmatched(0)
+    {
+    }
+
+    bool TimeAssociator::pair(const StampedPose & estimate, std::vector<PosePair> & pairs) const
+    {
+        if (truth.empty())
+        {
+            return false;
+        }
+        const StampedPose & b = truth.back();
+        if (estimate.t == b.t)
+        {
+            pairs.push_back({estimate, b});
+            return true;
+        }
+
+        const StampedPose & a = truth.front();
+        if ((truth.size() < 2) || (estimate.t < a.t) || (estimate.t > b.t) || (b.t - a.t > maxGap))
+        {
+            return false;
+        }
+
+        const double f = (estimate.t - a.t) / (b.t - a.t);
+        StampedPose between;
+        between.t = estimate.t;
+        between.th = rigid2d::normalize_angle(a.th + f * rigid2d::normalize_angle(b.th - a.th));
+        between.x = a.x + f * (b.x - a.x);
+        between.y = a.y + f * (b.y - a.y);
+        pairs.push_back({estimate, between});
+        return true;
+    }
+
+    void TimeAssociator::addTruth(const StampedPose & pose, std::vector<PosePair> & pairs)
+    {
+        if (!truth.empty() && (pose.t <= truth.back().t))
+        {
+            return;
+        }
+        truth.push_back(pose);
+        if (truth.size() > 2)
+        {
+            truth.pop_front();
+        }
+
+        while (!pending.empty() && (pending.front().t <= pose.t))
+        {
+            if (!pair(pending.front(), pairs))
+            {
+                ++unmatched;
+            }
+            pending.pop_front();
+        }
+    }
+
+    void TimeAssociator::addEstimate(const StampedPose & pose, std::vector<PosePair> & pairs)
+    {
+        if (!truth.empty() && (pose.t <= truth.back().t))
+        {
+            if (!pair(pose, pairs))
+            {
+                ++unmatched;
+            }
+            return;
+        }
+
+        pending.push_back(pose);
+        if (pending.size() > MAX_PENDING)
+        {
+            pending.pop_front();
+            ++unmatched;
+        }
+    }
+
+    uint64_t TimeAssociator::unpaired() const
+    {
+        return unmatched + pending.size();
+    }
+
+    Se2Aligner::Se2Aligner()
+        : count(0), sumP{0.0, 0.0}, sumQ{0.0, 0.0}, sumDot(0.0), sumCross(0.0)
+    {
+    }
+
+    void Se2Aligner::add(const PosePair & pair)
+    {
+        const StampedPose & p = pair.estimate;
+        const StampedPose & q = pair.truth;
+        ++count;
+        sumP[0] += p.x;
+        sumP[1] += p.y;
+        sumQ[0] += q.x;
+        sumQ[1] += q.y;
+        sumDot += p.x * q.x + p.y * q.y;
+        sumCross += p.x * q.y - p.y * q.x;
+    }
+
+    Alignment Se2Aligner::solve() const
+    {
+        Alignment alignment;
+        if (count < 2)
+        {
+            return alignment;
+        }
+
+        // the rotation that best turns the centered estimate onto the centered ground truth
+        const double px = sumP[0] / count, py = sumP[1] / count;
+        const double qx = sumQ[0] / count, qy = sumQ[1] / count;
+        const double dot = sumDot - count * (px * qx + py * qy);
+        const double cross = sumCross - count * (px * qy - py * qx);
+
+        alignment.valid = true;
+        alignment.th = ((dot == 0.0) && (cross == 0.0)) ? 0.0 : std::atan2(cross, dot);
+        alignment.x = qx - (std::cos(alignment.th) * px - std::sin(alignment.th) * py);
+        alignment.y = qy - (std::sin(alignment.th) * px + std::cos(alignment.th) * py);
+        return alignment;
+    }
+
+    void ErrorStats::add(double error)
+    {
+        ++count;
+        sum += error;
+        sumSq += error * error;
+        max = std::max(max, error);
+    }
+
+    double ErrorStats::mean() const
+    {
+        return (count > 0) ? sum / count : 0.0;
+    }
+
+    double ErrorStats::rmse() const
+    {
+        return (count > 0) ? std::sqrt(sumSq / count) : 0.0;
+    }
+
+    RelativeError::RelativeError(double deltaTime)
+        : delta(deltaTime)
+    {
+    }
+
+    void RelativeError::add(const PosePair & pair)
+    {
+        const double t = pair.estimate.t;
+        while ((recent.size() >= 2) && (recent[1].estimate.t <= t - delta))
+        {
+            recent.pop_front();
+        }
+
+        // the pair delta before, unless the trajectory has a gap there
+        if (!recent.empty() && (recent.front().estimate.t <= t - delta) && (recent.front().estimate.t >= t - 2.0 * delta))
+        {
+            const PosePair & before = recent.front();
+            const Transform2D moved = transform(before.estimate).inv() * transform(pair.estimate);
+            const Transform2D truth = transform(before.truth).inv() * transform(pair.truth);
+            const Transform2D error = truth.inv() * moved;
+
+            translation.add(std::hypot(error.getX(), error.getY()));
+            rotation.add(std::abs(angle(error)));
+        }
+        recent.push_back(pair);
+    }
+
+    void absoluteError(const Alignment & alignment, const PosePair & pair, double & translation, double & rotation)
+    {
+        const double c = std::cos(alignment.th), s = std::sin(alignment.th);
+        const StampedPose & p = pair.estimate;
+        const double x = c * p.x - s * p.y + alignment.x;
+        const double y = s * p.x + c * p.y + alignment.y;
+
+        translation = std::hypot(x - pair.truth.x, y - pair.truth.y);
+        rotation = std::abs(rigid2d::normalize_angle(p.th + alignment.th - pair.truth.th));
+    }
+
+    std::string sourceName(sensor_log::PoseSource source)
+    {
+        switch (source)
+        {
+            case sensor_log::PoseSource::SLAM:
+                return "slam";
+            case sensor_log::PoseSource::ODOMETRY:
+                return "odom";
+            case sensor_log::PoseSource::TRUTH:
+                return "real";
+        }
+        return "unknown";
+    }
+
+    bool evaluateLog(sensor_log::LogReader & reader, const EvalParams & params, Report & report, std::string & error)
+    {
+        using namespace sensor_log;
+
+        const auto start = std::chrono::steady_clock::now();
+        report = Report();
+        report.estimate = sourceName(params.estimate);
+        report.rpeDelta = params.rpeDelta;
+        report.records = reader.numRecords();
+        if (params.estimate == PoseSource::TRUTH)
+        {
+            error = "the ground truth cannot be evaluated against itself";
+            return false;
+        }
+
+        /**********
+         * First pass: pair the poses, fit the alignment and measure the relative error and the throughput
+         * *******/
+        TimeAssociator associator(params.maxTruthGap);
+        Se2Aligner aligner;
+        RelativeError relative(params.rpeDelta);
+        std::vector<PosePair> pairs;
+
+        int64_t firstTime = 0, lastTime = 0, firstWall = 0, lastWall = 0;
+        uint64_t scans = 0, scansAtLast = 0;
+
+        Record r;
+        reader.rewind();
+        while (reader.next(r))
+        {
+            if (r.type == RecordType::SCAN)
+            {
+                scans += (report.estimates > 0);
+                continue;
+            }
+            if (r.type != RecordType::POSE)
+            {
+                continue;
+            }
+
+            const StampedPose pose = {r.time * 1e-9, r.pose.th, r.pose.x, r.pose.y};
+            pairs.clear();
+            if (r.pose.source == PoseSource::TRUTH)
+            {
+                ++report.truths;
+                associator.addTruth(pose, pairs);
+            } else if (r.pose.source == params.estimate)
+            {
+                if (report.estimates++ == 0)
+                {
+                    firstTime = r.time;
+                    firstWall = r.pose.wallTime;
+                }
+                lastTime = r.time;
+                lastWall = r.pose.wallTime;
+                scansAtLast = scans;
+                associator.addEstimate(pose, pairs);
+            }
+
+            for (const auto & pair: pairs)
+            {
+                aligner.add(pair);
+                relative.add(pair);
+                ++report.pairs;
+            }
+        }
+
+        report.unpaired = associator.unpaired();
+        report.rpeTranslation = relative.translation;
+        report.rpeRotation = relative.rotation;
+        report.alignment = aligner.solve();
+
+        report.scans = scansAtLast;
+        report.logDuration = (lastTime - firstTime) * 1e-9;
+        report.wallDuration = (lastWall - firstWall) * 1e-9;
+        if (report.wallDuration > 0.0)
+        {
+            report.realtimeFactor = report.logDuration / report.wallDuration;
+            report.estimateRate = (report.estimates - 1) / report.wallDuration;
+            report.scanRate = report.scans / report.wallDuration;
+        }
+
+        if (!report.alignment.valid)
+        {
+            error = "fewer than 2 " + report.estimate + " poses could be paired with the ground truth";
+            return false;
+        }
+
+        /**********
+         * Second pass: the absolute error of every pair once the estimate is aligned
+         * *******/
+        associator = TimeAssociator(params.maxTruthGap);
+        reader.rewind();
+        while (reader.next(r))
+        {
+            if (r.type != RecordType::POSE)
+            {
+                continue;
+            }
+
+            const StampedPose pose = {r.time * 1e-9, r.pose.th, r.pose.x, r.pose.y};
+            pairs.clear();
+            if (r.pose.source == PoseSource::TRUTH)
+            {
+                associator.addTruth(pose, pairs);
+            } else if (r.pose.source == params.estimate)
+            {
+                associator.addEstimate(pose, pairs);
+            }
+
+            for (const auto & pair: pairs)
+            {
+                double translation, rotation;
+                absoluteError(report.alignment, pair, translation, rotation);
+                report.ateTranslation.add(translation);
+                report.ateRotation.add(rotation);
+            }
+        }
+
+        report.evaluationTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return true;
+    }
+
+    void writeJson(const Report & report, std::ostream & out)
+    {
+        const std::ios::fmtflags flags = out.flags();
+        const std::streamsize precision = out.precision(9);
+
+        out << "{\n";
+        out << "  \"estimate\": \"" << report.estimate << "\",\n";
+        out << "  \"poses\": {\"estimates\": " << report.estimates << ", \"truths\": " << report.truths
+            << ", \"pairs\": " << report.pairs << ", \"unpaired\": " << report.unpaired << "},\n";
+        out << "  \"alignment\": {\"th\": " << report.alignment.th << ", \"x\": " << report.alignment.x
+            << ", \"y\": " << report.alignment.y << "},\n";
+        out << "  \"ate\": {\"count\": " << report.ateTranslation.count << ", \"translation\": ";
+        jsonStats(report.ateTranslation, out);
+        out << ", \"rotation\": ";
+        jsonStats(report.ateRotation, out);
+        out << "},\n";
+        out << "  \"rpe\": {\"delta\": " << report.rpeDelta << ", \"count\": " << report.rpeTranslation.count
+            << ", \"translation\": ";
+        jsonStats(report.rpeTranslation, out);
+        out << ", \"rotation\": ";
+        jsonStats(report.rpeRotation, out);
+        out << "},\n";
+        out << "  \"throughput\": {\"log_duration\": " << report.logDuration << ", \"wall_duration\": "
+            << report.wallDuration << ", \"realtime_factor\": " << report.realtimeFactor << ", \"estimate_rate\": "
+            << report.estimateRate << ", \"scans\": " << report.scans << ", \"scan_rate\": " << report.scanRate
+            << "},\n";
+        out << "  \"evaluation\": {\"records\": " << report.records << ", \"time\": " << report.evaluationTime << "}\n";
+        out << "}\n";
+
+        out.precision(precision);
+        out.flags(flags);
+    }
+
+    void writeCsv(const Report & report, std::ostream & out, bool header)
+    {
+        if (header)
+        {
+            out << "estimate,estimates,truths,pairs,unpaired,align_th,align_x,align_y,"
+                << "ate_rmse,ate_mean,ate_max,ate_rot_rmse,ate_rot_mean,ate_rot_max,"
+                << "rpe_delta,rpe_rmse,rpe_mean,rpe_max,rpe_rot_rmse,rpe_rot_mean,rpe_rot_max,"
+                << "log_duration,wall_duration,realtime_factor,estimate_rate,scans,scan_rate,records,evaluation_time\n";
+        }
+
+        const std::ios::fmtflags flags = out.flags();
+        const std::streamsize precision = out.precision(9);
+
+        auto stats = [&](const ErrorStats & s) { out << s.rmse() << "," << s.mean() << "," << s.max << ","; };
+        out << report.estimate << "," << report.estimates << "," << report.truths << "," << report.pairs << ","
+            << report.unpaired << "," << report.alignment.th << "," << report.alignment.x << ","
+            << report.alignment.y << ",";
+        stats(report.ateTranslation);
+        stats(report.ateRotation);
+        out << report.rpeDelta << ",";
+        stats(report.rpeTranslation);
+        stats(report.rpeRotation);
+        out << report.logDuration << "," << report.wallDuration << "," << report.realtimeFactor << ","
+            << report.estimateRate << "," << report.scans << "," << report.scanRate << "," << report.records << ","
+            << report.evaluationTime << "\n";
+
+        out.precision(precision);
+        out.flags(flags);
+    }
+}
@@ -0,0 +1,159 @@
+#include <catch_ros/catch.hpp>
+#include <nuslam/checkpoint_library.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+/// \brief a checkpoint with n landmarks and values recognizable by k
+static checkpoint::Checkpoint testCheckpoint(int n, int k)
+{
+    checkpoint::Checkpoint snapshot;
+    const int len = 3 + 2 * n;
+    for (int i = 0; i < len; ++i)
+    {
+        snapshot.state.push_back(0.5 * i - 1.0 + k);
+    }
+    for (int i = 0; i < len * len; ++i)
+    {
+        snapshot.cov.push_back(1e-3 * i + k);
+    }
+    for (int j = 0; j < n; ++j)
+    {
+        const bool seen = j < n / 2;
+        snapshot.landmarks.push_back({j, seen ? map_file::LANDMARK_INITIALIZED : 0u, seen ? 0.05 + 0.01 * j : 0.0});
+    }
+    snapshot.stamp = 1000000000LL * k;
+    snapshot.landmarkGeneration = k;
+    snapshot.odometry = {1.0 + k, 2.0, 0.3, 10.5, -4.25};
+    snapshot.prediction = {0.9 + k, 2.1, 0.25, 10.0, -4.0};
+    return snapshot;
+}
+
+TEST_CASE("A written checkpoint reads back unchanged", "[checkpoint]")
+{
+    using namespace checkpoint;
+
+    const std::string path = "/tmp/nuslam_checkpoint_test_" + std::to_string(getpid()) + ".bin";
+    std::string error;
+
+    Checkpoint saved = testCheckpoint(6, 3);
+    saved.sequence = 42;
+    REQUIRE(writeCheckpoint(path, saved, error));
+
+    Checkpoint loaded;
+    REQUIRE(readCheckpoint(path, loaded, error));
+
+    REQUIRE(loaded.sequence == 42);
+    REQUIRE(loaded.stamp == saved.stamp);
+    REQUIRE(loaded.flags == 0);
+    REQUIRE(loaded.landmarkGeneration == 3);
+    REQUIRE(loaded.odometry.x == 4.0);
+    REQUIRE(loaded.odometry.thR == -4.25);
+    REQUIRE(loaded.prediction.thL == 10.0);
+    REQUIRE(loaded.state == saved.state);
+    REQUIRE(loaded.cov == saved.cov);
+
+    // the fitted radii come back with the landmarks they belong to
+    REQUIRE(loaded.landmarks.size() == 6);
+    REQUIRE(loaded.landmarks[2].flags == map_file::LANDMARK_INITIALIZED);
+    REQUIRE(loaded.landmarks[2].radius == 0.07);
+    REQUIRE(loaded.landmarks[3].flags == 0);
+
+    // a checkpoint is also a map
+    map_file::MappedMap mapped;
+    REQUIRE(mapped.open(path, error));
+    REQUIRE(mapped.numLandmarks() == 6);
+    REQUIRE(mapped.odometry()->sequence == 42);
+    mapped.close();
+
+    // the localization filter only has the pose
+    Checkpoint pose = testCheckpoint(0, 1);
+    pose.flags = CHECKPOINT_LOCALIZATION;
+    REQUIRE(writeCheckpoint(path, pose, error));
+    REQUIRE(readCheckpoint(path, loaded, error));
+    REQUIRE(loaded.flags == CHECKPOINT_LOCALIZATION);
+    REQUIRE(loaded.state.size() == 3);
+    REQUIRE(loaded.cov.size() == 9);
+
+    // a covariance that does not match the state is refused, and so are missing landmarks
+    Checkpoint bad = testCheckpoint(2, 0);
+    bad.cov.pop_back();
+    REQUIRE(!writeCheckpoint(path, bad, error));
+    bad = testCheckpoint(2, 0);
+    bad.landmarks.pop_back();
+    REQUIRE(!writeCheckpoint(path, bad, error));
+    REQUIRE(readCheckpoint(path, loaded, error));
+    REQUIRE(loaded.flags == CHECKPOINT_LOCALIZATION);
+
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Truncated or foreign checkpoints are refused", "[checkpoint]")
+{
+    using namespace checkpoint;
+
+    const std::string path = "/tmp/nuslam_checkpoint_test_" + std::to_string(getpid()) + ".bin";
+    std::string error;
+    Checkpoint loaded;
+
+    REQUIRE(!readCheckpoint(path + ".missing", loaded, error));
+
+    // a saved map has no odometry to resume from
+    const Checkpoint map = testCheckpoint(4, 1);
+    REQUIRE(map_file::saveMap(path, map.state.data(), map.state.size(), map.cov.data(), map.landmarks, error));
+    REQUIRE(!readCheckpoint(path, loaded, error));
+
+    REQUIRE(writeCheckpoint(path, testCheckpoint(4, 1), error));
+    std::vector<char> bytes;
+    {
+        std::ifstream file(path, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(bytes.data(), bytes.size() - 8);
+    }
+    REQUIRE(!readCheckpoint(path, loaded, error));
+
+    bytes[0] = 'X';
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(bytes.data(), bytes.size());
+    }
+    REQUIRE(!readCheckpoint(path, loaded, error));
+
+    std::remove(path.c_str());
+}
+
+TEST_CASE("The writer keeps the latest snapshot", "[checkpoint]")
+{
+    using namespace checkpoint;
+
+    const std::string path = "/tmp/nuslam_checkpoint_test_" + std::to_string(getpid()) + ".bin";
+    std::string error;
+
+    const int submits = 200;
+    {
+        CheckpointWriter writer(path);
+        for (int k = 1; k <= submits; ++k)
+        {
+            writer.submit(testCheckpoint(20, k));
+        }
+        // the last one is written when the writer goes
+    }
+
+    Checkpoint loaded;
+    REQUIRE(readCheckpoint(path, loaded, error));
+    REQUIRE(loaded.sequence == submits);
+    REQUIRE(loaded.landmarkGeneration == submits);
+    REQUIRE(loaded.state == testCheckpoint(20, submits).state);
+
+    std::ifstream tmp(path + ".tmp");
+    REQUIRE(!tmp.good());
+    std::remove(path.c_str());
+}
@@ -3,6 +3,7 @@
 #include <armadillo>
 #include <geometry_msgs/Point.h>
 #include <visualization_msgs/Marker.h>
+#include <cmath>
 #include <vector>
 
 /// \brief testing circle fitting algorithm 
@@ -77,4 +78,30 @@ TEST_CASE("circle fit test 2", "[circle fit test 2]")
     REQUIRE(marker.pose.position.x == Approx(0.4908357));
     REQUIRE(marker.pose.position.y == Approx(-22.15212));
     REQUIRE(marker.scale.x == Approx(22.17979));
-}
\ No newline at end of file
+}
+
+/// \brief testing clustering of scans that do not have 360 beams
+TEST_CASE("Clustering takes any number of beams around the full circle", "[cluster points]")
+{
+    using namespace circle_fit;
+
+    // 720 beams, half a degree apart, with a patch at 1 m from 50 to 54.5 degrees
+    std::vector<float> ranges(720, 10.0);
+    for (int i = 100; i < 110; ++i)
+    {
+        ranges[i] = 1.0;
+    }
+
+    std::vector<std::vector<geometry_msgs::Point>> clusters = ClusterPoints(ranges, 0.12, 3.5);
+    REQUIRE(clusters.size() == 1);
+    REQUIRE(clusters[0].size() == 10);
+    REQUIRE(clusters[0].front().x == Approx(cos(50.0 * M_PI / 180.0)));
+    REQUIRE(clusters[0].front().y == Approx(sin(50.0 * M_PI / 180.0)));
+    REQUIRE(clusters[0].back().y == Approx(sin(54.5 * M_PI / 180.0)));
+
+    // nothing breaks a scan of a round room, it is one cluster that wraps around
+    std::vector<float> room(720, 1.0);
+    clusters = ClusterPoints(room, 0.12, 3.5);
+    REQUIRE(clusters.size() == 1);
+    REQUIRE(clusters[0].size() == 720);
+}
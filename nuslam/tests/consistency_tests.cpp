@@ -0,0 +1,97 @@
+#include <catch_ros/catch.hpp>
+#include <nuslam/consistency_library.hpp>
+#include <array>
+#include <cmath>
+#include <random>
+
+/// \brief a sample of the chi-square distribution with dof degrees of freedom, scaled by scale
+static double chiSquare(std::mt19937 & rng, int dof, double scale)
+{
+    std::normal_distribution<double> normal(0.0, 1.0);
+    double sum = 0.0;
+    for (int k = 0; k < dof; ++k)
+    {
+        const double x = normal(rng);
+        sum += x * x;
+    }
+    return scale * sum;
+}
+
+TEST_CASE("The chi-square quantiles are close to the tabulated ones", "[consistency]")
+{
+    using namespace consistency;
+
+    REQUIRE(chiSquareQuantile(0.95, 2.0) == Approx(5.991).epsilon(0.02));
+    REQUIRE(chiSquareQuantile(0.99, 2.0) == Approx(9.210).epsilon(0.02));
+    REQUIRE(chiSquareQuantile(0.95, 3.0) == Approx(7.815).epsilon(0.02));
+    REQUIRE(chiSquareQuantile(0.025, 100.0) == Approx(74.22).epsilon(0.005));
+    REQUIRE(chiSquareQuantile(0.975, 100.0) == Approx(129.56).epsilon(0.005));
+}
+
+TEST_CASE("A window of normalized errors tells a consistent filter from a wrong one", "[consistency]")
+{
+    using namespace consistency;
+    std::mt19937 rng(7);
+
+    ConsistencyMonitor monitor(50, 2, 0.95);
+    REQUIRE(monitor.lowerBound() < 2.0);
+    REQUIRE(monitor.upperBound() > 2.0);
+
+    for (int k = 0; k < 49; ++k)
+    {
+        monitor.add(chiSquare(rng, 2, 1.0));
+    }
+    REQUIRE(monitor.verdict() == Verdict::FILLING);
+
+    // errors as large as the covariance says
+    int alarms = 0;
+    for (int k = 0; k < 1000; ++k)
+    {
+        monitor.add(chiSquare(rng, 2, 1.0));
+        alarms += (monitor.verdict() != Verdict::CONSISTENT);
+    }
+    REQUIRE(alarms < 150);
+    REQUIRE(monitor.count() == 1049);
+
+    // errors twice as large as the covariance says
+    for (int k = 0; k < 50; ++k)
+    {
+        monitor.add(chiSquare(rng, 2, 2.0));
+    }
+    REQUIRE(monitor.verdict() == Verdict::OVERCONFIDENT);
+
+    // errors much smaller
+    for (int k = 0; k < 50; ++k)
+    {
+        monitor.add(chiSquare(rng, 2, 0.3));
+    }
+    REQUIRE(monitor.verdict() == Verdict::UNDERCONFIDENT);
+
+    // samples that are not numbers are dropped, a cleared window fills again
+    monitor.add(std::nan(""));
+    REQUIRE(monitor.count() == 1149);
+    monitor.clear();
+    REQUIRE(monitor.verdict() == Verdict::FILLING);
+    REQUIRE(monitor.mean() == 0.0);
+}
+
+TEST_CASE("The pose NEES wraps the heading and uses the full covariance", "[consistency]")
+{
+    using namespace consistency;
+
+    const std::array<double, 9> diagonal = {0.01, 0.0, 0.0, 0.0, 0.04, 0.0, 0.0, 0.0, 0.25};
+    REQUIRE(poseNees({0.1, 1.2, 2.5}, {0.0, 1.0, 2.0}, diagonal) == Approx(1.0 + 1.0 + 1.0));
+
+    // 3.1 and -3.1 are 0.083 apart
+    REQUIRE(poseNees({3.1, 0.0, 0.0}, {-3.1, 0.0, 0.0}, diagonal) ==
+            Approx(std::pow(2.0 * M_PI - 6.2, 2) / 0.01));
+
+    // x and y errors along their correlation count less than across it
+    const std::array<double, 9> correlated = {0.01, 0.0, 0.0, 0.0, 0.04, 0.03, 0.0, 0.03, 0.04};
+    const double along = poseNees({0.0, 0.1, 0.1}, {0.0, 0.0, 0.0}, correlated);
+    const double across = poseNees({0.0, 0.1, -0.1}, {0.0, 0.0, 0.0}, correlated);
+    REQUIRE(along == Approx(0.02 / 0.07));
+    REQUIRE(across == Approx(0.02 / 0.01));
+
+    REQUIRE(poseNees({0.0, 0.1, 0.1}, {0.0, 0.0, 0.0}, {}) == -1.0);
+}
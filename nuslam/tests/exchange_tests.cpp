@@ -0,0 +1,133 @@
+#include <catch_ros/catch.hpp>
+#include <nuslam/exchange_library.hpp>
+#include <array>
+#include <vector>
+
+/// \brief a filter state with the given landmarks, each with variance var
+static void filter(const std::vector<double> & landmarks, double var, std::vector<double> & state,
+                   std::vector<double> & cov)
+{
+    const int len = 3 + landmarks.size();
+    state.assign(3, 0.0);
+    state.insert(state.end(), landmarks.begin(), landmarks.end());
+    cov.assign(len * len, 0.0);
+    for (int k = 0; k < len; ++k)
+    {
+        cov[k*len + k] = (k < 3) ? 0.01 : var;
+    }
+}
+
+TEST_CASE("Only landmarks that changed since the last exchange are sent", "[exchange]")
+{
+    using namespace exchange;
+
+    std::vector<double> state, cov;
+    filter({1.0, 1.0, 2.0, 2.0, 3.0, 3.0}, 0.1, state, cov);
+    const int len = state.size();
+
+    SummaryTracker tracker(3.0, 2.0, 0.02, 0.2);
+    tracker.update(state.data(), cov.data(), len, 2, 0);
+    REQUIRE(tracker.revisions() == 2);
+
+    // nobody in range, nothing to send
+    std::vector<LandmarkSummary> summary;
+    REQUIRE(tracker.select(0.0, 0.0, 10.0, summary) == 0);
+    REQUIRE(summary.empty());
+
+    tracker.heard("/b/slam", 10.0, 0.0, 10.0);
+    REQUIRE(tracker.select(0.0, 0.0, 10.0, summary) == 0);
+
+    // the first exchange sends everything
+    tracker.heard("/b/slam", 1.0, 0.0, 11.0);
+    REQUIRE(tracker.select(0.0, 0.0, 11.0, summary) == 1);
+    REQUIRE(summary.size() == 2);
+    REQUIRE(summary[1].id == 1);
+    REQUIRE(summary[1].x == 2.0);
+    REQUIRE(summary[1].cov[0] == 0.1);
+    REQUIRE(summary[1].cov[1] == 0.0);
+
+    // small changes are not worth sending
+    state[3] += 0.01;
+    cov[3*len + 3] = 0.09;
+    tracker.update(state.data(), cov.data(), len, 2, 0);
+    REQUIRE(tracker.select(0.0, 0.0, 11.5, summary) == 1);
+    REQUIRE(summary.empty());
+
+    // a new landmark and a landmark that became much surer are
+    cov[5*len + 5] = 0.05;
+    cov[6*len + 6] = 0.05;
+    tracker.update(state.data(), cov.data(), len, 3, 0);
+    REQUIRE(tracker.select(0.0, 0.0, 12.0, summary) == 1);
+    REQUIRE(summary.size() == 2);
+    REQUIRE(summary[0].id == 1);
+    REQUIRE(summary[1].id == 2);
+
+    // a robot met for the first time gets everything, the one met before only what changed
+    tracker.heard("/c/slam", 0.0, 1.0, 12.5);
+    state[3] += 0.5;
+    tracker.update(state.data(), cov.data(), len, 3, 0);
+    REQUIRE(tracker.select(0.0, 0.0, 13.0, summary) == 2);
+    REQUIRE(summary.size() == 3);
+
+    // after a merge every slot is sent again
+    tracker.heard("/b/slam", 1.0, 0.0, 13.5);
+    tracker.update(state.data(), cov.data(), len, 3, 1);
+    REQUIRE(tracker.select(0.0, 0.0, 13.5, summary) == 2);
+    REQUIRE(summary.size() == 3);
+
+    // robots not heard from recently are out of range
+    REQUIRE(tracker.inRange("/c/slam", 0.0, 0.0, 14.0));
+    REQUIRE(!tracker.inRange("/c/slam", 0.0, 0.0, 15.0));
+    REQUIRE(!tracker.inRange("/d/slam", 0.0, 0.0, 14.0));
+}
+
+TEST_CASE("Covariance intersection never claims more than either estimate", "[exchange]")
+{
+    using namespace exchange;
+
+    std::array<double, 2> fused;
+    std::array<double, 4> F;
+
+    // an estimate that is worse in every direction adds nothing
+    const std::array<double, 4> A = {0.01, 0.0, 0.0, 0.01};
+    REQUIRE(intersect({1.0, 2.0}, A, {1.5, 2.5}, {0.04, 0.0, 0.0, 0.04}, fused, F) == 1.0);
+    REQUIRE(fused[0] == Approx(1.0));
+    REQUIRE(F[0] == Approx(0.01));
+
+    // the same estimate twice is not counted twice
+    REQUIRE(intersect({1.0, 2.0}, A, {1.0, 2.0}, A, fused, F) == Approx(1.0));
+    REQUIRE(F[0] == Approx(0.01));
+    REQUIRE(F[3] == Approx(0.01));
+
+    // estimates sure in different directions both count
+    const std::array<double, 4> Ax = {0.01, 0.0, 0.0, 0.09};
+    const std::array<double, 4> By = {0.09, 0.0, 0.0, 0.01};
+    const double w = intersect({1.0, 2.0}, Ax, {1.2, 2.2}, By, fused, F);
+    REQUIRE(w == Approx(0.5));
+    REQUIRE(F[0] < 0.09);
+    REQUIRE(F[3] < 0.09);
+    REQUIRE(F[0] > 0.01);
+    REQUIRE(F[3] > 0.01);
+    REQUIRE(fused[0] == Approx(1.02).margin(0.001));
+    REQUIRE(fused[1] == Approx(2.18).margin(0.001));
+
+    // a better estimate mostly replaces the own one
+    REQUIRE(intersectionWeight(A, {0.0001, 0.0, 0.0, 0.0001}) == 0.0);
+}
+
+TEST_CASE("A received landmark finds the closest landmark of the filter", "[exchange]")
+{
+    using namespace exchange;
+
+    std::vector<double> state, cov;
+    filter({1.0, 1.0, 2.0, 2.0, 3.0, 3.0}, 0.01, state, cov);
+
+    double distance;
+    REQUIRE(closestLandmark(state.data(), cov.data(), state.size(), 3, {0, 2.1, 1.9, {0.01, 0.0, 0.01}}, distance) == 1);
+    REQUIRE(distance == Approx(1.0));
+
+    // landmarks not seen yet are never matched
+    REQUIRE(closestLandmark(state.data(), cov.data(), state.size(), 2, {0, 3.0, 3.0, {0.01, 0.0, 0.01}}, distance) == 1);
+    REQUIRE(distance == Approx(100.0));
+    REQUIRE(closestLandmark(state.data(), cov.data(), state.size(), 0, {0, 3.0, 3.0, {0.01, 0.0, 0.01}}, distance) == -1);
+}
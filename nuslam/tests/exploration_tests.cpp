@@ -0,0 +1,136 @@
+#include <catch_ros/catch.hpp>
+#include <nuslam/exploration_library.hpp>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+/// \brief ranges of a 360 beam scan from inside a square room with walls at +-half, with a doorway of
+/// half width door in the middle of the +x wall, infinite for the beams that leave through it
+static std::vector<float> roomScan(double x, double y, double th, double half, double door)
+{
+    std::vector<float> ranges(360);
+    for (int i = 0; i < 360; ++i)
+    {
+        double a = th + i * M_PI / 180.0;
+        double c = std::cos(a), s = std::sin(a);
+        double tx = (std::fabs(c) > 1e-9) ? ((c > 0 ? half : -half) - x) / c : 1e9;
+        double ty = (std::fabs(s) > 1e-9) ? ((s > 0 ? half : -half) - y) / s : 1e9;
+        ranges[i] = std::min(tx, ty);
+        if ((tx < ty) && (c > 0) && (std::fabs(y + tx * s) < door))
+        {
+            ranges[i] = std::numeric_limits<float>::infinity();
+        }
+    }
+    return ranges;
+}
+
+/// \brief the frontier cells found by checking every cell of the grid
+static int bruteForceFrontier(const exploration::FrontierGrid & grid, int half)
+{
+    using namespace exploration;
+
+    int count = 0;
+    for (int y = -half; y < half; ++y)
+    {
+        for (int x = -half; x < half; ++x)
+        {
+            bool front = false;
+            if (grid.at(x, y) == CellState::FREE)
+            {
+                const int d[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+                for (const auto & o : d)
+                {
+                    front |= grid.contains(x + o[0], y + o[1]) && (grid.at(x + o[0], y + o[1]) == CellState::UNKNOWN);
+                }
+            }
+            REQUIRE(grid.isFrontier(x, y) == front);
+            count += front;
+        }
+    }
+    return count;
+}
+
+TEST_CASE("The frontier kept from the touched cells matches a full check", "[exploration]")
+{
+    using namespace exploration;
+
+    ExploreParams params;
+    params.size = 100;
+    FrontierGrid grid(params);
+    REQUIRE(grid.frontierSize() == 0);
+
+    // a closed room leaves no cluster large enough to explore
+    grid.insertScan(0.05, 0.05, 0.0, 0.0, M_PI / 180.0, roomScan(0.05, 0.05, 0.0, 1.0, 0.0), 0.12, 3.5);
+    REQUIRE(grid.at(grid.toCell(0.5), grid.toCell(0.0)) == CellState::FREE);
+    REQUIRE(grid.at(grid.toCell(1.0), grid.toCell(0.2)) == CellState::OCCUPIED);
+    REQUIRE(grid.at(grid.toCell(2.0), grid.toCell(2.0)) == CellState::UNKNOWN);
+    REQUIRE(bruteForceFrontier(grid, params.size / 2) == grid.frontierSize());
+    REQUIRE(grid.clusters(0.05, 0.05).empty());
+
+    // the same room with a doorway, seen from a few poses, the last one reaching past the grid
+    const double poses[4][3] = {{0.05, 0.05, 0.0}, {-0.4, 0.3, 1.0}, {0.6, -0.5, 2.5}, {0.8, 0.0, 0.3}};
+    for (const auto & p : poses)
+    {
+        grid.insertScan(p[0], p[1], p[2], 0.0, M_PI / 180.0, roomScan(p[0], p[1], p[2], 1.0, 0.3), 0.12, 6.0);
+        REQUIRE(bruteForceFrontier(grid, params.size / 2) == grid.frontierSize());
+    }
+    REQUIRE(grid.frontierSize() > 0);
+}
+
+TEST_CASE("Frontier clusters are scored by their gain per travel cost", "[exploration]")
+{
+    using namespace exploration;
+
+    ExploreParams params;
+    FrontierGrid grid(params);
+    grid.insertScan(0.05, 0.05, 0.0, 0.0, M_PI / 180.0, roomScan(0.05, 0.05, 0.0, 1.0, 0.3), 0.12, 3.5);
+
+    // only the fan of free cells out of the doorway ends in unknown cells
+    std::vector<Cluster> clusters = grid.clusters(0.05, 0.05);
+    REQUIRE(!clusters.empty());
+    for (unsigned int k = 0; k < clusters.size(); ++k)
+    {
+        const Cluster & c = clusters.at(k);
+        REQUIRE(c.cells >= params.minClusterSize);
+        REQUIRE(c.goalX > 1.0);
+        REQUIRE(grid.isFrontier(grid.toCell(c.goalX), grid.toCell(c.goalY)));
+        REQUIRE(c.gain > 0);
+        REQUIRE(c.cost >= std::hypot(c.goalX - 0.05, c.goalY - 0.05) - 2.0 * params.resolution);
+        REQUIRE(c.score == Approx(c.gain / std::max(c.cost, params.minCost)));
+        if (k > 0)
+        {
+            REQUIRE(c.score <= clusters.at(k - 1).score);
+        }
+    }
+
+    // a goal walled off from the robot is left out, the wall is the +x side of the room seen from outside
+    FrontierGrid walled(params);
+    walled.insertScan(0.05, 0.05, 0.0, 0.0, M_PI / 180.0, roomScan(0.05, 0.05, 0.0, 1.0, 0.3), 0.12, 3.5);
+    REQUIRE(walled.clusters(-5.0, 0.05).empty());
+}
+
+TEST_CASE("A robot circling in a room is only drawn out of its doorway", "[exploration]")
+{
+    using namespace exploration;
+
+    ExploreParams params;
+    FrontierGrid grid(params);
+
+    const int scans = 100;
+    int changed = 0;
+    for (int k = 0; k < scans; ++k)
+    {
+        const double x = 0.3 * std::cos(0.1 * k), y = 0.3 * std::sin(0.1 * k), th = 0.05 * k;
+        changed += grid.insertScan(x, y, th, 0.0, M_PI / 180.0, roomScan(x, y, th, 2.0, 0.4), 0.12, 3.5);
+    }
+    REQUIRE(changed > 0);
+    REQUIRE(bruteForceFrontier(grid, params.size / 2) == grid.frontierSize());
+
+    std::vector<Cluster> clusters = grid.clusters(0.0, 0.0);
+    REQUIRE(!clusters.empty());
+    for (const Cluster & c : clusters)
+    {
+        REQUIRE(c.goalX > 2.0);
+        REQUIRE(c.cost > 0.0);
+    }
+}
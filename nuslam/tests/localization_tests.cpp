@@ -0,0 +1,99 @@
+#include <catch_ros/catch.hpp>
+#include <nuslam/slam_library.hpp>
+#include <rigid2d/rigid2d.hpp>
+#include <armadillo>
+#include <cmath>
+
+/// \brief the range and bearing of landmark (mx, my) seen from the pose (th, x, y)
+static arma::colvec measure(double th, double x, double y, double mx, double my)
+{
+    arma::colvec z(2);
+    z(0) = sqrt(pow(mx - x, 2) + pow(my - y, 2));
+    z(1) = rigid2d::normalize_angle(atan2(my - y, mx - x) - th);
+    return z;
+}
+
+/// \brief a surveyed map of three landmarks
+static arma::colvec surveyedMap()
+{
+    arma::colvec mapState(6);
+    mapState(0) = 1.0;
+    mapState(1) = 0.0;
+    mapState(2) = 0.0;
+    mapState(3) = 1.5;
+    mapState(4) = -1.0;
+    mapState(5) = -0.5;
+    return mapState;
+}
+
+TEST_CASE("Localization corrects the pose against a fixed map", "[localization]")
+{
+    using namespace arma;
+    using namespace slam_library;
+
+    colvec robotState(3, fill::zeros);
+    mat Q = 0.001 * mat(3, 3, fill::eye);
+    mat R = 0.0001 * mat(2, 2, fill::eye);
+
+    LocalizationKalman filter(robotState, surveyedMap(), Q, R, 0.0);
+    filter.resetPose(robotState, 0.1 * mat(3, 3, fill::eye));
+    REQUIRE(filter.NIS() == -1.0);
+
+    // the robot actually sits at (0.1, -0.05) facing 0.05 rad
+    const double th = 0.05, x = 0.1, y = -0.05;
+    for (int i = 0; i < 20; ++i)
+    {
+        filter.predict(rigid2d::Twist2D{0.0, 0.0, 0.0});
+        for (int j = 0; j < filter.numLandmarks(); ++j)
+        {
+            colvec landmark = filter.getLandmark(j);
+            filter.update(j, measure(th, x, y, landmark(0), landmark(1)));
+        }
+    }
+
+    REQUIRE(filter.getStateVec()(0) == Approx(th).margin(1e-3));
+    REQUIRE(filter.getStateVec()(1) == Approx(x).margin(1e-3));
+    REQUIRE(filter.getStateVec()(2) == Approx(y).margin(1e-3));
+
+    // noise free measurements of the converged pose are no surprise
+    REQUIRE(filter.NIS() >= 0.0);
+    REQUIRE(filter.NIS() < 1.0);
+
+    // the landmarks stay where the map puts them
+    REQUIRE(filter.getLandmark(1)(0) == Approx(0.0).margin(1e-12));
+    REQUIRE(filter.getLandmark(1)(1) == Approx(1.5));
+}
+
+TEST_CASE("Localization prediction follows the motion model", "[localization]")
+{
+    using namespace arma;
+    using namespace slam_library;
+
+    colvec robotState(3, fill::zeros);
+    mat Q(3, 3, fill::zeros);
+    mat R = 0.01 * mat(2, 2, fill::eye);
+
+    LocalizationKalman filter(robotState, surveyedMap(), Q, R, 0.0);
+    filter.predict(rigid2d::Twist2D{rigid2d::PI / 2, rigid2d::PI / 2, 0.0});
+
+    REQUIRE(filter.getStateVec()(0) == Approx(rigid2d::PI / 2));
+    REQUIRE(filter.getStateVec()(1) == Approx(1.0));
+    REQUIRE(filter.getStateVec()(2) == Approx(1.0));
+    REQUIRE(filter.getCov().n_rows == 3);
+}
+
+TEST_CASE("Localization data association gates unknown measurements", "[localization]")
+{
+    using namespace arma;
+    using namespace slam_library;
+
+    colvec robotState(3, fill::zeros);
+    mat Q = 0.001 * mat(3, 3, fill::eye);
+    mat R = 0.001 * mat(2, 2, fill::eye);
+
+    LocalizationKalman filter(robotState, surveyedMap(), Q, R, 0.0001);
+
+    REQUIRE(filter.DataAssociation(measure(0.0, 0.0, 0.0, 0.0, 1.5), 9.21) == 1);
+    REQUIRE(filter.DataAssociation(measure(0.0, 0.0, 0.0, -1.0, -0.5), 9.21) == 2);
+    REQUIRE(filter.DataAssociation(measure(0.0, 0.0, 0.0, 3.0, 3.0), 9.21) == -1);
+}
@@ -0,0 +1,110 @@
+#include <catch_ros/catch.hpp>
+#include <nuslam/loop_closure_library.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+/// \brief landmarks mapped on the first pass around a site
+static const std::vector<double> firstPass = {0.3, 0.2, -0.8, 0.5, 1.2, 1.1, -0.4, -1.3, 0.9, -0.6,
+                                              -1.5, -0.2, 2.1, 0.4, 0.1, 1.7};
+
+/// \brief the first pass followed by a drifted second pass over landmarks 1, 3, 4 and 6, and one new landmark
+static std::vector<double> afterLoop()
+{
+    std::vector<double> landmarks = firstPass;
+    const double th = 0.08, dx = 0.25, dy = -0.15;
+    for (int j: {1, 3, 4, 6})
+    {
+        double x = firstPass[2*j], y = firstPass[2*j + 1];
+        landmarks.push_back(cos(th) * x - sin(th) * y + dx);
+        landmarks.push_back(sin(th) * x + cos(th) * y + dy);
+    }
+    landmarks.push_back(3.5);
+    landmarks.push_back(-2.5);
+    return landmarks;
+}
+
+TEST_CASE("Duplicated landmarks after a loop are found", "[loop closure]")
+{
+    using namespace loop_closure;
+
+    LoopClosureDetector detector(5, 4.0, 0.05, 3, 1.0, 0.5, 200);
+    Closure closure;
+
+    REQUIRE(detector.detect(afterLoop(), closure));
+
+    std::vector<std::pair<int, int>> pairs = closure.pairs;
+    std::sort(pairs.begin(), pairs.end());
+    REQUIRE(pairs == std::vector<std::pair<int, int>>{{1, 8}, {3, 9}, {4, 10}, {6, 11}});
+
+    // the drift that moves the duplicates back onto the first pass
+    REQUIRE(closure.th == Approx(-0.08).margin(1e-6));
+    REQUIRE(closure.rms == Approx(0.0).margin(1e-6));
+}
+
+TEST_CASE("New landmarks are not mistaken for a loop", "[loop closure]")
+{
+    using namespace loop_closure;
+
+    LoopClosureDetector detector(5, 4.0, 0.05, 3, 1.0, 0.5, 200);
+    Closure closure;
+
+    std::vector<double> landmarks = firstPass;
+    landmarks.insert(landmarks.end(), {3.0, 3.0, 3.4, 2.1, 4.4, 3.3, 2.9, 4.1, 5.0, 2.0});
+    REQUIRE_FALSE(detector.detect(landmarks, closure));
+
+    // too few landmarks to tell
+    REQUIRE_FALSE(detector.detect({0.0, 0.0, 1.0, 0.0, 0.0, 1.0, 1.0, 1.0, 2.0, 0.0}, closure));
+}
+
+TEST_CASE("The detector index grows with the map and is rebuilt when landmarks move", "[loop closure]")
+{
+    using namespace loop_closure;
+
+    LoopClosureDetector detector(5, 4.0, 0.05, 3, 1.0, 0.5, 200);
+    Closure closure;
+
+    // the map as it grows on the way around, the five newest are not indexed yet
+    std::vector<double> landmarks = afterLoop();
+    std::vector<double> partial(landmarks.begin(), landmarks.begin() + 2 * 10);
+    REQUIRE_FALSE(detector.detect(partial, closure));
+    REQUIRE(detector.indexSize() == 5);
+
+    REQUIRE(detector.detect(landmarks, closure));
+    REQUIRE(detector.indexSize() == 8);
+    REQUIRE(detector.rebuilds() == 0);
+    REQUIRE(closure.pairs.size() == 4);
+
+    // once the duplicates are merged the later landmarks move down and the index starts over
+    std::vector<double> merged = firstPass;
+    merged.insert(merged.end(), {3.5, -2.5, 3.0, 3.0, 3.4, 2.1});
+    REQUIRE_FALSE(detector.detect(merged, closure));
+    REQUIRE(detector.rebuilds() == 1);
+    REQUIRE(detector.indexSize() == 6);
+}
+
+TEST_CASE("The background detector reports closures without blocking", "[loop closure]")
+{
+    using namespace loop_closure;
+
+    BackgroundDetector background(LoopClosureDetector(5, 4.0, 0.05, 3, 1.0, 0.5, 200));
+    Closure closure;
+
+    REQUIRE_FALSE(background.poll(closure));
+    REQUIRE(background.submit(afterLoop(), 7));
+
+    auto start = std::chrono::steady_clock::now();
+    while (background.isBusy() && (std::chrono::steady_clock::now() - start < std::chrono::seconds(5)))
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    REQUIRE(background.poll(closure));
+    REQUIRE(closure.generation == 7);
+    REQUIRE(closure.pairs.size() == 4);
+
+    // the result is handed out once
+    REQUIRE_FALSE(background.poll(closure));
+}
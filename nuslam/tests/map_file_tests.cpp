@@ -0,0 +1,136 @@
+#include <catch_ros/catch.hpp>
+#include <nuslam/map_file_library.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/// \brief a map with n landmarks and recognizable values
+struct TestMap
+{
+    std::vector<double> state;
+    std::vector<double> cov;
+    std::vector<map_file::LandmarkInfo> landmarks;
+
+    explicit TestMap(int n)
+    {
+        const int len = 3 + 2 * n;
+        for (int i = 0; i < len; ++i)
+        {
+            state.push_back(0.5 * i - 1.0);
+        }
+        for (int i = 0; i < len * len; ++i)
+        {
+            cov.push_back(1e-3 * i);
+        }
+        for (int j = 0; j < n; ++j)
+        {
+            landmarks.push_back({j, (j % 2 == 0) ? map_file::LANDMARK_INITIALIZED : 0u, 0.0762});
+        }
+    }
+};
+
+TEST_CASE("A saved map maps back unchanged", "[map file]")
+{
+    using namespace map_file;
+
+    const std::string path = "/tmp/nuslam_map_test.bin";
+    TestMap map(6);
+    std::string error;
+
+    REQUIRE(saveMap(path, map.state.data(), map.state.size(), map.cov.data(), map.landmarks, error));
+
+    MappedMap mapped;
+    REQUIRE(mapped.open(path, error));
+    REQUIRE(mapped.version() == MAP_VERSION);
+    REQUIRE(mapped.stateLength() == 15);
+    REQUIRE(mapped.numLandmarks() == 6);
+
+    REQUIRE(std::vector<double>(mapped.state(), mapped.state() + 15) == map.state);
+    REQUIRE(std::vector<double>(mapped.cov(), mapped.cov() + 225) == map.cov);
+    REQUIRE(mapped.landmarks()[4].id == 4);
+    REQUIRE(mapped.landmarks()[4].flags == LANDMARK_INITIALIZED);
+    REQUIRE(mapped.landmarks()[5].flags == 0);
+    REQUIRE(mapped.landmarks()[5].radius == Approx(0.0762));
+
+    // every section is aligned in memory, so it can be used in place
+    REQUIRE(reinterpret_cast<uintptr_t>(mapped.state()) % MAP_ALIGNMENT == 0);
+    REQUIRE(reinterpret_cast<uintptr_t>(mapped.cov()) % MAP_ALIGNMENT == 0);
+    REQUIRE(reinterpret_cast<uintptr_t>(mapped.landmarks()) % MAP_ALIGNMENT == 0);
+
+    // the mapping outlives a move
+    MappedMap moved = std::move(mapped);
+    REQUIRE_FALSE(mapped.isOpen());
+    REQUIRE(moved.state()[1] == Approx(-0.5));
+
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Damaged map files are refused", "[map file]")
+{
+    using namespace map_file;
+
+    const std::string path = "/tmp/nuslam_map_damaged.bin";
+    TestMap map(3);
+    std::string error;
+    MappedMap mapped;
+
+    REQUIRE_FALSE(mapped.open("/tmp/nuslam_map_missing.bin", error));
+
+    // a state that does not match the landmarks is not written
+    REQUIRE_FALSE(saveMap(path, map.state.data(), 8, map.cov.data(), map.landmarks, error));
+
+    // truncated
+    REQUIRE(saveMap(path, map.state.data(), map.state.size(), map.cov.data(), map.landmarks, error));
+    {
+        std::ifstream in(path, std::ios::binary);
+        std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(bytes.data(), bytes.size() - 8);
+    }
+    REQUIRE_FALSE(mapped.open(path, error));
+    REQUIRE_FALSE(mapped.isOpen());
+
+    // wrong magic
+    REQUIRE(saveMap(path, map.state.data(), map.state.size(), map.cov.data(), map.landmarks, error));
+    {
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        file.write("NOTAMAP!", 8);
+    }
+    REQUIRE_FALSE(mapped.open(path, error));
+
+    // newer version
+    REQUIRE(saveMap(path, map.state.data(), map.state.size(), map.cov.data(), map.landmarks, error));
+    {
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        uint32_t version = MAP_VERSION + 1;
+        file.seekp(8);
+        file.write(reinterpret_cast<const char *>(&version), sizeof(version));
+    }
+    REQUIRE_FALSE(mapped.open(path, error));
+
+    std::remove(path.c_str());
+}
+
+TEST_CASE("A large map is read in place to its last byte", "[map file]")
+{
+    using namespace map_file;
+
+    // 1000 landmarks, a 32 MB covariance
+    const std::string path = "/tmp/nuslam_map_large.bin";
+    TestMap map(1000);
+    std::string error;
+    REQUIRE(saveMap(path, map.state.data(), map.state.size(), map.cov.data(), map.landmarks, error));
+
+    MappedMap mapped;
+    REQUIRE(mapped.open(path, error));
+    REQUIRE(mapped.stateLength() == 2003);
+    REQUIRE(mapped.numLandmarks() == 1000);
+    REQUIRE(mapped.state()[2002] == Approx(0.5 * 2002 - 1.0));
+    REQUIRE(mapped.cov()[2003 * 2003 - 1] == Approx(1e-3 * (2003 * 2003 - 1)));
+    REQUIRE(mapped.landmarks()[999].id == 999);
+    REQUIRE(mapped.landmarks()[999].flags == 0);
+
+    std::remove(path.c_str());
+}
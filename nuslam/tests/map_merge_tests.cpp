@@ -0,0 +1,240 @@
+#include <catch_ros/catch.hpp>
+#include <nuslam/map_merge_library.hpp>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+/// \brief landmarks scattered over a square, at least spacing apart, sorted along x
+static std::vector<double> scatter(int n, double side, double spacing, unsigned int seed)
+{
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<> coord(0.0, side);
+    std::vector<double> world;
+    while (int(world.size()) < 2 * n)
+    {
+        const double x = coord(gen), y = coord(gen);
+        bool free = true;
+        for (int i = 0; free && (i < int(world.size())); i += 2)
+        {
+            free = std::hypot(world[i] - x, world[i + 1] - y) >= spacing;
+        }
+        if (free)
+        {
+            world.insert(world.end(), {x, y});
+        }
+    }
+
+    // so a range of landmarks is a strip of the world, like the part one robot explored
+    std::vector<std::pair<double, double>> points;
+    for (int i = 0; i < n; ++i)
+    {
+        points.emplace_back(world[2*i], world[2*i+1]);
+    }
+    std::sort(points.begin(), points.end());
+    for (int i = 0; i < n; ++i)
+    {
+        world[2*i] = points[i].first;
+        world[2*i+1] = points[i].second;
+    }
+    return world;
+}
+
+/// \brief the map a robot starting at (x, y, th) builds of landmarks first to last of the world
+static map_merge::LandmarkMap observe(const std::vector<double> & world, int first, int last, double x, double y,
+                                      double th, double sigma, unsigned int seed)
+{
+    std::mt19937 gen(seed);
+    std::normal_distribution<> noise(0.0, sigma);
+    const double c = std::cos(th), s = std::sin(th);
+
+    map_merge::LandmarkMap map;
+    for (int i = first; i < last; ++i)
+    {
+        const double dx = world[2*i] - x, dy = world[2*i+1] - y;
+        map.mean.push_back(c * dx + s * dy + noise(gen));
+        map.mean.push_back(-s * dx + c * dy + noise(gen));
+        map.cov.insert(map.cov.end(), {sigma * sigma, 0.0, 0.0, sigma * sigma});
+    }
+    return map;
+}
+
+/// \brief inverts a 2x2 matrix, column major
+static std::array<double, 4> invert(const std::array<double, 4> & m)
+{
+    const double det = m[0] * m[3] - m[1] * m[2];
+    return {m[3] / det, -m[1] / det, -m[2] / det, m[0] / det};
+}
+
+/// \brief the covariance of landmark i of a fused with landmark j of b, with b moved into the frame of a
+/// along with the covariance of the transform
+static std::array<double, 4> fusedCov(const map_merge::Alignment & t, const map_merge::LandmarkMap & a, int i,
+                                      const map_merge::LandmarkMap & b, int j)
+{
+    const double c = std::cos(t.th), s = std::sin(t.th);
+    const double bx = b.mean[2*j], by = b.mean[2*j+1];
+
+    // the moved landmark is R p + (x, y), so its derivative is R with respect to p and J with respect to (x, y, th)
+    const double R[2][2] = {{c, -s}, {s, c}};
+    const double J[2][3] = {{1.0, 0.0, -s * bx - c * by}, {0.0, 1.0, c * bx - s * by}};
+    std::array<double, 4> Sb = {};
+    for (int r = 0; r < 2; ++r)
+    {
+        for (int q = 0; q < 2; ++q)
+        {
+            for (int k = 0; k < 2; ++k)
+            {
+                for (int l = 0; l < 2; ++l)
+                {
+                    Sb[2*q + r] += R[r][k] * b.cov[4*j + 2*l + k] * R[q][l];
+                }
+            }
+            for (int k = 0; k < 3; ++k)
+            {
+                for (int l = 0; l < 3; ++l)
+                {
+                    Sb[2*q + r] += J[r][k] * t.cov[3*l + k] * J[q][l];
+                }
+            }
+        }
+    }
+
+    const std::array<double, 4> La = invert({a.cov[4*i], a.cov[4*i+1], a.cov[4*i+2], a.cov[4*i+3]});
+    const std::array<double, 4> Lb = invert(Sb);
+    return invert({La[0] + Lb[0], La[1] + Lb[1], La[2] + Lb[2], La[3] + Lb[3]});
+}
+
+TEST_CASE("Two maps are aligned and their shared landmarks fused", "[map merge]")
+{
+    using namespace map_merge;
+
+    const std::vector<double> world = scatter(60, 12.0, 0.6, 1);
+
+    // robot b started at (5, -2) facing 2 rad in the frame of robot a
+    const LandmarkMap a = observe(world, 0, 40, 0.0, 0.0, 0.0, 0.01, 2);
+    const LandmarkMap b = observe(world, 25, 60, 5.0, -2.0, 2.0, 0.01, 3);
+
+    MapMerger merger;
+    MergedMap merged;
+    REQUIRE(merger.merge(a, b, merged));
+
+    const Alignment & t = merged.alignment;
+    REQUIRE(t.found);
+    REQUIRE(!t.ambiguous);
+    REQUIRE(t.x == Approx(5.0).margin(0.02));
+    REQUIRE(t.y == Approx(-2.0).margin(0.02));
+    REQUIRE(t.th == Approx(2.0).margin(0.005));
+    REQUIRE(t.inliers == 15);
+    REQUIRE(t.cov[0] > 0.0);
+    REQUIRE(t.cov[8] > 0.0);
+
+    REQUIRE(merged.shared == 15);
+    REQUIRE(merged.landmarks.size() == 60);
+    REQUIRE(merged.origin.size() == 60);
+
+    for (int k = 0; k < merged.landmarks.size(); ++k)
+    {
+        const auto & o = merged.origin[k];
+        const int w = (o.first >= 0) ? o.first : o.second + 25;
+        if ((o.first >= 0) && (o.second >= 0))
+        {
+            // the same landmark in both maps
+            REQUIRE(o.first == o.second + 25);
+            // two equally sure observations would halve the variance, but b is less sure once moved
+            const std::array<double, 4> S = fusedCov(t, a, o.first, b, o.second);
+            for (int e = 0; e < 4; ++e)
+            {
+                REQUIRE(merged.landmarks.cov[4*k + e] == Approx(S[e]).epsilon(1e-6).margin(1e-12));
+            }
+            REQUIRE(merged.landmarks.cov[4*k] > 0.5e-4);
+            REQUIRE(merged.landmarks.cov[4*k] < 1e-4);
+        } else if (o.second >= 0)
+        {
+            // only in b, with the uncertainty of the transform on top
+            REQUIRE(merged.landmarks.cov[4*k] > 1e-4);
+        }
+        REQUIRE(merged.landmarks.mean[2*k] == Approx(world[2*w]).margin(0.05));
+        REQUIRE(merged.landmarks.mean[2*k+1] == Approx(world[2*w+1]).margin(0.05));
+    }
+
+    // the pose of robot b moves into the frame of a
+    std::array<double, 3> pose = {0.5, 1.0, 0.0};
+    std::array<double, 9> poseCov = {1e-4, 0.0, 0.0, 0.0, 1e-4, 0.0, 0.0, 0.0, 1e-4};
+    transformPose(t, pose, poseCov);
+    REQUIRE(pose[0] == Approx(2.5).margin(0.01));
+    REQUIRE(pose[1] == Approx(5.0 + std::cos(2.0)).margin(0.03));
+    REQUIRE(pose[2] == Approx(-2.0 + std::sin(2.0)).margin(0.03));
+    REQUIRE(poseCov[4] > 1e-4);
+}
+
+TEST_CASE("The merged landmarks seed a filter", "[map merge]")
+{
+    using namespace map_merge;
+
+    LandmarkMap landmarks;
+    landmarks.mean = {1.0, 2.0, 3.0, 4.0};
+    landmarks.cov = {0.1, 0.01, 0.01, 0.2, 0.3, 0.0, 0.0, 0.4};
+    const std::array<double, 3> pose = {0.5, -1.0, 2.0};
+    const std::array<double, 9> poseCov = {1.0, 0.0, 0.0, 0.0, 2.0, 0.0, 0.0, 0.0, 3.0};
+
+    std::vector<double> state, cov;
+    std::string error;
+    REQUIRE(!seedState(landmarks, pose, poseCov, 1, state, cov, error));
+
+    REQUIRE(seedState(landmarks, pose, poseCov, 3, state, cov, error));
+    const int len = 9;
+    REQUIRE(state == std::vector<double>({0.5, -1.0, 2.0, 1.0, 2.0, 3.0, 4.0, 0.0, 0.0}));
+    REQUIRE(cov.size() == 81);
+    REQUIRE(cov[len + 1] == 2.0);
+    REQUIRE(cov[3*len + 3] == 0.1);
+    REQUIRE(cov[3*len + 4] == 0.01);
+    REQUIRE(cov[4*len + 3] == 0.01);
+    REQUIRE(cov[4*len + 4] == 0.2);
+    REQUIRE(cov[6*len + 6] == 0.4);
+    REQUIRE(cov[5*len + 3] == 0.0);
+    REQUIRE(cov[7*len + 7] > 1e9);
+}
+
+TEST_CASE("Maps that share too little or fit more than one way are refused", "[map merge]")
+{
+    using namespace map_merge;
+
+    const std::vector<double> world = scatter(40, 10.0, 0.6, 4);
+    const LandmarkMap a = observe(world, 0, 20, 0.0, 0.0, 0.0, 0.01, 5);
+    const LandmarkMap b = observe(world, 20, 40, 1.0, 1.0, 1.0, 0.01, 6);
+
+    MapMerger merger;
+    MergedMap merged;
+    REQUIRE(!merger.merge(a, b, merged));
+    REQUIRE(merged.landmarks.size() == 0);
+
+    // a square looks the same after every quarter turn
+    LandmarkMap square;
+    square.mean = {0.0, 0.0, 1.0, 0.0, 1.0, 1.0, 0.0, 1.0};
+    square.cov.assign(16, 0.0);
+    Alignment alignment;
+    REQUIRE(!merger.align(square, square, alignment));
+    REQUIRE(alignment.ambiguous);
+}
+
+TEST_CASE("Two maps of a thousand landmarks merge into one", "[map merge]")
+{
+    using namespace map_merge;
+
+    const std::vector<double> world = scatter(1500, 50.0, 0.5, 7);
+    const LandmarkMap a = observe(world, 0, 1000, 0.0, 0.0, 0.0, 0.01, 8);
+    const LandmarkMap b = observe(world, 500, 1500, -10.0, 30.0, -1.2, 0.01, 9);
+
+    MapMerger merger;
+    MergedMap merged;
+    REQUIRE(merger.merge(a, b, merged));
+
+    REQUIRE(merged.alignment.x == Approx(-10.0).margin(0.01));
+    REQUIRE(merged.alignment.y == Approx(30.0).margin(0.01));
+    REQUIRE(merged.alignment.th == Approx(-1.2).margin(0.001));
+    REQUIRE(merged.shared == 500);
+    REQUIRE(merged.landmarks.size() == 1500);
+}
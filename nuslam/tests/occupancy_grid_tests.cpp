@@ -0,0 +1,124 @@
+#include <catch_ros/catch.hpp>
+#include <nuslam/occupancy_grid_library.hpp>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+/// \brief ranges of a 360 beam scan from inside a square room with walls at +-half
+static std::vector<float> roomScan(double x, double y, double th, double half)
+{
+    std::vector<float> ranges(360);
+    for (int i = 0; i < 360; ++i)
+    {
+        double a = th + i * M_PI / 180.0;
+        double c = std::cos(a), s = std::sin(a);
+        double tx = (std::fabs(c) > 1e-9) ? ((c > 0 ? half : -half) - x) / c : 1e9;
+        double ty = (std::fabs(s) > 1e-9) ? ((s > 0 ? half : -half) - y) / s : 1e9;
+        ranges[i] = std::min(tx, ty);
+    }
+    return ranges;
+}
+
+TEST_CASE("A scan clears the free space and marks the walls", "[occupancy grid]")
+{
+    using namespace occupancy_grid;
+
+    TiledGrid grid;
+    for (int k = 0; k < 5; ++k)
+    {
+        grid.insertScan(0.02, 0.02, 0.0, 0.0, M_PI / 180.0, roomScan(0.02, 0.02, 0.0, 0.975), 0.1, 3.5);
+    }
+
+    // free around the robot, occupied on the walls, unknown outside
+    REQUIRE(grid.occupancy(grid.toCell(0.5), grid.toCell(0.0)) < 20);
+    REQUIRE(grid.occupancy(grid.toCell(0.975), grid.toCell(0.0)) > 80);
+    REQUIRE(grid.occupancy(grid.toCell(0.0), grid.toCell(-0.975)) > 80);
+    REQUIRE(grid.occupancy(grid.toCell(2.0), grid.toCell(2.0)) == -1);
+
+    // the clamp keeps the log-odds bounded however often a cell is seen
+    REQUIRE(grid.logOdds(grid.toCell(0.975), grid.toCell(0.0)) == 350);
+    REQUIRE(grid.logOdds(grid.toCell(0.5), grid.toCell(0.0)) == -200);
+}
+
+TEST_CASE("The grid grows in tiles and reports the cells it changed", "[occupancy grid]")
+{
+    using namespace occupancy_grid;
+
+    TiledGrid grid;
+    REQUIRE(grid.numTiles() == 0);
+    REQUIRE(grid.takeDirty().empty());
+
+    // a single beam from the origin along -x, 2 m at 5 cm is 40 cells in a tile of 64
+    std::vector<float> ranges = {2.0f};
+    grid.insertScan(0.01, 0.01, M_PI, 0.0, 0.0, ranges, 0.1, 3.5);
+
+    Region dirty = grid.takeDirty();
+    REQUIRE(dirty.x == grid.toCell(-1.99));
+    REQUIRE(dirty.y == 0);
+    REQUIRE(dirty.width == 41);
+    REQUIRE(dirty.height == 1);
+    REQUIRE(grid.takeDirty().empty());
+
+    // the beam crosses from the tile at the origin into the one to its left
+    REQUIRE(grid.numTiles() == 2);
+    Region bounds = grid.bounds();
+    REQUIRE(bounds.x == -TILE_SIZE);
+    REQUIRE(bounds.width == 2 * TILE_SIZE);
+    REQUIRE(bounds.contains(dirty));
+
+    std::vector<int8_t> data;
+    grid.fill(dirty, data);
+    REQUIRE(data.size() == 41);
+    REQUIRE(data.front() > 50);
+    REQUIRE(data.back() < 50);
+
+    // a beam that saw nothing, too short to trust or nan changes nothing
+    for (float r: {std::numeric_limits<float>::infinity(), 1.5f, 0.05f, std::numeric_limits<float>::quiet_NaN()})
+    {
+        ranges[0] = r;
+        grid.insertScan(0.01, 0.01, 0.0, 0.0, 0.0, ranges, 0.1, 1.0);
+        REQUIRE(grid.takeDirty().empty());
+    }
+}
+
+TEST_CASE("A beam that saw nothing clears up to the maximum range only when asked to", "[occupancy grid]")
+{
+    using namespace occupancy_grid;
+
+    GridParams params;
+    params.clearNoReturn = true;
+    TiledGrid grid(params);
+
+    std::vector<float> ranges = {std::numeric_limits<float>::infinity()};
+    grid.insertScan(0.01, 0.01, 0.0, 0.0, 0.0, ranges, 0.1, 1.0);
+    REQUIRE(grid.occupancy(grid.toCell(1.01), 0) < 50);
+    REQUIRE(grid.occupancy(grid.toCell(0.5), 0) < 50);
+    REQUIRE(grid.takeDirty().width == grid.toCell(1.01) + 1);
+
+    // nan is still no reading
+    ranges[0] = std::numeric_limits<float>::quiet_NaN();
+    grid.insertScan(0.01, 0.01, M_PI / 2.0, 0.0, 0.0, ranges, 0.1, 1.0);
+    REQUIRE(grid.takeDirty().empty());
+}
+
+TEST_CASE("Scans from a moving robot map a room larger than the sensor range", "[occupancy grid]")
+{
+    using namespace occupancy_grid;
+
+    TiledGrid grid;
+    const int scans = 200;
+    for (int k = 0; k < scans; ++k)
+    {
+        const double x = 0.01 * k - 1.0, y = 0.005 * k - 0.5, th = 0.01 * k;
+        grid.insertScan(x, y, th, 0.0, M_PI / 180.0, roomScan(x, y, th, 3.0), 0.12, 3.5);
+    }
+
+    // the walls within range are occupied and the room in between free
+    REQUIRE(grid.occupancy(grid.toCell(3.0), grid.toCell(0.0)) > 80);
+    REQUIRE(grid.occupancy(grid.toCell(-1.0), grid.toCell(-3.0)) > 80);
+    REQUIRE(grid.occupancy(grid.toCell(0.0), grid.toCell(0.0)) < 20);
+    REQUIRE(grid.occupancy(grid.toCell(-2.0), grid.toCell(1.5)) < 20);
+
+    // the far corner was never within range
+    REQUIRE(grid.occupancy(grid.toCell(2.9), grid.toCell(-2.9)) == -1);
+}
@@ -0,0 +1,133 @@
+#include <catch_ros/catch.hpp>
+#include <nuslam/particle_filter_library.hpp>
+#include <rigid2d/rigid2d.hpp>
+#include <cmath>
+#include <random>
+#include <vector>
+
+/// \brief the tube map of tube_world
+static const std::vector<double> tubes = {0.5, 0.5, -0.5, -0.5, 1.0, 1.0, -1.0, -1.0, -0.75, 0.75, 0.75, -0.75};
+
+/// \brief a robot driving around the tubes with a noisy range-bearing sensor
+struct SimRobot
+{
+    double x = 0.0;
+    double y = 0.0;
+    double th = 0.0;
+    double maxRange = 1.5;
+    std::mt19937 gen{7};
+    std::normal_distribution<> noise{0.0, 0.01};
+
+    /// \brief drives along an arc
+    /// \param tw - the body twist
+    void move(const rigid2d::Twist2D & tw)
+    {
+        if (tw.dth == 0.0)
+        {
+            x += tw.dx * cos(th);
+            y += tw.dx * sin(th);
+        } else
+        {
+            double r = tw.dx / tw.dth;
+            x += -r * sin(th) + r * sin(th + tw.dth);
+            y += r * cos(th) - r * cos(th + tw.dth);
+        }
+        th = rigid2d::normalize_angle(th + tw.dth);
+    }
+
+    /// \brief measures the tubes in range
+    /// \param withIds - whether the measurements carry the landmark id
+    std::vector<particle_filter::Observation> sense(bool withIds)
+    {
+        std::vector<particle_filter::Observation> obs;
+        for (int j = 0; j < int(tubes.size()) / 2; ++j)
+        {
+            double dx = tubes[2*j] - x;
+            double dy = tubes[2*j + 1] - y;
+            double range = sqrt(dx * dx + dy * dy);
+            if (range > maxRange)
+            {
+                continue;
+            }
+
+            particle_filter::Observation z;
+            z.range = range + noise(gen);
+            z.bearing = rigid2d::normalize_angle(atan2(dy, dx) - th + noise(gen));
+            z.id = withIds ? j : -1;
+            obs.push_back(z);
+        }
+        return obs;
+    }
+};
+
+/// \brief drives the robot and the filter together for a number of steps
+static void drive(SimRobot & sim, particle_filter::ParticleFilter & filter, int steps, bool withIds)
+{
+    const rigid2d::Twist2D tw{0.02, 0.01, 0.0};
+    for (int i = 0; i < steps; ++i)
+    {
+        sim.move(tw);
+        filter.predict(tw);
+        filter.update(sim.sense(withIds));
+    }
+}
+
+TEST_CASE("MCL tracks the robot from a known pose without landmark ids", "[mcl]")
+{
+    using namespace particle_filter;
+
+    MclParams params;
+    params.maxParticles = 2000;
+    ParticleFilter filter(tubes, params, 1);
+
+    SimRobot sim;
+    filter.initPose(0.0, 0.0, 0.0, 0.05, 0.05);
+    drive(sim, filter, 300, false);
+
+    REQUIRE(filter.getX() == Approx(sim.x).margin(0.05));
+    REQUIRE(filter.getY() == Approx(sim.y).margin(0.05));
+    REQUIRE(rigid2d::normalize_angle(filter.getTh() - sim.th) == Approx(0.0).margin(0.05));
+}
+
+TEST_CASE("MCL localizes globally and shrinks the particle set", "[mcl]")
+{
+    using namespace particle_filter;
+
+    MclParams params;
+    ParticleFilter filter(tubes, params, 2);
+    REQUIRE(filter.size() == params.maxParticles);
+
+    SimRobot sim;
+    drive(sim, filter, 200, true);
+
+    REQUIRE(filter.getX() == Approx(sim.x).margin(0.05));
+    REQUIRE(filter.getY() == Approx(sim.y).margin(0.05));
+    REQUIRE(rigid2d::normalize_angle(filter.getTh() - sim.th) == Approx(0.0).margin(0.05));
+
+    // KLD sampling keeps far fewer particles once the posterior is tight
+    REQUIRE(filter.size() < params.maxParticles / 2);
+    REQUIRE(filter.size() >= params.minParticles);
+}
+
+TEST_CASE("MCL recovers from a kidnapped robot", "[mcl]")
+{
+    using namespace particle_filter;
+
+    MclParams params;
+    ParticleFilter filter(tubes, params, 3);
+
+    SimRobot sim;
+    filter.initPose(0.0, 0.0, 0.0, 0.05, 0.05);
+    drive(sim, filter, 100, true);
+    REQUIRE(filter.getX() == Approx(sim.x).margin(0.05));
+
+    // carry the robot somewhere else without telling the filter
+    sim.x = -0.6;
+    sim.y = 0.3;
+    sim.th = 2.0;
+    drive(sim, filter, 400, true);
+
+    REQUIRE(filter.getX() == Approx(sim.x).margin(0.05));
+    REQUIRE(filter.getY() == Approx(sim.y).margin(0.05));
+    REQUIRE(rigid2d::normalize_angle(filter.getTh() - sim.th) == Approx(0.0).margin(0.05));
+}
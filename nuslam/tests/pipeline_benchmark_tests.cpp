@@ -0,0 +1,78 @@
+#include <catch_ros/catch.hpp>
+#include <nuslam/pipeline_benchmark_library.hpp>
+#include <nuturtlesim/tube_world_library.hpp>
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <string>
+#include <vector>
+
+TEST_CASE("The tubes are scattered apart and off the path of the robot", "[pipeline benchmark]")
+{
+    using namespace pipeline_benchmark;
+
+    const std::vector<tube_world::Tube> tubes = scatterTubes(200, 0.0762, 16.0, 4.0, 0.2, 3);
+    REQUIRE(tubes.size() == 200);
+    for (size_t i = 0; i < tubes.size(); ++i)
+    {
+        REQUIRE(std::abs(tubes[i].x) < 8.0);
+        REQUIRE(std::abs(std::hypot(tubes[i].x, tubes[i].y) - 4.0) >= 0.0762 + 0.2);
+        for (size_t j = 0; j < i; ++j)
+        {
+            REQUIRE(std::hypot(tubes[i].x - tubes[j].x, tubes[i].y - tubes[j].y) >= 2 * 0.0762 + 0.2);
+        }
+    }
+
+    // the same seed gives the same world, a full square gives what fits
+    REQUIRE(scatterTubes(200, 0.0762, 16.0, 4.0, 0.2, 3)[17].x == tubes[17].x);
+    REQUIRE(scatterTubes(1000, 0.0762, 2.5, 0.6, 0.2, 3).size() < 1000);
+}
+
+TEST_CASE("The percentiles are taken by nearest rank", "[pipeline benchmark]")
+{
+    using namespace pipeline_benchmark;
+
+    std::vector<double> samples;
+    for (int k = 1; k <= 200; ++k)
+    {
+        samples.push_back(k);
+    }
+    REQUIRE(percentile(samples, 0.5) == 100);
+    REQUIRE(percentile(samples, 0.99) == 198);
+    REQUIRE(percentile(samples, 1.0) == 200);
+    REQUIRE(percentile(samples, 0.0) == 1);
+    REQUIRE(percentile({}, 0.5) == 0.0);
+}
+
+TEST_CASE("The stack maps the default world and reports its latency", "[pipeline benchmark]")
+{
+    using namespace pipeline_benchmark;
+
+    RunParams params;
+    params.landmarks = 6;
+    params.scans = 50;
+    const RunResult result = runPipeline(params);
+
+    REQUIRE(result.tubes == 6);
+    REQUIRE(result.scans == 50);
+    REQUIRE(result.detections > 0.0);
+    REQUIRE(result.mapped > 0);
+    REQUIRE(result.mapped <= 6);
+    REQUIRE(result.latencyP50 <= result.latencyP90);
+    REQUIRE(result.latencyP90 <= result.latencyP99);
+    REQUIRE(result.latencyP99 <= result.latencyMax);
+    REQUIRE(result.scanRate > 0.0);
+    REQUIRE(result.filterMb > 0.0);
+    REQUIRE(result.peakRssMb > 0.0);
+
+    // a budget that runs out stops the run early
+    params.budget = 1e-9;
+    REQUIRE(runPipeline(params).scans == 1);
+
+    std::ostringstream csv, json;
+    writeCsv({result, result}, csv, true);
+    writeJson({result}, json);
+    const std::string lines = csv.str();
+    REQUIRE(std::count(lines.begin(), lines.end(), '\n') == 3);
+    REQUIRE(json.str().find("\"landmarks\": 6") != std::string::npos);
+}
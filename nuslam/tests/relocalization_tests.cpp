@@ -0,0 +1,105 @@
+#include <catch_ros/catch.hpp>
+#include <nuslam/relocalization_library.hpp>
+#include <rigid2d/rigid2d.hpp>
+#include <cmath>
+#include <random>
+#include <vector>
+
+/// \brief a site with no symmetry
+static const std::vector<double> site = {0.3, 0.2, -0.8, 0.5, 1.2, 1.1, -0.4, -1.3, 0.9, -0.6,
+                                         -1.5, -0.2, 2.1, 0.4, 0.1, 1.7, -1.9, 1.4, 1.6, -1.8};
+
+/// \brief the tube map of tube_world, the same after a half turn
+static const std::vector<double> tubes = {0.5, 0.5, -0.5, -0.5, 1.0, 1.0, -1.0, -1.0, -0.75, 0.75, 0.75, -0.75};
+
+/// \brief the landmarks seen from a pose, relative to the robot
+static std::vector<double> scan(const std::vector<double> & map, double x, double y, double th,
+                                double range, double noise, unsigned int seed)
+{
+    std::mt19937 gen(seed);
+    std::normal_distribution<> n(0.0, noise > 0.0 ? noise : 1e-12);
+
+    std::vector<double> points;
+    for (int i = 0; i + 1 < int(map.size()); i += 2)
+    {
+        double dx = map[i] - x, dy = map[i + 1] - y;
+        if (std::hypot(dx, dy) > range)
+        {
+            continue;
+        }
+        points.push_back(cos(th) * dx + sin(th) * dy + n(gen));
+        points.push_back(-sin(th) * dx + cos(th) * dy + n(gen));
+    }
+    return points;
+}
+
+TEST_CASE("Relocalization finds the pose from one scan", "[relocalization]")
+{
+    using namespace relocalization;
+
+    Relocalizer relocalizer(site, 4.0, 0.05, 200);
+    REQUIRE(relocalizer.tableSize() > 0);
+
+    PoseHypothesis pose = relocalizer.relocalize(scan(site, 0.4, -0.2, 2.5, 2.0, 0.0, 1));
+
+    REQUIRE(pose.found);
+    REQUIRE_FALSE(pose.ambiguous);
+    REQUIRE(pose.x == Approx(0.4).margin(1e-6));
+    REQUIRE(pose.y == Approx(-0.2).margin(1e-6));
+    REQUIRE(pose.th == Approx(2.5).margin(1e-6));
+}
+
+TEST_CASE("Relocalization tolerates noise and false landmarks", "[relocalization]")
+{
+    using namespace relocalization;
+
+    Relocalizer relocalizer(site, 4.0, 0.05, 200);
+
+    std::vector<double> points = scan(site, -0.5, 0.6, -1.0, 2.0, 0.01, 2);
+    const int seen = points.size() / 2;
+    points.insert(points.end(), {0.35, -0.9, -1.1, 0.15});
+
+    PoseHypothesis pose = relocalizer.relocalize(points);
+
+    REQUIRE(pose.found);
+    REQUIRE_FALSE(pose.ambiguous);
+    REQUIRE(pose.inliers == seen);
+    REQUIRE(pose.x == Approx(-0.5).margin(0.02));
+    REQUIRE(pose.y == Approx(0.6).margin(0.02));
+    REQUIRE(rigid2d::normalize_angle(pose.th + 1.0) == Approx(0.0).margin(0.02));
+}
+
+TEST_CASE("Relocalization samples the triplets of a crowded scan", "[relocalization]")
+{
+    using namespace relocalization;
+
+    Relocalizer relocalizer(site, 6.0, 0.05, 50);
+    PoseHypothesis pose = relocalizer.relocalize(scan(site, 0.0, 0.0, 0.7, 10.0, 0.005, 3));
+
+    REQUIRE(pose.found);
+    REQUIRE(pose.inliers == int(site.size()) / 2);
+    REQUIRE(pose.x == Approx(0.0).margin(0.01));
+    REQUIRE(pose.y == Approx(0.0).margin(0.01));
+    REQUIRE(pose.th == Approx(0.7).margin(0.01));
+}
+
+TEST_CASE("Relocalization reports a symmetric map as ambiguous", "[relocalization]")
+{
+    using namespace relocalization;
+
+    Relocalizer relocalizer(tubes, 4.0, 0.05, 100);
+    PoseHypothesis pose = relocalizer.relocalize(scan(tubes, 0.1, 0.0, 0.3, 5.0, 0.0, 4));
+
+    REQUIRE(pose.found);
+    REQUIRE(pose.ambiguous);
+}
+
+TEST_CASE("Relocalization needs three landmarks", "[relocalization]")
+{
+    using namespace relocalization;
+
+    Relocalizer relocalizer(site, 4.0, 0.05, 100);
+
+    REQUIRE_FALSE(relocalizer.relocalize({0.3, 0.2, -0.8, 0.5}).found);
+    REQUIRE_FALSE(relocalizer.relocalize({5.0, 5.0, 7.0, 5.0, 5.0, 9.0}).found);
+}
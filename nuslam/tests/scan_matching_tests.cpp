@@ -0,0 +1,203 @@
+#include <catch_ros/catch.hpp>
+#include <nuslam/scan_matching_library.hpp>
+#include <cmath>
+#include <random>
+#include <vector>
+
+/// \brief a wall from (x1, y1) to (x2, y2)
+struct Wall
+{
+    double x1, y1, x2, y2;
+};
+
+/// \brief a 4 x 3 m room with a box in one corner
+static const std::vector<Wall> room = {
+    {-2.0, -1.5, 2.0, -1.5}, {2.0, -1.5, 2.0, 1.5}, {2.0, 1.5, -2.0, 1.5}, {-2.0, 1.5, -2.0, -1.5},
+    {1.0, 0.5, 1.4, 0.5}, {1.4, 0.5, 1.4, 0.9}, {1.4, 0.9, 1.0, 0.9}, {1.0, 0.9, 1.0, 0.5}};
+
+/// \brief a corridor, two long parallel walls
+static const std::vector<Wall> corridor = {{-50.0, -0.6, 50.0, -0.6}, {-50.0, 0.6, 50.0, 0.6}};
+
+/// \brief ranges of a 360 beam scan taken at (x, y, th), 0 where nothing is within 3.5 m
+static std::vector<float> castScan(const std::vector<Wall> & walls, double x, double y, double th, double noise = 0.0)
+{
+    std::mt19937 gen(3);
+    std::normal_distribution<> dist(0.0, noise);
+
+    std::vector<float> ranges(360, 0.0f);
+    for (int i = 0; i < 360; ++i)
+    {
+        double a = th + i * M_PI / 180.0;
+        double dx = std::cos(a), dy = std::sin(a);
+        double best = 3.5;
+        for (const auto & w: walls)
+        {
+            // x + t d = w1 + u (w2 - w1)
+            double ex = w.x2 - w.x1, ey = w.y2 - w.y1;
+            double den = dx * ey - dy * ex;
+            if (std::fabs(den) < 1e-12)
+            {
+                continue;
+            }
+            double t = ((w.x1 - x) * ey - (w.y1 - y) * ex) / den;
+            double u = ((w.x1 - x) * dy - (w.y1 - y) * dx) / den;
+            if ((t > 0.0) && (u >= 0.0) && (u <= 1.0) && (t < best))
+            {
+                best = t;
+            }
+        }
+        ranges[i] = (best < 3.5) ? float(best + dist(gen)) : 0.0f;
+    }
+    return ranges;
+}
+
+TEST_CASE("ICP recovers the motion between two scans", "[scan matching]")
+{
+    using namespace scan_matching;
+
+    IcpMatcher icp;
+    const double inc = M_PI / 180.0;
+    icp.setReference(0.0, inc, castScan(room, 0.1, -0.2, 0.3), 0.12, 3.5);
+
+    // the robot moved 8 cm forward and turned 0.08 rad, ICP starts from no motion at all
+    const double dth = 0.08, dx = 0.08, dy = 0.01;
+    double wx = 0.1 + dx * std::cos(0.3) - dy * std::sin(0.3);
+    double wy = -0.2 + dx * std::sin(0.3) + dy * std::cos(0.3);
+    IcpResult result = icp.match(0.0, inc, castScan(room, wx, wy, 0.3 + dth), 0.12, 3.5, 0.0, 0.0, 0.0);
+
+    REQUIRE(result.converged);
+    REQUIRE(result.x == Approx(dx).margin(2e-3));
+    REQUIRE(result.y == Approx(dy).margin(2e-3));
+    REQUIRE(result.th == Approx(dth).margin(2e-3));
+    REQUIRE(result.correspondences > 200);
+
+    // with noise the covariance is positive and small
+    IcpResult noisy = icp.match(0.0, inc, castScan(room, wx, wy, 0.3 + dth, 0.01), 0.12, 3.5, 0.0, 0.0, 0.0);
+    REQUIRE(noisy.converged);
+    REQUIRE(noisy.x == Approx(dx).margin(5e-3));
+    REQUIRE(noisy.th == Approx(dth).margin(5e-3));
+    for (int i = 0; i < 3; ++i)
+    {
+        REQUIRE(noisy.cov[4 * i] > 0.0);
+        REQUIRE(noisy.cov[4 * i] < 1e-4);
+    }
+}
+
+TEST_CASE("A corridor does not constrain the motion along it", "[scan matching]")
+{
+    using namespace scan_matching;
+
+    IcpMatcher icp;
+    const double inc = M_PI / 180.0;
+    icp.setReference(0.0, inc, castScan(corridor, 0.0, 0.0, 0.0), 0.12, 3.5);
+
+    IcpResult result = icp.match(0.0, inc, castScan(corridor, 0.1, 0.0, 0.0), 0.12, 3.5, 0.0, 0.0, 0.0);
+    REQUIRE_FALSE(result.converged);
+
+    // nothing to match against before a reference is set
+    IcpMatcher fresh;
+    REQUIRE_FALSE(fresh.hasReference());
+    REQUIRE_FALSE(fresh.match(0.0, inc, castScan(room, 0.0, 0.0, 0.0), 0.12, 3.5, 0.0, 0.0, 0.0).converged);
+}
+
+TEST_CASE("ICP tracks the robot scan to scan", "[scan matching]")
+{
+    using namespace scan_matching;
+
+    IcpMatcher icp;
+    const double inc = M_PI / 180.0;
+    const int scans = 100;
+
+    // every match is chained onto the pose of the first scan, so the small errors add up over 2 m
+    int converged = 0;
+    double x = -1.0, y = -0.5, th = 0.0;
+    icp.setReference(0.0, inc, castScan(room, x, y, th, 0.005), 0.12, 3.5);
+    for (int k = 1; k <= scans; ++k)
+    {
+        const std::vector<float> ranges = castScan(room, -1.0 + 0.02 * k, -0.5 + 0.005 * k, 0.01 * k, 0.005);
+        IcpResult result = icp.match(0.0, inc, ranges, 0.12, 3.5, 0.0, 0.0, 0.0);
+        converged += result.converged;
+        x += result.x * std::cos(th) - result.y * std::sin(th);
+        y += result.x * std::sin(th) + result.y * std::cos(th);
+        th += result.th;
+        icp.setReference(0.0, inc, ranges, 0.12, 3.5);
+    }
+
+    REQUIRE(converged == scans);
+    REQUIRE(x == Approx(1.0).margin(0.1));
+    REQUIRE(y == Approx(0.0).margin(0.1));
+    REQUIRE(th == Approx(1.0).margin(0.05));
+}
+
+TEST_CASE("The correlative matcher finds a large rotation that ICP misses", "[scan matching]")
+{
+    using namespace scan_matching;
+
+    const double inc = M_PI / 180.0;
+    std::vector<float> reference = castScan(room, 0.1, -0.2, 0.3);
+
+    // the robot turned 1.2 rad and moved 0.3 m
+    const double dth = 1.2, dx = 0.25, dy = -0.15;
+    double wx = 0.1 + dx * std::cos(0.3) - dy * std::sin(0.3);
+    double wy = -0.2 + dx * std::sin(0.3) + dy * std::cos(0.3);
+    std::vector<float> scan = castScan(room, wx, wy, 0.3 + dth, 0.005);
+
+    IcpMatcher icp;
+    icp.setReference(0.0, inc, reference, 0.12, 3.5);
+    IcpResult lost = icp.match(0.0, inc, scan, 0.12, 3.5, 0.0, 0.0, 0.0);
+    REQUIRE_FALSE((lost.converged && (std::fabs(lost.th - dth) < 0.01)));
+
+    CorrelativeParams params;
+    params.angularWindow = 1.5;
+    params.threads = 4;
+    CorrelativeMatcher correlative(params);
+    correlative.addReference(0.0, inc, reference, 0.12, 3.5, 0.0, 0.0, 0.0);
+    REQUIRE(correlative.numReferencePoints() > 300);
+
+    CorrelativeResult coarse = correlative.match(0.0, inc, scan, 0.12, 3.5, 0.0, 0.0, 0.0);
+    REQUIRE(coarse.found);
+    REQUIRE(coarse.x == Approx(dx).margin(0.05));
+    REQUIRE(coarse.y == Approx(dy).margin(0.05));
+    REQUIRE(coarse.th == Approx(dth).margin(0.03));
+
+    // and ICP takes it from there
+    IcpResult fine = icp.match(0.0, inc, scan, 0.12, 3.5, coarse.x, coarse.y, coarse.th);
+    REQUIRE(fine.converged);
+    REQUIRE(fine.x == Approx(dx).margin(5e-3));
+    REQUIRE(fine.th == Approx(dth).margin(5e-3));
+
+    // the same answer on one thread
+    params.threads = 1;
+    CorrelativeMatcher single(params);
+    single.addReference(0.0, inc, reference, 0.12, 3.5, 0.0, 0.0, 0.0);
+    CorrelativeResult same = single.match(0.0, inc, scan, 0.12, 3.5, 0.0, 0.0, 0.0);
+    REQUIRE(same.score == Approx(coarse.score));
+}
+
+TEST_CASE("The correlative matcher builds its field from several scans", "[scan matching]")
+{
+    using namespace scan_matching;
+
+    const double inc = M_PI / 180.0;
+    CorrelativeMatcher correlative;
+
+    // nothing to match against
+    REQUIRE_FALSE(correlative.match(0.0, inc, castScan(room, 0.0, 0.0, 0.0), 0.12, 3.5, 0.0, 0.0, 0.0).found);
+
+    // two scans placed at their poses in the frame of the first
+    correlative.addReference(0.0, inc, castScan(room, -1.0, 0.0, 0.0), 0.12, 3.5, 0.0, 0.0, 0.0);
+    correlative.addReference(0.0, inc, castScan(room, -0.6, 0.2, 0.5), 0.12, 3.5, 0.4, 0.2, 0.5);
+
+    CorrelativeResult result = correlative.match(0.0, inc, castScan(room, -0.7, -0.1, -0.4), 0.12, 3.5,
+                                                 0.0, 0.0, 0.0);
+    REQUIRE(result.found);
+    REQUIRE(result.x == Approx(0.3).margin(0.05));
+    REQUIRE(result.y == Approx(-0.1).margin(0.05));
+    REQUIRE(result.th == Approx(-0.4).margin(0.03));
+    REQUIRE(result.score > 0.8);
+
+    // a scan of somewhere else scores too low to be reported
+    correlative.clearReference();
+    correlative.addReference(0.0, inc, castScan(corridor, 0.0, 0.0, 0.0), 0.12, 3.5, 0.0, 0.0, 0.0);
+    REQUIRE_FALSE(correlative.match(0.0, inc, castScan(room, 1.5, 1.0, 2.0), 0.12, 3.5, 0.0, 0.0, 0.0).found);
+}
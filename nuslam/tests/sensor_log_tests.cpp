@@ -0,0 +1,213 @@
+#include <catch_ros/catch.hpp>
+#include <nuslam/sensor_log_library.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+/// \brief the steps written by writeLog
+static const int STEPS = 200;
+
+/// \brief writes a scan, joint states and, on every other step, landmarks of both kinds, every 10 ms
+/// The landmarks are stamped a little before the scan, as their messages arrive late.
+static void writeLog(sensor_log::LogWriter & writer)
+{
+    using namespace sensor_log;
+
+    for (int k = 0; k < STEPS; ++k)
+    {
+        const int64_t t = 1000000000LL + k * 10000000LL;
+        std::vector<float> ranges(360);
+        for (int i = 0; i < 360; ++i)
+        {
+            ranges[i] = 1.0f + 0.001f * ((i * 7 + k) % 1000);
+        }
+        writer.writeScan(t, 0.0f, 0.0174533f, 0.12f, 3.5f, ranges);
+        writer.writeJoints(t + 1000, {0.01 * k, -0.02 * k}, {1.0, -2.0});
+        if (k % 2 == 0)
+        {
+            writer.writeLandmarks(t - 3000000, RecordType::REAL_LANDMARKS, {{1.0f, 0.5f * k, 0.038f, k}});
+            writer.writeLandmarks(t - 3000000, RecordType::FAKE_LANDMARKS, {});
+        }
+    }
+}
+
+/// \brief reads every record and checks it is the one writeLog wrote
+static void checkLog(sensor_log::LogReader & reader)
+{
+    using namespace sensor_log;
+
+    Record r;
+    for (int k = 0; k < STEPS; ++k)
+    {
+        const int64_t t = 1000000000LL + k * 10000000LL;
+
+        REQUIRE(reader.next(r));
+        REQUIRE(r.type == RecordType::SCAN);
+        REQUIRE(r.time == t);
+        REQUIRE(r.scan.count == 360);
+        REQUIRE(r.scan.rangeMax == 3.5f);
+        REQUIRE(reinterpret_cast<uintptr_t>(r.scan.ranges) % alignof(float) == 0);
+        REQUIRE(r.scan.ranges[100] == 1.0f + 0.001f * ((700 + k) % 1000));
+
+        REQUIRE(reader.next(r));
+        REQUIRE(r.type == RecordType::JOINTS);
+        REQUIRE(r.time == t + 1000);
+        REQUIRE(r.joints.count == 2);
+        REQUIRE(reinterpret_cast<uintptr_t>(r.joints.positions) % alignof(double) == 0);
+        REQUIRE(r.joints.positions[1] == -0.02 * k);
+        REQUIRE(r.joints.velocities[1] == -2.0);
+
+        if (k % 2 == 0)
+        {
+            REQUIRE(reader.next(r));
+            REQUIRE(r.type == RecordType::REAL_LANDMARKS);
+            REQUIRE(r.time == t - 3000000);
+            REQUIRE(r.landmarks.count == 1);
+            REQUIRE(r.landmarks.observations[0].y == 0.5f * k);
+            REQUIRE(r.landmarks.observations[0].id == k);
+
+            REQUIRE(reader.next(r));
+            REQUIRE(r.type == RecordType::FAKE_LANDMARKS);
+            REQUIRE(r.landmarks.count == 0);
+        }
+    }
+    REQUIRE(!reader.next(r));
+    REQUIRE(reader.skippedChunks() == 0);
+}
+
+TEST_CASE("Records come back as written, across chunks", "[sensor log]")
+{
+    using namespace sensor_log;
+
+    const std::string path = "/tmp/sensor_log_test_" + std::to_string(getpid()) + ".log";
+    std::string error;
+
+    long rawBytes = 0;
+    for (bool lz4 : {false, true})
+    {
+        LogWriter writer;
+        REQUIRE(writer.open(path, lz4, 16 * 1024, error));
+        writeLog(writer);
+        REQUIRE(writer.close(error));
+
+        // compressed chunks are only kept when they are smaller
+        const long bytes = std::ifstream(path, std::ios::binary | std::ios::ate).tellg();
+        if (!lz4)
+        {
+            rawBytes = bytes;
+        } else if (haveLZ4())
+        {
+            REQUIRE(bytes < rawBytes);
+        }
+
+        LogReader reader;
+        REQUIRE(reader.open(path, error));
+        REQUIRE(!reader.recovered());
+        REQUIRE(reader.numChunks() > 10);
+        REQUIRE(reader.numRecords() == 3 * STEPS);
+        REQUIRE(reader.firstTime() == 1000000000LL - 3000000);
+        REQUIRE(reader.lastTime() == 1000000000LL + (STEPS - 1) * 10000000LL + 1000);
+        checkLog(reader);
+
+        // and again from the start
+        reader.rewind();
+        checkLog(reader);
+    }
+
+    // not a log
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file << std::string(100, 'x');
+    }
+    LogReader reader;
+    REQUIRE(!reader.open(path, error));
+    REQUIRE(!reader.isOpen());
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Seeking finds the first record at a time through the index", "[sensor log]")
+{
+    using namespace sensor_log;
+
+    const std::string path = "/tmp/sensor_log_test_" + std::to_string(getpid()) + ".log";
+    std::string error;
+
+    LogWriter writer;
+    REQUIRE(writer.open(path, false, 8 * 1024, error));
+    writeLog(writer);
+    REQUIRE(writer.close(error));
+
+    LogReader reader;
+    REQUIRE(reader.open(path, error));
+
+    Record r;
+    for (int k : {0, 1, 57, 120, STEPS - 1})
+    {
+        // the scan of step k, the landmarks stamped before it are passed
+        const int64_t t = 1000000000LL + k * 10000000LL;
+        reader.seek(t);
+        REQUIRE(reader.next(r));
+        REQUIRE(r.time >= t);
+        REQUIRE(r.time <= t + 1000);
+    }
+
+    reader.seek(0);
+    REQUIRE(reader.next(r));
+    REQUIRE(r.time == 1000000000LL);
+
+    reader.seek(reader.lastTime() + 1);
+    REQUIRE(!reader.next(r));
+    std::remove(path.c_str());
+}
+
+TEST_CASE("A log that was never closed is read up to its last complete chunk", "[sensor log]")
+{
+    using namespace sensor_log;
+
+    const std::string path = "/tmp/sensor_log_test_" + std::to_string(getpid()) + ".log";
+    std::string error;
+
+    LogWriter writer;
+    REQUIRE(writer.open(path, false, 16 * 1024, error));
+    writeLog(writer);
+    REQUIRE(writer.close(error));
+
+    LogReader reader;
+    REQUIRE(reader.open(path, error));
+    const size_t chunks = reader.numChunks();
+
+    // cut the file in the middle of the last chunk, losing it and the index
+    std::vector<char> bytes;
+    {
+        std::ifstream file(path, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    reader.close();
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(bytes.data(), bytes.size() - chunks * sizeof(ChunkIndex) - 100);
+    }
+
+    REQUIRE(reader.open(path, error));
+    REQUIRE(reader.recovered());
+    REQUIRE(reader.numChunks() == chunks - 1);
+
+    Record r;
+    uint64_t count = 0;
+    int64_t last = 0;
+    while (reader.next(r))
+    {
+        REQUIRE(r.time >= last - 4000000);
+        last = std::max(last, r.time);
+        ++count;
+    }
+    REQUIRE(count == reader.numRecords());
+    REQUIRE(count > 0);
+    REQUIRE(count < 3 * STEPS);
+    std::remove(path.c_str());
+}
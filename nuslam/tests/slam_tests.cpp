@@ -0,0 +1,166 @@
+#include <catch_ros/catch.hpp>
+#include <nuslam/slam_library.hpp>
+#include <armadillo>
+#include <cstdint>
+#include <vector>
+
+TEST_CASE("Data association numbers new landmarks from 1 and drops them once the state is full", "[slam]")
+{
+    using namespace arma;
+    using namespace slam_library;
+
+    colvec robotState(3, fill::zeros);
+    colvec mapState(6, fill::zeros);
+    mat Q(3, 3, fill::eye);
+    mat R(2, 2, fill::eye);
+    R *= 0.01;
+
+    ExtendedKalman filter(robotState, mapState, Q, R);
+    REQUIRE(filter.getNumVisited() == 0);
+
+    // the first landmark takes slot 1, the one h, getH and KalmanGain index from
+    REQUIRE(filter.DataAssociation(RangeBearing(1.0, 0.0)) == 1);
+    REQUIRE(filter.getNumVisited() == 1);
+    REQUIRE(filter.getStateVec()(3) == Approx(1.0));
+    REQUIRE(filter.getStateVec()(4) == Approx(0.0).margin(1e-12));
+
+    // once the landmarks are well known, a far measurement is a new one
+    filter.updateCov(1e-4 * mat(9, 9, fill::eye));
+    REQUIRE(filter.DataAssociation(RangeBearing(0.0, 2.0)) == 2);
+    REQUIRE(filter.getStateVec()(5) == Approx(0.0).margin(1e-12));
+    REQUIRE(filter.getStateVec()(6) == Approx(2.0));
+    REQUIRE(filter.DataAssociation(RangeBearing(1.0, 0.0)) == 1);
+
+    REQUIRE(filter.DataAssociation(RangeBearing(-2.0, 0.0)) == 3);
+    REQUIRE(filter.getNumVisited() == 3);
+
+    // every slot is taken, the landmark is dropped and nothing is written past the state
+    REQUIRE(filter.DataAssociation(RangeBearing(0.0, -3.0)) == -1);
+    REQUIRE(filter.getNumVisited() == 3);
+    REQUIRE(filter.getStateVec().n_elem == 9);
+}
+
+TEST_CASE("The fitted radius gates data association before the Mahalanobis test", "[slam]")
+{
+    using namespace arma;
+    using namespace slam_library;
+
+    colvec robotState(3, fill::zeros);
+    colvec mapState(6, fill::zeros);
+    mat Q(3, 3, fill::eye);
+    mat R(2, 2, fill::eye);
+    R *= 0.01;
+
+    ExtendedKalman filter(robotState, mapState, Q, R);
+    filter.setRadiusNoise(1e-4, 6.63);
+    REQUIRE(filter.getRadiusVar(1) == -1.0);
+
+    // a tube 1 m ahead, seen twice
+    const colvec ahead = RangeBearing(1.0, 0.0);
+    REQUIRE(filter.DataAssociation(ahead, 0.05) == 1);
+    filter.updateRadius(1, 0.05);
+    REQUIRE(filter.getRadius(1) == Approx(0.05));
+    REQUIRE(filter.getRadiusVar(1) == Approx(1e-4));
+    REQUIRE(filter.DataAssociation(ahead, 0.05) == 1);
+    filter.updateRadius(1, 0.052);
+    REQUIRE(filter.getRadius(1) == Approx(0.051));
+    REQUIRE(filter.getRadiusVar(1) == Approx(5e-5));
+    filter.updateCov(1e-4 * mat(9, 9, fill::eye));
+
+    // a tube three times as wide at the same place is a bad fit of that tube, not a second one on top of it
+    REQUIRE(filter.DataAssociation(ahead, 0.15) == -1);
+    REQUIRE(filter.getNumVisited() == 1);
+    REQUIRE(filter.DataAssociation(ahead) == 1);
+
+    // elsewhere it is another landmark
+    REQUIRE(filter.DataAssociation(RangeBearing(0.0, 2.0), 0.15) == 2);
+    filter.updateRadius(2, 0.15);
+
+    uint64_t tested, rejected;
+    filter.associationStats(tested, rejected);
+    REQUIRE(tested == 4);
+    REQUIRE(rejected == 2);
+
+    // once every slot is taken a tube of a new size is dropped
+    REQUIRE(filter.DataAssociation(RangeBearing(-2.0, 0.0), 0.3) == 3);
+    filter.updateRadius(3, 0.3);
+    REQUIRE(filter.DataAssociation(RangeBearing(0.0, -3.0), 0.6) == -1);
+    filter.associationStats(tested, rejected);
+    REQUIRE(tested == 9);
+    REQUIRE(rejected == 7);
+    REQUIRE(filter.getNumVisited() == 3);
+
+    // merging two landmarks fuses their radii and frees the slot of the duplicate
+    filter.mergeLandmarks({{1, 3}}, 1e-6);
+    REQUIRE(filter.getNumVisited() == 2);
+    REQUIRE(filter.getRadius(1) == Approx((0.051 * 1e-4 + 0.3 * 5e-5) / 1.5e-4));
+    REQUIRE(filter.getRadiusVar(1) == Approx(5e-5 * 1e-4 / 1.5e-4));
+    REQUIRE(filter.getRadius(2) == Approx(0.15));
+    REQUIRE(filter.getRadiusVar(3) == -1.0);
+
+    // a warm start forgets the radii, a saved map can set them again
+    filter.warmStart(filter.getStateVec(), filter.getCov(), 2);
+    REQUIRE(filter.getRadiusVar(1) == -1.0);
+    filter.setRadius(2, 0.15, 1e-4);
+    REQUIRE(filter.getRadius(2) == Approx(0.15));
+}
+
+TEST_CASE("Merged slots follow the landmarks mergeLandmarks moves down", "[slam]")
+{
+    using namespace slam_library;
+
+    // the duplicates take the slot they were merged into, the landmarks after them move down
+    REQUIRE(mergedSlots(6, {{1, 4}, {2, 6}}) == std::vector<int>{0, 1, 2, 3, 1, 4, 2});
+
+    // a kept landmark that is itself a duplicate passes its slot on
+    REQUIRE(mergedSlots(5, {{1, 3}, {3, 5}}) == std::vector<int>{0, 1, 2, 1, 3, 1});
+    REQUIRE(mergedSlots(2, {}) == std::vector<int>{0, 1, 2});
+}
+
+TEST_CASE("A landmark summary is fused in one covariance intersection, whatever its order", "[slam]")
+{
+    using namespace arma;
+    using namespace slam_library;
+
+    colvec robotState(3, fill::zeros);
+    colvec mapState(6, fill::zeros);
+    mat Q(3, 3, fill::eye);
+    mat R(2, 2, fill::eye);
+    R *= 0.01;
+
+    ExtendedKalman filter(robotState, mapState, Q, R);
+    REQUIRE(filter.DataAssociation(RangeBearing(1.0, 0.0)) == 1);
+    filter.updateCov(1e-4 * mat(9, 9, fill::eye));
+    REQUIRE(filter.DataAssociation(RangeBearing(0.0, 2.0)) == 2);
+    REQUIRE(filter.DataAssociation(RangeBearing(-2.0, 0.0)) == 3);
+
+    const colvec variances = {0.1, 0.1, 0.1, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0};
+    filter.updateCov(diagmat(variances));
+    ExtendedKalman swapped = filter;
+
+    // the other robot knows landmarks 1 and 2 far better
+    const colvec means = {1.1, 0.0, 0.0, 2.1};
+    const mat B = diagmat(colvec{0.01, 0.01, 0.02, 0.02});
+    const double omega = filter.intersectLandmarks({1, 2}, means, B);
+    REQUIRE(omega > 0.0);
+    REQUIRE(omega < 1.0);
+
+    const colvec swappedMeans = {0.0, 2.1, 1.1, 0.0};
+    const mat swappedB = diagmat(colvec{0.02, 0.02, 0.01, 0.01});
+    REQUIRE(swapped.intersectLandmarks({2, 1}, swappedMeans, swappedB) == Approx(omega));
+    REQUIRE(approx_equal(filter.getStateVec(), swapped.getStateVec(), "absdiff", 1e-9));
+    REQUIRE(approx_equal(filter.getCov(), swapped.getCov(), "absdiff", 1e-9));
+
+    // the pose and landmark 3 are inflated by 1/omega once, not once per landmark
+    REQUIRE(filter.getCov()(0, 0) == Approx(0.1 / omega));
+    REQUIRE(filter.getCov()(7, 7) == Approx(1.0 / omega));
+    REQUIRE(filter.getCov()(3, 3) < 1.0);
+    REQUIRE(filter.getStateVec()(3) > 1.0);
+
+    // an estimate no better than the filter is not worth inflating the rest for
+    const colvec state = filter.getStateVec();
+    const mat cov = filter.getCov();
+    REQUIRE(filter.intersectLandmarks({3}, colvec{-2.5, 0.0}, 100.0 * mat(2, 2, fill::eye)) == 1.0);
+    REQUIRE(approx_equal(filter.getStateVec(), state, "absdiff", 0.0));
+    REQUIRE(approx_equal(filter.getCov(), cov, "absdiff", 0.0));
+}
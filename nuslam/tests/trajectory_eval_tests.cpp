@@ -0,0 +1,176 @@
+#include <catch_ros/catch.hpp>
+#include <nuslam/trajectory_eval_library.hpp>
+#include <nuslam/sensor_log_library.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+/// \brief the true pose of a robot driving a circle of radius 1 m at 0.5 rad/s
+static trajectory_eval::StampedPose circle(double t)
+{
+    return {t, std::remainder(0.5 * t + M_PI / 2.0, 2.0 * M_PI), std::cos(0.5 * t), std::sin(0.5 * t)};
+}
+
+/// \brief a pose moved by the rotation th and the translation (x, y)
+static trajectory_eval::StampedPose moved(const trajectory_eval::StampedPose & p, double th, double x, double y)
+{
+    return {p.t, std::remainder(p.th + th, 2.0 * M_PI), std::cos(th) * p.x - std::sin(th) * p.y + x,
+            std::sin(th) * p.x + std::cos(th) * p.y + y};
+}
+
+TEST_CASE("Estimates are paired with the ground truth interpolated at their stamp", "[trajectory eval]")
+{
+    using namespace trajectory_eval;
+
+    TimeAssociator associator(0.5);
+    std::vector<PosePair> pairs;
+
+    // before the ground truth starts nothing is paired, after it an estimate waits for the next pose
+    associator.addEstimate({-0.05, 0.0, 0.0, 0.0}, pairs);
+    associator.addTruth({0.0, 0.0, 0.0, 0.0}, pairs);
+    REQUIRE(pairs.empty());
+    associator.addEstimate({0.15, 0.0, 0.0, 0.0}, pairs);
+    associator.addTruth({0.2, 0.2, 1.0, -2.0}, pairs);
+    REQUIRE(pairs.size() == 1);
+    REQUIRE(pairs[0].truth.t == 0.15);
+    REQUIRE(pairs[0].truth.x == Approx(0.75));
+    REQUIRE(pairs[0].truth.y == Approx(-1.5));
+    REQUIRE(pairs[0].truth.th == Approx(0.15));
+
+    // the heading is interpolated the short way around
+    pairs.clear();
+    associator.addTruth({0.4, 3.1, 1.0, -2.0}, pairs);
+    associator.addTruth({0.6, -3.1, 1.0, -2.0}, pairs);
+    associator.addEstimate({0.5, 0.0, 0.0, 0.0}, pairs);
+    REQUIRE(pairs.size() == 1);
+    REQUIRE(std::abs(pairs[0].truth.th) == Approx(M_PI).margin(0.05));
+
+    // estimates in a gap of the ground truth are not paired
+    pairs.clear();
+    associator.addEstimate({1.0, 0.0, 0.0, 0.0}, pairs);
+    associator.addTruth({2.0, 0.0, 0.0, 0.0}, pairs);
+    REQUIRE(pairs.empty());
+    associator.addEstimate({2.5, 0.0, 0.0, 0.0}, pairs);
+    REQUIRE(associator.unpaired() == 3);
+}
+
+TEST_CASE("The alignment moves the estimate onto the ground truth", "[trajectory eval]")
+{
+    using namespace trajectory_eval;
+
+    Se2Aligner aligner;
+    std::vector<PosePair> pairs;
+    for (int k = 0; k < 100; ++k)
+    {
+        const StampedPose truth = circle(0.1 * k);
+        const StampedPose estimate = moved(truth, -0.3, 0.5, -1.0);
+        pairs.push_back({estimate, truth});
+        aligner.add(pairs.back());
+    }
+
+    const Alignment alignment = aligner.solve();
+    REQUIRE(alignment.valid);
+    REQUIRE(alignment.th == Approx(0.3));
+
+    ErrorStats ate;
+    for (const auto & pair: pairs)
+    {
+        double translation, rotation;
+        absoluteError(alignment, pair, translation, rotation);
+        ate.add(translation);
+        REQUIRE(rotation == Approx(0.0).margin(1e-9));
+    }
+    REQUIRE(ate.count == 100);
+    REQUIRE(ate.max == Approx(0.0).margin(1e-9));
+
+    REQUIRE(!Se2Aligner().solve().valid);
+}
+
+TEST_CASE("The relative error measures the drift over a fixed time", "[trajectory eval]")
+{
+    using namespace trajectory_eval;
+
+    // the estimate drives 10 % further than the robot, which drives straight at 1 m/s
+    RelativeError relative(1.0);
+    for (int k = 0; k <= 50; ++k)
+    {
+        const double t = 0.1 * k;
+        relative.add({{t, 0.0, 1.1 * t, 0.0}, {t, 0.0, t, 0.0}});
+    }
+    REQUIRE(relative.translation.count == 41);
+    REQUIRE(relative.translation.mean() == Approx(0.1).margin(0.001));
+    REQUIRE(relative.rotation.max == Approx(0.0).margin(1e-9));
+}
+
+TEST_CASE("A recorded log is evaluated in two passes", "[trajectory eval]")
+{
+    using namespace trajectory_eval;
+    using namespace sensor_log;
+
+    const std::string path = "/tmp/trajectory_eval_test_" + std::to_string(getpid()) + ".log";
+    {
+        // the ground truth at 50 Hz, the estimate at 10 Hz in a turned frame with a 2 cm error,
+        // replayed at twice real time
+        LogWriter writer;
+        std::string error;
+        REQUIRE(writer.open(path, false, 4096, error));
+        for (int k = 0; k <= 1000; ++k)
+        {
+            const double t = 0.02 * k;
+            const int64_t ns = 1000000000LL + k * 20000000LL;
+            const int64_t wall = 5000000000LL + k * 10000000LL;
+            const StampedPose truth = circle(t);
+            writer.writePose(ns, PoseSource::TRUTH, wall, truth.th, truth.x, truth.y);
+            if (k % 5 == 0)
+            {
+                const StampedPose estimate = moved(truth, 0.2, 0.3, 0.0);
+                writer.writeScan(ns, 0.0f, 0.1f, 0.1f, 3.5f, std::vector<float>(4, 1.0f));
+                writer.writePose(ns + 1000, PoseSource::SLAM, wall, estimate.th, estimate.x + ((k % 10) ? 0.02 : -0.02),
+                                 estimate.y);
+            }
+        }
+        REQUIRE(writer.close(error));
+    }
+
+    LogReader reader;
+    std::string error;
+    REQUIRE(reader.open(path, error));
+
+    EvalParams params;
+    Report report;
+    REQUIRE(evaluateLog(reader, params, report, error));
+    REQUIRE(report.estimate == "slam");
+    REQUIRE(report.estimates == 201);
+    REQUIRE(report.truths == 1001);
+    REQUIRE(report.pairs == 200);
+    REQUIRE(report.unpaired == 1);
+    REQUIRE(report.alignment.th == Approx(-0.2).margin(0.005));
+    REQUIRE(report.ateTranslation.count == 200);
+    REQUIRE(report.ateTranslation.rmse() == Approx(0.02).margin(0.002));
+    REQUIRE(report.ateRotation.max < 0.01);
+    REQUIRE(report.rpeTranslation.count > 150);
+    REQUIRE(report.rpeTranslation.max < 0.05);
+    REQUIRE(report.logDuration == Approx(20.0));
+    REQUIRE(report.realtimeFactor == Approx(2.0));
+    REQUIRE(report.estimateRate == Approx(20.0));
+    REQUIRE(report.scans == 200);
+    REQUIRE(report.records == 1001 + 2 * 201);
+
+    std::ostringstream json, csv;
+    writeJson(report, json);
+    writeCsv(report, csv, true);
+    REQUIRE(json.str().find("\"realtime_factor\": 2") != std::string::npos);
+    const std::string lines = csv.str();
+    REQUIRE(std::count(lines.begin(), lines.end(), '\n') == 2);
+
+    // the ground truth is not evaluated against itself
+    params.estimate = PoseSource::TRUTH;
+    REQUIRE(!evaluateLog(reader, params, report, error));
+
+    reader.close();
+    std::remove(path.c_str());
+}
@@ -0,0 +1,171 @@
+#ifndef DWA_LIBRARY_INCLUDE_GUARD_HPP
+#define DWA_LIBRARY_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Library for avoiding obstacles with a dynamic window planner over a precomputed trajectory lattice
+
+#include <rigid2d/rigid2d.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace dwa
+{
+    using rigid2d::Twist2D;
+
+    /// \brief the cost of a cell holding an obstacle, lower costs fall off with the distance to one
+    constexpr uint8_t LETHAL = 255;
+
+    /// \brief parameters of the local grid and the planner
+    struct DwaParams
+    {
+        double resolution = 0.02;       // cell side of the local grid (m)
+        double range = 1.0;             // the grid reaches this far from the robot on each side (m)
+        double robotRadius = 0.095;     // the swept footprints are this wide on each side of the trajectory (m)
+        double inflation = 0.15;        // cells closer than this to an obstacle cost more the closer they are (m)
+
+        double horizon = 1.5;           // time each twist is rolled out for (s)
+        double dt = 0.05;               // step of the rollout (s)
+        int linearSamples = 11;         // forward speeds in the lattice, from 0 to the fastest
+        int angularSamples = 21;        // turning rates in the lattice, symmetric about 0
+
+        double maxLinearAccel = 1.0;    // the window around the current twist, per control period (m/s^2)
+        double maxAngularAccel = 6.0;   // (rad/s^2)
+
+        double goalWeight = 1.0;        // per meter from the end of a trajectory to the goal, around the obstacles
+        double headingWeight = 0.1;     // per radian between the final heading and the goal direction
+        double clearanceWeight = 0.3;   // at the highest cost below LETHAL along the trajectory
+        double speedWeight = 0.2;       // at standing still
+    };
+
+    /// \brief a grid around the robot, in its frame, holding the cost of being in each cell
+    /// Rebuilt from every scan: each point marks its cell LETHAL and stamps a precomputed kernel that
+    /// falls off linearly to 0 at the inflation distance, keeping the highest cost in each cell. The
+    /// distance to the goal is then spread from the goal cell around the cells the robot fits in, so
+    /// the planner is not drawn into obstacles lying between the robot and the goal.
+    class CostGrid
+    {
+        private:
+            double resolution;
+            int size;                           // cells on a side, the robot is in the middle cell
+            std::vector<uint8_t> cost;          // row major
+
+            int kernelRadius;
+            std::vector<uint8_t> kernel;
+            uint8_t inscribed;                  // cells at or above this cost are closer than the robot radius to an obstacle
+
+            std::vector<float> toGoal;          // distance to the goal around the obstacles (m), row major
+
+        public:
+            /// \brief create an empty grid
+            /// \param params - the resolution, range and inflation of the grid
+            explicit CostGrid(const DwaParams & params);
+
+            /// \brief replaces the content of the grid with a scan taken at the robot
+            /// \param angleMin - angle of the first beam
+            /// \param angleIncrement - angle between beams
+            /// \param ranges - range of each beam
+            /// \param rangeMin - shorter ranges are ignored
+            /// \param rangeMax - longer ranges are ignored
+            void build(double angleMin, double angleIncrement, const std::vector<float> & ranges,
+                       double rangeMin, double rangeMax);
+
+            /// \brief spreads the distance to a goal over the cells the robot fits in
+            /// \param goalX - the goal in the robot frame, a goal off the grid is moved in to its edge
+            /// \param goalY - the goal in the robot frame
+            void spreadGoal(double goalX, double goalY);
+
+            /// \brief returns the number of cells on a side
+            int getSize() const;
+
+            /// \brief returns the index of the cell holding a point in the robot frame, -1 off the grid
+            int index(double x, double y) const;
+
+            /// \brief returns the cost of a cell by index
+            uint8_t at(int index) const;
+
+            /// \brief returns the costs of every cell, row major
+            const uint8_t * data() const;
+
+            /// \brief returns the distance from a cell to the goal of the last spreadGoal, by index
+            /// Cells the goal cannot be reached from are further than any that it can.
+            float goalDistance(int index) const;
+
+            /// \brief returns the direction from a cell toward its neighbor closest to the goal, by index
+            /// \return the angle in the robot frame, NaN at the goal cell
+            double goalDirection(int index) const;
+    };
+
+    /// \brief the twist chosen by the planner
+    struct DwaResult
+    {
+        bool found = false;             // false if every twist in the window collides
+        Twist2D twist{0.0, 0.0, 0.0};   // the twist to command, zero if none was found
+        double cost = 0.0;
+        int evaluated = 0;              // trajectories scored
+    };
+
+    /// \brief a dynamic window planner that scores a fixed lattice of twists against a local cost grid
+    /// At construction every (v, w) twist in the lattice that the wheels can follow is rolled out over the
+    /// horizon with the DiffDrive kinematics, and the grid cells swept by the robot along it are stored step
+    /// by step. Planning then only reads the cost grid at those precomputed indices, stopping at the first
+    /// step that reaches an obstacle, and weighs progress toward the goal against the clearance and the
+    /// speed for each twist inside the window reachable from the current one. As in the original dynamic
+    /// window approach, a twist that reaches an obstacle is still allowed if the robot can brake before it,
+    /// scored on the part of it before the obstacle, so a robot that is going fast is never left without
+    /// a choice.
+    class DwaPlanner
+    {
+        private:
+            /// \brief one rolled out twist of the lattice
+            struct Trajectory
+            {
+                double v, w;
+                int first, last;                // range of its steps in the step list
+            };
+
+            /// \brief one step of a rollout
+            struct Step
+            {
+                float x, y, th;                 // pose reached at the end of the step
+                int cell;                       // grid index of the pose
+                int first, last;                // range of the cells first swept in this step in the swept cell list
+            };
+
+            DwaParams params;
+            double maxLinear, maxAngular;
+            std::vector<Trajectory> lattice;
+            std::vector<Step> steps;            // the steps of every trajectory, one after the other
+            std::vector<int32_t> swept;         // the grid cells of every step, one after the other
+
+        public:
+            /// \brief rolls out the lattice
+            /// \param dwaParams - the parameters of the grid and the lattice
+            /// \param wheelBase - the distance between the wheels
+            /// \param wheelRad - the radius of the wheels
+            /// \param maxWheelVel - the fastest a wheel turns (rad/s)
+            DwaPlanner(const DwaParams & dwaParams, double wheelBase, double wheelRad, double maxWheelVel);
+
+            /// \brief returns the number of twists in the lattice
+            int latticeSize() const;
+
+            /// \brief returns the total number of swept cells stored for the lattice
+            int sweptCells() const;
+
+            /// \brief returns the fastest forward speed of the lattice
+            double getMaxLinear() const;
+
+            /// \brief returns the fastest turning rate of the lattice
+            double getMaxAngular() const;
+
+            /// \brief chooses the twist to command
+            /// \param grid - the costs around the robot, built with the same parameters, with the goal spread
+            /// \param current - the twist the robot is moving with
+            /// \param period - the control period, the window is what the accelerations reach in it
+            /// \param goalX - the goal in the robot frame, as given to spreadGoal
+            /// \param goalY - the goal in the robot frame
+            /// \return the best twist, or a zero twist if every twist in the window collides
+            DwaResult plan(const CostGrid & grid, const Twist2D & current, double period, double goalX,
+                           double goalY) const;
+    };
+}
+
+#endif
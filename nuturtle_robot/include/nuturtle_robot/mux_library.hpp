@@ -0,0 +1,78 @@
+#ifndef MUX_LIBRARY_INCLUDE_GUARD_HPP
+#define MUX_LIBRARY_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Library for multiplexing twist commands from several sources by priority
+
+#include <rigid2d/rigid2d.hpp>
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace mux
+{
+    using rigid2d::Twist2D;
+
+    /// \brief the largest number of lanes a multiplexer can hold
+    constexpr int MAX_LANES = 8;
+
+    /// \brief selects, among several twist sources, the highest priority one that is still fresh
+    /// Every lane is written by its own subscriber callback and read by whichever thread publishes,
+    /// so a lane is guarded by a sequence counter instead of a mutex: writers never block and a
+    /// reader retries on the rare occasion it overlaps a write. Lanes are added before any update
+    /// and kept sorted by priority, so selection is a single scan that stops at the first fresh lane.
+    class TwistMux
+    {
+        private:
+            /// \brief one twist source
+            struct Lane
+            {
+                int priority = 0;
+                double timeout = 0.0;
+                std::atomic<std::uint32_t> seq{0};      // odd while a write is in progress
+                std::atomic<double> stamp{-1.0};        // time of the last command, negative if none yet
+                std::atomic<double> dx{0.0};
+                std::atomic<double> dth{0.0};
+            };
+
+            std::array<Lane, MAX_LANES> lanes;
+            std::array<int, MAX_LANES> order;           // lane indices, highest priority first
+            int count = 0;
+
+            std::atomic<bool> stopped{false};
+
+        public:
+            /// \brief create a multiplexer with no lanes
+            TwistMux();
+
+            /// \brief adds a twist source, must be called before the multiplexer is used from several threads
+            /// Lanes of equal priority are ordered by the order they were added in.
+            /// \param priority - higher priorities override lower ones
+            /// \param timeout - seconds after its last command at which the lane stops being considered
+            /// \return the index of the new lane, or -1 if there are already MAX_LANES lanes
+            int addLane(int priority, double timeout);
+
+            /// \brief number of lanes that have been added
+            int lanesCount() const;
+
+            /// \brief records a new command on a lane, safe to call concurrently with select
+            /// \param lane - the index returned by addLane
+            /// \param tw - the commanded twist
+            /// \param stamp - the time of the command (seconds)
+            void update(int lane, const Twist2D & tw, double stamp);
+
+            /// \brief engages or releases the safety stop, which overrides every lane with a zero twist
+            /// \param stop - true to stop the robot
+            void setStop(bool stop);
+
+            /// \brief whether the safety stop is engaged
+            bool isStopped() const;
+
+            /// \brief finds the command to send
+            /// \param now - the current time (seconds)
+            /// \param out - the twist of the selected lane, or zero if no lane is selected
+            /// \return the index of the selected lane, or -1 if the safety stop is engaged or every lane timed out
+            int select(double now, Twist2D & out) const;
+    };
+}
+
+#endif
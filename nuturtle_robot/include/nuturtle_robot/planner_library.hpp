@@ -0,0 +1,184 @@
+#ifndef PLANNER_LIBRARY_INCLUDE_GUARD_HPP
+#define PLANNER_LIBRARY_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Library for planning paths over an occupancy grid inflated by the robot radius
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace planner
+{
+    /// \brief a cell of the grid, (0, 0) is the cell at the origin of the map
+    struct Cell
+    {
+        int x = 0;
+        int y = 0;
+    };
+
+    /// \brief a grid of obstacles with the distance from each cell to the nearest obstacle
+    /// The distance transform is kept up to date incrementally (dynamic brushfire, Lau et al. 2010):
+    /// setting or clearing obstacles queues the changed cells, and update() only visits the cells whose
+    /// nearest obstacle changed. Distances are only propagated out to the inflation radius, cells closer
+    /// than that to an obstacle are blocked. Cells are stored row by row with a one cell border, so neighbors
+    /// never need a bounds check, and the blocked cells are mirrored into one bit per cell both row by row
+    /// and column by column for the planner to scan 64 cells at a time.
+    class DistanceMap
+    {
+        private:
+            int width, height, stride;
+            int maxDist2;                       // squared inflation radius, in cells, nothing is propagated further
+
+            std::vector<int32_t> dist2;         // squared distance to the nearest obstacle, in cells, -1 on the border
+            std::vector<int32_t> nearest;       // index of the nearest obstacle, -1 if none within the inflation
+            std::vector<uint8_t> flags;         // OBSTACLE, BORDER and RAISE bits
+            int offsets[8];                     // index offsets of the neighbors, straight ones first
+
+            // blocked bits, including the border
+            int rowWords, columnWords;
+            std::vector<uint64_t> rows;         // height + 2 rows of rowWords words
+            std::vector<uint64_t> columns;      // width + 2 columns of columnWords words
+
+            // bucket queue on the squared distance
+            std::vector<std::vector<int32_t>> buckets;
+            int lowestBucket;
+            int queued;
+
+            void push(int index, int d2);
+            int pop();
+
+            /// \brief sets the distance of a cell and flips its blocked bits if needed
+            void setDistance2(int index, int d2);
+
+            /// \brief squared distance between two cells given by index
+            int distance2(int a, int b) const;
+
+            void raise(int index);
+            void lower(int index);
+
+        public:
+            static constexpr uint8_t OBSTACLE = 1;
+            static constexpr uint8_t BORDER = 2;
+            static constexpr uint8_t RAISE = 4;
+
+            /// \brief create an empty map
+            DistanceMap();
+
+            /// \brief create a map without obstacles
+            /// \param w - width in cells
+            /// \param h - height in cells
+            /// \param inflation - cells closer than this to an obstacle are blocked, in cells
+            DistanceMap(int w, int h, double inflation);
+
+            /// \brief returns the width in cells
+            int getWidth() const;
+
+            /// \brief returns the height in cells
+            int getHeight() const;
+
+            /// \brief returns the internal index of a cell, for the planner
+            int index(int x, int y) const;
+
+            /// \brief returns the cell at an internal index
+            Cell cellAt(int index) const;
+
+            /// \brief returns the index offset of a neighbor
+            /// \param k - 0 to 3 are +x, -x, +y, -y, 4 to 7 the diagonals +x+y, +x-y, -x+y, -x-y
+            int neighborOffset(int k) const;
+
+            /// \brief returns true if the cell is on the map
+            bool contains(int x, int y) const;
+
+            /// \brief marks a cell as an obstacle, applied by the next update
+            void setObstacle(int x, int y);
+
+            /// \brief clears an obstacle, applied by the next update
+            void removeObstacle(int x, int y);
+
+            /// \brief returns true if the cell is an obstacle
+            bool isObstacle(int x, int y) const;
+
+            /// \brief propagates every change since the last update
+            /// \return the number of cells visited
+            int update();
+
+            /// \brief returns the distance from a cell to the nearest obstacle, in cells, capped at the inflation
+            double distance(int x, int y) const;
+
+            /// \brief returns the squared distance of a cell by internal index, in cells, -1 on the border
+            int distance2At(int index) const;
+
+            /// \brief returns the flags of a cell by internal index
+            uint8_t flagsAt(int index) const;
+
+            /// \brief returns true if a cell is clear of the inflation, by internal index
+            bool isFree(int index) const;
+
+            /// \brief returns the number of words in a row of blocked bits
+            int getRowWords() const;
+
+            /// \brief returns the number of words in a column of blocked bits
+            int getColumnWords() const;
+
+            /// \brief returns the blocked bits of a row, bit x + 1 is the cell (x, y)
+            /// \param y - row, -1 and height for the border
+            const uint64_t * blockedRow(int y) const;
+
+            /// \brief returns the blocked bits of a column, bit y + 1 is the cell (x, y)
+            /// \param x - column, -1 and width for the border
+            const uint64_t * blockedColumn(int x) const;
+    };
+
+    /// \brief jump point search over a distance map
+    /// Moves are 8 connected without cutting corners between blocked cells. Jump point search (Harabor
+    /// and Grastien 2011) returns the same shortest paths as A* with the octile heuristic, but scans
+    /// along straight and diagonal runs and only puts the cells where the path may turn on the open list.
+    /// The straight runs are scanned a word of blocked bits at a time. The per cell search state is only
+    /// reset by bumping a generation counter, so a plan costs the cells it touches and not the size of
+    /// the grid.
+    class GridPlanner
+    {
+        private:
+            std::vector<float> g;
+            std::vector<int32_t> parent;
+            std::vector<uint32_t> seen;         // generation in which g and parent were set
+            std::vector<uint32_t> closed;       // generation in which the cell was expanded
+            uint32_t generation;
+
+            std::vector<std::pair<float, int32_t>> open;
+            int expanded;
+
+            Cell goal;                          // goal of the search in progress
+
+            /// \brief scans a straight run for the next jump point
+            /// \param map - the obstacles and their distances
+            /// \param x - the first cell of the scan
+            /// \param y - the first cell of the scan
+            /// \param dx - -1, 0 or 1
+            /// \param dy - -1, 0 or 1, one of dx and dy is 0
+            /// \return the index of the jump point, or -1 if the scan ran into a blocked cell
+            int jumpStraight(const DistanceMap & map, int x, int y, int dx, int dy) const;
+
+            /// \brief scans a diagonal run for the next jump point
+            /// \return the index of the jump point, or -1 if the scan ran into a blocked cell
+            int jumpDiagonal(const DistanceMap & map, int x, int y, int dx, int dy) const;
+
+        public:
+            /// \brief create a planner
+            GridPlanner();
+
+            /// \brief finds the shortest path between two cells that stays out of the inflation
+            /// \param map - the obstacles and their distances
+            /// \param start - the start cell, if it is inside the inflation the path first climbs away from
+            /// the obstacles
+            /// \param goal - the goal cell
+            /// \param path - the cells of the path, from start to goal, with the cells along straight runs left out
+            /// \return true if a path was found
+            bool plan(const DistanceMap & map, const Cell & start, const Cell & goal, std::vector<Cell> & path);
+
+            /// \brief returns the number of jump points expanded by the last plan
+            int getExpanded() const;
+    };
+}
+
+#endif
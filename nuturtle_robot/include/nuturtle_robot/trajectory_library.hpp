@@ -0,0 +1,151 @@
+#ifndef TRAJECTORY_LIBRARY_INCLUDE_GUARD_HPP
+#define TRAJECTORY_LIBRARY_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Library for following arbitrary paths with pure pursuit or linear MPC
+
+#include <rigid2d/rigid2d.hpp>
+#include <array>
+#include <vector>
+
+namespace trajectory
+{
+    using rigid2d::Twist2D;
+
+    /// \brief a planar pose, used both for the robot and for points along a path
+    struct Waypoint
+    {
+        double x = 0.0;
+        double y = 0.0;
+        double th = 0.0;
+    };
+
+    /// \brief finds the index of the path point closest to the pose, searching forward from start
+    /// Stops as soon as the distance starts growing again, so the search is amortized O(1) while following
+    /// \param pose - the pose of the robot
+    /// \param path - the path being followed
+    /// \param start - the index to start searching from
+    /// \return index of the closest path point
+    std::size_t nearestIndex(const Waypoint & pose, const std::vector<Waypoint> & path, std::size_t start);
+
+    /// \brief a pure pursuit controller that steers toward a point one lookahead distance along the path
+    class PurePursuit
+    {
+        private:
+            double lookahead;
+            double speed;
+            double goalTol;
+            std::size_t nearest = 0;
+
+        public:
+            /// \brief create a pure pursuit controller with a 0.2m lookahead at 0.1m/s
+            PurePursuit();
+
+            /// \brief create a pure pursuit controller
+            /// \param look - the lookahead distance
+            /// \param vel - the nominal forward speed
+            /// \param tol - distance to the last point at which the path is considered done
+            PurePursuit(double look, double vel, double tol);
+
+            /// \brief forget progress along the previous path
+            void reset();
+
+            /// \brief computes the twist that drives the robot along the path
+            /// \param pose - the pose of the robot
+            /// \param path - the path to follow
+            /// \return the commanded body twist (zero once the goal is reached)
+            Twist2D computeTwist(const Waypoint & pose, const std::vector<Waypoint> & path);
+
+            /// \brief checks whether the robot has reached the end of the path
+            /// \param pose - the pose of the robot
+            /// \param path - the path being followed
+            /// \return true if within the goal tolerance of the last point
+            bool finished(const Waypoint & pose, const std::vector<Waypoint> & path) const;
+    };
+
+    /// \brief prediction horizon of the MPC (number of steps)
+    constexpr int MPC_HORIZON = 10;
+
+    /// \brief number of error states of the linearized unicycle (x, y, th)
+    constexpr int MPC_STATES = 3;
+
+    /// \brief number of inputs of the unicycle (v, w)
+    constexpr int MPC_INPUTS = 2;
+
+    /// \brief size of the condensed QP decision vector
+    constexpr int MPC_VARS = MPC_HORIZON * MPC_INPUTS;
+
+    /// \brief weights and limits for the linear MPC
+    struct MPCParams
+    {
+        double dt = 0.1;            // discretization step of the horizon
+        double speed = 0.1;         // reference forward speed along the path
+        double qXY = 50.0;          // weight on position error
+        double qTh = 1.0;           // weight on heading error
+        double rV = 0.1;            // weight on linear velocity deviation
+        double rW = 0.05;           // weight on angular velocity deviation
+        double maxV = 0.22;         // linear velocity bound
+        double maxW = 2.84;         // angular velocity bound
+        double goalTol = 0.05;      // distance to the last point at which the path is done
+        int maxIter = 50;           // iteration cap of the QP solver
+    };
+
+    /// \brief short-horizon linear MPC on the unicycle model
+    /// The unicycle is linearized about a reference sampled along the path and the horizon is
+    /// condensed into a dense box-constrained QP over the input deviations. All matrices have
+    /// compile-time sizes and the QP is warm started with the previous (shifted) solution.
+    class LinearMPC
+    {
+        private:
+            MPCParams params;
+            std::size_t nearest = 0;
+
+            std::array<Waypoint, MPC_HORIZON + 1> ref;      // reference poses
+            std::array<double, MPC_HORIZON> refV;           // reference linear velocities
+            std::array<double, MPC_HORIZON> refW;           // reference angular velocities
+
+            std::array<double, MPC_VARS * MPC_VARS> H;      // QP hessian
+            std::array<double, MPC_VARS> f;                 // QP linear term
+            std::array<double, MPC_VARS> lower;             // input deviation lower bounds
+            std::array<double, MPC_VARS> upper;             // input deviation upper bounds
+            std::array<double, MPC_VARS> U;                 // current (warm started) solution
+
+            int lastIter = 0;
+
+            /// \brief samples the reference trajectory along the path, starting from the projection of the pose
+            void sampleReference(const Waypoint & pose, const std::vector<Waypoint> & path);
+
+            /// \brief forms the condensed QP (H, f and bounds) for the current error state
+            void buildQP(const Waypoint & pose);
+
+            /// \brief solves the box-constrained QP with accelerated projected gradient
+            void solveQP();
+
+        public:
+            /// \brief create an MPC with default parameters
+            LinearMPC();
+
+            /// \brief create an MPC
+            /// \param p - the weights and limits of the controller
+            explicit LinearMPC(const MPCParams & p);
+
+            /// \brief forget progress along the previous path and the warm start
+            void reset();
+
+            /// \brief computes the twist that drives the robot along the path
+            /// \param pose - the pose of the robot
+            /// \param path - the path to follow
+            /// \return the first input of the optimal sequence (zero once the goal is reached)
+            Twist2D computeTwist(const Waypoint & pose, const std::vector<Waypoint> & path);
+
+            /// \brief checks whether the robot has reached the end of the path
+            /// \param pose - the pose of the robot
+            /// \param path - the path being followed
+            /// \return true if within the goal tolerance of the last point
+            bool finished(const Waypoint & pose, const std::vector<Waypoint> & path) const;
+
+            /// \brief number of solver iterations used by the last call to computeTwist
+            int iterations() const;
+    };
+}
+
+#endif
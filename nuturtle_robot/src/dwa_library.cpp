@@ -0,0 +1,387 @@
+/// \file dwa_library.cpp
+/// \brief a library for avoiding obstacles with a dynamic window planner over a precomputed trajectory lattice
+
+#include "nuturtle_robot/dwa_library.hpp"
+#include <rigid2d/diff_drive.hpp>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <utility>
+
+namespace dwa
+{
+    CostGrid::CostGrid(const DwaParams & params)
+        : resolution(params.resolution)
+    {
+        size = 2 * int(std::ceil(params.range / resolution)) + 1;
+        cost.assign(size * size, 0);
+
+        kernelRadius = int(std::ceil(params.inflation / resolution));
+        const int side = 2 * kernelRadius + 1;
+        kernel.assign(side * side, 0);
+        for (int dy = -kernelRadius; dy <= kernelRadius; ++dy)
+        {
+            for (int dx = -kernelRadius; dx <= kernelRadius; ++dx)
+            {
+                double d = resolution * std::sqrt(double(dx * dx + dy * dy));
+                uint8_t c = 0;
+                if ((dx == 0) && (dy == 0))
+                {
+                    c = LETHAL;
+                } else if (d < params.inflation)
+                {
+                    c = uint8_t(std::lround((LETHAL - 1) * (1.0 - d / params.inflation)));
+                }
+                kernel[(dy + kernelRadius) * side + dx + kernelRadius] = c;
+            }
+        }
+
+        // the cost of a cell as far from an obstacle as the robot radius
+        inscribed = 1;
+        if (params.robotRadius < params.inflation)
+        {
+            inscribed = uint8_t(std::max(1L, std::lround((LETHAL - 1) * (1.0 - params.robotRadius / params.inflation))));
+        }
+        toGoal.assign(size * size, 0.0f);
+    }
+
+    void CostGrid::build(double angleMin, double angleIncrement, const std::vector<float> & ranges,
+                         double rangeMin, double rangeMax)
+    {
+        std::fill(cost.begin(), cost.end(), 0);
+
+        const int centre = size / 2;
+        const int side = 2 * kernelRadius + 1;
+        for (unsigned int i = 0; i < ranges.size(); ++i)
+        {
+            const double r = ranges[i];
+            if (!(r >= rangeMin) || !(r <= rangeMax))
+            {
+                continue;
+            }
+            const double a = angleMin + i * angleIncrement;
+            const int cx = centre + int(std::lround(r * std::cos(a) / resolution));
+            const int cy = centre + int(std::lround(r * std::sin(a) / resolution));
+
+            // the part of the kernel on the grid
+            const int x0 = std::max(0, cx - kernelRadius), x1 = std::min(size - 1, cx + kernelRadius);
+            const int y0 = std::max(0, cy - kernelRadius), y1 = std::min(size - 1, cy + kernelRadius);
+            for (int y = y0; y <= y1; ++y)
+            {
+                uint8_t * row = cost.data() + y * size;
+                const uint8_t * k = kernel.data() + (y - cy + kernelRadius) * side + kernelRadius;
+                for (int x = x0; x <= x1; ++x)
+                {
+                    row[x] = std::max(row[x], k[x - cx]);
+                }
+            }
+        }
+    }
+
+    void CostGrid::spreadGoal(double goalX, double goalY)
+    {
+        // a goal off the grid is moved in along the line to it
+        const double edge = (size / 2 - 1) * resolution;
+        const double far = std::max(std::fabs(goalX), std::fabs(goalY));
+        if (far > edge)
+        {
+            goalX *= edge / far;
+            goalY *= edge / far;
+        }
+        const int goal = index(goalX, goalY);
+
+        const float unreached = std::numeric_limits<float>::max();
+        std::fill(toGoal.begin(), toGoal.end(), unreached);
+
+        // Dijkstra over the 8 connected cells the robot fits in, from the goal cell out
+        using Entry = std::pair<float, int>;
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
+        toGoal[goal] = 0.0f;
+        open.emplace(0.0f, goal);
+
+        const float straight = resolution, diagonal = float(std::sqrt(2.0) * resolution);
+        while (!open.empty())
+        {
+            const Entry e = open.top();
+            open.pop();
+            if (e.first > toGoal[e.second])
+            {
+                continue;
+            }
+            const int cx = e.second % size, cy = e.second / size;
+            for (int dy = -1; dy <= 1; ++dy)
+            {
+                for (int dx = -1; dx <= 1; ++dx)
+                {
+                    const int x = cx + dx, y = cy + dy;
+                    if (((dx == 0) && (dy == 0)) || (x < 0) || (y < 0) || (x >= size) || (y >= size))
+                    {
+                        continue;
+                    }
+                    const int next = y * size + x;
+                    const float d = e.first + (((dx != 0) && (dy != 0)) ? diagonal : straight);
+                    if ((cost[next] < inscribed) && (d < toGoal[next]))
+                    {
+                        toGoal[next] = d;
+                        open.emplace(d, next);
+                    }
+                }
+            }
+        }
+
+        // the cells cut off from the goal are ranked by the straight distance, behind every reached cell
+        const float behind = 2.0f * size * resolution;
+        const int gx = goal % size, gy = goal / size;
+        for (int i = 0; i < size * size; ++i)
+        {
+            if (toGoal[i] == unreached)
+            {
+                toGoal[i] = behind + resolution * float(std::hypot(i % size - gx, i / size - gy));
+            }
+        }
+    }
+
+    double CostGrid::goalDirection(int index) const
+    {
+        // toward the neighbor closest to the goal
+        const int cx = index % size, cy = index / size;
+        float best = toGoal[index];
+        double direction = std::numeric_limits<double>::quiet_NaN();
+        for (int dy = -1; dy <= 1; ++dy)
+        {
+            for (int dx = -1; dx <= 1; ++dx)
+            {
+                const int x = cx + dx, y = cy + dy;
+                if ((x < 0) || (y < 0) || (x >= size) || (y >= size) || (toGoal[y * size + x] >= best))
+                {
+                    continue;
+                }
+                best = toGoal[y * size + x];
+                direction = std::atan2(double(dy), double(dx));
+            }
+        }
+        return direction;
+    }
+
+    int CostGrid::getSize() const
+    {
+        return size;
+    }
+
+    int CostGrid::index(double x, double y) const
+    {
+        const int centre = size / 2;
+        const int cx = centre + int(std::lround(x / resolution));
+        const int cy = centre + int(std::lround(y / resolution));
+        if ((cx < 0) || (cy < 0) || (cx >= size) || (cy >= size))
+        {
+            return -1;
+        }
+        return cy * size + cx;
+    }
+
+    uint8_t CostGrid::at(int index) const
+    {
+        return cost[index];
+    }
+
+    const uint8_t * CostGrid::data() const
+    {
+        return cost.data();
+    }
+
+    float CostGrid::goalDistance(int index) const
+    {
+        return toGoal[index];
+    }
+
+    DwaPlanner::DwaPlanner(const DwaParams & dwaParams, double wheelBase, double wheelRad, double maxWheelVel)
+        : params(dwaParams)
+    {
+        using namespace rigid2d;
+
+        maxLinear = maxWheelVel * wheelRad;
+        maxAngular = 2.0 * maxWheelVel * wheelRad / wheelBase;
+
+        // the cells of the footprint around its centre cell
+        const CostGrid grid(params);
+        const int size = grid.getSize();
+        const int footprintRadius = int(std::ceil(params.robotRadius / params.resolution));
+        std::vector<std::pair<int, int>> footprint;
+        for (int dy = -footprintRadius; dy <= footprintRadius; ++dy)
+        {
+            for (int dx = -footprintRadius; dx <= footprintRadius; ++dx)
+            {
+                if (dx * dx + dy * dy <= footprintRadius * footprintRadius)
+                {
+                    footprint.emplace_back(dx, dy);
+                }
+            }
+        }
+
+        std::vector<int> stamp(size * size, -1);
+        const int numSteps = int(std::lround(params.horizon / params.dt));
+        const int linear = std::max(2, params.linearSamples), angular = std::max(3, params.angularSamples);
+
+        for (int i = 0; i < linear; ++i)
+        {
+            for (int j = 0; j < angular; ++j)
+            {
+                Trajectory t;
+                t.v = maxLinear * i / (linear - 1);
+                t.w = maxAngular * (2.0 * j / (angular - 1) - 1.0);
+
+                // only the twists the wheels can follow
+                DiffDrive dd(wheelBase, wheelRad, 0.0, 0.0, 0.0, 0.0, 0.0);
+                wheelVel u = dd.convertTwist(Twist2D{t.w, t.v, 0.0});
+                if ((std::fabs(u.uL) > maxWheelVel * (1.0 + 1e-9)) || (std::fabs(u.uR) > maxWheelVel * (1.0 + 1e-9)))
+                {
+                    continue;
+                }
+
+                const int id = lattice.size();
+                t.first = steps.size();
+                for (int k = 1; k <= numSteps; ++k)
+                {
+                    dd(dd.getThL() + u.uL * params.dt, dd.getThR() + u.uR * params.dt);
+
+                    const int centre = grid.index(dd.getX(), dd.getY());
+                    if (centre < 0)
+                    {
+                        // left the grid, the rest of the horizon is not seen
+                        break;
+                    }
+
+                    Step step;
+                    step.x = dd.getX();
+                    step.y = dd.getY();
+                    step.th = dd.getTh();
+                    step.cell = centre;
+                    step.first = swept.size();
+
+                    const int cx = centre % size, cy = centre / size;
+                    for (const auto & offset : footprint)
+                    {
+                        const int x = cx + offset.first, y = cy + offset.second;
+                        if ((x < 0) || (y < 0) || (x >= size) || (y >= size) || (stamp[y * size + x] == id))
+                        {
+                            continue;
+                        }
+                        stamp[y * size + x] = id;
+                        swept.push_back(y * size + x);
+                    }
+                    step.last = swept.size();
+                    steps.push_back(step);
+                }
+                t.last = steps.size();
+                if (t.last > t.first)
+                {
+                    lattice.push_back(t);
+                }
+            }
+        }
+    }
+
+    int DwaPlanner::latticeSize() const
+    {
+        return lattice.size();
+    }
+
+    int DwaPlanner::sweptCells() const
+    {
+        return swept.size();
+    }
+
+    double DwaPlanner::getMaxLinear() const
+    {
+        return maxLinear;
+    }
+
+    double DwaPlanner::getMaxAngular() const
+    {
+        return maxAngular;
+    }
+
+    DwaResult DwaPlanner::plan(const CostGrid & grid, const Twist2D & current, double period, double goalX,
+                               double goalY) const
+    {
+        // the window is never narrower than one step of the lattice, so there is always a twist in it
+        const int linear = std::max(2, params.linearSamples), angular = std::max(3, params.angularSamples);
+        const double dv = std::max(params.maxLinearAccel * period, maxLinear / (linear - 1)) + 1e-9;
+        const double dw = std::max(params.maxAngularAccel * period, 2.0 * maxAngular / (angular - 1)) + 1e-9;
+
+        const uint8_t * cost = grid.data();
+
+        DwaResult result;
+        result.cost = std::numeric_limits<double>::max();
+        bool braking = false;           // the best twist so far only stops short of an obstacle
+        for (const auto & t : lattice)
+        {
+            if ((std::fabs(t.v - current.dx) > dv) || (std::fabs(t.w - current.dth) > dw))
+            {
+                continue;
+            }
+            ++result.evaluated;
+
+            // the highest cost along the trajectory, a step at a time, stopping at the first step that
+            // reaches an obstacle; the cells of each step are precomputed, a step is a max over their costs
+            uint8_t highest = 0;
+            int end = t.first;
+            for (; end < t.last; ++end)
+            {
+                uint8_t m = 0;
+                for (int k = steps[end].first; k < steps[end].last; ++k)
+                {
+                    m = std::max(m, cost[swept[k]]);
+                }
+                if (m == LETHAL)
+                {
+                    break;
+                }
+                highest = std::max(highest, m);
+            }
+
+            const bool blocked = end < t.last;
+            if (blocked)
+            {
+                // an obstacle ahead, only allowed if the robot can stop short of it, and only chosen when
+                // every twist in the window is blocked
+                const double distance = t.v * params.dt * (end - t.first);
+                if ((end == t.first) || (t.v * t.v > 2.0 * params.maxLinearAccel * distance) ||
+                    (result.found && !braking))
+                {
+                    continue;
+                }
+                highest = LETHAL - 1;
+            }
+
+            // the heading is measured against the way around the obstacles, or straight at the goal once there
+            const Step & last = steps[end - 1];
+            double direction = grid.goalDirection(last.cell);
+            if (std::isnan(direction))
+            {
+                direction = std::atan2(goalY - last.y, goalX - last.x);
+            }
+            const double heading = std::fabs(rigid2d::normalize_angle(direction - last.th));
+            const double score = params.goalWeight * grid.goalDistance(last.cell) +
+                                 params.headingWeight * heading +
+                                 params.clearanceWeight * highest / (LETHAL - 1) +
+                                 params.speedWeight * (1.0 - t.v / maxLinear);
+            if ((score < result.cost) || (braking && !blocked))
+            {
+                braking = blocked;
+                result.found = true;
+                result.cost = score;
+                result.twist = Twist2D{t.w, t.v, 0.0};
+            }
+        }
+
+        if (!result.found)
+        {
+            result.cost = 0.0;
+        }
+        return result;
+    }
+}
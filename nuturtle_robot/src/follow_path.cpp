@@ -0,0 +1,204 @@
+/// \file follow_path.cpp
+/// \brief contains a node called follow_path that drives the robot along an arbitrary path
+/// using either pure pursuit or a short-horizon linear MPC on the unicycle model
+///
+/// PARAMETERS:
+///         controller : which controller to run, "pure_pursuit" or "mpc"
+///         frequency : the rate of the control loop (Hz)
+///         speed : the nominal forward speed along the path
+///         lookahead : the pure pursuit lookahead distance
+///         goal_tolerance : distance to the last point at which the path is done
+///         mpc_dt : the discretization step of the MPC horizon
+///         mpc_q_xy, mpc_q_th : MPC weights on position and heading error
+///         mpc_r_v, mpc_r_w : MPC weights on linear and angular velocity deviation
+///         max_linear, max_angular : velocity bounds used by the MPC
+/// PUBLISHES:
+///         cmd_vel (geometry_msgs/Twist) : the commanded twist, only while a path is followed and once
+///                                         more to stop the robot at its end
+/// SUBSCRIBES:
+///         path (nav_msgs/Path) : the path to follow, replaces any path currently being followed
+///         odom (nav_msgs/Odometry) : the pose of the robot
+/// SERVICES:
+///         ~control : "stop" abandons the current path, under the node name so it does not take the
+///                    /control of follow_circle
+
+#include <ros/ros.h>
+#include <nuturtle_robot/control.h>
+#include <nuturtle_robot/trajectory_library.hpp>
+
+#include <rigid2d/rigid2d.hpp>
+
+#include <geometry_msgs/Twist.h>
+#include <nav_msgs/Path.h>
+#include <nav_msgs/Odometry.h>
+#include <tf2/utils.h>
+
+#include <string>
+#include <vector>
+
+/***************
+ * Declare global variables
+ * ************/
+static std::vector<trajectory::Waypoint> path;
+static trajectory::Waypoint pose;
+
+static bool path_received = false;
+static bool odom_received = false;
+static bool following = false;
+
+/***************
+ * Helper Functions
+ * ************/
+void pathCallback(const nav_msgs::Path::ConstPtr & msg);
+void odomCallback(const nav_msgs::Odometry::ConstPtr & msg);
+bool control(nuturtle_robot::control::Request &req, nuturtle_robot::control::Response &);
+
+int main(int argc, char* argv[])
+{
+    using namespace rigid2d;
+    using namespace trajectory;
+
+    /****************
+     * Initialize node & node handler
+    ****************/
+    ros::init(argc, argv, "follow_path");
+    ros::NodeHandle n("~");
+
+    /****************
+     * Define variables
+    ****************/
+    int frequency = 100;
+    std::string controller = "pure_pursuit";
+    double lookahead = 0.2;
+    double goalTol = 0.05;
+
+    MPCParams params;
+
+    n.getParam("controller", controller);
+    n.getParam("frequency", frequency);
+    n.getParam("speed", params.speed);
+    n.getParam("lookahead", lookahead);
+    n.getParam("goal_tolerance", goalTol);
+    n.getParam("mpc_dt", params.dt);
+    n.getParam("mpc_q_xy", params.qXY);
+    n.getParam("mpc_q_th", params.qTh);
+    n.getParam("mpc_r_v", params.rV);
+    n.getParam("mpc_r_w", params.rW);
+    n.getParam("max_linear", params.maxV);
+    n.getParam("max_angular", params.maxW);
+    params.goalTol = goalTol;
+
+    bool useMPC = (controller == "mpc");
+
+    PurePursuit pursuit(lookahead, params.speed, goalTol);
+    LinearMPC mpc(params);
+
+    /****************
+     * Define publisher, subscriber, services and clients
+     * *************/
+    ros::Publisher twist_pub = n.advertise<geometry_msgs::Twist>("/cmd_vel", frequency);
+    ros::Subscriber path_sub = n.subscribe("/path", 1, pathCallback);
+    ros::Subscriber odom_sub = n.subscribe("/odom", frequency, odomCallback);
+    ros::ServiceServer control_service = n.advertiseService("control", control);
+
+    geometry_msgs::Twist twist_msg;
+    bool moving = false;
+
+    const double period = 1.0 / frequency;
+
+    ros::Rate loop_rate(frequency);
+    while (ros::ok())
+    {
+        ros::spinOnce();
+
+        /****************
+         * A new path restarts both controllers
+         * *************/
+        if (path_received)
+        {
+            pursuit.reset();
+            mpc.reset();
+            following = !path.empty();
+            path_received = false;
+        }
+
+        if (following && odom_received)
+        {
+            ros::WallTime start = ros::WallTime::now();
+
+            Twist2D tw = useMPC ? mpc.computeTwist(pose, path) : pursuit.computeTwist(pose, path);
+
+            double elapsed = (ros::WallTime::now() - start).toSec();
+            if (elapsed > period)
+            {
+                ROS_WARN_THROTTLE(1.0, "follow_path: %s took %.2f ms, over the %.2f ms budget",
+                                  controller.c_str(), 1e3 * elapsed, 1e3 * period);
+            }
+
+            twist_msg.linear.x = tw.dx;
+            twist_msg.linear.y = 0.0;
+            twist_msg.angular.z = tw.dth;
+            twist_pub.publish(twist_msg);
+            moving = true;
+
+            bool done = useMPC ? mpc.finished(pose, path) : pursuit.finished(pose, path);
+            if (done)
+            {
+                ROS_INFO("follow_path: reached the end of the path");
+                following = false;
+            }
+        } else if (moving)
+        {
+            // one zero twist stops the robot, then the node stays quiet so other nodes can drive it
+            twist_msg.linear.x = 0.0;
+            twist_msg.linear.y = 0.0;
+            twist_msg.angular.z = 0.0;
+            twist_pub.publish(twist_msg);
+            moving = false;
+        }
+
+        loop_rate.sleep();
+    }
+    return 0;
+}
+
+/// \brief callback function for the path subscriber
+/// \param msg : the path to follow
+void pathCallback(const nav_msgs::Path::ConstPtr & msg)
+{
+    path.clear();
+    path.reserve(msg->poses.size());
+
+    for (const auto & p : msg->poses)
+    {
+        trajectory::Waypoint w;
+        w.x = p.pose.position.x;
+        w.y = p.pose.position.y;
+        w.th = tf2::getYaw(p.pose.orientation);
+        path.push_back(w);
+    }
+    path_received = true;
+}
+
+/// \brief callback function for the odometry subscriber
+/// \param msg : the odometry message
+void odomCallback(const nav_msgs::Odometry::ConstPtr & msg)
+{
+    pose.x = msg->pose.pose.position.x;
+    pose.y = msg->pose.pose.position.y;
+    pose.th = tf2::getYaw(msg->pose.pose.orientation);
+    odom_received = true;
+}
+
+/// \brief control function for ~control service
+/// "stop" abandons the path currently being followed
+/// \param req : The service request
+/// \return true
+bool control(nuturtle_robot::control::Request &req, nuturtle_robot::control::Response &)
+{
+    if (req.direction == "stop")
+    {
+        following = false;
+    }
+    return true;
+}
@@ -0,0 +1,342 @@
+/// \file global_planner.cpp
+/// \brief contains a node called global_planner that plans a path to a goal over the occupancy grid,
+/// keeping the robot radius clear of every obstacle
+///
+/// PARAMETERS:
+///         robot_radius : the radius of the turtlebot (m)
+///         map_frame_id : the frame of the grid and the path
+///         body_frame_id : the frame of the robot, the path starts at its origin
+///         planner_inflation_margin : added to the robot radius to keep the path off the obstacles (m)
+///         planner_occupied_threshold : cells at or above this occupancy (0 - 100) are obstacles
+///         planner_unknown_is_free : whether cells not seen yet may be planned through
+///         planner_goal_tolerance : distance to the goal at which it is dropped (m)
+///         planner_frequency : the rate (Hz) at which map changes are applied and the path is checked
+/// PUBLISHES:
+///         path (nav_msgs/Path) : the path to the goal, an empty path if there is none
+/// SUBSCRIBES:
+///         map (nav_msgs/OccupancyGrid) : the grid
+///         map_updates (map_msgs/OccupancyGridUpdate) : the cells changed since the last grid
+///         move_base_simple/goal (geometry_msgs/PoseStamped) : the goal, e.g. from the rviz 2D Nav Goal tool
+///
+/// Only the cells that changed are applied to the distance transform, so a new grid or update costs the
+/// cells around the change. A path is planned for each new goal, and planned again only when a map change
+/// blocks it, so the path follower is not restarted needlessly.
+
+#include <ros/ros.h>
+#include <nuturtle_robot/planner_library.hpp>
+
+#include <geometry_msgs/PoseStamped.h>
+#include <geometry_msgs/TransformStamped.h>
+#include <map_msgs/OccupancyGridUpdate.h>
+#include <nav_msgs/OccupancyGrid.h>
+#include <nav_msgs/Path.h>
+
+#include <tf2_ros/buffer.h>
+#include <tf2_ros/transform_listener.h>
+#include <tf2/utils.h>
+#include <tf2_geometry_msgs/tf2_geometry_msgs.h>
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+/***************
+ * Declare global variables
+ * ************/
+static nav_msgs::OccupancyGrid::ConstPtr grid_msg;
+static std::vector<map_msgs::OccupancyGridUpdate::ConstPtr> update_msgs;
+static geometry_msgs::PoseStamped::ConstPtr goal_msg;
+
+static bool grid_flag = false;
+static bool goal_flag = false;
+
+/***************
+ * Helper Functions
+ * ************/
+void gridCallback(const nav_msgs::OccupancyGrid::ConstPtr & msg);
+void updateCallback(const map_msgs::OccupancyGridUpdate::ConstPtr & msg);
+void goalCallback(const geometry_msgs::PoseStamped::ConstPtr & msg);
+
+int main(int argc, char* argv[])
+{
+    using namespace planner;
+
+    /****************
+     * Initialize node & node handler
+    ****************/
+    ros::init(argc, argv, "global_planner");
+    ros::NodeHandle n;
+
+    /****************
+     * Define variables
+    ****************/
+    std::string map_frame_id = "map", body_frame_id = "base_footprint";
+    double robotRadius = 0.095;
+    double margin = 0.02;
+    int occupiedThreshold = 50;
+    bool unknownIsFree = true;
+    double goalTol = 0.05;
+    int frequency = 10;
+
+    n.getParam("robot_radius", robotRadius);
+    n.getParam("map_frame_id", map_frame_id);
+    n.getParam("body_frame_id", body_frame_id);
+    n.getParam("planner_inflation_margin", margin);
+    n.getParam("planner_occupied_threshold", occupiedThreshold);
+    n.getParam("planner_unknown_is_free", unknownIsFree);
+    n.getParam("planner_goal_tolerance", goalTol);
+    n.getParam("planner_frequency", frequency);
+
+    tf2_ros::Buffer tfBuffer;
+    tf2_ros::TransformListener tfListener(tfBuffer);
+
+    /****************
+     * Define publisher and subscribers
+     * *************/
+    ros::Publisher path_pub = n.advertise<nav_msgs::Path>("path", 1, true);
+    ros::Subscriber grid_sub = n.subscribe("map", 1, gridCallback);
+    ros::Subscriber update_sub = n.subscribe("map_updates", 10, updateCallback);
+    ros::Subscriber goal_sub = n.subscribe("move_base_simple/goal", 1, goalCallback);
+
+    // the grid as last applied to the distance map
+    nav_msgs::MapMetaData info;
+    std::vector<int8_t> cells;
+    DistanceMap distanceMap;
+    GridPlanner gridPlanner;
+
+    auto isObstacle = [&](int8_t value)
+    {
+        return (value < 0) ? !unknownIsFree : (value >= occupiedThreshold);
+    };
+
+    // applies a cell to the distance map if it changed, returns true if it did
+    auto applyCell = [&](int x, int y, int8_t value)
+    {
+        int8_t & old = cells[y * info.width + x];
+        if (isObstacle(old) == isObstacle(value))
+        {
+            old = value;
+            return false;
+        }
+        old = value;
+        if (isObstacle(value))
+        {
+            distanceMap.setObstacle(x, y);
+        } else
+        {
+            distanceMap.removeObstacle(x, y);
+        }
+        return true;
+    };
+
+    bool haveGoal = false, replan = false, mapChanged = false;
+    geometry_msgs::PoseStamped goal;
+    std::vector<Cell> cellPath;
+    nav_msgs::Path path_msg;
+
+    ros::Rate loop_rate(frequency);
+    while (ros::ok())
+    {
+        ros::spinOnce();
+
+        /****************
+         * A grid with a new size or origin rebuilds the distance map, otherwise only its changes are applied
+         * *************/
+        if (grid_flag)
+        {
+            grid_flag = false;
+            const auto & g = grid_msg->info;
+            if ((g.width != info.width) || (g.height != info.height) || (g.resolution != info.resolution) ||
+                (g.origin.position.x != info.origin.position.x) || (g.origin.position.y != info.origin.position.y))
+            {
+                info = g;
+                cells.assign(grid_msg->data.size(), 0);
+                distanceMap = DistanceMap(info.width, info.height, (robotRadius + margin) / info.resolution);
+                cellPath.clear();
+                mapChanged = true;
+                ROS_INFO("global_planner: new %u x %u grid", info.width, info.height);
+            }
+
+            for (unsigned int y = 0; y < info.height; ++y)
+            {
+                for (unsigned int x = 0; x < info.width; ++x)
+                {
+                    mapChanged |= applyCell(x, y, grid_msg->data[y * info.width + x]);
+                }
+            }
+        }
+
+        for (const auto & update : update_msgs)
+        {
+            if (cells.empty() || (update->x < 0) || (update->y < 0) ||
+                (update->x + update->width > info.width) || (update->y + update->height > info.height))
+            {
+                // refers to a grid not received yet, the next full grid will carry it
+                continue;
+            }
+            for (unsigned int y = 0; y < update->height; ++y)
+            {
+                for (unsigned int x = 0; x < update->width; ++x)
+                {
+                    mapChanged |= applyCell(update->x + x, update->y + y, update->data[y * update->width + x]);
+                }
+            }
+        }
+        update_msgs.clear();
+
+        if (goal_flag)
+        {
+            goal_flag = false;
+            try
+            {
+                goal = tfBuffer.transform(*goal_msg, map_frame_id, ros::Duration(0.1));
+                haveGoal = true;
+                replan = true;
+            }
+            catch (tf2::TransformException & ex)
+            {
+                ROS_WARN("global_planner: dropping the goal, %s", ex.what());
+            }
+        }
+
+        /****************
+         * Plan again when a map change blocks the path, or may have opened one where there was none.
+         * The path may start inside the inflation, only the cells after it first clears it are checked.
+         * *************/
+        if (mapChanged)
+        {
+            distanceMap.update();
+            mapChanged = false;
+
+            replan |= haveGoal && cellPath.empty();
+            bool clear = false;
+            for (unsigned int k = 1; (k < cellPath.size()) && !replan; ++k)
+            {
+                const Cell & a = cellPath[k - 1], & b = cellPath[k];
+                const int steps = std::max(std::abs(b.x - a.x), std::abs(b.y - a.y));
+                for (int s = 0; s <= steps; ++s)
+                {
+                    const int x = a.x + (b.x - a.x) * s / steps, y = a.y + (b.y - a.y) * s / steps;
+                    const bool free = distanceMap.isFree(distanceMap.index(x, y));
+                    if (!free && clear)
+                    {
+                        replan = true;
+                        break;
+                    }
+                    clear |= free;
+                }
+            }
+        }
+
+        geometry_msgs::TransformStamped mapBody;
+        if (haveGoal && !cells.empty())
+        {
+            try
+            {
+                mapBody = tfBuffer.lookupTransform(map_frame_id, body_frame_id, ros::Time(0));
+            }
+            catch (tf2::TransformException & ex)
+            {
+                ROS_WARN_THROTTLE(1.0, "global_planner: %s", ex.what());
+                loop_rate.sleep();
+                continue;
+            }
+
+            const double rx = mapBody.transform.translation.x, ry = mapBody.transform.translation.y;
+            const double gx = goal.pose.position.x, gy = goal.pose.position.y;
+
+            if (std::hypot(gx - rx, gy - ry) < goalTol)
+            {
+                ROS_INFO("global_planner: reached the goal");
+                haveGoal = false;
+                replan = false;
+                cellPath.clear();
+            }
+        }
+
+        if (haveGoal && replan && !cells.empty())
+        {
+            replan = false;
+            const double rx = mapBody.transform.translation.x, ry = mapBody.transform.translation.y;
+            const double gx = goal.pose.position.x, gy = goal.pose.position.y;
+
+            auto toCell = [&](double x, double y)
+            {
+                Cell c;
+                c.x = int(std::floor((x - info.origin.position.x) / info.resolution));
+                c.y = int(std::floor((y - info.origin.position.y) / info.resolution));
+                return c;
+            };
+
+            ros::WallTime start = ros::WallTime::now();
+            bool found = gridPlanner.plan(distanceMap, toCell(rx, ry), toCell(gx, gy), cellPath);
+            double elapsed = (ros::WallTime::now() - start).toSec();
+
+            /****************
+             * Cell centers in between, the robot and the goal themselves at the ends
+             * *************/
+            path_msg.header.stamp = ros::Time::now();
+            path_msg.header.frame_id = map_frame_id;
+            path_msg.poses.clear();
+            if (found)
+            {
+                for (const auto & c : cellPath)
+                {
+                    geometry_msgs::PoseStamped p;
+                    p.header = path_msg.header;
+                    p.pose.position.x = info.origin.position.x + (c.x + 0.5) * info.resolution;
+                    p.pose.position.y = info.origin.position.y + (c.y + 0.5) * info.resolution;
+                    path_msg.poses.push_back(p);
+                }
+                path_msg.poses.front().pose.position.x = rx;
+                path_msg.poses.front().pose.position.y = ry;
+                path_msg.poses.back().pose.position = goal.pose.position;
+
+                tf2::Quaternion q;
+                for (unsigned int k = 0; k + 1 < path_msg.poses.size(); ++k)
+                {
+                    const auto & a = path_msg.poses[k].pose.position, & b = path_msg.poses[k + 1].pose.position;
+                    q.setRPY(0.0, 0.0, std::atan2(b.y - a.y, b.x - a.x));
+                    path_msg.poses[k].pose.orientation = tf2::toMsg(q);
+                }
+                path_msg.poses.back().pose.orientation = goal.pose.orientation;
+
+                ROS_INFO("global_planner: %zu point path in %.2f ms, %d jump points expanded",
+                         cellPath.size(), 1e3 * elapsed, gridPlanner.getExpanded());
+            } else
+            {
+                // nothing to follow until the map changes or a new goal arrives
+                ROS_WARN_THROTTLE(5.0, "global_planner: no path to the goal (%.2f ms)", 1e3 * elapsed);
+            }
+            path_pub.publish(path_msg);
+        }
+
+        loop_rate.sleep();
+    }
+    return 0;
+}
+
+/// \brief callback function for the grid subscriber
+/// \param msg : the whole grid, the updates that follow are relative to it
+void gridCallback(const nav_msgs::OccupancyGrid::ConstPtr & msg)
+{
+    grid_msg = msg;
+    grid_flag = true;
+    update_msgs.clear();
+}
+
+/// \brief callback function for the grid update subscriber
+/// \param msg : a rectangle of changed cells
+void updateCallback(const map_msgs::OccupancyGridUpdate::ConstPtr & msg)
+{
+    update_msgs.push_back(msg);
+}
+
+/// \brief callback function for the goal subscriber
+/// \param msg : the goal pose
+void goalCallback(const geometry_msgs::PoseStamped::ConstPtr & msg)
+{
+    goal_msg = msg;
+    goal_flag = true;
+}
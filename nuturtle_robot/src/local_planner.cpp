@@ -0,0 +1,240 @@
+/// \file local_planner.cpp
+/// \brief contains a node called local_planner that follows the global path with a dynamic window planner,
+/// avoiding the obstacles in the latest scan
+///
+/// PARAMETERS:
+///         robot_radius : the radius of the turtlebot (m)
+///         wheel_base : the distance between the wheels
+///         wheel_radius : the radius of the wheels
+///         max_wheel_velocity : the fastest the wheels turn (rad/s), as limited by turtle_interface
+///         body_frame_id : the frame of the robot and of the scan
+///         shm_transport : read the scans through shared memory when the publisher is local (default true)
+///         dwa_frequency : the rate of the control loop (Hz)
+///         dwa_lookahead : the point of the path this far ahead of the robot is the local goal (m)
+///         dwa_goal_tolerance : distance to the last point at which the path is done (m)
+///         dwa_resolution, dwa_range, dwa_inflation : the local cost grid, see dwa::DwaParams
+///         dwa_horizon, dwa_dt, dwa_linear_samples, dwa_angular_samples : the twist lattice
+///         dwa_max_linear_accel, dwa_max_angular_accel : the dynamic window
+///         dwa_goal_weight, dwa_heading_weight, dwa_clearance_weight, dwa_speed_weight : the terms of the score
+/// PUBLISHES:
+///         cmd_vel (geometry_msgs/Twist) : the commanded twist, remapped to a twist_mux lane
+/// SUBSCRIBES:
+///         path (nav_msgs/Path) : the path to follow, replaces any path currently being followed
+///         scan (sensor_msgs/LaserScan) : the obstacles around the robot
+///
+/// The swept cells of every twist are computed once at startup, so a control step only rebuilds the
+/// cost grid from the scan and reads it at the stored cells of the twists in the window.
+
+#include <ros/ros.h>
+#include <nuturtle_robot/dwa_library.hpp>
+
+#include <rigid2d/rigid2d.hpp>
+#include <rigid2d/shm_transport.hpp>
+
+#include <geometry_msgs/TransformStamped.h>
+#include <geometry_msgs/Twist.h>
+#include <nav_msgs/Path.h>
+#include <sensor_msgs/LaserScan.h>
+
+#include <tf2_ros/buffer.h>
+#include <tf2_ros/transform_listener.h>
+#include <tf2/utils.h>
+
+#include <cmath>
+#include <string>
+
+/***************
+ * Declare global variables
+ * ************/
+static nav_msgs::Path::ConstPtr path_msg;
+static sensor_msgs::LaserScan::ConstPtr scan_msg;
+
+static bool path_received = false;
+static bool scan_received = false;
+
+/***************
+ * Helper Functions
+ * ************/
+void pathCallback(const nav_msgs::Path::ConstPtr & msg);
+void scanCallback(const sensor_msgs::LaserScan::ConstPtr & msg);
+
+int main(int argc, char* argv[])
+{
+    using namespace rigid2d;
+    using namespace dwa;
+
+    /****************
+     * Initialize node & node handler
+    ****************/
+    ros::init(argc, argv, "local_planner");
+    ros::NodeHandle n;
+
+    /****************
+     * Define variables
+    ****************/
+    std::string body_frame_id = "base_footprint";
+    double wheelBase = 0.16, wheelRad = 0.033, maxWheelVel = 5.97;
+    int frequency = 20;
+    double lookahead = 0.3;
+    double goalTol = 0.05;
+    bool shm_transport = true;
+
+    DwaParams params;
+
+    n.getParam("robot_radius", params.robotRadius);
+    n.getParam("wheel_base", wheelBase);
+    n.getParam("wheel_radius", wheelRad);
+    n.getParam("max_wheel_velocity", maxWheelVel);
+    n.getParam("body_frame_id", body_frame_id);
+    n.getParam("shm_transport", shm_transport);
+    n.getParam("dwa_frequency", frequency);
+    n.getParam("dwa_lookahead", lookahead);
+    n.getParam("dwa_goal_tolerance", goalTol);
+    n.getParam("dwa_resolution", params.resolution);
+    n.getParam("dwa_range", params.range);
+    n.getParam("dwa_inflation", params.inflation);
+    n.getParam("dwa_horizon", params.horizon);
+    n.getParam("dwa_dt", params.dt);
+    n.getParam("dwa_linear_samples", params.linearSamples);
+    n.getParam("dwa_angular_samples", params.angularSamples);
+    n.getParam("dwa_max_linear_accel", params.maxLinearAccel);
+    n.getParam("dwa_max_angular_accel", params.maxAngularAccel);
+    n.getParam("dwa_goal_weight", params.goalWeight);
+    n.getParam("dwa_heading_weight", params.headingWeight);
+    n.getParam("dwa_clearance_weight", params.clearanceWeight);
+    n.getParam("dwa_speed_weight", params.speedWeight);
+
+    ros::WallTime start = ros::WallTime::now();
+    const DwaPlanner planner(params, wheelBase, wheelRad, maxWheelVel);
+    CostGrid grid(params);
+    ROS_INFO("local_planner: %d twists, %d swept cells, rolled out in %.1f ms", planner.latticeSize(),
+             planner.sweptCells(), 1e3 * (ros::WallTime::now() - start).toSec());
+
+    tf2_ros::Buffer tfBuffer;
+    tf2_ros::TransformListener tfListener(tfBuffer);
+
+    /****************
+     * Define publisher and subscribers
+     * *************/
+    ros::Publisher twist_pub = n.advertise<geometry_msgs::Twist>("cmd_vel", frequency);
+    ros::Subscriber path_sub = n.subscribe("path", 1, pathCallback);
+    rigid2d::ShmSubscriber<sensor_msgs::LaserScan> scan_sub(n, "scan", 1, scanCallback, shm_transport);
+
+    geometry_msgs::Twist twist_msg;
+    Twist2D current{0.0, 0.0, 0.0};
+    bool following = false;
+    unsigned int progress = 0;         // the path point closest to the robot, never moves back
+
+    const double period = 1.0 / frequency;
+
+    ros::Rate loop_rate(frequency);
+    while (ros::ok())
+    {
+        ros::spinOnce();
+
+        if (path_received)
+        {
+            path_received = false;
+            following = !path_msg->poses.empty();
+            progress = 0;
+        }
+
+        if (following && scan_received)
+        {
+            geometry_msgs::TransformStamped pathBody;
+            try
+            {
+                pathBody = tfBuffer.lookupTransform(path_msg->header.frame_id, body_frame_id, ros::Time(0));
+            }
+            catch (tf2::TransformException & ex)
+            {
+                ROS_WARN_THROTTLE(1.0, "local_planner: %s", ex.what());
+                loop_rate.sleep();
+                continue;
+            }
+            const double rx = pathBody.transform.translation.x, ry = pathBody.transform.translation.y;
+            const double rth = tf2::getYaw(pathBody.transform.rotation);
+
+            /****************
+             * The local goal is the first point past the lookahead after the closest one
+             * *************/
+            const auto & poses = path_msg->poses;
+            auto distance = [&](unsigned int k)
+            {
+                return std::hypot(poses[k].pose.position.x - rx, poses[k].pose.position.y - ry);
+            };
+
+            for (unsigned int k = progress + 1; k < poses.size(); ++k)
+            {
+                if (distance(k) < distance(progress))
+                {
+                    progress = k;
+                }
+            }
+
+            if (distance(poses.size() - 1) < goalTol)
+            {
+                ROS_INFO("local_planner: reached the end of the path");
+                following = false;
+                current = Twist2D{0.0, 0.0, 0.0};
+                twist_pub.publish(geometry_msgs::Twist());
+                loop_rate.sleep();
+                continue;
+            }
+
+            unsigned int carrot = progress;
+            while ((carrot + 1 < poses.size()) && (distance(carrot) < lookahead))
+            {
+                ++carrot;
+            }
+            const double px = poses[carrot].pose.position.x - rx, py = poses[carrot].pose.position.y - ry;
+            const double gx = std::cos(rth) * px + std::sin(rth) * py;
+            const double gy = -std::sin(rth) * px + std::cos(rth) * py;
+
+            /****************
+             * Score the lattice against the scan, the last command is the twist the window is around
+             * *************/
+            start = ros::WallTime::now();
+
+            grid.build(scan_msg->angle_min, scan_msg->angle_increment, scan_msg->ranges, scan_msg->range_min,
+                       scan_msg->range_max);
+            grid.spreadGoal(gx, gy);
+            DwaResult result = planner.plan(grid, current, period, gx, gy);
+
+            const double elapsed = (ros::WallTime::now() - start).toSec();
+            if (elapsed > period)
+            {
+                ROS_WARN_THROTTLE(1.0, "local_planner: took %.2f ms, over the %.2f ms budget", 1e3 * elapsed,
+                                  1e3 * period);
+            }
+            if (!result.found)
+            {
+                ROS_WARN_THROTTLE(1.0, "local_planner: every twist in the window collides, stopping");
+            }
+
+            current = result.twist;
+            twist_msg.linear.x = current.dx;
+            twist_msg.angular.z = current.dth;
+            twist_pub.publish(twist_msg);
+        }
+
+        loop_rate.sleep();
+    }
+    return 0;
+}
+
+/// \brief callback function for the path subscriber
+/// \param msg : the path to follow
+void pathCallback(const nav_msgs::Path::ConstPtr & msg)
+{
+    path_msg = msg;
+    path_received = true;
+}
+
+/// \brief callback function for the scan subscriber
+/// \param msg : the latest scan, taken at the robot
+void scanCallback(const sensor_msgs::LaserScan::ConstPtr & msg)
+{
+    scan_msg = msg;
+    scan_received = true;
+}
@@ -0,0 +1,113 @@
+/// \file mux_library.cpp
+/// \brief a library that selects between twist sources by priority and timeout
+
+#include "nuturtle_robot/mux_library.hpp"
+
+namespace mux
+{
+    TwistMux::TwistMux()
+    {
+        order.fill(-1);
+    }
+
+    int TwistMux::addLane(int priority, double timeout)
+    {
+        if (count >= MAX_LANES)
+        {
+            return -1;
+        }
+
+        int idx = count;
+        lanes[idx].priority = priority;
+        lanes[idx].timeout = timeout;
+
+        /********************
+         * Insert into the priority order, after lanes of equal priority
+         * ******************/
+        int pos = count;
+        while ((pos > 0) && (lanes[order[pos - 1]].priority < priority))
+        {
+            order[pos] = order[pos - 1];
+            --pos;
+        }
+        order[pos] = idx;
+
+        ++count;
+        return idx;
+    }
+
+    int TwistMux::lanesCount() const
+    {
+        return count;
+    }
+
+    void TwistMux::update(int lane, const Twist2D & tw, double stamp)
+    {
+        if ((lane < 0) || (lane >= count))
+        {
+            return;
+        }
+
+        Lane & l = lanes[lane];
+
+        std::uint32_t s = l.seq.load(std::memory_order_relaxed);
+        l.seq.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        l.dx.store(tw.dx, std::memory_order_relaxed);
+        l.dth.store(tw.dth, std::memory_order_relaxed);
+        l.stamp.store(stamp, std::memory_order_relaxed);
+
+        l.seq.store(s + 2, std::memory_order_release);
+    }
+
+    void TwistMux::setStop(bool stop)
+    {
+        stopped.store(stop, std::memory_order_release);
+    }
+
+    bool TwistMux::isStopped() const
+    {
+        return stopped.load(std::memory_order_acquire);
+    }
+
+    int TwistMux::select(double now, Twist2D & out) const
+    {
+        out.dth = 0.0;
+        out.dx = 0.0;
+        out.dy = 0.0;
+
+        if (isStopped())
+        {
+            return -1;
+        }
+
+        for (int i = 0; i < count; ++i)
+        {
+            const Lane & l = lanes[order[i]];
+
+            /********************
+             * Read a consistent snapshot of the lane, retrying if a write overlapped
+             * ******************/
+            double stamp, dx, dth;
+            std::uint32_t before, after;
+            do
+            {
+                before = l.seq.load(std::memory_order_acquire);
+                stamp = l.stamp.load(std::memory_order_relaxed);
+                dx = l.dx.load(std::memory_order_relaxed);
+                dth = l.dth.load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                after = l.seq.load(std::memory_order_relaxed);
+            } while ((before & 1u) || (before != after));
+
+            if ((stamp >= 0.0) && (now - stamp <= l.timeout))
+            {
+                out.dx = dx;
+                out.dth = dth;
+                return order[i];
+            }
+        }
+        return -1;
+    }
+}
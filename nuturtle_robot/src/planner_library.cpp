@@ -0,0 +1,567 @@
+/// \file planner_library.cpp
+/// \brief a library for planning paths over an occupancy grid inflated by the robot radius
+
+#include "nuturtle_robot/planner_library.hpp"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <functional>
+
+namespace planner
+{
+    /// \brief scans a line of blocked bits for the first cell a straight jump stops at
+    /// A jump stops on the goal, on a blocked cell, or where a cell on either side of the line is free while
+    /// the cell behind it is blocked, so the search may have to turn there.
+    /// \param line - the blocked bits of the line
+    /// \param sideA - the blocked bits of the line on one side
+    /// \param sideB - the blocked bits of the line on the other side
+    /// \param words - the number of words in a line
+    /// \param pos - the bit the scan starts at
+    /// \param dir - 1 to scan up, -1 to scan down
+    /// \param goal - the bit of the goal, -1 if the goal is not on the line
+    /// \return the bit the jump stops at, -1 if it ran into a blocked cell
+    static int scanLine(const uint64_t * line, const uint64_t * sideA, const uint64_t * sideB, int words,
+                        int pos, int dir, int goal)
+    {
+        int w = pos >> 6;
+        uint64_t mask = (dir > 0) ? (~0ULL << (pos & 63)) : (~0ULL >> (63 - (pos & 63)));
+        while ((w >= 0) && (w < words))
+        {
+            uint64_t behindA, behindB;
+            if (dir > 0)
+            {
+                behindA = (sideA[w] << 1) | ((w > 0) ? (sideA[w - 1] >> 63) : 0);
+                behindB = (sideB[w] << 1) | ((w > 0) ? (sideB[w - 1] >> 63) : 0);
+            } else
+            {
+                behindA = (sideA[w] >> 1) | ((w + 1 < words) ? (sideA[w + 1] << 63) : 0);
+                behindB = (sideB[w] >> 1) | ((w + 1 < words) ? (sideB[w + 1] << 63) : 0);
+            }
+
+            uint64_t stop = line[w] | (~sideA[w] & behindA) | (~sideB[w] & behindB);
+            if ((goal >> 6) == w)
+            {
+                stop |= 1ULL << (goal & 63);
+            }
+            stop &= mask;
+
+            if (stop)
+            {
+                int bit = (dir > 0) ? __builtin_ctzll(stop) : 63 - __builtin_clzll(stop);
+                return ((line[w] >> bit) & 1) ? -1 : (w << 6) + bit;
+            }
+            mask = ~0ULL;
+            w += dir;
+        }
+        return -1;
+    }
+
+    DistanceMap::DistanceMap()
+        : DistanceMap(0, 0, 1.0)
+    {
+    }
+
+    DistanceMap::DistanceMap(int w, int h, double inflation)
+        : width(std::max(0, w)), height(std::max(0, h)), stride(width + 2), lowestBucket(0), queued(0)
+    {
+        maxDist2 = std::max(1, int(std::ceil(inflation * inflation)));
+
+        const int cells = stride * (height + 2);
+        dist2.assign(cells, INT_MAX);
+        nearest.assign(cells, -1);
+        flags.assign(cells, 0);
+        buckets.resize(maxDist2 + 1);
+
+        // every bit starts blocked, including the padding past the end of a line, and the map is cleared
+        rowWords = (stride + 63) / 64;
+        columnWords = (height + 2 + 63) / 64;
+        rows.assign((height + 2) * rowWords, ~0ULL);
+        columns.assign(stride * columnWords, ~0ULL);
+
+        for (int y = 0; y < height + 2; ++y)
+        {
+            for (int x = 0; x < stride; ++x)
+            {
+                const int i = y * stride + x;
+                if ((x == 0) || (y == 0) || (x == stride - 1) || (y == height + 1))
+                {
+                    // the border is marked with a negative distance, so the planner only reads one array
+                    flags[i] = BORDER;
+                    dist2[i] = -1;
+                } else
+                {
+                    rows[y * rowWords + (x >> 6)] &= ~(1ULL << (x & 63));
+                    columns[x * columnWords + (y >> 6)] &= ~(1ULL << (y & 63));
+                }
+            }
+        }
+
+        const int dx[8] = {1, -1, 0, 0, 1, 1, -1, -1};
+        const int dy[8] = {0, 0, 1, -1, 1, -1, 1, -1};
+        for (int k = 0; k < 8; ++k)
+        {
+            offsets[k] = dy[k] * stride + dx[k];
+        }
+    }
+
+    int DistanceMap::getWidth() const
+    {
+        return width;
+    }
+
+    int DistanceMap::getHeight() const
+    {
+        return height;
+    }
+
+    int DistanceMap::index(int x, int y) const
+    {
+        return (y + 1) * stride + x + 1;
+    }
+
+    Cell DistanceMap::cellAt(int index) const
+    {
+        Cell cell;
+        cell.x = index % stride - 1;
+        cell.y = index / stride - 1;
+        return cell;
+    }
+
+    int DistanceMap::neighborOffset(int k) const
+    {
+        return offsets[k];
+    }
+
+    bool DistanceMap::contains(int x, int y) const
+    {
+        return (x >= 0) && (y >= 0) && (x < width) && (y < height);
+    }
+
+    void DistanceMap::push(int index, int d2)
+    {
+        d2 = std::min(d2, maxDist2);
+        buckets[d2].push_back(index);
+        lowestBucket = std::min(lowestBucket, d2);
+        ++queued;
+    }
+
+    int DistanceMap::pop()
+    {
+        while (buckets[lowestBucket].empty())
+        {
+            ++lowestBucket;
+        }
+        int index = buckets[lowestBucket].back();
+        buckets[lowestBucket].pop_back();
+        --queued;
+        return index;
+    }
+
+    void DistanceMap::setDistance2(int index, int d2)
+    {
+        const bool wasBlocked = dist2[index] < maxDist2;
+        const bool blocked = d2 < maxDist2;
+        dist2[index] = d2;
+
+        if (wasBlocked != blocked)
+        {
+            const int x = index % stride, y = index / stride;
+            rows[y * rowWords + (x >> 6)] ^= 1ULL << (x & 63);
+            columns[x * columnWords + (y >> 6)] ^= 1ULL << (y & 63);
+        }
+    }
+
+    int DistanceMap::distance2(int a, int b) const
+    {
+        int dx = a % stride - b % stride;
+        int dy = a / stride - b / stride;
+        return dx * dx + dy * dy;
+    }
+
+    void DistanceMap::setObstacle(int x, int y)
+    {
+        int i = index(x, y);
+        if (flags[i] & OBSTACLE)
+        {
+            return;
+        }
+        flags[i] = (flags[i] | OBSTACLE) & ~RAISE;
+        nearest[i] = i;
+        setDistance2(i, 0);
+        push(i, 0);
+    }
+
+    void DistanceMap::removeObstacle(int x, int y)
+    {
+        int i = index(x, y);
+        if (!(flags[i] & OBSTACLE))
+        {
+            return;
+        }
+        flags[i] = (flags[i] & ~OBSTACLE) | RAISE;
+        nearest[i] = -1;
+        setDistance2(i, INT_MAX);
+        push(i, 0);
+    }
+
+    bool DistanceMap::isObstacle(int x, int y) const
+    {
+        return flags[index(x, y)] & OBSTACLE;
+    }
+
+    void DistanceMap::raise(int i)
+    {
+        // every neighbor that got its distance from a removed obstacle is cleared and raises its own neighbors,
+        // the others are queued to lower the cleared cells again
+        for (int k = 0; k < 8; ++k)
+        {
+            int n = i + offsets[k];
+            if ((flags[n] & (BORDER | RAISE)) || (nearest[n] < 0))
+            {
+                continue;
+            }
+
+            push(n, dist2[n]);
+            if (!(flags[nearest[n]] & OBSTACLE))
+            {
+                flags[n] |= RAISE;
+                nearest[n] = -1;
+                setDistance2(n, INT_MAX);
+            }
+        }
+        flags[i] &= ~RAISE;
+    }
+
+    void DistanceMap::lower(int i)
+    {
+        const int source = nearest[i];
+        for (int k = 0; k < 8; ++k)
+        {
+            int n = i + offsets[k];
+            if (flags[n] & (BORDER | RAISE))
+            {
+                continue;
+            }
+
+            int d2 = distance2(source, n);
+            if ((d2 < dist2[n]) && (d2 <= maxDist2))
+            {
+                nearest[n] = source;
+                setDistance2(n, d2);
+                push(n, d2);
+            }
+        }
+    }
+
+    int DistanceMap::update()
+    {
+        int visited = 0;
+        while (queued > 0)
+        {
+            int i = pop();
+            ++visited;
+
+            if (flags[i] & RAISE)
+            {
+                raise(i);
+            } else if ((nearest[i] >= 0) && (flags[nearest[i]] & OBSTACLE))
+            {
+                lower(i);
+            }
+        }
+        lowestBucket = 0;
+        return visited;
+    }
+
+    double DistanceMap::distance(int x, int y) const
+    {
+        return std::sqrt(double(std::min(dist2[index(x, y)], maxDist2)));
+    }
+
+    int DistanceMap::distance2At(int index) const
+    {
+        return dist2[index];
+    }
+
+    uint8_t DistanceMap::flagsAt(int index) const
+    {
+        return flags[index];
+    }
+
+    bool DistanceMap::isFree(int index) const
+    {
+        return dist2[index] >= maxDist2;
+    }
+
+    int DistanceMap::getRowWords() const
+    {
+        return rowWords;
+    }
+
+    int DistanceMap::getColumnWords() const
+    {
+        return columnWords;
+    }
+
+    const uint64_t * DistanceMap::blockedRow(int y) const
+    {
+        return rows.data() + (y + 1) * rowWords;
+    }
+
+    const uint64_t * DistanceMap::blockedColumn(int x) const
+    {
+        return columns.data() + (x + 1) * columnWords;
+    }
+
+    GridPlanner::GridPlanner()
+        : generation(0), expanded(0)
+    {
+    }
+
+    int GridPlanner::jumpStraight(const DistanceMap & map, int x, int y, int dx, int dy) const
+    {
+        // the sides of a line on the border are off the map
+        if (!map.isFree(map.index(x, y)))
+        {
+            return -1;
+        }
+
+        if (dy == 0)
+        {
+            int bit = scanLine(map.blockedRow(y), map.blockedRow(y - 1), map.blockedRow(y + 1), map.getRowWords(),
+                               x + 1, dx, (goal.y == y) ? goal.x + 1 : -1);
+            return (bit < 0) ? -1 : map.index(bit - 1, y);
+        }
+
+        int bit = scanLine(map.blockedColumn(x), map.blockedColumn(x - 1), map.blockedColumn(x + 1),
+                           map.getColumnWords(), y + 1, dy, (goal.x == x) ? goal.y + 1 : -1);
+        return (bit < 0) ? -1 : map.index(x, bit - 1);
+    }
+
+    int GridPlanner::jumpDiagonal(const DistanceMap & map, int x, int y, int dx, int dy) const
+    {
+        while (true)
+        {
+            const int i = map.index(x, y);
+            if (!map.isFree(i))
+            {
+                return -1;
+            }
+            if ((x == goal.x) && (y == goal.y))
+            {
+                return i;
+            }
+
+            // a diagonal run stops where one of its straight runs finds something
+            if ((jumpStraight(map, x + dx, y, dx, 0) >= 0) || (jumpStraight(map, x, y + dy, 0, dy) >= 0))
+            {
+                return i;
+            }
+
+            // no squeezing diagonally between two blocked cells
+            if (!map.isFree(map.index(x + dx, y)) || !map.isFree(map.index(x, y + dy)))
+            {
+                return -1;
+            }
+            x += dx;
+            y += dy;
+        }
+    }
+
+    bool GridPlanner::plan(const DistanceMap & map, const Cell & start, const Cell & goalCell,
+                           std::vector<Cell> & path)
+    {
+        path.clear();
+        expanded = 0;
+        goal = goalCell;
+        if (!map.contains(start.x, start.y) || !map.contains(goal.x, goal.y) ||
+            !map.isFree(map.index(goal.x, goal.y)))
+        {
+            return false;
+        }
+
+        // from inside the inflation, climb the distance until the robot is clear of it
+        std::vector<Cell> points;
+        int startIndex = map.index(start.x, start.y);
+        points.push_back(start);
+        while (!map.isFree(startIndex))
+        {
+            int best = startIndex;
+            for (int k = 0; k < 8; ++k)
+            {
+                int n = startIndex + map.neighborOffset(k);
+                if (map.distance2At(n) > map.distance2At(best))
+                {
+                    best = n;
+                }
+            }
+            if (best == startIndex)
+            {
+                return false;
+            }
+            startIndex = best;
+            points.push_back(map.cellAt(best));
+        }
+
+        const int cells = (map.getWidth() + 2) * (map.getHeight() + 2);
+        if (int(g.size()) != cells)
+        {
+            g.assign(cells, 0.0f);
+            parent.assign(cells, -1);
+            seen.assign(cells, 0);
+            closed.assign(cells, 0);
+            generation = 0;
+        }
+        if (++generation == 0)
+        {
+            // wrapped around, every stamp is stale
+            std::fill(seen.begin(), seen.end(), 0);
+            std::fill(closed.begin(), closed.end(), 0);
+            generation = 1;
+        }
+
+        // octile distance, nudged up a little for the heuristic so ties are broken toward the goal
+        const float diagonal = float(std::sqrt(2.0));
+        auto octile = [&](const Cell & a, const Cell & b)
+        {
+            float dx = std::abs(a.x - b.x), dy = std::abs(a.y - b.y);
+            return (dx + dy) + (diagonal - 2.0f) * std::min(dx, dy);
+        };
+
+        open.clear();
+        g[startIndex] = 0.0f;
+        parent[startIndex] = -1;
+        seen[startIndex] = generation;
+        open.emplace_back(1.001f * octile(map.cellAt(startIndex), goal), startIndex);
+
+        const std::greater<std::pair<float, int32_t>> later;
+        const int goalIndex = map.index(goal.x, goal.y);
+        bool found = false;
+
+        while (!open.empty())
+        {
+            std::pop_heap(open.begin(), open.end(), later);
+            int current = open.back().second;
+            open.pop_back();
+
+            if (closed[current] == generation)
+            {
+                continue;
+            }
+            closed[current] = generation;
+            ++expanded;
+
+            if (current == goalIndex)
+            {
+                found = true;
+                break;
+            }
+
+            // the directions worth scanning given the direction the search arrived from
+            const Cell here = map.cellAt(current);
+            int directions[8][2];
+            int numDirections = 0;
+            if (parent[current] < 0)
+            {
+                const int all[8][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}, {1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+                for (const auto & d: all)
+                {
+                    directions[numDirections][0] = d[0];
+                    directions[numDirections++][1] = d[1];
+                }
+            } else
+            {
+                const Cell from = map.cellAt(parent[current]);
+                const int dx = (here.x > from.x) - (here.x < from.x);
+                const int dy = (here.y > from.y) - (here.y < from.y);
+                directions[numDirections][0] = dx;
+                directions[numDirections++][1] = dy;
+                if ((dx != 0) && (dy != 0))
+                {
+                    // off a diagonal run, its two straight components
+                    directions[numDirections][0] = dx;
+                    directions[numDirections++][1] = 0;
+                    directions[numDirections][0] = 0;
+                    directions[numDirections++][1] = dy;
+                } else
+                {
+                    // off a straight run, to either side and diagonally ahead to either side
+                    const int px = dy, py = dx;
+                    const int sides[4][2] = {{px, py}, {-px, -py}, {dx + px, dy + py}, {dx - px, dy - py}};
+                    for (const auto & d: sides)
+                    {
+                        directions[numDirections][0] = d[0];
+                        directions[numDirections++][1] = d[1];
+                    }
+                }
+            }
+
+            for (int k = 0; k < numDirections; ++k)
+            {
+                const int dx = directions[k][0], dy = directions[k][1];
+                int next;
+                if ((dx != 0) && (dy != 0))
+                {
+                    if (!map.isFree(map.index(here.x + dx, here.y)) || !map.isFree(map.index(here.x, here.y + dy)))
+                    {
+                        continue;
+                    }
+                    next = jumpDiagonal(map, here.x + dx, here.y + dy, dx, dy);
+                } else
+                {
+                    next = jumpStraight(map, here.x + dx, here.y + dy, dx, dy);
+                }
+                if ((next < 0) || (closed[next] == generation))
+                {
+                    continue;
+                }
+
+                const Cell there = map.cellAt(next);
+                float cost = g[current] + octile(here, there);
+                if ((seen[next] != generation) || (cost < g[next]))
+                {
+                    g[next] = cost;
+                    parent[next] = current;
+                    seen[next] = generation;
+                    open.emplace_back(cost + 1.001f * octile(there, goal), next);
+                    std::push_heap(open.begin(), open.end(), later);
+                }
+            }
+        }
+
+        if (!found)
+        {
+            return false;
+        }
+
+        // after the climb, the jump points from the start of the search to the goal
+        std::vector<Cell> jumpPoints;
+        for (int i = goalIndex; i != startIndex; i = parent[i])
+        {
+            jumpPoints.push_back(map.cellAt(i));
+        }
+        points.insert(points.end(), jumpPoints.rbegin(), jumpPoints.rend());
+
+        // jump points are joined by straight or diagonal runs, keep only those where the direction changes
+        auto direction = [](const Cell & a, const Cell & b)
+        {
+            int dx = b.x - a.x, dy = b.y - a.y;
+            return std::make_pair((dx > 0) - (dx < 0), (dy > 0) - (dy < 0));
+        };
+        for (unsigned int k = 0; k < points.size(); ++k)
+        {
+            if ((k > 0) && (k + 1 < points.size()) &&
+                (direction(points[k - 1], points[k]) == direction(points[k], points[k + 1])))
+            {
+                continue;
+            }
+            path.push_back(points[k]);
+        }
+        return true;
+    }
+
+    int GridPlanner::getExpanded() const
+    {
+        return expanded;
+    }
+}
@@ -0,0 +1,455 @@
+/// \file trajectory_library.cpp
+/// \brief a library that implements pure pursuit and linear MPC path following
+
+#include "nuturtle_robot/trajectory_library.hpp"
+#include "rigid2d/rigid2d.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace trajectory
+{
+    using namespace rigid2d;
+
+    /// \brief distance between the position of two poses
+    static double distance(const Waypoint & a, const Waypoint & b)
+    {
+        return std::hypot(b.x - a.x, b.y - a.y);
+    }
+
+    std::size_t nearestIndex(const Waypoint & pose, const std::vector<Waypoint> & path, std::size_t start)
+    {
+        if (path.empty())
+        {
+            return 0;
+        }
+
+        std::size_t i = std::min(start, path.size() - 1);
+        double best = distance(pose, path[i]);
+
+        while (i + 1 < path.size())
+        {
+            double next = distance(pose, path[i + 1]);
+            if (next > best)
+            {
+                break;
+            }
+            best = next;
+            ++i;
+        }
+        return i;
+    }
+
+    /************************
+     * Pure Pursuit
+     * *********************/
+    PurePursuit::PurePursuit()
+    {
+        lookahead = 0.2;
+        speed = 0.1;
+        goalTol = 0.05;
+    }
+
+    PurePursuit::PurePursuit(double look, double vel, double tol)
+    {
+        lookahead = look;
+        speed = vel;
+        goalTol = tol;
+    }
+
+    void PurePursuit::reset()
+    {
+        nearest = 0;
+    }
+
+    bool PurePursuit::finished(const Waypoint & pose, const std::vector<Waypoint> & path) const
+    {
+        if (path.empty())
+        {
+            return true;
+        }
+        return (nearest + 1 >= path.size()) && (distance(pose, path.back()) < goalTol);
+    }
+
+    Twist2D PurePursuit::computeTwist(const Waypoint & pose, const std::vector<Waypoint> & path)
+    {
+        Twist2D tw;
+        tw.dth = 0.0;
+        tw.dx = 0.0;
+        tw.dy = 0.0;
+
+        if (path.empty())
+        {
+            return tw;
+        }
+
+        nearest = nearestIndex(pose, path, nearest);
+
+        if (finished(pose, path))
+        {
+            return tw;
+        }
+
+        // find the first point at least one lookahead distance away
+        std::size_t goal = nearest;
+        while ((goal + 1 < path.size()) && (distance(pose, path[goal]) < lookahead))
+        {
+            ++goal;
+        }
+
+        // express the goal point in the body frame of the robot
+        double dx = path[goal].x - pose.x;
+        double dy = path[goal].y - pose.y;
+        double xl = cos(pose.th) * dx + sin(pose.th) * dy;
+        double yl = -sin(pose.th) * dx + cos(pose.th) * dy;
+        double dist2 = xl * xl + yl * yl;
+
+        if (dist2 < 1e-12)
+        {
+            return tw;
+        }
+
+        // slow down when closing in on the end of the path
+        double vel = speed;
+        double dist = sqrt(dist2);
+        if ((goal + 1 == path.size()) && (dist < lookahead))
+        {
+            vel = speed * dist / lookahead;
+        }
+
+        if (xl < 0.0)
+        {
+            // goal is behind the robot, turn in place toward it
+            tw.dth = (yl < 0.0 ? -2.0 : 2.0) * speed / lookahead;
+            return tw;
+        }
+
+        tw.dx = vel;
+        tw.dth = vel * 2.0 * yl / dist2;
+        return tw;
+    }
+
+    /************************
+     * Linear MPC
+     * *********************/
+    LinearMPC::LinearMPC()
+    {
+        reset();
+    }
+
+    LinearMPC::LinearMPC(const MPCParams & p)
+    {
+        params = p;
+        reset();
+    }
+
+    void LinearMPC::reset()
+    {
+        nearest = 0;
+        lastIter = 0;
+        U.fill(0.0);
+    }
+
+    int LinearMPC::iterations() const
+    {
+        return lastIter;
+    }
+
+    bool LinearMPC::finished(const Waypoint & pose, const std::vector<Waypoint> & path) const
+    {
+        if (path.empty())
+        {
+            return true;
+        }
+        return (nearest + 1 >= path.size()) && (distance(pose, path.back()) < params.goalTol);
+    }
+
+    void LinearMPC::sampleReference(const Waypoint & pose, const std::vector<Waypoint> & path)
+    {
+        const std::size_t last = path.size() - 1;
+        std::size_t seg = std::min(nearest, last);
+        double along = 0.0;
+
+        // start the reference at the projection of the robot onto the path
+        auto project = [&path, &pose](std::size_t s)
+        {
+            double len = distance(path[s], path[s + 1]);
+            if (len <= 0.0)
+            {
+                return 0.0;
+            }
+            double t = ((pose.x - path[s].x) * (path[s + 1].x - path[s].x)
+                      + (pose.y - path[s].y) * (path[s + 1].y - path[s].y)) / len;
+            return std::min(std::max(t, 0.0), len);
+        };
+
+        if ((seg > 0) && (project(seg - 1) < distance(path[seg - 1], path[seg])))
+        {
+            seg -= 1;
+            along = project(seg);
+        } else if (seg < last)
+        {
+            along = project(seg);
+        }
+
+        auto headingOf = [&path, last](std::size_t s)
+        {
+            if (last == 0)
+            {
+                return path[0].th;
+            }
+            std::size_t a = std::min(s, last - 1);
+            return atan2(path[a + 1].y - path[a].y, path[a + 1].x - path[a].x);
+        };
+
+        auto pointAt = [&path, last, &headingOf](std::size_t s, double d)
+        {
+            Waypoint w = path[s];
+            if (s < last)
+            {
+                double len = distance(path[s], path[s + 1]);
+                double frac = len > 0.0 ? d / len : 0.0;
+                w.x += frac * (path[s + 1].x - path[s].x);
+                w.y += frac * (path[s + 1].y - path[s].y);
+            }
+            w.th = headingOf(s);
+            return w;
+        };
+
+        ref[0] = pointAt(seg, along);
+
+        const double step = params.speed * params.dt;
+        for (int k = 1; k <= MPC_HORIZON; ++k)
+        {
+            // walk one step of arc length along the path
+            double remaining = step;
+            double moved = 0.0;
+            while ((remaining > 0.0) && (seg < last))
+            {
+                double len = distance(path[seg], path[seg + 1]);
+                if (along + remaining < len)
+                {
+                    along += remaining;
+                    moved += remaining;
+                    remaining = 0.0;
+                } else
+                {
+                    moved += len - along;
+                    remaining -= len - along;
+                    along = 0.0;
+                    ++seg;
+                }
+            }
+
+            ref[k] = pointAt(seg, along);
+            refV[k - 1] = moved / params.dt;
+            refW[k - 1] = normalize_angle(ref[k].th - ref[k - 1].th) / params.dt;
+        }
+    }
+
+    void LinearMPC::buildQP(const Waypoint & pose)
+    {
+        constexpr int N = MPC_HORIZON;
+        constexpr int NX = MPC_STATES;
+        constexpr int NU = MPC_INPUTS;
+        constexpr int ROWS = N * NX;
+
+        // prediction matrices X = Xfree + T U, where X stacks the errors at steps 1..N
+        std::array<double, ROWS> Xfree;
+        std::array<double, ROWS * MPC_VARS> T;
+        T.fill(0.0);
+
+        std::array<std::array<double, NX * NX>, N> A;
+        std::array<std::array<double, NX * NU>, N> B;
+
+        for (int k = 0; k < N; ++k)
+        {
+            double c = cos(ref[k].th);
+            double s = sin(ref[k].th);
+            double v = refV[k];
+            double dt = params.dt;
+
+            A[k] = {1.0, 0.0, -v * s * dt,
+                    0.0, 1.0, v * c * dt,
+                    0.0, 0.0, 1.0};
+            B[k] = {c * dt, 0.0,
+                    s * dt, 0.0,
+                    0.0, dt};
+        }
+
+        // free response of the error from the initial state
+        std::array<double, NX> e = {pose.x - ref[0].x, pose.y - ref[0].y, normalize_angle(pose.th - ref[0].th)};
+        for (int k = 0; k < N; ++k)
+        {
+            std::array<double, NX> next;
+            for (int r = 0; r < NX; ++r)
+            {
+                next[r] = A[k][r * NX + 0] * e[0] + A[k][r * NX + 1] * e[1] + A[k][r * NX + 2] * e[2];
+            }
+            e = next;
+            for (int r = 0; r < NX; ++r)
+            {
+                Xfree[k * NX + r] = e[r];
+            }
+        }
+
+        // forced response: block (i, j) = A_i ... A_{j+1} B_j
+        for (int j = 0; j < N; ++j)
+        {
+            std::array<double, NX * NU> G = B[j];
+            for (int i = j; i < N; ++i)
+            {
+                if (i > j)
+                {
+                    std::array<double, NX * NU> next;
+                    for (int r = 0; r < NX; ++r)
+                    {
+                        for (int c = 0; c < NU; ++c)
+                        {
+                            next[r * NU + c] = A[i][r * NX + 0] * G[0 * NU + c]
+                                             + A[i][r * NX + 1] * G[1 * NU + c]
+                                             + A[i][r * NX + 2] * G[2 * NU + c];
+                        }
+                    }
+                    G = next;
+                }
+                for (int r = 0; r < NX; ++r)
+                {
+                    for (int c = 0; c < NU; ++c)
+                    {
+                        T[(i * NX + r) * MPC_VARS + (j * NU + c)] = G[r * NU + c];
+                    }
+                }
+            }
+        }
+
+        // H = T' Q T + R and f = T' Q Xfree, with diagonal Q and R
+        const std::array<double, NX> q = {params.qXY, params.qXY, params.qTh};
+        const std::array<double, NU> rw = {params.rV, params.rW};
+
+        for (int a = 0; a < MPC_VARS; ++a)
+        {
+            double fa = 0.0;
+            for (int r = 0; r < ROWS; ++r)
+            {
+                fa += T[r * MPC_VARS + a] * q[r % NX] * Xfree[r];
+            }
+            f[a] = fa;
+
+            for (int b = a; b < MPC_VARS; ++b)
+            {
+                double hab = 0.0;
+                for (int r = 0; r < ROWS; ++r)
+                {
+                    hab += T[r * MPC_VARS + a] * q[r % NX] * T[r * MPC_VARS + b];
+                }
+                if (a == b)
+                {
+                    hab += rw[a % NU];
+                }
+                H[a * MPC_VARS + b] = hab;
+                H[b * MPC_VARS + a] = hab;
+            }
+        }
+
+        // box constraints on the deviation from the reference inputs
+        for (int k = 0; k < N; ++k)
+        {
+            lower[k * NU + 0] = -params.maxV - refV[k];
+            upper[k * NU + 0] = params.maxV - refV[k];
+            lower[k * NU + 1] = -params.maxW - refW[k];
+            upper[k * NU + 1] = params.maxW - refW[k];
+        }
+    }
+
+    void LinearMPC::solveQP()
+    {
+        // warm start: shift the previous solution by one step
+        for (int i = 0; i < MPC_VARS - MPC_INPUTS; ++i)
+        {
+            U[i] = U[i + MPC_INPUTS];
+        }
+        for (int i = 0; i < MPC_VARS; ++i)
+        {
+            U[i] = std::min(std::max(U[i], lower[i]), upper[i]);
+        }
+
+        // Gershgorin bound on the largest eigenvalue gives a safe step size
+        double lip = 0.0;
+        for (int a = 0; a < MPC_VARS; ++a)
+        {
+            double row = 0.0;
+            for (int b = 0; b < MPC_VARS; ++b)
+            {
+                row += fabs(H[a * MPC_VARS + b]);
+            }
+            lip = std::max(lip, row);
+        }
+        const double step = 1.0 / lip;
+
+        // accelerated projected gradient (FISTA)
+        std::array<double, MPC_VARS> y = U;
+        double t = 1.0;
+        lastIter = 0;
+
+        for (int iter = 0; iter < params.maxIter; ++iter)
+        {
+            std::array<double, MPC_VARS> next;
+            for (int a = 0; a < MPC_VARS; ++a)
+            {
+                double g = f[a];
+                for (int b = 0; b < MPC_VARS; ++b)
+                {
+                    g += H[a * MPC_VARS + b] * y[b];
+                }
+                next[a] = std::min(std::max(y[a] - step * g, lower[a]), upper[a]);
+            }
+
+            double tNext = 0.5 * (1.0 + sqrt(1.0 + 4.0 * t * t));
+            double momentum = (t - 1.0) / tNext;
+            double change = 0.0;
+            for (int a = 0; a < MPC_VARS; ++a)
+            {
+                y[a] = next[a] + momentum * (next[a] - U[a]);
+                change = std::max(change, fabs(next[a] - U[a]));
+            }
+
+            U = next;
+            t = tNext;
+            lastIter = iter + 1;
+
+            if (change < 1e-6)
+            {
+                break;
+            }
+        }
+    }
+
+    Twist2D LinearMPC::computeTwist(const Waypoint & pose, const std::vector<Waypoint> & path)
+    {
+        Twist2D tw;
+        tw.dth = 0.0;
+        tw.dx = 0.0;
+        tw.dy = 0.0;
+
+        if (path.empty())
+        {
+            return tw;
+        }
+
+        nearest = nearestIndex(pose, path, nearest);
+
+        if (finished(pose, path))
+        {
+            U.fill(0.0);
+            return tw;
+        }
+
+        sampleReference(pose, path);
+        buildQP(pose);
+        solveQP();
+
+        tw.dx = refV[0] + U[0];
+        tw.dth = refW[0] + U[1];
+        return tw;
+    }
+}
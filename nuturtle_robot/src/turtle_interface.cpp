@@ -7,6 +7,7 @@
 /// PARAMETERS:
 ///             wheelRad : the radius of the robot's wheels
 ///             wheelBase : the distance between the robot's wheels
+///             max_wheel_velocity : the fastest the wheels turn (rad/s), a full wheel command
 ///             left_wheel_joint : the string used in publishing a joint_state message
 ///             right_wheel_joint : the string used in publishing a joint_state message
 ///             odom_frame_id : the string used in publishing a joint_state message
@@ -66,6 +67,7 @@ int main(int argc, char* argv[])
     double maxAngVel = 5.97; // rad/s
     n.getParam("wheel_radius", wheelRad);
     n.getParam("wheel_base", wheelBase);
+    n.getParam("max_wheel_velocity", maxAngVel);
     n.getParam("left_wheel_joint", left_wheel_joint);
     n.getParam("right_wheel_joint", right_wheel_joint);
     n.getParam("odom_frame_id", odom_frame_id);
@@ -0,0 +1,196 @@
+/// \file twist_mux.cpp
+/// \brief contains a node called twist_mux that forwards the highest priority twist command to cmd_vel
+///
+/// PARAMETERS:
+///         mux_lane_topics : the twist topics to listen to, one per source
+///         mux_lane_priorities : the priority of each source, higher overrides lower
+///         mux_lane_timeouts : seconds after its last command at which a source is ignored
+///         mux_frequency : the rate (Hz) at which the selection is republished and timeouts are checked
+///         mux_threads : number of callback threads (0 uses one per core)
+///         mux_latency_budget : the time (s) from receiving a command to sending it, above which a warning is printed
+/// PUBLISHES:
+///         cmd_vel (geometry_msgs/Twist) : the command of the selected source, zero once every source timed out
+/// SUBSCRIBES:
+///         <mux_lane_topics> (geometry_msgs/Twist) : the commands of each source
+///         safety_stop (std_msgs/Bool) : while true every source is overridden with a zero twist
+///
+/// A command on the selected source is forwarded from its own callback, so it does not wait for the timer.
+/// Messages are taken and sent as shared pointers, so sources running in the same process (nodelets)
+/// are not serialized.
+
+#include <ros/ros.h>
+#include <nuturtle_robot/mux_library.hpp>
+
+#include <rigid2d/rigid2d.hpp>
+
+#include <geometry_msgs/Twist.h>
+#include <std_msgs/Bool.h>
+#include <boost/bind.hpp>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+/***************
+ * Declare global variables
+ * ************/
+static mux::TwistMux twistMux;
+static ros::Publisher twist_pub;
+static double latencyBudget = 100e-6;
+
+static std::atomic<int> lastLane{-1};
+
+/***************
+ * Helper Functions
+ * ************/
+void twistCallback(const geometry_msgs::Twist::ConstPtr & msg, int lane);
+void stopCallback(const std_msgs::Bool::ConstPtr & msg);
+void muxTimer(const ros::TimerEvent &);
+int publishSelection();
+
+int main(int argc, char* argv[])
+{
+    /****************
+     * Initialize node & node handler
+    ****************/
+    ros::init(argc, argv, "twist_mux");
+    ros::NodeHandle n;
+
+    /****************
+     * Define variables
+    ****************/
+    std::vector<std::string> topics;
+    std::vector<int> priorities;
+    std::vector<double> timeouts;
+    int frequency = 100;
+    int threads = 0;
+
+    n.getParam("mux_lane_topics", topics);
+    n.getParam("mux_lane_priorities", priorities);
+    n.getParam("mux_lane_timeouts", timeouts);
+    n.getParam("mux_frequency", frequency);
+    n.getParam("mux_threads", threads);
+    n.getParam("mux_latency_budget", latencyBudget);
+
+    if ((priorities.size() != topics.size()) || (timeouts.size() != topics.size()))
+    {
+        ROS_FATAL("twist_mux: lane_topics, lane_priorities and lane_timeouts must have the same length");
+        return 1;
+    }
+
+    /****************
+     * Define publisher, subscribers and lanes
+     * *************/
+    twist_pub = n.advertise<geometry_msgs::Twist>("cmd_vel", frequency);
+
+    std::vector<ros::Subscriber> lane_subs;
+    for (std::size_t i = 0; i < topics.size(); ++i)
+    {
+        int lane = twistMux.addLane(priorities[i], timeouts[i]);
+        if (lane < 0)
+        {
+            ROS_ERROR("twist_mux: only %d lanes are supported, ignoring %s", mux::MAX_LANES, topics[i].c_str());
+            continue;
+        }
+        lane_subs.push_back(n.subscribe<geometry_msgs::Twist>(topics[i], 1,
+                                                              boost::bind(twistCallback, _1, lane),
+                                                              ros::VoidConstPtr(),
+                                                              ros::TransportHints().tcpNoDelay()));
+        ROS_INFO("twist_mux: lane %d on %s, priority %d, timeout %.2f s", lane, topics[i].c_str(),
+                 priorities[i], timeouts[i]);
+    }
+
+    ros::Subscriber stop_sub = n.subscribe("safety_stop", 1, stopCallback);
+
+    ros::Timer mux_timer = n.createTimer(ros::Duration(1.0 / frequency), muxTimer);
+
+    /****************
+     * Lanes are lock free, so callbacks may run on several threads at once
+     * *************/
+    ros::AsyncSpinner spinner(threads);
+    spinner.start();
+    ros::waitForShutdown();
+    return 0;
+}
+
+/// \brief sends the command of the selected lane, or a zero twist if no lane is selected
+/// \return the selected lane, -1 if none
+int publishSelection()
+{
+    rigid2d::Twist2D tw;
+    int lane = twistMux.select(ros::Time::now().toSec(), tw);
+
+    geometry_msgs::TwistPtr out(new geometry_msgs::Twist);
+    out->linear.x = tw.dx;
+    out->angular.z = tw.dth;
+    twist_pub.publish(out);
+
+    int previous = lastLane.exchange(lane);
+    if (previous != lane)
+    {
+        ROS_DEBUG("twist_mux: switched from lane %d to lane %d", previous, lane);
+    }
+    return lane;
+}
+
+/// \brief callback function for the twist subscriber of one lane
+/// Forwards the command right away if the lane is the one selected
+/// \param msg : the twist command
+/// \param lane : the lane the subscriber belongs to
+void twistCallback(const geometry_msgs::Twist::ConstPtr & msg, int lane)
+{
+    ros::WallTime start = ros::WallTime::now();
+
+    rigid2d::Twist2D tw;
+    tw.dth = msg->angular.z;
+    tw.dx = msg->linear.x;
+    tw.dy = 0.0;
+    twistMux.update(lane, tw, ros::Time::now().toSec());
+
+    if (twistMux.isStopped())
+    {
+        return;
+    }
+
+    rigid2d::Twist2D selected;
+    if (twistMux.select(ros::Time::now().toSec(), selected) == lane)
+    {
+        publishSelection();
+
+        double elapsed = (ros::WallTime::now() - start).toSec();
+        if (elapsed > latencyBudget)
+        {
+            ROS_WARN_THROTTLE(1.0, "twist_mux: forwarding took %.1f us, over the %.1f us budget",
+                              1e6 * elapsed, 1e6 * latencyBudget);
+        }
+    }
+}
+
+/// \brief callback function for the safety stop subscriber
+/// \param msg : true engages the stop, false releases it
+void stopCallback(const std_msgs::Bool::ConstPtr & msg)
+{
+    bool wasStopped = twistMux.isStopped();
+    twistMux.setStop(msg->data);
+
+    if (msg->data && !wasStopped)
+    {
+        ROS_WARN("twist_mux: safety stop engaged");
+        publishSelection();
+    } else if (!msg->data && wasStopped)
+    {
+        ROS_INFO("twist_mux: safety stop released");
+    }
+}
+
+/// \brief republishes the selection, and a single zero twist once every lane has timed out
+void muxTimer(const ros::TimerEvent &)
+{
+    rigid2d::Twist2D tw;
+    int lane = twistMux.select(ros::Time::now().toSec(), tw);
+
+    if ((lane >= 0) || (lastLane.load() >= 0))
+    {
+        publishSelection();
+    }
+}
@@ -0,0 +1,145 @@
+/// \brief dwa_tests.cpp
+/// test file for the dynamic window local planner
+
+#include <catch_ros/catch.hpp>
+#include <nuturtle_robot/dwa_library.hpp>
+#include <rigid2d/rigid2d.hpp>
+#include <cmath>
+#include <vector>
+
+/// \brief a 360 beam scan of a wall across the x axis at distance d, 0 where the wall is out of range
+static std::vector<float> wallAhead(double d, double halfWidth)
+{
+    std::vector<float> ranges(360, 0.0f);
+    for (int i = 0; i < 360; ++i)
+    {
+        double a = i * rigid2d::PI / 180.0;
+        if (std::cos(a) > 1e-6)
+        {
+            double r = d / std::cos(a);
+            if (std::fabs(r * std::sin(a)) <= halfWidth)
+            {
+                ranges[i] = r;
+            }
+        }
+    }
+    return ranges;
+}
+
+TEST_CASE("The lattice only holds twists the wheels can follow", "[dwa]")
+{
+    using namespace dwa;
+
+    const double base = 0.16, rad = 0.033, maxWheel = 5.97;
+    DwaParams params;
+    DwaPlanner planner(params, base, rad, maxWheel);
+
+    REQUIRE(planner.getMaxLinear() == Approx(maxWheel * rad));
+    REQUIRE(planner.getMaxAngular() == Approx(2.0 * maxWheel * rad / base));
+    REQUIRE(planner.latticeSize() > 50);
+    REQUIRE(planner.latticeSize() < params.linearSamples * params.angularSamples);
+    REQUIRE(planner.sweptCells() > planner.latticeSize());
+
+    // on an empty grid the robot heads straight for a goal in front of it, as fast as it can
+    CostGrid grid(params);
+    grid.build(0.0, rigid2d::PI / 180.0, std::vector<float>(360, 0.0f), 0.12, 3.5);
+    grid.spreadGoal(1.0, 0.0);
+    DwaResult result = planner.plan(grid, rigid2d::Twist2D{0.0, planner.getMaxLinear(), 0.0}, 0.05, 1.0, 0.0);
+    REQUIRE(result.found);
+    REQUIRE(result.twist.dx == Approx(planner.getMaxLinear()));
+    REQUIRE(result.twist.dth == Approx(0.0).margin(1e-9));
+    REQUIRE(result.evaluated < planner.latticeSize());
+}
+
+/// \brief a 360 beam scan taken at (x, y, th) of a tube of radius r at (tx, ty)
+static std::vector<float> tubeScan(double x, double y, double th, double tx, double ty, double r)
+{
+    std::vector<float> ranges(360, 0.0f);
+    for (int i = 0; i < 360; ++i)
+    {
+        // x + t d hits the circle where t^2 - 2 t (d . c) + |c|^2 - r^2 = 0, c from the robot to the tube
+        double a = th + i * rigid2d::PI / 180.0;
+        double cx = tx - x, cy = ty - y;
+        double b = std::cos(a) * cx + std::sin(a) * cy;
+        double disc = b * b - (cx * cx + cy * cy - r * r);
+        if ((disc >= 0.0) && (b - std::sqrt(disc) > 0.0))
+        {
+            ranges[i] = b - std::sqrt(disc);
+        }
+    }
+    return ranges;
+}
+
+TEST_CASE("The planner steers around an obstacle and never into one", "[dwa]")
+{
+    using namespace dwa;
+
+    DwaParams params;
+    DwaPlanner planner(params, 0.16, 0.033, 5.97);
+    CostGrid grid(params);
+
+    // a short wall 0.3 m ahead
+    grid.build(0.0, rigid2d::PI / 180.0, wallAhead(0.3, 0.1), 0.12, 3.5);
+    REQUIRE(grid.at(grid.index(0.3, 0.0)) == LETHAL);
+    REQUIRE(grid.at(grid.index(0.3 - 0.5 * params.inflation, 0.0)) > 0);
+    REQUIRE(grid.at(grid.index(0.0, 0.0)) == 0);
+
+    // drive to a goal behind a tube in the way, the scan is cast from the pose reached every step
+    const double tx = 0.6, ty = 0.01, tubeRadius = 0.0762, period = 0.05;
+    double x = 0.0, y = 0.0, th = 0.0;
+    rigid2d::Twist2D twist{0.0, 0.0, 0.0};
+    double closest = 1.0;
+    bool reached = false;
+    for (int k = 0; (k < 400) && !reached; ++k)
+    {
+        grid.build(0.0, rigid2d::PI / 180.0, tubeScan(x, y, th, tx, ty, tubeRadius), 0.12, 3.5);
+
+        const double gx = std::cos(th) * (1.2 - x) - std::sin(th) * y;
+        const double gy = -std::sin(th) * (1.2 - x) - std::cos(th) * y;
+        grid.spreadGoal(gx, gy);
+        DwaResult result = planner.plan(grid, twist, period, gx, gy);
+        REQUIRE(result.found);
+        twist = result.twist;
+
+        th += 0.5 * twist.dth * period;
+        x += twist.dx * period * std::cos(th);
+        y += twist.dx * period * std::sin(th);
+        th += 0.5 * twist.dth * period;
+
+        closest = std::min(closest, std::hypot(tx - x, ty - y) - tubeRadius);
+        reached = std::hypot(1.2 - x, y) < 0.05;
+    }
+    REQUIRE(reached);
+    REQUIRE(closest > params.robotRadius - params.resolution);
+
+    // boxed in by a wide wall right in front, only turning in place is safe
+    grid.build(0.0, rigid2d::PI / 180.0, wallAhead(0.12, 2.0), 0.1, 3.5);
+    grid.spreadGoal(1.0, 0.0);
+    DwaResult result = planner.plan(grid, rigid2d::Twist2D{0.0, 0.0, 0.0}, 0.05, 1.0, 0.0);
+    REQUIRE((!result.found || (result.twist.dx == Approx(0.0))));
+}
+
+TEST_CASE("Every control step with a wide window scores the whole lattice", "[dwa]")
+{
+    using namespace dwa;
+
+    DwaParams params;
+    params.maxLinearAccel = 100.0;
+    params.maxAngularAccel = 100.0;
+    DwaPlanner planner(params, 0.16, 0.033, 5.97);
+    CostGrid grid(params);
+
+    const std::vector<float> ranges = wallAhead(0.4, 0.3);
+    const int steps = 100;
+    int found = 0;
+    for (int k = 0; k < steps; ++k)
+    {
+        grid.build(0.0, rigid2d::PI / 180.0, ranges, 0.12, 3.5);
+        grid.spreadGoal(1.0, 0.2);
+        DwaResult result = planner.plan(grid, rigid2d::Twist2D{0.0, 0.1, 0.0}, 0.05, 1.0, 0.2);
+        found += result.found;
+        REQUIRE(result.evaluated == planner.latticeSize());
+    }
+
+    REQUIRE(found == steps);
+}
@@ -0,0 +1,112 @@
+/// \brief mux_tests.cpp
+/// test file for the priority twist multiplexer
+
+#include <catch_ros/catch.hpp>
+#include <nuturtle_robot/mux_library.hpp>
+#include <rigid2d/rigid2d.hpp>
+#include <atomic>
+#include <thread>
+
+/// \brief builds a twist with the given linear and angular velocity
+static rigid2d::Twist2D makeTwist(double dx, double dth)
+{
+    rigid2d::Twist2D tw;
+    tw.dth = dth;
+    tw.dx = dx;
+    tw.dy = 0.0;
+    return tw;
+}
+
+TEST_CASE("The highest priority fresh lane is selected", "[twist_mux]")
+{
+    mux::TwistMux m;
+    int teleop = m.addLane(10, 0.5);
+    int planner = m.addLane(5, 0.5);
+
+    rigid2d::Twist2D out;
+    REQUIRE(m.select(0.0, out) == -1);
+    REQUIRE(out.dx == Approx(0.0));
+
+    m.update(planner, makeTwist(0.1, 0.2), 1.0);
+    REQUIRE(m.select(1.1, out) == planner);
+    REQUIRE(out.dx == Approx(0.1));
+    REQUIRE(out.dth == Approx(0.2));
+
+    m.update(teleop, makeTwist(-0.05, 1.0), 1.2);
+    REQUIRE(m.select(1.3, out) == teleop);
+    REQUIRE(out.dx == Approx(-0.05));
+    REQUIRE(out.dth == Approx(1.0));
+}
+
+TEST_CASE("Lanes that timed out fall back to lower priorities, then to zero", "[twist_mux]")
+{
+    mux::TwistMux m;
+    int planner = m.addLane(5, 1.0);
+    int teleop = m.addLane(10, 0.5);
+
+    rigid2d::Twist2D out;
+    m.update(planner, makeTwist(0.1, 0.0), 0.0);
+    m.update(teleop, makeTwist(0.2, 0.0), 0.0);
+
+    REQUIRE(m.select(0.4, out) == teleop);
+    REQUIRE(m.select(0.6, out) == planner);
+    REQUIRE(out.dx == Approx(0.1));
+    REQUIRE(m.select(1.1, out) == -1);
+    REQUIRE(out.dx == Approx(0.0));
+}
+
+TEST_CASE("The safety stop overrides every lane", "[twist_mux]")
+{
+    mux::TwistMux m;
+    int lane = m.addLane(1, 1.0);
+
+    rigid2d::Twist2D out;
+    m.update(lane, makeTwist(0.2, 0.5), 0.0);
+    m.setStop(true);
+    REQUIRE(m.select(0.1, out) == -1);
+    REQUIRE(out.dx == Approx(0.0));
+    REQUIRE(out.dth == Approx(0.0));
+
+    m.setStop(false);
+    REQUIRE(m.select(0.1, out) == lane);
+    REQUIRE(out.dx == Approx(0.2));
+}
+
+TEST_CASE("Only MAX_LANES lanes can be added", "[twist_mux]")
+{
+    mux::TwistMux m;
+    for (int i = 0; i < mux::MAX_LANES; ++i)
+    {
+        REQUIRE(m.addLane(i, 1.0) == i);
+    }
+    REQUIRE(m.addLane(0, 1.0) == -1);
+    REQUIRE(m.lanesCount() == mux::MAX_LANES);
+}
+
+TEST_CASE("A reader never sees a half written command", "[twist_mux]")
+{
+    mux::TwistMux m;
+    int lane = m.addLane(1, 1e9);
+    m.update(lane, makeTwist(0.0, 0.0), 0.0);
+
+    std::atomic<bool> done{false};
+    std::thread writer([&]()
+    {
+        for (int i = 1; i < 200000; ++i)
+        {
+            m.update(lane, makeTwist(i, -i), i);
+        }
+        done = true;
+    });
+
+    bool consistent = true;
+    rigid2d::Twist2D out;
+    while (!done)
+    {
+        m.select(0.0, out);
+        consistent = consistent && (out.dx == -out.dth);
+    }
+    writer.join();
+
+    REQUIRE(consistent);
+}
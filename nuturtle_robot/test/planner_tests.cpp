@@ -0,0 +1,186 @@
+/// \brief planner_tests.cpp
+/// test file for the incremental distance transform and the grid planner
+
+#include <catch_ros/catch.hpp>
+#include <nuturtle_robot/planner_library.hpp>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+/// \brief checks every distance of the map against a brute force search over the obstacles
+static bool matchesBruteForce(const planner::DistanceMap & map, double maxDistance)
+{
+    std::vector<planner::Cell> obstacles;
+    for (int y = 0; y < map.getHeight(); ++y)
+    {
+        for (int x = 0; x < map.getWidth(); ++x)
+        {
+            if (map.isObstacle(x, y))
+            {
+                obstacles.push_back({x, y});
+            }
+        }
+    }
+
+    for (int y = 0; y < map.getHeight(); ++y)
+    {
+        for (int x = 0; x < map.getWidth(); ++x)
+        {
+            int best = int(std::ceil(maxDistance * maxDistance));
+            for (const auto & o: obstacles)
+            {
+                best = std::min(best, (o.x - x) * (o.x - x) + (o.y - y) * (o.y - y));
+            }
+            if (std::fabs(map.distance(x, y) - std::sqrt(double(best))) > 1e-9)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+TEST_CASE("The distance transform follows obstacles being added and removed", "[planner]")
+{
+    using namespace planner;
+
+    const double maxDistance = 8.0;
+    DistanceMap map(40, 30, maxDistance);
+    map.update();
+    REQUIRE(map.distance(10, 10) == Approx(maxDistance));
+
+    map.setObstacle(10, 10);
+    map.update();
+    REQUIRE(map.distance(10, 10) == Approx(0.0));
+    REQUIRE(map.distance(13, 14) == Approx(5.0));
+    REQUIRE(matchesBruteForce(map, maxDistance));
+
+    std::mt19937 gen(7);
+    std::uniform_int_distribution<> xs(0, 39), ys(0, 29);
+    for (int round = 0; round < 20; ++round)
+    {
+        for (int k = 0; k < 15; ++k)
+        {
+            map.setObstacle(xs(gen), ys(gen));
+        }
+        for (int k = 0; k < 15; ++k)
+        {
+            map.removeObstacle(xs(gen), ys(gen));
+        }
+        map.update();
+        REQUIRE(matchesBruteForce(map, maxDistance));
+    }
+
+    // a small change only visits the cells around it
+    map.setObstacle(20, 15);
+    map.update();
+    map.removeObstacle(20, 15);
+    REQUIRE(map.update() < 40 * 30);
+    REQUIRE(matchesBruteForce(map, maxDistance));
+}
+
+TEST_CASE("Paths keep their clearance from obstacles", "[planner]")
+{
+    using namespace planner;
+
+    // a wall across the map with a gap 9 cells wide
+    DistanceMap map(60, 40, 3.0), wide(60, 40, 5.5);
+    for (int y = 0; y < 40; ++y)
+    {
+        if ((y < 25) || (y > 33))
+        {
+            map.setObstacle(30, y);
+            wide.setObstacle(30, y);
+        }
+    }
+    map.update();
+    wide.update();
+
+    GridPlanner planner;
+    std::vector<Cell> path;
+    REQUIRE(planner.plan(map, {5, 5}, {55, 5}, path));
+    REQUIRE(path.front().x == 5);
+    REQUIRE(path.back().x == 55);
+
+    // every cell between the corners of the path is clear of the wall
+    for (unsigned int i = 1; i < path.size(); ++i)
+    {
+        int steps = std::max(std::abs(path[i].x - path[i - 1].x), std::abs(path[i].y - path[i - 1].y));
+        REQUIRE(steps > 0);
+        for (int s = 0; s <= steps; ++s)
+        {
+            int x = path[i - 1].x + (path[i].x - path[i - 1].x) * s / steps;
+            int y = path[i - 1].y + (path[i].y - path[i - 1].y) * s / steps;
+            REQUIRE(map.distance(x, y) >= 3.0);
+        }
+    }
+
+    // the gap is too narrow for a wider robot
+    REQUIRE_FALSE(planner.plan(wide, {5, 5}, {55, 5}, path));
+    REQUIRE(path.empty());
+
+    // and the planner forgets the last search
+    REQUIRE(planner.plan(map, {5, 5}, {20, 5}, path));
+    REQUIRE(path.size() == 2);
+    REQUIRE(planner.getExpanded() < 10);
+
+    // a goal off the map or inside the inflation is refused
+    REQUIRE_FALSE(planner.plan(map, {5, 5}, {60, 5}, path));
+    REQUIRE_FALSE(planner.plan(map, {5, 5}, {28, 5}, path));
+
+    // a start inside the inflation first backs away from the wall
+    REQUIRE(planner.plan(map, {29, 5}, {5, 5}, path));
+    REQUIRE(path.front().x == 29);
+    REQUIRE(path.back().x == 5);
+}
+
+TEST_CASE("Replanning on a 1000 x 1000 grid goes around each new obstacle", "[planner]")
+{
+    using namespace planner;
+
+    const int size = 1000;
+    DistanceMap map(size, size, 2.0);
+
+    // scattered 3 x 3 blocks, like the tubes seen at 5 cm
+    std::mt19937 gen(11);
+    std::uniform_int_distribution<> position(20, size - 20);
+    for (int k = 0; k < 3000; ++k)
+    {
+        int bx = position(gen), by = position(gen);
+        for (int y = by - 1; y <= by + 1; ++y)
+        {
+            for (int x = bx - 1; x <= bx + 1; ++x)
+            {
+                map.setObstacle(x, y);
+            }
+        }
+    }
+    map.update();
+
+    GridPlanner planner;
+    std::vector<Cell> path;
+    REQUIRE(planner.plan(map, {5, 5}, {size - 5, size - 5}, path));
+
+    // a new obstacle is seen on the path, the distance transform only visits the cells around it
+    // and the new path keeps its clearance from it
+    const int replans = 10;
+    for (int k = 0; k < replans; ++k)
+    {
+        const Cell blocked = path[path.size() / 2];
+        map.setObstacle(blocked.x, blocked.y);
+        REQUIRE(map.update() < 100);
+        REQUIRE(planner.plan(map, {5, 5}, {size - 5, size - 5}, path));
+
+        for (unsigned int i = 1; i < path.size(); ++i)
+        {
+            int steps = std::max(std::abs(path[i].x - path[i - 1].x), std::abs(path[i].y - path[i - 1].y));
+            for (int s = 0; s <= steps; ++s)
+            {
+                int x = path[i - 1].x + (path[i].x - path[i - 1].x) * s / steps;
+                int y = path[i - 1].y + (path[i].y - path[i - 1].y) * s / steps;
+                REQUIRE(map.distance(x, y) >= 2.0);
+            }
+        }
+    }
+}
@@ -0,0 +1,163 @@
+/// \brief trajectory_tests.cpp
+/// test file for the pure pursuit and linear MPC path followers
+
+#include <catch_ros/catch.hpp>
+#include <nuturtle_robot/trajectory_library.hpp>
+#include <rigid2d/rigid2d.hpp>
+#include <cmath>
+#include <vector>
+
+/// \brief builds a counter-clockwise circle path of the given radius starting at the origin
+static std::vector<trajectory::Waypoint> circlePath(double radius, int points)
+{
+    std::vector<trajectory::Waypoint> path;
+    for (int i = 0; i <= points; ++i)
+    {
+        double ang = 2.0 * rigid2d::PI * i / points;
+        trajectory::Waypoint w;
+        w.x = radius * sin(ang);
+        w.y = radius * (1.0 - cos(ang));
+        w.th = ang;
+        path.push_back(w);
+    }
+    return path;
+}
+
+/// \brief integrates a unicycle for one time step
+static void step(trajectory::Waypoint & pose, const rigid2d::Twist2D & tw, double dt)
+{
+    pose.x += tw.dx * cos(pose.th) * dt;
+    pose.y += tw.dx * sin(pose.th) * dt;
+    pose.th = rigid2d::normalize_angle(pose.th + tw.dth * dt);
+}
+
+TEST_CASE("nearest index only moves forward", "[nearest index]")
+{
+    using namespace trajectory;
+
+    std::vector<Waypoint> path(5);
+    for (int i = 0; i < 5; ++i)
+    {
+        path[i].x = i;
+    }
+
+    Waypoint pose;
+    pose.x = 2.1;
+
+    REQUIRE(nearestIndex(pose, path, 0) == 2);
+    REQUIRE(nearestIndex(pose, path, 3) == 3);
+    REQUIRE(nearestIndex(pose, path, 10) == 4);
+}
+
+TEST_CASE("pure pursuit steers toward the path", "[pure pursuit]")
+{
+    using namespace trajectory;
+
+    std::vector<Waypoint> path(11);
+    for (int i = 0; i < 11; ++i)
+    {
+        path[i].x = 0.1 * i;
+        path[i].y = 0.1;
+    }
+
+    PurePursuit follower(0.3, 0.2, 0.05);
+    Waypoint pose;
+
+    rigid2d::Twist2D tw = follower.computeTwist(pose, path);
+
+    REQUIRE(tw.dx == Approx(0.2));
+    REQUIRE(tw.dth > 0.0);
+    REQUIRE(tw.dy == Approx(0.0));
+}
+
+TEST_CASE("pure pursuit follows a circle to the end", "[pure pursuit circle]")
+{
+    using namespace trajectory;
+
+    std::vector<Waypoint> path = circlePath(0.5, 200);
+    PurePursuit follower(0.15, 0.2, 0.05);
+    Waypoint pose;
+
+    double dt = 0.01;
+    for (int i = 0; i < 5000 && !follower.finished(pose, path); ++i)
+    {
+        step(pose, follower.computeTwist(pose, path), dt);
+    }
+
+    REQUIRE(follower.finished(pose, path));
+}
+
+TEST_CASE("linear MPC follows a circle to the end", "[mpc circle]")
+{
+    using namespace trajectory;
+
+    std::vector<Waypoint> path = circlePath(0.5, 200);
+    MPCParams params;
+    params.speed = 0.2;
+    LinearMPC follower(params);
+
+    Waypoint pose;
+    pose.y = -0.05;
+
+    double dt = 0.01;
+    double worst = 0.0;
+    for (int i = 0; i < 5000 && !follower.finished(pose, path); ++i)
+    {
+        step(pose, follower.computeTwist(pose, path), dt);
+        double radial = fabs(std::hypot(pose.x, pose.y - 0.5) - 0.5);
+        if (i > 200)
+        {
+            worst = std::max(worst, radial);
+        }
+    }
+
+    REQUIRE(follower.finished(pose, path));
+    REQUIRE(worst < 0.02);
+}
+
+TEST_CASE("linear MPC with its iteration cap matches a converged solve", "[mpc solver]")
+{
+    using namespace trajectory;
+
+    std::vector<Waypoint> path = circlePath(1.0, 1000);
+    MPCParams params;
+    LinearMPC follower(params);
+
+    // the same controller with the solver run until it converges
+    MPCParams converged = params;
+    converged.maxIter = 10000;
+    LinearMPC reference(converged);
+
+    Waypoint pose;
+    pose.y = 0.1;
+    pose.th = 0.3;
+
+    const int runs = 1000;
+    double settledError = 0.0, worstV = 0.0, worstW = 0.0;
+    for (int i = 0; i < runs; ++i)
+    {
+        rigid2d::Twist2D tw = follower.computeTwist(pose, path);
+        rigid2d::Twist2D best = reference.computeTwist(pose, path);
+
+        // every solve stays within the cap and the velocity bounds
+        REQUIRE(follower.iterations() >= 1);
+        REQUIRE(follower.iterations() <= params.maxIter);
+        REQUIRE(reference.iterations() < converged.maxIter);
+        REQUIRE(fabs(tw.dx) <= params.maxV + 1e-9);
+        REQUIRE(fabs(tw.dth) <= params.maxW + 1e-9);
+
+        step(pose, tw, 0.01);
+
+        // once back on the path the warm start keeps the capped solve close to the converged one
+        if (i >= runs / 2)
+        {
+            settledError = std::max(settledError, fabs(std::hypot(pose.x, pose.y - 1.0) - 1.0));
+            worstV = std::max(worstV, fabs(tw.dx - best.dx));
+            worstW = std::max(worstW, fabs(tw.dth - best.dth));
+        }
+    }
+
+    REQUIRE(settledError < 0.02);
+    REQUIRE(worstV < 0.005);
+    REQUIRE(worstW < 0.02);
+}
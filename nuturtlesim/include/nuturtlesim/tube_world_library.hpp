@@ -0,0 +1,52 @@
+#ifndef TUBE_WORLD_LIBRARY_INCLUDE_GUARD_HPP
+#define TUBE_WORLD_LIBRARY_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Library for the simulated world of tube_world: tubes inside a rectangle of walls, the robot
+/// bumping into the tubes and the lidar scan it sees
+///
+/// Nothing here needs ROS, so the simulation can also run headless, as in the nuslam pipeline benchmark.
+
+#include <rigid2d/diff_drive.hpp>
+
+#include <vector>
+
+namespace tube_world
+{
+    /// \brief a tube standing in the world
+    struct Tube
+    {
+        double x;
+        double y;
+        double radius;
+    };
+
+    /// \brief the walls, a rectangle centered at the origin of the world
+    struct Walls
+    {
+        double width;
+        double height;
+    };
+
+    /// \brief moves the robot off the tubes it runs into, along the tangent of each one
+    /// \param robot - the robot, changed in place
+    /// \param robotRadius - the radius of the robot
+    /// \param tubes - the tubes
+    /// \return the number of tubes the robot touched
+    int resolveCollisions(rigid2d::DiffDrive & robot, double robotRadius, const std::vector<Tube> & tubes);
+
+    /// \brief simulates the lidar, casting evenly spaced beams around the robot against the tubes and walls
+    /// Each tube is only tested against the beams that can reach it, so a scan costs the number of beams
+    /// plus the number of beams that fall on tubes, not beams times tubes.
+    /// \param th - the heading of the robot
+    /// \param x - the x position of the robot
+    /// \param y - the y position of the robot
+    /// \param tubes - the tubes
+    /// \param walls - the walls
+    /// \param maxRange - the range of the lidar, beams that hit nothing closer read maxRange + 1
+    /// \param ranges - the range of each beam, beam i at angle 2 PI i / ranges.size() from the heading;
+    /// it keeps its size, 360 if it is empty
+    void simulateScan(double th, double x, double y, const std::vector<Tube> & tubes, const Walls & walls,
+                      double maxRange, std::vector<float> & ranges);
+}
+
+#endif
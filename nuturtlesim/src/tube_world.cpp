@@ -7,6 +7,10 @@
 ///     right_wheel_joint : string used for publishing joint_state_message
 ///     wheelRad : the radius of the robot's wheels
 ///     wheelBase : the distance between the robot's wheels
+///     slip_min, slip_max : bounds of the wheel slip, seen by the encoders but not by the body
+///     gyro_noise : standard deviation of the simulated gyro noise (rad/s)
+///     gyro_bias : constant bias of the simulated gyro (rad/s)
+///     shm_transport : also hand the scans to local nodes through shared memory (default true)
 /// PUBLISHES:
 ///     sensor_msgs/JointState on the joint state topic
 ///     visualization_msgs/MarkerArray (the ground truth markers)
@@ -14,6 +18,7 @@
 ///     visualization_msgs/Marker (the walls)
 ///     nav_msgs/Path (the real path that the robot follows)
 ///     sensor_msgs/LaserScan (the lidar sensor messages)
+///     sensor_msgs/Imu on the imu topic (the simulated gyro yaw rate)
 /// SUBSCRIBES:
 ///     geometry_msgs/Twist on the cmd_vel topic
 /// SERVICES:
@@ -27,9 +32,13 @@
 
 #include <sensor_msgs/JointState.h>
 #include <sensor_msgs/LaserScan.h>
+#include <sensor_msgs/Imu.h>
 
 #include <rigid2d/rigid2d.hpp>
 #include <rigid2d/diff_drive.hpp>
+#include <rigid2d/shm_transport.hpp>
+
+#include <nuturtlesim/tube_world_library.hpp>
 
 #include <visualization_msgs/MarkerArray.h>
 #include <visualization_msgs/Marker.h>
@@ -59,31 +68,6 @@ static bool twist_received = false;
  * ********/
 void twistCallback(const geometry_msgs::Twist msg);
 
-geometry_msgs::Point LineToLine(geometry_msgs::Point point1, geometry_msgs::Point point2, geometry_msgs::Point point3, geometry_msgs::Point point4)
-    {
-        double x1 = point1.x;
-        double y1 = point1.y;
-
-        double x2 = point2.x;
-        double y2 = point2.y;
-
-        double x3 = point3.x;
-        double y3 = point3.y;
-
-        double x4 = point4.x;
-        double y4 = point4.y;
-
-        double det12 = x1*y2 - x2*y1;
-        double det34 = x3*y4 - x4*y3;
-        double det1234 = (x1-x2)*(y3-y4) - (x3-x4)*(y1-y2);
-
-        geometry_msgs::Point intercept;
-        intercept.x = ((det12*(x3-x4) - det34*(x1-x2))) / det1234;
-        intercept.y = ((det12*(y3-y4) - det34*(y1-y2))) / det1234;
-
-        return intercept;
-    }
-
 /***********
  * get_random() function
  * ********/
@@ -121,6 +105,10 @@ int main(int argc, char* argv[])
     int angleIncr, sampleNum;
 
     double wallWidth, wallHeight;
+
+    double gyroNoise, gyroBias;
+
+    bool shm_transport = true;
     
     std::string world_frame_id, turtle_frame_id, left_wheel_joint, right_wheel_joint;
     std::string odom_frame_id;
@@ -159,6 +147,9 @@ int main(int argc, char* argv[])
     n.getParam("noise_level", scanNoise);
     n.getParam("wall_width", wallWidth);
     n.getParam("wall_height", wallHeight);
+    n.param("gyro_noise", gyroNoise, 0.0);
+    n.param("gyro_bias", gyroBias, 0.0);
+    n.getParam("shm_transport", shm_transport);
 
     /***********
      * Initialize more local variables
@@ -169,7 +160,12 @@ int main(int argc, char* argv[])
     double slipVar = slipMax - slipMean;
 
     std::normal_distribution<> slip_noise(slipMean, slipVar);
-    std::list<std::vector<double>> listOfTubes({tube1_loc, tube2_loc, tube3_loc, tube4_loc, tube5_loc, tube6_loc});
+    std::normal_distribution<> gyro_noise(0, gyroNoise);
+    std::vector<tube_world::Tube> tubes;
+    for (const auto & loc: {tube1_loc, tube2_loc, tube3_loc, tube4_loc, tube5_loc, tube6_loc})
+    {
+        tubes.push_back({loc[0], loc[1], tubeRad});
+    }
 
 
     /***********
@@ -180,7 +176,8 @@ int main(int argc, char* argv[])
     ros::Publisher marker_rel_pub = n.advertise<visualization_msgs::MarkerArray>("/fake_sensor", frequency);
     ros::Publisher wall_pub = n.advertise<visualization_msgs::Marker>("/wall", frequency);
     ros::Publisher path_pub = n.advertise<nav_msgs::Path>("/real_path", frequency);
-    ros::Publisher lidar_pub = n.advertise<sensor_msgs::LaserScan>("/scan", frequency);
+    rigid2d::ShmPublisher<sensor_msgs::LaserScan> lidar_pub(n, "/scan", frequency, shm_transport);
+    ros::Publisher imu_pub = n.advertise<sensor_msgs::Imu>("/imu", frequency);
 
     ros::Subscriber twist_sub = n.subscribe("/cmd_vel", frequency, twistCallback);
 
@@ -206,6 +203,15 @@ int main(int argc, char* argv[])
     
     joint_pub.publish(joint_msg);
 
+    // the wheel angles the body actually moved by, the joint states also include the slip
+    double trueLeft = 0.0, trueRight = 0.0;
+
+    sensor_msgs::Imu imu_msg;
+    imu_msg.header.frame_id = turtle_frame_id;
+    imu_msg.orientation_covariance[0] = -1;
+    imu_msg.linear_acceleration_covariance[0] = -1;
+    imu_msg.angular_velocity_covariance[8] = gyroNoise * gyroNoise;
+
     while(ros::ok())
     {
         current_time = ros::Time::now();
@@ -397,6 +403,8 @@ int main(int argc, char* argv[])
 
         marker_true_pub.publish(markerArray);
 
+        double trueYawRate = 0.0;
+
         // if twist message has been received
         if (twist_received)
         {
@@ -425,39 +433,32 @@ int main(int argc, char* argv[])
             joint_msg.header.stamp = current_time;
             joint_msg.header.frame_id = turtle_frame_id;
 
+            trueLeft += wheelVelocities.uL * (current_time - last_time).toSec();
+            trueRight += wheelVelocities.uR * (current_time - last_time).toSec();
+
             joint_msg.position[0] += wheelVelocities.uL * (current_time - last_time).toSec();
             joint_msg.position[1] += wheelVelocities.uR * (current_time - last_time).toSec();
 
             /***********
              * Add wheel slip noise using slip model nu*omega where nu is uniform random noise between
-             * slipMin and slipMax
+             * slipMin and slipMax. The slipping wheels turn the encoders but do not move the body.
              * ********/
             joint_msg.position[0] += wheelVelocities.uL * slip_noise(get_random());
             joint_msg.position[1] += wheelVelocities.uR * slip_noise(get_random());
 
             /************
-             * Update configuration of diff-drive robot based on new wheel angles
+             * Update configuration of diff-drive robot based on the wheel angles without slip
              * Publish joint_state message
              * *********/
-            ninjaTurtle(joint_msg.position[0], joint_msg.position[1]);
+            ninjaTurtle(trueLeft, trueRight);
+            trueYawRate = desiredTwist.dth;
 
             joint_pub.publish(joint_msg);
 
             /***********
              * COLLISION DETECTION
              * ********/
-            for (auto loc : listOfTubes)
-            {
-                double distBetween = sqrt(pow(loc[0] - ninjaTurtle.getX(), 2) + pow(loc[1] - ninjaTurtle.getY(), 2));
-                if (distBetween <= (tubeRad + robotRad))
-                {
-                    double dx = (loc[0] - ninjaTurtle.getX())/20;
-                    double dy = (loc[1] - ninjaTurtle.getY())/20;
-                    
-                    // // have the robot move along that tangent line
-                    ninjaTurtle.changeConfig(dy, dx);
-                }
-            }
+            tube_world::resolveCollisions(ninjaTurtle, robotRad, tubes);
 
             /***********
              * Publish a transform between world frame and turtle frame to indicate location of robot
@@ -715,135 +716,9 @@ int main(int argc, char* argv[])
             /*************
              * Publish simulated lidar scanner messages
              * **********/
-            std::vector<float> lidarRanges(360, maxRangeScan+1);
-            std::fill(lidarRanges.begin(),lidarRanges.end(),maxRangeScan+1);
-
-            for (auto marker : markerArray.markers)
-            {
-                // angle of the tube relative to the world [-180, 180]
-                int tubeAngle = round(rad2deg(atan2(marker.pose.position.y, marker.pose.position.x)));
-
-                // shift the angle from [-180, 180] to [0, 359]
-                if (tubeAngle < 0)
-                {
-                    tubeAngle += 360;
-                }
-
-                // find (x1, y1), location of the turtle relative to the tube
-                double x1 = ninjaTurtle.getX() - marker.pose.position.x;
-                double y1 = ninjaTurtle.getY() - marker.pose.position.y;
-
-                // look for points -20 and +20 degrees from the angle of the tube
-                for (int i = tubeAngle - 20; i < tubeAngle + 20; ++i)
-                {
-                    // find (x2, y2), based on the angle of the lidar scanner
-                    double x2 = x1 + maxRange * cos(deg2rad(i));
-                    double y2 = y1 + maxRange * sin(deg2rad(i));
-                    
-                    double dx = x2 - x1;
-                    double dy = y2 - y1;
-                    double dr = sqrt(pow(dx, 2) + pow(dy, 2));
-                    double det = x1*y2 - x2*y1;
-                    double dis = pow(tubeRad, 2) * pow(dr, 2) - pow(det, 2);
-
-                    double distance;
-                    // find the points of intersection
-
-                    if (fabs(dis) < 1e-5) // tangent
-                    {
-                        double intX = (det * dy) / pow(dr, 2);
-                        double intY = -(det * dx) / pow(dr, 2);
-                        distance = sqrt(pow(intX, 2) + pow(intY, 2));
-                    } else if (fabs(dis) > 0)
-                    {
-                        double intX1 = (det * dy + (dy / fabs(dy)) * dx * sqrt(pow(tubeRad, 2) * pow(dr, 2) - pow(det, 2))) / pow(dr, 2);
-                        double intY1 = (-det * dx + fabs(dy) * sqrt(pow(tubeRad, 2) * pow(dr, 2) - pow(det, 2))) / pow(dr, 2);
-                        double dist1 = sqrt(pow(intX1 - x1, 2) + pow(intY1 - y1, 2));
-
-                        double intX2 = (det * dy - (dy / fabs(dy)) * dx * sqrt(pow(tubeRad, 2) * pow(dr, 2) - pow(det, 2))) / pow(dr, 2);
-                        double intY2 = (-det * dx - fabs(dy) * sqrt(pow(tubeRad, 2) * pow(dr, 2) - pow(det, 2))) / pow(dr, 2);
-                        double dist2 = sqrt(pow(intX2 - x1, 2) + pow(intY2 - y1, 2));
-
-                        if (dist1 < dist2)
-                        {
-                            distance = dist1;
-                        } else
-                        {
-                            distance = dist2;
-                        }
-                    }
-
-                    int index = i - int(rad2deg(ninjaTurtle.getTh()));
-                    index = index % 360;
-                    if (index < 0)
-                    {
-                        index += 360;
-                    }
-
-                    if (distance < lidarRanges[index])
-                    {
-                        lidarRanges[index] = distance;
-                    }
-                }
-            }
-
-            /************
-             * Check for Walls!!!!!!!!
-             * *********/
-            for (int a = 0; a < 360; ++a)
-            {
-                geometry_msgs::Point point1, point2;
-
-                point1.x = ninjaTurtle.getX();
-                point1.y = ninjaTurtle.getY();
-
-                point2.x = point1.x + maxRange * cos(deg2rad(a));
-                point2.y = point1.y + maxRange * sin(deg2rad(a));
-
-                geometry_msgs::Point intercept;
-
-                int wallIndex = round(a - int(rad2deg(ninjaTurtle.getTh())));
-                wallIndex = wallIndex % 360;
-                if (wallIndex < 0)
-                {
-                    wallIndex += 360;
-                } else if (wallIndex > 359)
-                {
-                    wallIndex -= 360;
-                }
-
-                // check ground truth top line (upper left to upper right)
-                geometry_msgs::Point inter1 = LineToLine(point1, point2, wall.points[0], wall.points[1]);
-                double dist1 = sqrt(pow(inter1.x - point1.x, 2) + pow(inter1.y - point1.y, 2));
-                if ((a < 180) && (dist1 < lidarRanges[wallIndex]))
-                {
-                    lidarRanges[wallIndex] = dist1;
-                }
-            
-                // check ground truth right line (upper right to lower right)
-                geometry_msgs::Point inter2 = LineToLine(point1, point2, wall.points[1], wall.points[2]);
-                double dist2 = sqrt(pow(inter2.x - point1.x, 2) + pow(inter2.y - point1.y, 2));
-                if (((a < 90) || (a > 270)) && (dist2 < lidarRanges[wallIndex]))
-                {
-                    lidarRanges[wallIndex] = dist2;
-                }
-
-                // check ground truth bottom line (lower right to lower left)
-                geometry_msgs::Point inter3 = LineToLine(point1, point2, wall.points[2], wall.points[3]);
-                double dist3 = sqrt(pow(inter3.x - point1.x, 2) + pow(inter3.y - point1.y, 2));
-                if ((a > 180) && (dist3 < lidarRanges[wallIndex]))
-                {
-                    lidarRanges[wallIndex] = dist3;
-                }
-                
-                // check ground truth left line (lower left to upper left)
-                geometry_msgs::Point inter4 = LineToLine(point1, point2, wall.points[3], wall.points[4]);
-                double dist4 = sqrt(pow(inter4.x - point1.x, 2) + pow(inter4.y - point1.y, 2));
-                if ((a > 90) && (a < 269) && (dist4 < lidarRanges[wallIndex]))
-                {
-                    lidarRanges[wallIndex] = dist4;
-                }
-            }
+            std::vector<float> lidarRanges(360);
+            tube_world::simulateScan(ninjaTurtle.getTh(), ninjaTurtle.getX(), ninjaTurtle.getY(), tubes,
+                                     {wallWidth, wallHeight}, maxRangeScan, lidarRanges);
 
             sensor_msgs::LaserScan scan_msg;
             scan_msg.header.frame_id = turtle_frame_id;
@@ -860,6 +735,13 @@ int main(int argc, char* argv[])
 
         }
 
+        /*************
+         * Publish the simulated gyro, the true yaw rate with bias and noise
+         * **********/
+        imu_msg.header.stamp = current_time;
+        imu_msg.angular_velocity.z = trueYawRate + gyroBias + gyro_noise(get_random());
+        imu_pub.publish(imu_msg);
+
     last_time = current_time;
     loop_rate.sleep();
     }
@@ -0,0 +1,115 @@
+/// \file tube_world_library.cpp
+/// \brief a library that simulates the world of tube_world
+
+#include "nuturtlesim/tube_world_library.hpp"
+#include "rigid2d/rigid2d.hpp"
+#include <cmath>
+#include <limits>
+
+namespace tube_world
+{
+    using namespace rigid2d;
+
+    int resolveCollisions(DiffDrive & robot, double robotRadius, const std::vector<Tube> & tubes)
+    {
+        int touched = 0;
+        for (const auto & tube: tubes)
+        {
+            double distBetween = sqrt(pow(tube.x - robot.getX(), 2) + pow(tube.y - robot.getY(), 2));
+            if (distBetween <= (tube.radius + robotRadius))
+            {
+                double dx = (tube.x - robot.getX()) / 20;
+                double dy = (tube.y - robot.getY()) / 20;
+
+                // have the robot move along that tangent line
+                robot.changeConfig(dy, dx);
+                ++touched;
+            }
+        }
+        return touched;
+    }
+
+    void simulateScan(double th, double x, double y, const std::vector<Tube> & tubes, const Walls & walls,
+                      double maxRange, std::vector<float> & ranges)
+    {
+        if (ranges.empty())
+        {
+            ranges.resize(360);
+        }
+        const int beams = ranges.size();
+        const double increment = 2 * PI / beams;
+        const double inf = std::numeric_limits<double>::infinity();
+
+        // the walls, every beam from inside the rectangle ends on one of them
+        for (int i = 0; i < beams; ++i)
+        {
+            const double ux = cos(th + i * increment);
+            const double uy = sin(th + i * increment);
+
+            double tx = inf, ty = inf;
+            if (ux > 1e-12)
+            {
+                tx = (walls.width / 2 - x) / ux;
+            } else if (ux < -1e-12)
+            {
+                tx = (-walls.width / 2 - x) / ux;
+            }
+            if (uy > 1e-12)
+            {
+                ty = (walls.height / 2 - y) / uy;
+            } else if (uy < -1e-12)
+            {
+                ty = (-walls.height / 2 - y) / uy;
+            }
+
+            const double t = std::min(tx, ty);
+            ranges[i] = (t >= 0.0) ? t : inf;
+        }
+
+        // the tubes, each against the beams between its two tangents
+        for (const auto & tube: tubes)
+        {
+            const double dx = tube.x - x;
+            const double dy = tube.y - y;
+            const double d = sqrt(dx * dx + dy * dy);
+            if ((d <= tube.radius) || (d - tube.radius > maxRange))
+            {
+                continue;
+            }
+
+            const double bearing = atan2(dy, dx) - th;
+            const double half = asin(tube.radius / d);
+            const int first = ceil((bearing - half) / increment);
+            const int last = floor((bearing + half) / increment);
+
+            for (int k = first; k <= last; ++k)
+            {
+                const double ux = cos(th + k * increment);
+                const double uy = sin(th + k * increment);
+
+                // the nearer root of |t u - (dx, dy)| = radius
+                const double along = dx * ux + dy * uy;
+                const double disc = tube.radius * tube.radius - (d * d - along * along);
+                if (disc < 0.0)
+                {
+                    continue;
+                }
+                const double t = along - sqrt(disc);
+
+                const int index = ((k % beams) + beams) % beams;
+                if ((t > 0.0) && (t < ranges[index]))
+                {
+                    ranges[index] = t;
+                }
+            }
+        }
+
+        for (auto & range: ranges)
+        {
+            if (!(range <= maxRange))
+            {
+                range = maxRange + 1;
+            }
+        }
+    }
+}
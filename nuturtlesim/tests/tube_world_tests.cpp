@@ -0,0 +1,53 @@
+#include <catch_ros/catch.hpp>
+#include <nuturtlesim/tube_world_library.hpp>
+#include <rigid2d/diff_drive.hpp>
+#include <cmath>
+#include <vector>
+
+TEST_CASE("The lidar is cast against the walls and the tubes", "[tube world]")
+{
+    using namespace tube_world;
+
+    const Walls walls{4.0, 4.0};
+    std::vector<float> ranges;
+
+    // an empty scan gets 360 beams, the walls are 2 m away in front and 2 sqrt(2) m in the corners
+    simulateScan(0.0, 0.0, 0.0, {}, walls, 3.5, ranges);
+    REQUIRE(ranges.size() == 360);
+    REQUIRE(ranges[0] == Approx(2.0));
+    REQUIRE(ranges[90] == Approx(2.0));
+    REQUIRE(ranges[45] == Approx(2.0 * sqrt(2.0)));
+
+    // a tube 1 m ahead, beams that miss it still end on the wall
+    const std::vector<Tube> tubes = {{1.0, 0.0, 0.1}};
+    simulateScan(0.0, 0.0, 0.0, tubes, walls, 3.5, ranges);
+    REQUIRE(ranges[0] == Approx(0.9));
+    const double along = cos(5.0 * M_PI / 180.0), across = sin(5.0 * M_PI / 180.0);
+    REQUIRE(ranges[5] == Approx(along - sqrt(0.01 - across * across)));
+    REQUIRE(ranges[355] == Approx(ranges[5]));
+    REQUIRE(ranges[10] == Approx(2.0 / cos(10.0 * M_PI / 180.0)));
+
+    // the beams turn with the robot, the tube is on the right when it faces up
+    simulateScan(M_PI / 2.0, 0.0, 0.0, tubes, walls, 3.5, ranges);
+    REQUIRE(ranges[270] == Approx(0.9));
+    REQUIRE(ranges[0] == Approx(2.0));
+
+    // any number of beams, and nothing in range reads past the maximum range
+    std::vector<float> fine(720);
+    simulateScan(0.0, 0.0, 0.0, tubes, {10.0, 10.0}, 3.5, fine);
+    REQUIRE(fine.size() == 720);
+    REQUIRE(fine[0] == Approx(0.9));
+    REQUIRE(fine[180] == Approx(4.5));
+}
+
+TEST_CASE("The robot is pushed along the tangent of the tubes it touches", "[tube world]")
+{
+    using namespace tube_world;
+
+    rigid2d::DiffDrive robot(0.16, 0.033, 0.0, 0.0, 0.0, 0.0, 0.0);
+    const std::vector<Tube> tubes = {{0.15, 0.0, 0.0762}, {3.0, 3.0, 0.0762}};
+
+    REQUIRE(resolveCollisions(robot, 0.095, tubes) == 1);
+    REQUIRE(robot.getX() == Approx(0.0).margin(1e-12));
+    REQUIRE(robot.getY() == Approx(0.15 / 20));
+}
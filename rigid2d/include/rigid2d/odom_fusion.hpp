@@ -0,0 +1,103 @@
+#ifndef ODOM_FUSION_INCLUDE_GUARD_HPP
+#define ODOM_FUSION_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Library for fusing gyro yaw rate with wheel odometry.
+
+#include<rigid2d/rigid2d.hpp>
+
+namespace rigid2d
+{
+    /// \brief This class fuses the yaw rate of a gyro with the wheel odometry of a
+    /// differential drive robot using a complementary filter
+    ///
+    /// The heading is propagated with the bias corrected gyro at IMU rate. When new wheel
+    /// angles arrive, the heading change the wheels measured since the last wheel update is
+    /// compared with the one the gyro measured. Small disagreements are used to estimate the
+    /// gyro bias (quickly while the wheels stand still, slowly while driving) and the heading
+    /// is pulled slowly toward the wheel heading. Large ones are treated as wheel slip: the
+    /// wheel heading follows the gyro for that update and the bias is left alone. The wheel
+    /// travel is then laid along the fused heading.
+    class OdomFusion
+    {
+        private:
+            double wheelBase;
+            double wheelRad;
+            double headingGain;
+            double biasGain;
+            double stillBiasGain;
+            double slipThreshold;
+
+            double x;
+            double y;
+            double th;
+            double bias;
+
+            double thL;
+            double thR;
+            bool wheelsInit;
+
+            double thWheels;        // heading from the wheels, following the gyro while slipping
+            double thAtWheels;      // fused heading at the last wheel update
+            double gyroDth;         // gyro heading change since the last wheel update
+            double gyroTime;        // time covered by the gyro since the last wheel update
+            bool slipping;
+
+            Twist2D twist;          // latest body velocity
+
+        public:
+            /// \brief create a fusion filter with all values equal to 0.0
+            OdomFusion();
+
+            /// \brief create a fusion filter
+            /// \param base - the distance between the wheels
+            /// \param rad - the radius of the wheels
+            /// \param kHeading - fraction of the difference to the wheel heading corrected per wheel update
+            /// \param kBias - fraction of the yaw rate disagreement fed into the gyro bias per wheel update while driving
+            /// \param kBiasStill - fraction of the yaw rate disagreement fed into the gyro bias per wheel update while standing still
+            /// \param slipRate - yaw rate disagreement (rad/s) above which the wheels are assumed to slip
+            OdomFusion(double base, double rad, double kHeading, double kBias, double kBiasStill, double slipRate);
+
+            /// \brief propagates the heading with one gyro reading
+            /// \param gyroZ - the measured yaw rate (rad/s)
+            /// \param dt - the time since the previous gyro reading (s)
+            void imuUpdate(double gyroZ, double dt);
+
+            /// \brief corrects the heading and advances the position with new wheel angles
+            /// The first call only records the wheel angles.
+            /// \param thLnew - the new left wheel angle
+            /// \param thRnew - the new right wheel angle
+            /// \param dt - the time since the previous wheel update (s), used for the velocity
+            void wheelUpdate(double thLnew, double thRnew, double dt);
+
+            /// \brief resets the pose, keeping the gyro bias and the wheel angles
+            /// \param xx - the new x location
+            /// \param yy - the new y location
+            /// \param theta - the new heading
+            void setPose(double xx, double yy, double theta);
+
+            /// \brief access the x location of the fused configuration
+            /// \return x location
+            const double& getX() const;
+
+            /// \brief access the y location of the fused configuration
+            /// \return y location
+            const double& getY() const;
+
+            /// \brief access the fused heading
+            /// \return heading, normalized to (-PI, PI]
+            double getTh() const;
+
+            /// \brief access the estimated gyro bias
+            /// \return the gyro bias (rad/s)
+            const double& getBias() const;
+
+            /// \brief access the latest body velocity
+            /// \return the body twist (yaw rate from the gyro, forward speed from the wheels)
+            const Twist2D& getTwist() const;
+
+            /// \brief whether the last wheel update was rejected as slip
+            /// \return true if the wheels disagreed with the gyro by more than the slip threshold
+            bool isSlipping() const;
+    };
+}
+#endif
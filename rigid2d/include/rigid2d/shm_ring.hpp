@@ -0,0 +1,179 @@
+#ifndef SHM_RING_INCLUDE_GUARD_HPP
+#define SHM_RING_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Library for passing serialized messages between processes of the same machine through shared memory
+///
+/// A ring is a POSIX shared memory segment with one writer and up to numReaders readers:
+///     header                  (ShmRingHeader)
+///     readers                 (numReaders x ShmReaderEntry)
+///     index                   (numSlots 64 bit entries, message seq << 16 | slot)
+///     slots                   (numSlots x (ShmSlotHeader, slotSize bytes)), 64 byte aligned
+/// The writer fills any slot no reader is holding, oldest first, and never waits for the readers. A reader
+/// holds a slot by counting itself in its refs while it reads the message in place, and a writer claims a
+/// slot by setting WRITER_BIT in refs only while the count is zero. A reader that falls more than numSlots
+/// messages behind loses the oldest ones. Each reader also notes its pid and the slot it holds in its
+/// entry, so the slot of a reader whose process died is given back instead of being held forever.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+
+namespace rigid2d
+{
+    /// \brief the version written by ShmRing::create
+    constexpr uint32_t SHM_RING_VERSION = 2;
+
+    /// \brief the readers a ring created by ShmRing::create can have at once
+    constexpr uint32_t SHM_RING_READERS = 64;
+
+    /// \brief set in the refs of a slot while the writer fills it
+    constexpr uint32_t WRITER_BIT = 0x80000000u;
+
+    static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2 && sizeof(long long) == 8,
+                  "the ring needs lock free 32 and 64 bit atomics");
+
+    /// \brief the header at the start of a ring
+    struct ShmRingHeader
+    {
+        char magic[8];                          // "RIGIDSHM"
+        std::atomic<uint32_t> version;          // SHM_RING_VERSION once the segment is initialized
+        uint32_t numSlots;
+        uint32_t slotSize;                      // bytes of message a slot holds
+        int32_t writerPid;
+        std::atomic<uint32_t> closed;           // 1 once the writer has gone
+        std::atomic<uint32_t> wakeups;          // bumped on every message, the word the readers sleep on
+        std::atomic<uint32_t> sleepers;         // readers sleeping on wakeups
+        uint32_t numReaders;                    // entries of the reader table
+        std::atomic<uint64_t> writeSeq;         // seq of the latest message, messages are numbered from 1
+        uint64_t reserved[2];
+    };
+
+    static_assert(sizeof(ShmRingHeader) == 64, "the ring header must stay 64 bytes");
+
+    /// \brief the header in front of the message of a slot
+    struct ShmSlotHeader
+    {
+        std::atomic<uint32_t> refs;             // readers holding the slot, WRITER_BIT while being filled
+        uint32_t size;                          // bytes of the message
+        std::atomic<uint64_t> seq;              // seq of the message, 0 while being filled
+        uint64_t reserved[6];
+    };
+
+    static_assert(sizeof(ShmSlotHeader) == 64, "the slot header must stay 64 bytes");
+
+    /// \brief the entry of a reader in the reader table
+    struct ShmReaderEntry
+    {
+        std::atomic<int32_t> pid;               // process of the reader, 0 if free, -1 while being reclaimed
+        std::atomic<uint32_t> held;             // slot the reader holds plus 1, 0 if it holds none
+    };
+
+    static_assert(sizeof(ShmReaderEntry) == 8, "a reader entry must stay 8 bytes");
+
+    /// \brief one end of a shared memory ring, the writer if created and a reader if attached
+    class ShmRing
+    {
+        private:
+            void * data;
+            size_t length;
+            std::string name;
+            bool writer;
+
+            ShmRingHeader * header;
+            ShmReaderEntry * readers;
+            std::atomic<uint64_t> * index;
+            uint8_t * slots;
+            size_t stride;                      // bytes from one slot header to the next
+
+            uint64_t seq;                       // writer: seq of the message being written, reader: next to read
+            uint32_t current;                   // slot being written or read
+            bool busy;                          // a write or a read has begun and not ended
+            uint64_t lost;
+            int readerEntry;                    // reader: its entry in the reader table
+
+            /// \brief returns the header of a slot
+            ShmSlotHeader & slot(uint32_t k) const;
+
+            /// \brief maps an open segment and sets the pointers into it
+            bool map(int fd, size_t bytes, std::string & error);
+
+            /// \brief sets the pointers to the reader table, the index and the slots from the header
+            void locate();
+
+            /// \brief takes a free entry of the reader table
+            /// \return false if every entry is taken by a live reader
+            bool registerReader();
+
+        public:
+            /// \brief create a closed ring
+            ShmRing();
+
+            ShmRing(const ShmRing &) = delete;
+            ShmRing & operator=(const ShmRing &) = delete;
+
+            /// \brief closes the ring
+            ~ShmRing();
+
+            /// \brief creates a ring and becomes its writer, replacing a ring whose writer has gone
+            /// \param ringName - the shared memory name, e.g. "/rigid2d.scan"
+            /// \param numSlots - messages that can be held at once, at most 65535
+            /// \param slotSize - the largest message in bytes
+            /// \param error - the reason the ring could not be created, e.g. another writer is alive
+            /// \return true if the ring is open
+            bool create(const std::string & ringName, uint32_t numSlots, uint32_t slotSize, std::string & error);
+
+            /// \brief attaches to a ring as a reader, starting after its latest message
+            /// \param ringName - the shared memory name
+            /// \param error - the reason the ring could not be attached, e.g. it does not exist yet
+            /// \return true if the ring is open
+            bool attach(const std::string & ringName, std::string & error);
+
+            /// \brief detaches from the ring, the writer also marks it closed and removes it
+            void close();
+
+            /// \brief returns true if the ring is open
+            bool isOpen() const;
+
+            /// \brief returns the largest message in bytes
+            uint32_t slotSize() const;
+
+            /// \brief starts writing a message into the oldest slot no reader holds
+            /// \param size - bytes of the message
+            /// \return where to write the message, nullptr if it is too large or every slot is held
+            uint8_t * beginWrite(uint32_t size);
+
+            /// \brief hands the message to the readers and wakes those that sleep
+            void endWrite();
+
+            /// \brief holds the next message, skipping those overwritten before they were read
+            /// \param bytes - the message, valid until endRead
+            /// \param size - bytes of the message
+            /// \return false if there is no new message
+            bool beginRead(const uint8_t *& bytes, uint32_t & size);
+
+            /// \brief releases the message held by beginRead
+            void endRead();
+
+            /// \brief sleeps until there is a new message, the writer has gone or the time runs out
+            /// \param timeoutMs - the longest sleep (ms)
+            /// \return true if there is a new message
+            bool wait(int timeoutMs);
+
+            /// \brief returns true if the writer closed the ring or its process has exited
+            bool writerGone() const;
+
+            /// \brief returns the messages this reader lost because it was too slow
+            uint64_t lostMessages() const;
+
+            /// \brief frees the entries of readers whose process has exited and the slots they held
+            /// The writer calls it when every slot is held, and a reader when the table is full. A reader
+            /// that dies in the few instructions between counting itself in a slot and noting it in its
+            /// entry still keeps that slot.
+            /// \return the readers freed
+            uint32_t reclaimReaders();
+    };
+}
+
+#endif
@@ -0,0 +1,355 @@
+#ifndef SHM_TRANSPORT_INCLUDE_GUARD_HPP
+#define SHM_TRANSPORT_INCLUDE_GUARD_HPP
+/// \file
+/// \brief Publishers and subscribers that pass messages between nodes of the same machine through shared memory
+///
+/// ShmPublisher and ShmSubscriber stand in for ros::Publisher and ros::Subscriber on busy topics. The
+/// publisher serializes each message once into a ShmRing named after the topic, and still publishes it
+/// over ROS, which costs nothing while no ROS subscriber is connected. A subscriber reads the ring while
+/// its writer is alive and is subscribed over ROS the rest of the time, so it also works with publishers
+/// that do not use the ring, on other machines or started later. Its callback runs from the node's
+/// callback queue, like that of a ros::Subscriber.
+
+#include <rigid2d/shm_ring.hpp>
+
+#include <ros/ros.h>
+#include <ros/callback_queue_interface.h>
+#include <ros/serialization.h>
+
+#include <boost/make_shared.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace rigid2d
+{
+    /// \brief the default number of messages a ring holds
+    constexpr uint32_t SHM_DEFAULT_SLOTS = 8;
+
+    /// \brief the default largest message in bytes, a 360 beam scan with intensities is under 3 kB
+    constexpr uint32_t SHM_DEFAULT_SLOT_SIZE = 64 * 1024;
+
+    /// \brief the shared memory name of the ring of a topic
+    /// \param resolvedTopic - the fully resolved topic name, e.g. "/scan"
+    /// \return the ring name, e.g. "/rigid2d.scan"
+    inline std::string shmRingName(const std::string & resolvedTopic)
+    {
+        std::string ringName = "/rigid2d";
+        for (const char c : resolvedTopic)
+        {
+            ringName += (c == '/') ? '.' : c;
+        }
+        return ringName;
+    }
+
+    /// \brief publishes to a ROS topic and to its shared memory ring
+    template <class M>
+    class ShmPublisher
+    {
+        private:
+            /// \brief the ring and the lock that lets copies of the publisher share it
+            struct Shared
+            {
+                ShmRing ring;
+                std::mutex mutex;
+            };
+
+            ros::Publisher pub;
+            std::shared_ptr<Shared> shared;
+
+        public:
+            /// \brief create a publisher that publishes nothing
+            ShmPublisher() = default;
+
+            /// \brief advertises a topic and creates its ring
+            /// \param n - the node handle
+            /// \param topic - the topic
+            /// \param queueSize - the ROS publisher queue size
+            /// \param shm - false to publish over ROS only
+            /// \param slots - messages the ring holds, readers further behind lose messages
+            /// \param slotSize - the largest message in bytes, larger ones only go over ROS
+            ShmPublisher(ros::NodeHandle & n, const std::string & topic, uint32_t queueSize, bool shm,
+                         uint32_t slots = SHM_DEFAULT_SLOTS, uint32_t slotSize = SHM_DEFAULT_SLOT_SIZE)
+            {
+                pub = n.advertise<M>(topic, queueSize);
+                if (!shm)
+                {
+                    return;
+                }
+
+                shared = std::make_shared<Shared>();
+                std::string error;
+                if (!shared->ring.create(shmRingName(pub.getTopic()), slots, slotSize, error))
+                {
+                    ROS_WARN("%s is only published over ROS: %s", pub.getTopic().c_str(), error.c_str());
+                    shared.reset();
+                }
+            }
+
+            /// \brief publishes a message to the ring and over ROS
+            /// \param msg - the message
+            void publish(const M & msg) const
+            {
+                if (shared)
+                {
+                    std::lock_guard<std::mutex> lock(shared->mutex);
+                    const uint32_t size = ros::serialization::serializationLength(msg);
+                    uint8_t * bytes = shared->ring.beginWrite(size);
+                    if (bytes)
+                    {
+                        ros::serialization::OStream stream(bytes, size);
+                        ros::serialization::serialize(stream, msg);
+                        shared->ring.endWrite();
+                    } else
+                    {
+                        ROS_WARN_THROTTLE(5.0, "%s: a %u byte message did not fit in a ring slot",
+                                          pub.getTopic().c_str(), size);
+                    }
+                }
+                pub.publish(msg);
+            }
+
+            /// \brief returns the number of subscribers connected over ROS, not those reading the ring
+            uint32_t getNumSubscribers() const
+            {
+                return pub.getNumSubscribers();
+            }
+
+            /// \brief returns the topic
+            std::string getTopic() const
+            {
+                return pub.getTopic();
+            }
+    };
+
+    /// \brief subscribes to a topic through its shared memory ring when it has one and over ROS otherwise
+    template <class M>
+    class ShmSubscriber
+    {
+        public:
+            using Callback = std::function<void(const typename M::ConstPtr &)>;
+
+        private:
+            /// \brief the state shared by the copies of a subscriber and its reading thread
+            struct Impl : public std::enable_shared_from_this<Impl>
+            {
+                ros::NodeHandle n;
+                std::string topic;
+                std::string ringName;
+                uint32_t queueSize;
+                Callback callback;
+                ros::CallbackQueueInterface * queue;
+
+                std::mutex mutex;
+                ros::Subscriber sub;                            // while the ring is not read
+                std::deque<typename M::ConstPtr> pending;       // read from the ring, waiting for the callback
+
+                std::atomic<bool> running{false};
+                std::thread thread;
+
+                /// \brief runs the callback on the oldest message read from the ring
+                class ShmCallback : public ros::CallbackInterface
+                {
+                    private:
+                        std::weak_ptr<Impl> owner;
+
+                    public:
+                        explicit ShmCallback(const std::weak_ptr<Impl> & impl) : owner(impl) {}
+
+                        CallResult call() override
+                        {
+                            const std::shared_ptr<Impl> impl = owner.lock();
+                            if (!impl)
+                            {
+                                return Success;
+                            }
+                            typename M::ConstPtr msg;
+                            {
+                                std::lock_guard<std::mutex> lock(impl->mutex);
+                                if (impl->pending.empty())
+                                {
+                                    // dropped when the queue was full
+                                    return Success;
+                                }
+                                msg = impl->pending.front();
+                                impl->pending.pop_front();
+                            }
+                            impl->callback(msg);
+                            return Success;
+                        }
+                };
+
+                /// \brief subscribes over ROS
+                void subscribeRos()
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    sub = n.subscribe<M>(topic, queueSize,
+                                         boost::function<void(const typename M::ConstPtr &)>(callback));
+                }
+
+                /// \brief stops the ROS subscription
+                void unsubscribeRos()
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    sub.shutdown();
+                }
+
+                /// \brief queues a message read from the ring, dropping the oldest one past the queue size
+                void push(const typename M::ConstPtr & msg)
+                {
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        pending.push_back(msg);
+                        if (pending.size() > queueSize)
+                        {
+                            pending.pop_front();
+                        }
+                    }
+                    queue->addCallback(boost::make_shared<ShmCallback>(std::weak_ptr<Impl>(this->shared_from_this())),
+                                       reinterpret_cast<uint64_t>(this));
+                }
+
+                /// \brief sleeps for up to a time, returning early when stopped
+                void pause(int ms)
+                {
+                    for (int t = 0; t < ms && running; t += 50)
+                    {
+                        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+                    }
+                }
+
+                /// \brief the reading thread, attaches to the ring whenever it has a live writer
+                void read()
+                {
+                    ShmRing ring;
+                    std::string error;
+                    while (running)
+                    {
+                        if (!ring.isOpen())
+                        {
+                            if (!ring.attach(ringName, error) || ring.writerGone())
+                            {
+                                ring.close();
+                                pause(500);
+                                continue;
+                            }
+                            unsubscribeRos();
+                            ROS_DEBUG("%s is read from shared memory", topic.c_str());
+                        }
+
+                        if (!ring.wait(100))
+                        {
+                            if (ring.writerGone())
+                            {
+                                ring.close();
+                                subscribeRos();
+                                ROS_DEBUG("%s is read over ROS", topic.c_str());
+                            }
+                            continue;
+                        }
+
+                        const uint8_t * bytes;
+                        uint32_t size;
+                        while (ring.beginRead(bytes, size))
+                        {
+                            const boost::shared_ptr<M> msg = boost::make_shared<M>();
+                            try
+                            {
+                                ros::serialization::IStream stream(const_cast<uint8_t *>(bytes), size);
+                                ros::serialization::deserialize(stream, *msg);
+                            } catch (const ros::Exception & e)
+                            {
+                                ring.endRead();
+                                ROS_ERROR_THROTTLE(5.0, "%s: bad message in the ring: %s", topic.c_str(), e.what());
+                                continue;
+                            }
+                            ring.endRead();
+                            push(msg);
+                        }
+                    }
+                    ring.close();
+                }
+
+                /// \brief subscribes over ROS and starts looking for the ring
+                void start(bool shm)
+                {
+                    subscribeRos();
+                    if (shm)
+                    {
+                        running = true;
+                        thread = std::thread(&Impl::read, this);
+                    }
+                }
+
+                /// \brief stops reading and unsubscribes
+                void stop()
+                {
+                    running = false;
+                    if (thread.joinable())
+                    {
+                        thread.join();
+                    }
+                    unsubscribeRos();
+                    queue->removeByID(reinterpret_cast<uint64_t>(this));
+                }
+
+                ~Impl()
+                {
+                    stop();
+                }
+            };
+
+            std::shared_ptr<Impl> impl;
+
+        public:
+            /// \brief create a subscriber that receives nothing
+            ShmSubscriber() = default;
+
+            /// \brief subscribes to a topic
+            /// \param n - the node handle, its callback queue runs the callback
+            /// \param topic - the topic
+            /// \param queueSize - messages kept waiting for the callback, the oldest are dropped
+            /// \param callback - called with each message
+            /// \param shm - false to subscribe over ROS only
+            ShmSubscriber(ros::NodeHandle & n, const std::string & topic, uint32_t queueSize, const Callback & callback,
+                          bool shm)
+            {
+                impl = std::make_shared<Impl>();
+                impl->n = n;
+                impl->topic = topic;
+                impl->ringName = shmRingName(n.resolveName(topic));
+                impl->queueSize = queueSize > 0 ? queueSize : 1;
+                impl->callback = callback;
+                impl->queue = n.getCallbackQueue() ? n.getCallbackQueue() : ros::getGlobalCallbackQueue();
+                impl->start(shm);
+            }
+
+            /// \brief stops receiving messages, for every copy of the subscriber
+            void shutdown()
+            {
+                if (impl)
+                {
+                    impl->stop();
+                }
+            }
+
+            /// \brief returns the number of publishers connected over ROS
+            uint32_t getNumPublishers() const
+            {
+                if (!impl)
+                {
+                    return 0;
+                }
+                std::lock_guard<std::mutex> lock(impl->mutex);
+                return impl->sub.getNumPublishers();
+            }
+    };
+}
+
+#endif
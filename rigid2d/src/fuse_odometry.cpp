@@ -0,0 +1,155 @@
+/// \file fuse_odometry.cpp
+/// \brief contains a node called fuse_odometry that fuses the gyro of an IMU with the wheel odometry
+/// and publishes the fused odometry at IMU rate
+///
+/// PARAMETERS:
+///     wheel_base (double) : The distance between wheels
+///     wheel_radius (double)   : The radius of both wheels
+///     odom_frame_id   : The name of the odometry tf frame
+///     body_frame_id   : The name of the body tf frame
+///     fusion_heading_gain (double)    : Fraction of the difference to the wheel heading corrected per joint state (default 0.01)
+///     fusion_bias_gain (double)   : Gain of the gyro bias estimate while driving (default 0.002)
+///     fusion_still_bias_gain (double) : Gain of the gyro bias estimate while standing still (default 0.05)
+///     fusion_slip_rate (double)   : Wheel / gyro yaw rate disagreement (rad/s) treated as wheel slip (default 0.5)
+/// PUBLISHES: fused_odom (nav_msgs/Odometry)
+/// SUBSCRIBES: imu (sensor_msgs/Imu)
+///             joint_states (sensor_msgs/JointState)
+///
+/// The heading is propagated on every IMU message and the odometry is sent right after, so the
+/// fused odometry comes out at IMU rate. Joint states correct the gyro bias and advance the position.
+
+#include <ros/ros.h>
+
+#include <nav_msgs/Odometry.h>
+#include <geometry_msgs/Quaternion.h>
+#include <tf2/LinearMath/Quaternion.h>
+#include <tf2_geometry_msgs/tf2_geometry_msgs.h>
+#include <sensor_msgs/JointState.h>
+#include <sensor_msgs/Imu.h>
+
+#include <rigid2d/rigid2d.hpp>
+#include <rigid2d/odom_fusion.hpp>
+
+#include <string>
+
+/****************************
+* Declare global variables
+****************************/
+static ros::Publisher fused_pub;
+static rigid2d::OdomFusion fusion;
+static nav_msgs::Odometry fused_msg;
+
+static ros::Time last_imu_stamp;
+static ros::Time last_joint_stamp;
+static bool first_imu = true;
+static bool first_joint_state = true;
+
+/****************************
+* Declare helper funcions
+****************************/
+void imuCallback(const sensor_msgs::Imu::ConstPtr & msg);
+void jointStateCallback(const sensor_msgs::JointState::ConstPtr & msg);
+
+/****************************
+* Main Function
+****************************/
+int main(int argc, char* argv[])
+{
+    using namespace rigid2d;
+
+    /****************************
+    * Initialize the node & node handle
+    ****************************/
+    ros::init(argc, argv, "fuse_odometry");
+    ros::NodeHandle n;
+
+    /****************************
+    * Reading parameters from parameter server
+    ****************************/
+    double wheelBase = 0.0, wheelRad = 0.0;
+    double headingGain = 0.01, biasGain = 0.002, stillBiasGain = 0.05, slipRate = 0.5;
+    std::string odom_frame_id, body_frame_id;
+    int frequency = 100;
+
+    n.getParam("wheel_base", wheelBase);
+    n.getParam("wheel_radius", wheelRad);
+    n.getParam("odom_frame_id", odom_frame_id);
+    n.getParam("body_frame_id", body_frame_id);
+    n.getParam("fusion_heading_gain", headingGain);
+    n.getParam("fusion_bias_gain", biasGain);
+    n.getParam("fusion_still_bias_gain", stillBiasGain);
+    n.getParam("fusion_slip_rate", slipRate);
+
+    fusion = OdomFusion(wheelBase, wheelRad, headingGain, biasGain, stillBiasGain, slipRate);
+
+    fused_msg.header.frame_id = odom_frame_id;
+    fused_msg.child_frame_id = body_frame_id;
+
+    /****************************
+    * Define publisher and subscribers
+    ****************************/
+    fused_pub = n.advertise<nav_msgs::Odometry>("fused_odom", frequency);
+
+    ros::Subscriber imu_sub = n.subscribe("imu", frequency, imuCallback);
+    ros::Subscriber joint_sub = n.subscribe("joint_states", frequency, jointStateCallback);
+
+    ros::spin();
+    return 0;
+}
+
+/// \brief callback function for subscriber to the imu message
+/// Propagates the heading with the gyro and sends the fused odometry
+/// \param msg : the imu message
+void imuCallback(const sensor_msgs::Imu::ConstPtr & msg)
+{
+    ros::Time stamp = msg->header.stamp.isZero() ? ros::Time::now() : msg->header.stamp;
+
+    if (first_imu)
+    {
+        first_imu = false;
+        last_imu_stamp = stamp;
+        return;
+    }
+
+    fusion.imuUpdate(msg->angular_velocity.z, (stamp - last_imu_stamp).toSec());
+    last_imu_stamp = stamp;
+
+    /***********************
+    * Refresh and send the fused odometry
+    ***********************/
+    tf2::Quaternion fused_quater;
+    fused_quater.setRPY(0, 0, fusion.getTh());
+
+    fused_msg.header.stamp = stamp;
+    fused_msg.pose.pose.position.x = fusion.getX();
+    fused_msg.pose.pose.position.y = fusion.getY();
+    fused_msg.pose.pose.orientation = tf2::toMsg(fused_quater);
+    fused_msg.twist.twist.linear.x = fusion.getTwist().dx;
+    fused_msg.twist.twist.angular.z = fusion.getTwist().dth;
+
+    fused_pub.publish(fused_msg);
+}
+
+/// \brief callback function for subscriber to joint state message
+/// Corrects the gyro bias and advances the position with the new wheel angles
+/// \param msg : the joint state message
+void jointStateCallback(const sensor_msgs::JointState::ConstPtr & msg)
+{
+    if (msg->position.size() < 2)
+    {
+        return;
+    }
+
+    ros::Time stamp = msg->header.stamp.isZero() ? ros::Time::now() : msg->header.stamp;
+    double dt = first_joint_state ? 0.0 : (stamp - last_joint_stamp).toSec();
+
+    fusion.wheelUpdate(msg->position[0], msg->position[1], dt);
+
+    if (fusion.isSlipping())
+    {
+        ROS_DEBUG("fuse_odometry: wheel slip detected, bias %f", fusion.getBias());
+    }
+
+    first_joint_state = false;
+    last_joint_stamp = stamp;
+}
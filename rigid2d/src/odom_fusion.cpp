@@ -0,0 +1,162 @@
+#include "rigid2d/odom_fusion.hpp"
+#include "rigid2d/rigid2d.hpp"
+#include <cmath>
+
+namespace rigid2d
+{
+    OdomFusion::OdomFusion()
+        : OdomFusion(0.0, 0.0, 0.0, 0.0, 0.0, 0.0)
+    {
+    }
+
+    OdomFusion::OdomFusion(double base, double rad, double kHeading, double kBias, double kBiasStill, double slipRate)
+    {
+        wheelBase = base;
+        wheelRad = rad;
+        headingGain = kHeading;
+        biasGain = kBias;
+        stillBiasGain = kBiasStill;
+        slipThreshold = slipRate;
+
+        x = 0.0;
+        y = 0.0;
+        th = 0.0;
+        bias = 0.0;
+
+        thL = 0.0;
+        thR = 0.0;
+        wheelsInit = false;
+
+        thWheels = 0.0;
+        thAtWheels = 0.0;
+        gyroDth = 0.0;
+        gyroTime = 0.0;
+        slipping = false;
+
+        twist.dth = 0.0;
+        twist.dx = 0.0;
+        twist.dy = 0.0;
+    }
+
+    void OdomFusion::imuUpdate(double gyroZ, double dt)
+    {
+        if (dt <= 0.0)
+        {
+            return;
+        }
+
+        double w = gyroZ - bias;
+
+        th += w * dt;
+        gyroDth += w * dt;
+        gyroTime += dt;
+        twist.dth = w;
+    }
+
+    void OdomFusion::wheelUpdate(double thLnew, double thRnew, double dt)
+    {
+        if (!wheelsInit)
+        {
+            thL = thLnew;
+            thR = thRnew;
+            thWheels = th;
+            thAtWheels = th;
+            gyroDth = 0.0;
+            gyroTime = 0.0;
+            wheelsInit = true;
+            return;
+        }
+
+        // Find change in wheel angles
+        double dUL = thLnew - thL;
+        double dUR = thRnew - thR;
+
+        double wheelDth = (wheelRad / wheelBase) * (dUR - dUL);
+        double ds = (wheelRad / 2) * (dUL + dUR);
+
+        // Correct the gyro with the wheels, unless they disagree enough to be slipping
+        slipping = false;
+        if (gyroTime > 0.0)
+        {
+            double rateErr = (gyroDth - wheelDth) / gyroTime;
+            bool still = (dUL == 0.0) && (dUR == 0.0);
+
+            if (!still && (std::fabs(rateErr) > slipThreshold))
+            {
+                slipping = true;
+                thWheels += gyroDth;
+            } else
+            {
+                thWheels += wheelDth;
+                bias += (still ? stillBiasGain : biasGain) * rateErr;
+            }
+            th += headingGain * (thWheels - th);
+        } else
+        {
+            // no gyro readings since the last wheel update, fall back to the wheels
+            thWheels += wheelDth;
+            th += wheelDth;
+        }
+
+        // Lay the wheel travel along the average heading over the update
+        double thMid = thAtWheels + (th - thAtWheels) / 2.0;
+        x += ds * std::cos(thMid);
+        y += ds * std::sin(thMid);
+
+        if (dt > 0.0)
+        {
+            twist.dx = ds / dt;
+            if (gyroTime <= 0.0)
+            {
+                twist.dth = wheelDth / dt;
+            }
+        }
+
+        thL = thLnew;
+        thR = thRnew;
+        thAtWheels = th;
+        gyroDth = 0.0;
+        gyroTime = 0.0;
+    }
+
+    void OdomFusion::setPose(double xx, double yy, double theta)
+    {
+        x = xx;
+        y = yy;
+        th = theta;
+        thWheels = theta;
+        thAtWheels = theta;
+        gyroDth = 0.0;
+        gyroTime = 0.0;
+    }
+
+    const double& OdomFusion::getX() const
+    {
+        return x;
+    }
+
+    const double& OdomFusion::getY() const
+    {
+        return y;
+    }
+
+    double OdomFusion::getTh() const
+    {
+        return normalize_angle(th);
+    }
+
+    const double& OdomFusion::getBias() const
+    {
+        return bias;
+    }
+
+    const Twist2D& OdomFusion::getTwist() const
+    {
+        return twist;
+    }
+
+    bool OdomFusion::isSlipping() const
+    {
+        return slipping;
+    }
+}
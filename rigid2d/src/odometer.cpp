@@ -8,9 +8,15 @@
 ///     body_frame_id   : The name of the body tf frame
 ///     left_wheel_joint    : The name of the left wheel joint
 ///     right_wheel_joint   : The name of the right wheel joint
+///     publish_rate (double)   : Rate (Hz) of the odom message and tf broadcast, 0 publishes on every joint state (default 0)
+///     pose_covariance (double[6]) : Diagonal of the pose covariance (x, y, z, roll, pitch, yaw)
+///     twist_covariance (double[6])    : Diagonal of the twist covariance (vx, vy, vz, wx, wy, wz)
 /// PUBLISHES: odom (nav_msgs/Odometry)
 /// SUBSCRIBES: joint_states (sensor_msgs/JointState)
 /// SERVICES: set_pose : Sets the pose of the turtlebot's configuration
+///
+/// The configuration is integrated on every joint state message. The odometry message and transform
+/// are allocated once and only their numeric fields are refreshed when they are published.
 
 #include <ros/ros.h>
 
@@ -28,28 +34,39 @@
 #include <rigid2d/diff_drive.hpp>
 
 #include <string>
+#include <vector>
 #include <iostream>
 
 /****************************
 * Declare global variables
 ****************************/
-static sensor_msgs::JointState joint_msg;
 static std::string odom_frame_id, body_frame_id, left_wheel_joint, right_wheel_joint;
 static ros::Publisher odom_pub;
 static ros::ServiceServer setPose_service;
-static ros::ServiceClient setPose_client;
-
-// static tf::TransformBroadcaster odom_broadcaster;
 
 static double wheelBase, wheelRad;
 static int frequency = 100;
 
 static rigid2d::DiffDrive odom_diffdrive;
 
+/****************************
+* Preallocated messages, reused for every publish
+****************************/
+static nav_msgs::Odometry odom_msg;
+static geometry_msgs::TransformStamped odom_trans;
+
+static ros::Time last_stamp;
+static ros::Time odom_stamp;
+static bool first_joint_state = true;
+static bool odom_updated = false;
+static bool decimate = false;
+
 /****************************
 * Declare helper funcions
 ****************************/
-void jointStateCallback(const sensor_msgs::JointState msg);
+void jointStateCallback(const sensor_msgs::JointState::ConstPtr & msg);
+void publishTimer(const ros::TimerEvent & event);
+void publishOdometry();
 bool setPose(rigid2d::set_pose::Request & req, rigid2d::set_pose::Response &res);
 
 /****************************
@@ -68,60 +85,131 @@ int main(int argc, char* argv[])
     /****************************
     * Reading parameters from parameter server
     ****************************/
+    double publishRate = 0.0;
+    std::vector<double> poseCov(6, 0.0), twistCov(6, 0.0);
+
     n.getParam("wheel_base", wheelBase);
     n.getParam("wheel_radius", wheelRad);
     n.getParam("odom_frame_id", odom_frame_id);
     n.getParam("body_frame_id", body_frame_id);
     n.getParam("left_wheel_joint", left_wheel_joint);
     n.getParam("right_wheel_joint", right_wheel_joint);
+    n.getParam("publish_rate", publishRate);
+    n.getParam("pose_covariance", poseCov);
+    n.getParam("twist_covariance", twistCov);
+
+    /****************************
+    * Fill in the parts of the messages that never change
+    ****************************/
+    odom_msg.header.frame_id = odom_frame_id;
+    odom_msg.child_frame_id = body_frame_id;
+    odom_msg.pose.pose.position.z = 0.0;
+    odom_msg.twist.twist.linear.z = 0.0;
+    odom_msg.twist.twist.angular.x = 0.0;
+    odom_msg.twist.twist.angular.y = 0.0;
+
+    for (int i = 0; (i < 6) && (i < int(poseCov.size())); ++i)
+    {
+        odom_msg.pose.covariance[7 * i] = poseCov[i];
+    }
+    for (int i = 0; (i < 6) && (i < int(twistCov.size())); ++i)
+    {
+        odom_msg.twist.covariance[7 * i] = twistCov[i];
+    }
+
+    odom_trans.header.frame_id = odom_frame_id;
+    odom_trans.child_frame_id = body_frame_id;
+    odom_trans.transform.translation.z = 0.0;
 
     /****************************
     * Define publisher, subscriber, services and clients
     ****************************/
     odom_pub = n.advertise<nav_msgs::Odometry>("odom", frequency);
     setPose_service = n.advertiseService("set_pose", setPose);
-    setPose_client = n.serviceClient<rigid2d::set_pose>("set_pose");
 
     ros::Subscriber joint_sub = n.subscribe("/joint_states", frequency, jointStateCallback);
-    ros::Rate loop_rate(frequency);
+
+    /****************************
+    * Publish at a fixed rate, decoupled from integration, if a publish rate is given
+    ****************************/
+    ros::Timer publish_timer;
+    if (publishRate > 0.0)
+    {
+        decimate = true;
+        publish_timer = n.createTimer(ros::Duration(1.0 / publishRate), publishTimer);
+    }
 
     /****************************
     * Set initial parameters of the differential drive robot to 0
     ****************************/
     odom_diffdrive = DiffDrive(wheelBase, wheelRad, 0.0, 0.0, 0.0, 0.0, 0.0);
 
-    while (ros::ok())
-    {
-        ros::spinOnce();
-
-        loop_rate.sleep();
-    }
+    ros::spin();
     return 0;
 }
 
 /// \brief callback function for subscriber to joint state message
-/// Sends an odometry message and broadcasts a tf transform to update the configuration of the robot
+/// Integrates the new wheel angles and updates the body twist. Sends an odometry message and
+/// broadcasts a tf transform right away unless publishing is decimated.
 ///
 /// \param msg : the joint state message
-void jointStateCallback(const sensor_msgs::JointState msg)
+void jointStateCallback(const sensor_msgs::JointState::ConstPtr & msg)
 {
     using namespace rigid2d;
 
-    static tf2_ros::TransformBroadcaster odom_broadcaster;
+    if (msg->position.size() < 2)
+    {
+        return;
+    }
 
-    ros::Time current_time = ros::Time::now();
+    ros::Time stamp = msg->header.stamp.isZero() ? ros::Time::now() : msg->header.stamp;
 
     /***********************
-    * Get the velocities from new wheel angles and update configuration
+    * Get the wheel displacement twist and update configuration
     ***********************/
-    Twist2D twist_vel = odom_diffdrive.getTwist(msg.position[0], msg.position[1]);
+    Twist2D twist_delta = odom_diffdrive.getTwist(msg->position[0], msg->position[1]);
 
-    odom_diffdrive(msg.position[0], msg.position[1]);
+    odom_diffdrive(msg->position[0], msg->position[1]);
+
+    /***********************
+    * Convert the displacement into a body velocity
+    ***********************/
+    double dt = (stamp - last_stamp).toSec();
+    if (!first_joint_state && (dt > 0.0))
+    {
+        odom_msg.twist.twist.linear.x = twist_delta.dx / dt;
+        odom_msg.twist.twist.linear.y = twist_delta.dy / dt;
+        odom_msg.twist.twist.angular.z = twist_delta.dth / dt;
+    }
+    first_joint_state = false;
+    last_stamp = stamp;
+    odom_stamp = stamp;
+    odom_updated = true;
+
+    if (!decimate)
+    {
+        publishOdometry();
+    }
+}
+
+/// \brief timer callback that publishes the latest odometry at the configured rate
+/// \param event : the timer event
+void publishTimer(const ros::TimerEvent & event)
+{
+    if (odom_updated)
+    {
+        publishOdometry();
+    }
+}
+
+/// \brief refreshes the preallocated odometry message and transform and sends them
+void publishOdometry()
+{
+    static tf2_ros::TransformBroadcaster odom_broadcaster;
 
     /***********************
     * Create a quaternion from yaw
     ***********************/
-    // geometry_msgs::Quaternion odom_quat = tf::createQuaternionMsgFromYaw(odom_diffdrive.getTh());
     tf2::Quaternion odom_quater;
     odom_quater.setRPY(0, 0, odom_diffdrive.getTh());
 
@@ -130,14 +218,9 @@ void jointStateCallback(const sensor_msgs::JointState msg)
     /***********************
     * Publish the transform over tf
     ***********************/
-    geometry_msgs::TransformStamped odom_trans;
-    odom_trans.header.stamp = current_time;
-    odom_trans.header.frame_id = odom_frame_id;
-    odom_trans.child_frame_id = body_frame_id;
-
+    odom_trans.header.stamp = odom_stamp;
     odom_trans.transform.translation.x = odom_diffdrive.getX();
     odom_trans.transform.translation.y = odom_diffdrive.getY();
-    odom_trans.transform.translation.z = 0.0;
     odom_trans.transform.rotation = odom_quat;
 
     odom_broadcaster.sendTransform(odom_trans);
@@ -145,22 +228,14 @@ void jointStateCallback(const sensor_msgs::JointState msg)
     /***********************
     * Publish the odometry message over ROS
     ***********************/
-    nav_msgs::Odometry odom_msg;
-    odom_msg.header.stamp = current_time;
-    odom_msg.header.frame_id = odom_frame_id;
+    odom_msg.header.stamp = odom_stamp;
     odom_msg.pose.pose.position.x = odom_diffdrive.getX();
     odom_msg.pose.pose.position.y = odom_diffdrive.getY();
-    odom_msg.pose.pose.position.z = 0.0;
     odom_msg.pose.pose.orientation = odom_quat;
 
-    odom_msg.child_frame_id = body_frame_id;
-    odom_msg.twist.twist.linear.x = twist_vel.dx;
-    odom_msg.twist.twist.linear.y = twist_vel.dy;
-    odom_msg.twist.twist.linear.z = twist_vel.dth;
-
     odom_pub.publish(odom_msg);
 
-    return ;
+    odom_updated = false;
 }
 
 /// \brief setPose function for set_pose service
@@ -182,9 +257,11 @@ bool setPose(rigid2d::set_pose::Request &req, rigid2d::set_pose::Response &res)
 
     /****************************
     * Location of odometry reset so robot is at requested location
-    * Replaces odom_diffdrive with a new configuration
+    * Replaces odom_diffdrive with a new configuration, keeping the current wheel angles
+    * so the next joint state does not look like a jump
     ****************************/
-    odom_diffdrive = DiffDrive(wheelBase, wheelRad, xNew, yNew, thNew, 0.0, 0.0);
+    odom_diffdrive = DiffDrive(wheelBase, wheelRad, xNew, yNew, thNew, odom_diffdrive.getThL(), odom_diffdrive.getThR());
+    odom_updated = true;
 
     return true;
-}
\ No newline at end of file
+}
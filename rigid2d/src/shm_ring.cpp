@@ -0,0 +1,491 @@
+/// \file shm_ring.cpp
+/// \brief a ring of preallocated slots in POSIX shared memory, with one writer and reference counted readers
+
+#include "rigid2d/shm_ring.hpp"
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace rigid2d
+{
+    namespace
+    {
+        /// \brief the magic at the start of every ring
+        const char RING_MAGIC[8] = {'R', 'I', 'G', 'I', 'D', 'S', 'H', 'M'};
+
+        /// \brief rounds up to a multiple of 64 bytes, a cache line
+        size_t roundLine(size_t bytes)
+        {
+            return (bytes + 63) & ~static_cast<size_t>(63);
+        }
+
+        /// \brief byte offset of the index
+        size_t indexOffset(uint32_t numReaders)
+        {
+            return sizeof(ShmRingHeader) + numReaders * sizeof(ShmReaderEntry);
+        }
+
+        /// \brief byte offset of the first slot header
+        size_t slotsOffset(uint32_t numReaders, uint32_t numSlots)
+        {
+            return roundLine(indexOffset(numReaders) + numSlots * sizeof(uint64_t));
+        }
+
+        /// \brief bytes from one slot header to the next
+        size_t slotStride(uint32_t slotSize)
+        {
+            return sizeof(ShmSlotHeader) + roundLine(slotSize);
+        }
+
+        /// \brief the size of a ring
+        size_t ringBytes(uint32_t numReaders, uint32_t numSlots, uint32_t slotSize)
+        {
+            return slotsOffset(numReaders, numSlots) + numSlots * slotStride(slotSize);
+        }
+
+        /// \brief returns true if the process has exited
+        bool processGone(int32_t pid)
+        {
+            return kill(pid, 0) != 0 && errno == ESRCH;
+        }
+
+        /// \brief the futex word readers sleep on, the kernel only sees its 32 bits
+        uint32_t * futexWord(std::atomic<uint32_t> & word)
+        {
+            return reinterpret_cast<uint32_t *>(&word);
+        }
+    }
+
+    ShmRing::ShmRing()
+        : data(nullptr), length(0), writer(false), header(nullptr), readers(nullptr), index(nullptr), slots(nullptr),
+          stride(0), seq(0), current(0), busy(false), lost(0), readerEntry(-1)
+    {
+    }
+
+    ShmRing::~ShmRing()
+    {
+        close();
+    }
+
+    ShmSlotHeader & ShmRing::slot(uint32_t k) const
+    {
+        return *reinterpret_cast<ShmSlotHeader *>(slots + k * stride);
+    }
+
+    bool ShmRing::map(int fd, size_t bytes, std::string & error)
+    {
+        void * mapped = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (mapped == MAP_FAILED)
+        {
+            error = "could not map " + name + ": " + std::strerror(errno);
+            return false;
+        }
+        data = mapped;
+        length = bytes;
+        header = static_cast<ShmRingHeader *>(data);
+        return true;
+    }
+
+    void ShmRing::locate()
+    {
+        uint8_t * base = static_cast<uint8_t *>(data);
+        readers = reinterpret_cast<ShmReaderEntry *>(base + sizeof(ShmRingHeader));
+        index = reinterpret_cast<std::atomic<uint64_t> *>(base + indexOffset(header->numReaders));
+        slots = base + slotsOffset(header->numReaders, header->numSlots);
+        stride = slotStride(header->slotSize);
+    }
+
+    bool ShmRing::registerReader()
+    {
+        const int32_t pid = getpid();
+        for (int attempt = 0; attempt < 2; ++attempt)
+        {
+            for (uint32_t e = 0; e < header->numReaders; ++e)
+            {
+                int32_t expected = 0;
+                if (readers[e].pid.compare_exchange_strong(expected, pid, std::memory_order_acq_rel))
+                {
+                    readerEntry = e;
+                    return true;
+                }
+            }
+            reclaimReaders();
+        }
+        return false;
+    }
+
+    bool ShmRing::create(const std::string & ringName, uint32_t numSlots, uint32_t slotSize, std::string & error)
+    {
+        close();
+        if (numSlots == 0 || numSlots > 0xffff || slotSize == 0)
+        {
+            error = "a ring needs 1 to 65535 slots of at least a byte";
+            return false;
+        }
+        name = ringName;
+
+        int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0 && errno == EEXIST)
+        {
+            // left behind by a writer that crashed, or in use by a live one
+            ShmRing other;
+            std::string otherError;
+            if (other.attach(ringName, otherError) && !other.writerGone())
+            {
+                error = ringName + " already has a writer";
+                return false;
+            }
+            other.close();
+            shm_unlink(name.c_str());
+            fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        }
+        if (fd < 0)
+        {
+            error = "could not create " + name + ": " + std::strerror(errno);
+            return false;
+        }
+
+        const size_t bytes = ringBytes(SHM_RING_READERS, numSlots, slotSize);
+        if (ftruncate(fd, bytes) != 0)
+        {
+            error = "could not size " + name + ": " + std::strerror(errno);
+            ::close(fd);
+            shm_unlink(name.c_str());
+            return false;
+        }
+        const bool mapped = map(fd, bytes, error);
+        ::close(fd);
+        if (!mapped)
+        {
+            shm_unlink(name.c_str());
+            return false;
+        }
+
+        // the segment starts zeroed, only the sizes need to be filled in
+        std::memcpy(header->magic, RING_MAGIC, sizeof(RING_MAGIC));
+        header->numSlots = numSlots;
+        header->slotSize = slotSize;
+        header->writerPid = getpid();
+        header->numReaders = SHM_RING_READERS;
+        locate();
+        header->version.store(SHM_RING_VERSION, std::memory_order_release);
+
+        writer = true;
+        seq = 0;
+        current = numSlots - 1;
+        busy = false;
+        lost = 0;
+        return true;
+    }
+
+    bool ShmRing::attach(const std::string & ringName, std::string & error)
+    {
+        close();
+        name = ringName;
+
+        const int fd = shm_open(name.c_str(), O_RDWR, 0);
+        if (fd < 0)
+        {
+            error = "could not open " + name + ": " + std::strerror(errno);
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(ShmRingHeader))
+        {
+            error = name + " is not initialized yet";
+            ::close(fd);
+            return false;
+        }
+        const bool mapped = map(fd, st.st_size, error);
+        ::close(fd);
+        if (!mapped)
+        {
+            return false;
+        }
+
+        if (std::memcmp(header->magic, RING_MAGIC, sizeof(RING_MAGIC)) != 0
+            || header->version.load(std::memory_order_acquire) != SHM_RING_VERSION
+            || header->numSlots == 0 || header->numSlots > 0xffff || header->numReaders > 0xffff
+            || ringBytes(header->numReaders, header->numSlots, header->slotSize) != length)
+        {
+            error = name + " is not an initialized ring of version " + std::to_string(SHM_RING_VERSION);
+            close();
+            return false;
+        }
+
+        locate();
+        if (!registerReader())
+        {
+            error = name + " already has " + std::to_string(header->numReaders) + " readers";
+            close();
+            return false;
+        }
+
+        writer = false;
+        seq = header->writeSeq.load(std::memory_order_acquire) + 1;
+        busy = false;
+        lost = 0;
+        return true;
+    }
+
+    void ShmRing::close()
+    {
+        if (!data)
+        {
+            return;
+        }
+        if (writer)
+        {
+            if (busy)
+            {
+                slot(current).refs.fetch_sub(WRITER_BIT, std::memory_order_release);
+            }
+            header->closed.store(1, std::memory_order_seq_cst);
+            header->wakeups.fetch_add(1, std::memory_order_seq_cst);
+            syscall(SYS_futex, futexWord(header->wakeups), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+            shm_unlink(name.c_str());
+        } else
+        {
+            if (busy)
+            {
+                endRead();
+            }
+            if (readerEntry >= 0)
+            {
+                readers[readerEntry].pid.store(0, std::memory_order_release);
+            }
+        }
+
+        munmap(data, length);
+        data = nullptr;
+        length = 0;
+        header = nullptr;
+        readers = nullptr;
+        index = nullptr;
+        slots = nullptr;
+        writer = false;
+        busy = false;
+        readerEntry = -1;
+    }
+
+    bool ShmRing::isOpen() const
+    {
+        return data != nullptr;
+    }
+
+    uint32_t ShmRing::slotSize() const
+    {
+        return header ? header->slotSize : 0;
+    }
+
+    uint8_t * ShmRing::beginWrite(uint32_t size)
+    {
+        if (!writer || busy || size > header->slotSize)
+        {
+            return nullptr;
+        }
+
+        // the slot after the last one written is the oldest, readers rarely hold it
+        const uint32_t n = header->numSlots;
+        for (int attempt = 0; attempt < 2; ++attempt)
+        {
+            for (uint32_t i = 1; i <= n; ++i)
+            {
+                const uint32_t k = (current + i) % n;
+                uint32_t expected = 0;
+                if (slot(k).refs.compare_exchange_strong(expected, WRITER_BIT, std::memory_order_acquire))
+                {
+                    ShmSlotHeader & s = slot(k);
+                    s.seq.store(0, std::memory_order_relaxed);
+                    s.size = size;
+                    current = k;
+                    busy = true;
+                    return reinterpret_cast<uint8_t *>(&s) + sizeof(ShmSlotHeader);
+                }
+            }
+
+            // every slot is held, perhaps by readers that died while reading
+            if (reclaimReaders() == 0)
+            {
+                break;
+            }
+        }
+        return nullptr;
+    }
+
+    void ShmRing::endWrite()
+    {
+        if (!writer || !busy)
+        {
+            return;
+        }
+        const uint64_t next = seq + 1;
+
+        ShmSlotHeader & s = slot(current);
+        s.seq.store(next, std::memory_order_relaxed);
+        s.refs.fetch_sub(WRITER_BIT, std::memory_order_release);
+
+        index[next % header->numSlots].store((next << 16) | current, std::memory_order_release);
+        header->writeSeq.store(next, std::memory_order_release);
+        seq = next;
+        busy = false;
+
+        // the readers check for new messages before they sleep, so one that missed it sees wakeups change
+        header->wakeups.fetch_add(1, std::memory_order_seq_cst);
+        if (header->sleepers.load(std::memory_order_seq_cst) > 0)
+        {
+            syscall(SYS_futex, futexWord(header->wakeups), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+        }
+    }
+
+    bool ShmRing::beginRead(const uint8_t *& bytes, uint32_t & size)
+    {
+        if (!data || writer || busy)
+        {
+            return false;
+        }
+
+        const uint32_t n = header->numSlots;
+        while (true)
+        {
+            const uint64_t latest = header->writeSeq.load(std::memory_order_acquire);
+            if (seq > latest)
+            {
+                return false;
+            }
+            if (latest - seq >= n)
+            {
+                // the index only remembers the last n messages
+                lost += latest - n + 1 - seq;
+                seq = latest - n + 1;
+            }
+
+            const uint64_t entry = index[seq % n].load(std::memory_order_acquire);
+            if ((entry >> 16) < seq)
+            {
+                return false;
+            }
+            const uint32_t k = entry & 0xffff;
+            if ((entry >> 16) == seq && k < n)
+            {
+                // counted in refs, the slot cannot be claimed, so it holds seq until endRead if it does now
+                ShmSlotHeader & s = slot(k);
+                const uint32_t refs = s.refs.fetch_add(1, std::memory_order_acquire);
+                if (!(refs & WRITER_BIT) && s.seq.load(std::memory_order_acquire) == seq)
+                {
+                    readers[readerEntry].held.store(k + 1, std::memory_order_release);
+                    current = k;
+                    busy = true;
+                    bytes = reinterpret_cast<const uint8_t *>(&s) + sizeof(ShmSlotHeader);
+                    size = s.size;
+                    return true;
+                }
+                s.refs.fetch_sub(1, std::memory_order_release);
+            }
+
+            // overwritten before it was read
+            ++lost;
+            ++seq;
+        }
+    }
+
+    void ShmRing::endRead()
+    {
+        if (writer || !busy)
+        {
+            return;
+        }
+        // forgotten before it is released, so a reclaim never releases it twice
+        readers[readerEntry].held.store(0, std::memory_order_release);
+        slot(current).refs.fetch_sub(1, std::memory_order_release);
+        ++seq;
+        busy = false;
+    }
+
+    bool ShmRing::wait(int timeoutMs)
+    {
+        if (!data || writer)
+        {
+            return false;
+        }
+
+        const uint32_t wakeups = header->wakeups.load(std::memory_order_seq_cst);
+        if (seq <= header->writeSeq.load(std::memory_order_acquire))
+        {
+            return true;
+        }
+        if (writerGone())
+        {
+            return false;
+        }
+
+        timespec timeout;
+        timeout.tv_sec = timeoutMs / 1000;
+        timeout.tv_nsec = (timeoutMs % 1000) * 1000000L;
+
+        // returns at once if a message came since wakeups was read
+        header->sleepers.fetch_add(1, std::memory_order_seq_cst);
+        syscall(SYS_futex, futexWord(header->wakeups), FUTEX_WAIT, wakeups, &timeout, nullptr, 0);
+        header->sleepers.fetch_sub(1, std::memory_order_seq_cst);
+
+        return seq <= header->writeSeq.load(std::memory_order_acquire);
+    }
+
+    bool ShmRing::writerGone() const
+    {
+        if (!header)
+        {
+            return true;
+        }
+        if (header->closed.load(std::memory_order_acquire))
+        {
+            return true;
+        }
+        return processGone(header->writerPid);
+    }
+
+    uint64_t ShmRing::lostMessages() const
+    {
+        return lost;
+    }
+
+    uint32_t ShmRing::reclaimReaders()
+    {
+        if (!data)
+        {
+            return 0;
+        }
+
+        uint32_t freed = 0;
+        for (uint32_t e = 0; e < header->numReaders; ++e)
+        {
+            int32_t pid = readers[e].pid.load(std::memory_order_acquire);
+            if (pid <= 0 || !processGone(pid))
+            {
+                continue;
+            }
+
+            // only the one that marks the entry gives back its slot
+            if (!readers[e].pid.compare_exchange_strong(pid, -1, std::memory_order_acq_rel))
+            {
+                continue;
+            }
+            const uint32_t held = readers[e].held.exchange(0, std::memory_order_acq_rel);
+            if (held > 0 && held <= header->numSlots)
+            {
+                slot(held - 1).refs.fetch_sub(1, std::memory_order_release);
+            }
+            readers[e].pid.store(0, std::memory_order_release);
+            ++freed;
+        }
+        return freed;
+    }
+}
@@ -0,0 +1,177 @@
+#include <catch_ros/catch.hpp>
+#include <rigid2d/rigid2d.hpp>
+#include <rigid2d/diff_drive.hpp>
+#include <rigid2d/odom_fusion.hpp>
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+/// \brief the simulated robot of tube_world: the body follows the (noisy) command, the encoders
+/// see the true wheel rotation plus slip, and the gyro sees the true yaw rate plus bias and noise
+struct SimTurtle
+{
+    double base = 0.16;
+    double rad = 0.033;
+    double trueL = 0.0;
+    double trueR = 0.0;
+    double encL = 0.0;
+    double encR = 0.0;
+    double th = 0.0;
+    double gyroBias = 0.0;
+    std::mt19937 gen{42};
+    std::normal_distribution<> slip{0.0, 0.0};
+    std::normal_distribution<> gyroNoise{0.0, 0.0};
+
+    /// \brief drives the robot for one step
+    /// \param v - commanded forward speed
+    /// \param w - commanded yaw rate
+    /// \param dt - the length of the step
+    /// \return the gyro reading for the step
+    double step(double v, double w, double dt)
+    {
+        double uL = (v - w * base / 2.0) / rad;
+        double uR = (v + w * base / 2.0) / rad;
+
+        trueL += uL * dt;
+        trueR += uR * dt;
+        encL += uL * dt + uL * slip(gen);
+        encR += uR * dt + uR * slip(gen);
+        th += w * dt;
+
+        return w + gyroBias + gyroNoise(gen);
+    }
+};
+
+TEST_CASE("Fusion without slip or bias matches the wheel odometry", "[odom fusion]")
+{
+    using namespace rigid2d;
+
+    SimTurtle sim;
+    DiffDrive wheels(sim.base, sim.rad, 0.0, 0.0, 0.0, 0.0, 0.0);
+    OdomFusion fused(sim.base, sim.rad, 0.01, 0.002, 0.05, 0.5);
+    fused.wheelUpdate(0.0, 0.0, 0.0);
+
+    const double dt = 0.01;
+    for (int i = 0; i < 500; ++i)
+    {
+        double gyro = sim.step(0.1, 0.4, dt);
+        fused.imuUpdate(gyro, dt);
+        fused.wheelUpdate(sim.encL, sim.encR, dt);
+        wheels(sim.encL, sim.encR);
+    }
+
+    REQUIRE(fused.getTh() == Approx(wheels.getTh()).margin(1e-6));
+    REQUIRE(fused.getX() == Approx(wheels.getX()).margin(1e-3));
+    REQUIRE(fused.getY() == Approx(wheels.getY()).margin(1e-3));
+    REQUIRE(fused.getTwist().dx == Approx(0.1));
+    REQUIRE(fused.getTwist().dth == Approx(0.4));
+}
+
+TEST_CASE("Without gyro readings the fusion falls back to the wheels", "[odom fusion]")
+{
+    using namespace rigid2d;
+
+    OdomFusion fused(2.0, 1.0, 0.01, 0.002, 0.05, 0.5);
+    fused.wheelUpdate(0.0, 0.0, 0.0);
+    fused.wheelUpdate(-PI / 4, PI / 4, 1.0);
+
+    REQUIRE(fused.getTh() == Approx(PI / 4));
+    REQUIRE(fused.getX() == Approx(0.0).margin(1e-9));
+    REQUIRE(fused.getY() == Approx(0.0).margin(1e-9));
+}
+
+TEST_CASE("The gyro bias is estimated standing still and refined while driving", "[odom fusion]")
+{
+    using namespace rigid2d;
+
+    SimTurtle sim;
+    sim.gyroBias = 0.05;
+    sim.gyroNoise = std::normal_distribution<>(0.0, 0.01);
+
+    OdomFusion fused(sim.base, sim.rad, 0.01, 0.002, 0.05, 0.5);
+    fused.wheelUpdate(0.0, 0.0, 0.0);
+
+    // gyro at 100 Hz, wheels at 10 Hz, standing still for the first 5 seconds
+    const double dt = 0.01;
+    for (int i = 0; i < 500; ++i)
+    {
+        fused.imuUpdate(sim.step(0.0, 0.0, dt), dt);
+        if (i % 10 == 9)
+        {
+            fused.wheelUpdate(sim.encL, sim.encR, 10 * dt);
+        }
+    }
+
+    REQUIRE(fused.getBias() == Approx(0.05).margin(0.005));
+
+    for (int i = 0; i < 30000; ++i)
+    {
+        double gyro = sim.step(0.1, 0.3 * sin(0.01 * i), dt);
+        fused.imuUpdate(gyro, dt);
+        if (i % 10 == 9)
+        {
+            fused.wheelUpdate(sim.encL, sim.encR, 10 * dt);
+        }
+    }
+
+    REQUIRE(fused.getBias() == Approx(0.05).margin(0.002));
+    REQUIRE(normalize_angle(fused.getTh() - sim.th) == Approx(0.0).margin(0.05));
+}
+
+TEST_CASE("Fusion keeps the heading when the wheels slip", "[odom fusion]")
+{
+    using namespace rigid2d;
+
+    SimTurtle sim;
+    sim.slip = std::normal_distribution<>(0.0, 0.002);
+    sim.gyroBias = 0.02;
+    sim.gyroNoise = std::normal_distribution<>(0.0, 0.01);
+
+    DiffDrive wheels(sim.base, sim.rad, 0.0, 0.0, 0.0, 0.0, 0.0);
+    OdomFusion fused(sim.base, sim.rad, 0.01, 0.002, 0.05, 0.5);
+    fused.wheelUpdate(0.0, 0.0, 0.0);
+
+    // gyro at 100 Hz, wheels at 10 Hz, standing still for the first 5 seconds
+    const double dt = 0.01;
+    double wheelErr = 0.0;
+    double fusedErr = 0.0;
+    for (int i = 0; i < 6500; ++i)
+    {
+        double gyro = (i < 500) ? sim.step(0.0, 0.0, dt) : sim.step(0.1, 0.5, dt);
+
+        // every 5 seconds the right wheel spins out for half a second
+        if ((i >= 500) && (i % 500 < 50))
+        {
+            sim.encR += 0.05;
+        }
+
+        fused.imuUpdate(gyro, dt);
+        if (i % 10 == 9)
+        {
+            fused.wheelUpdate(sim.encL, sim.encR, 10 * dt);
+            wheels(sim.encL, sim.encR);
+
+            wheelErr = std::max(wheelErr, std::fabs(normalize_angle(wheels.getTh() - sim.th)));
+            fusedErr = std::max(fusedErr, std::fabs(normalize_angle(fused.getTh() - sim.th)));
+        }
+    }
+    REQUIRE(std::fabs(normalize_angle(fused.getTh() - sim.th)) < 0.1);
+    REQUIRE(fusedErr < wheelErr / 5.0);
+    REQUIRE(fused.getBias() == Approx(0.02).margin(0.005));
+}
+
+TEST_CASE("A wheel update that disagrees with the gyro is treated as slip", "[odom fusion]")
+{
+    using namespace rigid2d;
+
+    OdomFusion fused(0.16, 0.033, 0.5, 0.5, 0.5, 0.5);
+    fused.wheelUpdate(0.0, 0.0, 0.0);
+
+    // the gyro sees no rotation while one wheel spins in place
+    fused.imuUpdate(0.0, 0.1);
+    fused.wheelUpdate(0.0, 3.0, 0.1);
+
+    REQUIRE(fused.isSlipping());
+    REQUIRE(fused.getTh() == Approx(0.0).margin(1e-12));
+    REQUIRE(fused.getBias() == Approx(0.0).margin(1e-12));
+}
@@ -0,0 +1,299 @@
+#include <catch_ros/catch.hpp>
+#include <rigid2d/shm_ring.hpp>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+/// \brief a ring name no other test run uses
+static std::string testRing()
+{
+    return "/rigid2d_shm_ring_test_" + std::to_string(getpid());
+}
+
+/// \brief writes a message of size bytes, every byte the low byte of value
+static bool writeMessage(rigid2d::ShmRing & ring, uint32_t size, uint32_t value)
+{
+    uint8_t * bytes = ring.beginWrite(size);
+    if (!bytes)
+    {
+        return false;
+    }
+    std::memcpy(bytes, &value, sizeof(value));
+    std::memset(bytes + sizeof(value), value & 0xff, size - sizeof(value));
+    ring.endWrite();
+    return true;
+}
+
+/// \brief reads a message written by writeMessage, checking it is whole
+/// \return the value of the message, 0 if there is none
+static uint32_t readMessage(rigid2d::ShmRing & ring)
+{
+    const uint8_t * bytes;
+    uint32_t size;
+    if (!ring.beginRead(bytes, size))
+    {
+        return 0;
+    }
+    uint32_t value;
+    std::memcpy(&value, bytes, sizeof(value));
+    for (uint32_t i = sizeof(value); i < size; ++i)
+    {
+        if (bytes[i] != (value & 0xff))
+        {
+            ring.endRead();
+            return 0xffffffff;
+        }
+    }
+    ring.endRead();
+    return value;
+}
+
+TEST_CASE("Readers get the messages written after they attach, in order", "[shm ring]")
+{
+    using namespace rigid2d;
+
+    std::string error;
+    ShmRing writer;
+    REQUIRE(writer.create(testRing(), 4, 256, error));
+
+    // before any reader
+    REQUIRE(writeMessage(writer, 100, 1));
+
+    ShmRing reader1, reader2;
+    REQUIRE(reader1.attach(testRing(), error));
+    REQUIRE(reader2.attach(testRing(), error));
+    REQUIRE(!reader1.writerGone());
+    REQUIRE(readMessage(reader1) == 0);
+
+    for (uint32_t v = 2; v <= 4; ++v)
+    {
+        REQUIRE(writeMessage(writer, 8 + 50 * v, v));
+    }
+    for (uint32_t v = 2; v <= 4; ++v)
+    {
+        REQUIRE(readMessage(reader1) == v);
+    }
+    REQUIRE(readMessage(reader1) == 0);
+
+    // reader2 falls behind by more than the ring holds and loses the oldest
+    for (uint32_t v = 5; v <= 8; ++v)
+    {
+        REQUIRE(writeMessage(writer, 64, v));
+    }
+    for (uint32_t v = 5; v <= 8; ++v)
+    {
+        REQUIRE(readMessage(reader2) == v);
+    }
+    REQUIRE(reader2.lostMessages() == 3);
+    REQUIRE(readMessage(reader2) == 0);
+    REQUIRE(reader1.lostMessages() == 0);
+
+    // too large for a slot
+    REQUIRE(!writer.beginWrite(257));
+
+    // one writer at a time
+    ShmRing second;
+    REQUIRE(!second.create(testRing(), 4, 256, error));
+
+    // what was written before the writer went can still be read
+    writer.close();
+    REQUIRE(reader1.writerGone());
+    REQUIRE(reader1.wait(10));
+    for (uint32_t v = 5; v <= 8; ++v)
+    {
+        REQUIRE(readMessage(reader1) == v);
+    }
+    REQUIRE(!reader1.wait(10));
+
+    ShmRing late;
+    REQUIRE(!late.attach(testRing(), error));
+}
+
+TEST_CASE("The writer never overwrites a message a reader holds", "[shm ring]")
+{
+    using namespace rigid2d;
+
+    std::string error;
+    ShmRing writer;
+    REQUIRE(writer.create(testRing(), 3, 64, error));
+    ShmRing reader;
+    REQUIRE(reader.attach(testRing(), error));
+
+    REQUIRE(writeMessage(writer, 64, 1));
+    const uint8_t * held;
+    uint32_t size;
+    REQUIRE(reader.beginRead(held, size));
+
+    // the other two slots take turns while the held one is skipped
+    for (uint32_t v = 2; v <= 9; ++v)
+    {
+        REQUIRE(writeMessage(writer, 64, v));
+        REQUIRE(held[4] == 1);
+    }
+    reader.endRead();
+
+    // the oldest messages still in a slot come next
+    REQUIRE(readMessage(reader) == 8);
+    REQUIRE(readMessage(reader) == 9);
+
+    // with every slot held by readers, messages are refused instead of waited for
+    ShmRing readers[3];
+    for (uint32_t k = 0; k < 3; ++k)
+    {
+        REQUIRE(readers[k].attach(testRing(), error));
+        REQUIRE(writeMessage(writer, 64, 10 + k));
+        REQUIRE(readers[k].beginRead(held, size));
+    }
+    REQUIRE(!writer.beginWrite(64));
+    readers[1].endRead();
+    REQUIRE(writeMessage(writer, 64, 13));
+}
+
+TEST_CASE("The slot of a reader that died while reading is given back", "[shm ring]")
+{
+    using namespace rigid2d;
+
+    const std::string ringName = testRing();
+    std::string error;
+    ShmRing writer;
+    REQUIRE(writer.create(ringName, 1, 64, error));
+
+    // the child holds the only slot and exits without letting go of it
+    int ready[2], written[2];
+    REQUIRE(pipe(ready) == 0);
+    REQUIRE(pipe(written) == 0);
+    const pid_t child = fork();
+    REQUIRE(child >= 0);
+    if (child == 0)
+    {
+        ShmRing reader;
+        std::string childError;
+        const char ok = reader.attach(ringName, childError) ? 1 : 0;
+        (void)!write(ready[1], &ok, 1);
+        char c;
+        (void)!read(written[0], &c, 1);
+        const uint8_t * bytes;
+        uint32_t size;
+        const bool held = reader.beginRead(bytes, size);
+        _exit(held ? 0 : 1);
+    }
+
+    char ok = 0;
+    REQUIRE(read(ready[0], &ok, 1) == 1);
+    REQUIRE(ok == 1);
+    REQUIRE(writeMessage(writer, 64, 1));
+    REQUIRE(write(written[1], &ok, 1) == 1);
+    int status = 0;
+    REQUIRE(waitpid(child, &status, 0) == child);
+    REQUIRE(WIFEXITED(status));
+    REQUIRE(WEXITSTATUS(status) == 0);
+    for (int fd: {ready[0], ready[1], written[0], written[1]})
+    {
+        close(fd);
+    }
+
+    // the writer finds every slot held, frees the dead reader and goes on
+    REQUIRE(writeMessage(writer, 64, 2));
+    REQUIRE(writer.reclaimReaders() == 0);
+
+    // a live reader keeps its slot
+    ShmRing reader;
+    REQUIRE(reader.attach(ringName, error));
+    REQUIRE(writeMessage(writer, 64, 3));
+    const uint8_t * held;
+    uint32_t size;
+    REQUIRE(reader.beginRead(held, size));
+    REQUIRE(!writer.beginWrite(64));
+    reader.endRead();
+    REQUIRE(writeMessage(writer, 64, 4));
+}
+
+TEST_CASE("Readers on other threads see whole messages while the writer keeps going", "[shm ring]")
+{
+    using namespace rigid2d;
+
+    const uint32_t total = 200000;
+
+    std::string error;
+    ShmRing writer;
+    REQUIRE(writer.create(testRing(), 8, 4096, error));
+
+    std::atomic<int> ready{0};
+    std::vector<uint64_t> received(3, 0), lost(3, 0);
+    std::vector<int> torn(3, 0), disordered(3, 0);
+    std::vector<std::thread> threads;
+    for (int r = 0; r < 3; ++r)
+    {
+        threads.emplace_back([&, r]()
+        {
+            ShmRing reader;
+            std::string readerError;
+            if (!reader.attach(testRing(), readerError))
+            {
+                ++ready;
+                return;
+            }
+            ++ready;
+
+            uint32_t last = 0;
+            while (last < total)
+            {
+                if (!reader.wait(100))
+                {
+                    if (reader.writerGone())
+                    {
+                        break;
+                    }
+                    continue;
+                }
+                uint32_t v;
+                while ((v = readMessage(reader)) != 0)
+                {
+                    if (v == 0xffffffff)
+                    {
+                        ++torn[r];
+                        continue;
+                    }
+                    if (v <= last)
+                    {
+                        ++disordered[r];
+                    }
+                    last = v;
+                    ++received[r];
+                }
+            }
+            lost[r] = reader.lostMessages();
+        });
+    }
+    while (ready < 3)
+    {
+        std::this_thread::yield();
+    }
+
+    uint32_t refused = 0;
+    for (uint32_t v = 1; v <= total; ++v)
+    {
+        while (!writeMessage(writer, 8 + (v * 37) % 4000, v))
+        {
+            ++refused;
+        }
+    }
+    for (auto & t : threads)
+    {
+        t.join();
+    }
+
+    for (int r = 0; r < 3; ++r)
+    {
+        REQUIRE(torn[r] == 0);
+        REQUIRE(disordered[r] == 0);
+        REQUIRE(received[r] > 0);
+        REQUIRE(received[r] + lost[r] == total);
+    }
+    REQUIRE(refused == 0);
+}
@@ -1,19 +1,26 @@
-/// \file turtle_rect.cpp 
-/// \brief contains a node called turtle_rect which will make the turtle simulator move in a rectangular trajectory
-///        that is designated by the user (x, y, w, h). The movement is started by calling a /start service.
+/// \file turtle_rect.cpp
+/// \brief contains a node called turtle_rect which will make the turtle simulator visit a list of waypoints,
+///        either a rectangle that is designated by the user (x, y, w, h) or any polygon / waypoint list.
+///        The movement is started by calling a /start service.
 ///
 /// PARAMETERS:
 ///     max_xdot (double) : the maximum linear velocity
 ///     max_wdot (double) : the maximum angular velocity
 ///     frequency (int) : the frequency of the control loop
+///     k_heading (double) : proportional gain on the heading error (default 4.0)
+///     k_distance (double) : proportional gain on the distance to the waypoint (default 2.0)
+///     heading_tolerance (double) : heading error below which the turtle stops rotating and drives (default 0.01)
+///     distance_tolerance (double) : distance at which a waypoint counts as reached (default 0.05)
 /// PUBLISHES:
-///     turtle1/pose (turtlesim/Pose): The x, y, theta, linear velocity and angular velocity of the turtlesim
-/// SUBSCRIBES:
 ///     turtle1/cmd_vel (geometry_msgs/Twist): The linear and angular command velocity for the turtlesim.
+/// SUBSCRIBES:
+///     turtle1/pose (turtlesim/Pose): The x, y, theta, linear velocity and angular velocity of the turtlesim
 /// SERVICES:
 ///     trect/start (trect/Start): Clears the background of the turtle simulator, draws the desired trajectory
-///     in yellow, causes the robot to follow the rectangle (path in lavender), provides the location and dimensions
-///     of the rectangle to the node.
+///     in yellow, causes the robot to follow it (path in lavender). If waypoints_x / waypoints_y are given they
+///     are visited in order (returning to the first one if closed is true), otherwise the rectangle (x, y, width, height) is used.
+///
+/// The control loop runs on a timer that only runs while there are waypoints left, so the node sleeps between commands.
 
 
 /// Roughly followed tutorials provided by turtlesim page on ros wiki
@@ -30,8 +37,9 @@
 #include "turtlesim/Color.h"
 #include "std_srvs/Empty.h"
 
-#include <sstream>
-#include "std_msgs/String.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
 
 static const double PI = 3.14159265359;
 
@@ -41,35 +49,40 @@ static const double PI = 3.14159265359;
 
 bool start(trect::start::Request &req, trect::start::Response &res);
 void poseCallback(const turtlesim::Pose::ConstPtr & pose_msg);
+void controlTimer(const ros::TimerEvent & event);
 
 static ros::Publisher pub;
 static ros::Subscriber sub;
 static ros::ServiceServer start_service;
-static ros::ServiceClient start_client;
 static ros::ServiceClient setPen_client;
 static ros::ServiceClient teleAbs_client;
 static ros::ServiceClient teleRel_client;
 static ros::ServiceClient clear_client;
+static ros::Timer control_timer;
 
 static turtlesim::PoseConstPtr turtle_pose;
 
 /****************************
 * Declare states that the turtlesim will be in
 ****************************/
-enum State {Idle, bottomLine, rightLine, topLine, leftLine, Rotate};
+enum State {Idle, Rotate, Drive};
 
-static State currentState, previousState;
+static State currentState = Idle;
 
 /****************************
 * Declare global variables
 ****************************/
-static double width, height;
+struct Waypoint
+{
+    double x;
+    double y;
+};
 
-/****************************
-* Declare desired position of the turtle
-****************************/
-static double desiredX, desiredY, desiredTh;
+static std::vector<Waypoint> waypoints;
+static std::size_t target = 0;
 
+static double max_xdot, max_wdot;
+static double kHeading, kDistance, headingTol, distanceTol;
 
 /****************************
 * Main Function
@@ -85,9 +98,7 @@ int main(int argc, char* argv[])
     /**********************
     * Initialize local variables
     **********************/
-    double max_xdot, max_wdot, linVel, angVel;
     int frequency;
-    geometry_msgs::Twist msg;
 
     /**********************
     * Reads parameters from parameter server
@@ -95,12 +106,10 @@ int main(int argc, char* argv[])
     n.getParam("max_xdot", max_xdot);
     n.getParam("max_wdot", max_wdot);
     n.getParam("frequency", frequency);
-
-    /**********************
-    * Set the linear and angular velocity to maximum values
-    **********************/
-    linVel = max_xdot;
-    angVel = max_wdot;
+    n.param("k_heading", kHeading, 4.0);
+    n.param("k_distance", kDistance, 2.0);
+    n.param("heading_tolerance", headingTol, 0.01);
+    n.param("distance_tolerance", distanceTol, 0.05);
 
     /**********************
     * Define publisher, subscriber, service and clients
@@ -108,139 +117,22 @@ int main(int argc, char* argv[])
     pub = n.advertise<geometry_msgs::Twist>("/turtle1/cmd_vel", frequency);
     sub = n.subscribe("/turtle1/pose", 10, poseCallback);
     start_service = n.advertiseService("start", start);
-    start_client = n.serviceClient<trect::start>("start");
     setPen_client = n.serviceClient<turtlesim::SetPen>("turtle1/set_pen");
     teleAbs_client = n.serviceClient<turtlesim::TeleportAbsolute>("turtle1/teleport_absolute");
     teleRel_client = n.serviceClient<turtlesim::TeleportRelative>("turtle1/teleport_relative");
     clear_client = n.serviceClient<std_srvs::Empty>("clear");
-    
-    ros::Rate loop_rate(frequency);    // ensures a somewhat-consistent publishing frequency
+
+    /**********************
+    * The control timer is created stopped and only runs while following waypoints
+    **********************/
+    control_timer = n.createTimer(ros::Duration(1.0 / frequency), controlTimer, false, false);
 
     /**********************
     * Log parameters as ROS_INFO messages
     **********************/
     ROS_INFO("max_xdot: %f max_wdot: %f frequency: %d", max_xdot, max_wdot, frequency);
-    
-    while(ros::ok())
-    {
-        ros::spinOnce();
-        switch (currentState)
-        {
-            /**********************
-            * Idle : Turtle is Idle before moving in rectangle trajectory and after finishing moving in rectangle trajectory
-            * When turtle reaches corner, transitions to Rotate state
-            **********************/
-            case Idle:
-                msg.linear.x = 0;
-                msg.angular.z = 0;
-                pub.publish(msg);
-                break;
-            /**********************
-            * Bottom Line : When the turtle is moving along the bottom line of the rectangle trajectory
-            * When turtle reaches corner, transitions to Rotate state
-            **********************/
-            case bottomLine:
-                msg.linear.x = linVel;
-                msg.angular.z = 0;
-                if (desiredX - turtle_pose->x < 0)
-                {
-                    desiredTh = PI/2;                // update the desired angle of the turtle
-
-                    currentState = Rotate;
-                    previousState = bottomLine;
-                }
-                pub.publish(msg);
-                break;
-            /**********************
-            * Right Line : When the turtle is moving along the right line of the rectangle trajectory
-            * When turtle reaches corner, transitions to Rotate state
-            **********************/
-            case rightLine:
-                msg.linear.x = linVel;
-                msg.angular.z = 0;
-                if (desiredY - turtle_pose->y < 0)
-                {
-                    desiredTh = PI;
-
-                    currentState = Rotate;
-                    previousState = rightLine;
-                }
-                pub.publish(msg);
-                break;
-            /**********************
-            * Top Line : When the turtle is moving along the top line of the rectangle trajectory
-            * When turtle reaches corner, transitions to Rotate state
-            **********************/
-            case topLine:
-                msg.linear.x = linVel;
-                msg.angular.z = 0;
-
-                if (desiredX - turtle_pose->x > 0)
-                {
-                    desiredTh = -PI/2;
-
-                    currentState = Rotate;
-                    previousState = topLine;
-                }
-                pub.publish(msg);
-                break;
-            /**********************
-            * Left Line : When the turtle is moving along the left line of the rectangle trajectory
-            * When turtle reaches corner, transitions to Rotate state
-            **********************/
-            case leftLine:
-                msg.linear.x = linVel;
-                msg.angular.z = 0;
-
-                if (desiredY - turtle_pose->y > 0)
-                {
-                    desiredTh = 0;
-                    
-                    currentState = Idle;
-                    previousState = leftLine;
-                }
-                pub.publish(msg);
-                break;
-            /**********************
-            * Rotate : When the turtle is rotating at a corner of the rectangle trajectory
-            * Depending on the previous state of the turtle, will transition to new state of rectangle trajectory
-            **********************/
-            case Rotate:
-                msg.linear.x = 0;
-                msg.angular.z = angVel;
-
-                if (previousState == bottomLine)
-                {
-                    if (fabs(desiredTh - turtle_pose->theta) < 0.01)
-                    {
-                        desiredY += height;
-                        ROS_INFO("New desired y is %f", desiredY);
-                        currentState = rightLine;
-                        previousState = Rotate;
-                    }
-                }
-                else if (previousState == rightLine)
-                {
-                    if (fabs(desiredTh - turtle_pose->theta) < 0.01)
-                    {
-                        desiredX -= width;
-                        currentState = topLine;
-                        previousState = Rotate;
-                    }
-                }
-                else if (previousState == topLine)
-                {
-                    if (fabs(desiredTh - turtle_pose->theta) < 0.01)
-                    {
-                        desiredY -= height;
-                        currentState = leftLine;
-                        previousState = Rotate;
-                    }
-                }
-                pub.publish(msg);
-                break;
-        }
-    }  
+
+    ros::spin();
     return 0;
 }
 
@@ -248,6 +140,96 @@ int main(int argc, char* argv[])
 * Helper Function Declarations
 ************************************************************************/
 
+/// \brief wraps an angle to [-PI, PI]
+/// \param rad : the angle in radians
+/// \return the equivalent angle in [-PI, PI]
+static double wrapAngle(double rad)
+{
+    return atan2(sin(rad), cos(rad));
+}
+
+/// \brief saturates a value to [-limit, limit]
+static double clamp(double value, double limit)
+{
+    return std::max(-limit, std::min(limit, value));
+}
+
+/// \brief publishes a zero twist, stops the control timer and returns to Idle
+static void stopTurtle()
+{
+    geometry_msgs::Twist msg;
+    pub.publish(msg);
+    control_timer.stop();
+    currentState = Idle;
+}
+
+/// \brief control loop, called by the timer while there are waypoints left
+/// Closed-form heading and distance control toward the current waypoint:
+/// Rotate turns in place until the turtle faces the waypoint, Drive moves toward it while
+/// correcting the heading, and reaching it moves on to the next one.
+///
+/// \param event : the timer event
+void controlTimer(const ros::TimerEvent & event)
+{
+    if (!turtle_pose || (currentState == Idle))
+    {
+        return;
+    }
+
+    if (target >= waypoints.size())
+    {
+        ROS_INFO("Finished all %zu waypoints", waypoints.size());
+        stopTurtle();
+        return;
+    }
+
+    double dx = waypoints[target].x - turtle_pose->x;
+    double dy = waypoints[target].y - turtle_pose->y;
+    double distance = sqrt(dx * dx + dy * dy);
+    double headingErr = wrapAngle(atan2(dy, dx) - turtle_pose->theta);
+
+    geometry_msgs::Twist msg;
+
+    /**********************
+    * Waypoint reached : move on to the next one and face it
+    **********************/
+    if (distance < distanceTol)
+    {
+        ++target;
+        currentState = Rotate;
+        pub.publish(msg);
+        return;
+    }
+
+    switch (currentState)
+    {
+        /**********************
+        * Rotate : turn in place toward the waypoint, then drive
+        **********************/
+        case Rotate:
+            if (fabs(headingErr) < headingTol)
+            {
+                currentState = Drive;
+            } else
+            {
+                msg.angular.z = clamp(kHeading * headingErr, max_wdot);
+            }
+            break;
+        /**********************
+        * Drive : move toward the waypoint, slowing down as it gets close and
+        * while the heading is off
+        **********************/
+        case Drive:
+            msg.linear.x = std::min(max_xdot, kDistance * distance) * std::max(0.0, cos(headingErr));
+            msg.angular.z = clamp(kHeading * headingErr, max_wdot);
+            break;
+        case Idle:
+            break;
+    }
+
+    pub.publish(msg);
+}
+
 /// \brief callback function for subscriber
 ///
 /// \param pose_msg : the pose message for the subscriber
@@ -262,15 +244,34 @@ void poseCallback(const turtlesim::Pose::ConstPtr & pose_msg)
 /// \param res : The service response
 bool start(trect::start::Request &req, trect::start::Response &res)
 {
-    width = req.width;
-    height = req.height;
-
     /***************************
-    * Set the first desired location of the turtle
+    * Build the list of waypoints: the given polygon, or the rectangle
     ***************************/
-    desiredX = req.x + req.width;
-    desiredY = req.y;
-    desiredTh = 0;
+    if (req.waypoints_x.size() != req.waypoints_y.size())
+    {
+        ROS_ERROR("waypoints_x and waypoints_y must have the same length");
+        return false;
+    }
+
+    waypoints.clear();
+    if (!req.waypoints_x.empty())
+    {
+        for (std::size_t i = 0; i < req.waypoints_x.size(); ++i)
+        {
+            waypoints.push_back({req.waypoints_x[i], req.waypoints_y[i]});
+        }
+        if (req.closed)
+        {
+            waypoints.push_back(waypoints.front());
+        }
+    } else
+    {
+        waypoints.push_back({req.x, req.y});
+        waypoints.push_back({req.x + req.width, req.y});
+        waypoints.push_back({req.x + req.width, req.y + req.height});
+        waypoints.push_back({req.x, req.y + req.height});
+        waypoints.push_back({req.x, req.y});
+    }
 
     /***************************
     * Set color of the pen to pastel yellow
@@ -291,7 +292,6 @@ bool start(trect::start::Request &req, trect::start::Response &res)
     ros::param::set("sim/background_r", 255);
     ros::param::set("sim/background_g", 192);
     ros::param::set("sim/background_b", 203);
-    ros::spinOnce();
 
     /***************************
     * Clear the background of the turtle simulator
@@ -299,13 +299,18 @@ bool start(trect::start::Request &req, trect::start::Response &res)
     setPen_client.call(turtle_pen);
     clear_client.call(empty);
 
-    turtle_absPos.request.x = req.x;
-    turtle_absPos.request.y = req.y;
-    turtle_absPos.request.theta = 0;
-
     /***************************
-    * Move turtle to designated start position
+    * Move turtle to the first waypoint, facing the second
     ***************************/
+    turtle_absPos.request.x = waypoints[0].x;
+    turtle_absPos.request.y = waypoints[0].y;
+    turtle_absPos.request.theta = 0;
+    if (waypoints.size() > 1)
+    {
+        turtle_absPos.request.theta = atan2(waypoints[1].y - waypoints[0].y, waypoints[1].x - waypoints[0].x);
+    }
+    double startTheta = turtle_absPos.request.theta;
+
     teleAbs_client.call(turtle_absPos);
 
     /***************************
@@ -314,18 +319,21 @@ bool start(trect::start::Request &req, trect::start::Response &res)
     clear_client.call(empty);
 
     /***************************
-    * Have turtle draw the rectangle in indigo
+    * Have turtle draw the trajectory in yellow, then return to the start
     ***************************/
-    turtle_absPos.request.x += width;
-    teleAbs_client.call(turtle_absPos);
-
-    turtle_absPos.request.y += height;
-    teleAbs_client.call(turtle_absPos);
+    for (std::size_t i = 1; i < waypoints.size(); ++i)
+    {
+        turtle_absPos.request.x = waypoints[i].x;
+        turtle_absPos.request.y = waypoints[i].y;
+        teleAbs_client.call(turtle_absPos);
+    }
 
-    turtle_absPos.request.x -= width;
-    teleAbs_client.call(turtle_absPos);
+    turtle_pen.request.off = 1;
+    setPen_client.call(turtle_pen);
 
-    turtle_absPos.request.y -= height;
+    turtle_absPos.request.x = waypoints[0].x;
+    turtle_absPos.request.y = waypoints[0].y;
+    turtle_absPos.request.theta = startTheta;
     teleAbs_client.call(turtle_absPos);
 
     /****************************
@@ -334,11 +342,14 @@ bool start(trect::start::Request &req, trect::start::Response &res)
     turtle_pen.request.r = 182;
     turtle_pen.request.g = 104;
     turtle_pen.request.b = 182;
+    turtle_pen.request.off = 0;
     setPen_client.call(turtle_pen);
 
     /***************************
-    * Put turtle in bottom line state
+    * Head for the second waypoint and start the control timer
     ***************************/
-    currentState = bottomLine;
+    target = 1;
+    currentState = Rotate;
+    control_timer.start();
     return true;
-}
\ No newline at end of file
+}